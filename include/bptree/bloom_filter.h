@@ -0,0 +1,105 @@
+#pragma once
+
+/// @file bloom_filter.h
+/// @brief In-memory filter over the tree's keys that answers "definitely
+///        absent" without a descent.
+///
+/// Design:
+///   - Blocked Bloom filter: a key sets `k` bits inside one 512-bit block
+///     chosen by its hash, so adding or probing touches one cache line.
+///     `k` is `bits_per_key * ln 2`, the optimum for a standard filter.
+///   - Layers: the filter starts sized for a number of keys.  Once a layer
+///     has taken that many, a layer for twice as many takes the adds from
+///     then on, and a probe checks every layer.  The rates of the layers add
+///     up, so each new one gets `kExtraBitsPerLayer` more bits per key,
+///     which halves its rate: all of them together stay within twice that
+///     of the first (a scalable Bloom filter).
+///   - Bits are never cleared, so a removed key keeps answering "maybe"
+///     until the filter is built again.
+///
+/// Concurrency:
+///   `Add` and `MayContain` are lock-free and may run concurrently; only
+///   adding a layer takes a latch.  A probe that starts after an `Add` has
+///   returned sees the key.
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+
+namespace bptree {
+
+/// What a filter holds, and how often it is expected to be wrong.
+struct BloomFilterStats {
+    size_t layers = 0;
+    size_t bits   = 0;   ///< all layers
+    size_t keys   = 0;   ///< adds, removed keys and repeats included
+    /// Chance that a key never added passes `MayContain`, from how many
+    /// bits of each block are set.
+    double estimated_fpr = 0;
+};
+
+class BloomFilter {
+public:
+    /// A filter of @p bits_per_key bits for each of @p capacity keys in its
+    /// first layer.
+    BloomFilter(size_t bits_per_key, size_t capacity);
+
+    // Non-copyable, non-movable.
+    BloomFilter(const BloomFilter&)            = delete;
+    BloomFilter& operator=(const BloomFilter&) = delete;
+
+    /// Add the key with hash @p hash (a well-mixed 64-bit hash).
+    void Add(uint64_t hash);
+
+    /// False if no key with hash @p hash was ever added.
+    [[nodiscard]] bool MayContain(uint64_t hash) const;
+
+    /// Scans every bit: meant for reporting, not the lookup path.
+    [[nodiscard]] BloomFilterStats Stats() const;
+
+    /// Of the first layer.
+    [[nodiscard]] size_t BitsPerKey() const { return bits_per_key_; }
+    [[nodiscard]] int    Hashes()     const { return layers_[0]->hashes; }
+
+    /// Smallest first layer, in keys.
+    static constexpr size_t kMinCapacity = 1024;
+
+private:
+    static constexpr size_t kBlockBits  = 512;
+    static constexpr size_t kBlockWords = kBlockBits / 64;
+    static constexpr int    kMaxLayers  = 48;
+
+    /// log2(e) bits per key halve a filter's false-positive rate.
+    static constexpr double kExtraBitsPerLayer = 1.5;
+
+    struct Layer {
+        /// Sized for @p capacity keys at @p bits_per_key.
+        Layer(size_t capacity, double bits_per_key);
+
+        size_t blocks;
+        size_t capacity;                  ///< keys it was sized for
+        int    hashes;                    ///< bits set per key
+        std::atomic<size_t> keys{0};      ///< keys added to it
+        std::unique_ptr<std::atomic<uint64_t>[]> storage;
+        std::atomic<uint64_t>* words = nullptr;  ///< storage, line-aligned
+    };
+
+    /// The masks of the block words @p hash sets, and the block.
+    size_t Masks(const Layer& layer, uint64_t hash, uint64_t* masks) const;
+
+    /// Add a layer after @p full, unless another thread already has.
+    void Grow(int full);
+
+    size_t bits_per_key_;
+
+    /// layers_[0, num_layers_) are set and never change; the count is
+    /// published after the layer.
+    std::array<std::unique_ptr<Layer>, kMaxLayers> layers_;
+    std::atomic<int> num_layers_{0};
+    std::mutex       grow_latch_;  ///< One thread adds a layer.
+};
+
+}  // namespace bptree
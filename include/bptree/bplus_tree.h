@@ -3,16 +3,29 @@
 /// @file bplus_tree.h
 /// @brief Disk-based B+ tree index with insert, point query, range query,
 ///        and delete with rebalancing.  Uses BufferPool for page-level caching
-///        over DiskManager.
+///        over DiskManager.  Templated on the key type and its order.
 
 #include "config.h"
 #include "status.h"
 #include "disk_manager.h"
 #include "buffer_pool.h"
+#include "bloom_filter.h"
+#include "options.h"
+#include "page.h"
 #include "wal.h"
 
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <functional>
 #include <memory>
+#include <mutex>
+#include <optional>
+#include <shared_mutex>
 #include <string>
+#include <string_view>
+#include <type_traits>
 #include <vector>
 #include <utility>
 
@@ -23,15 +36,56 @@ class TreeVisualizer;
 
 /// A persistent, disk-backed B+ tree index.
 ///
-/// Supports integer keys and fixed-size (100-byte) data payloads.
-/// Data is stored on disk via memory-mapped I/O and survives restarts.
-/// A buffer pool (LRU) sits between the tree and the disk to cache hot pages.
+/// Maps fixed-size @p Key keys, ordered by @p Compare, to byte-string
+/// values of any length up to MAX_VALUE_SIZE.  `BPlusTree` is the tree with
+/// int keys.
+/// Data is stored in one file and survives restarts.  The file is read
+/// and written through a memory mapping or, with `DiskBackend::kDirect`,
+/// with O_DIRECT `pread` / `pwrite` (`Options::disk_backend`).
+/// A buffer pool sits between the tree and the disk to cache hot pages; its
+/// replacement policy (LRU, CLOCK or LRU-K) is `Options::replacement_policy`.
 ///
-/// Delete operations properly rebalance the tree by redistributing or
-/// merging underful nodes.
+/// Deletes rebalance the tree by redistributing or merging underfull
+/// nodes.  How full a node must stay is `Options::merge_threshold`: below 1
+/// nodes drain further before they borrow or merge, and at 0 only empty
+/// leaves and internal nodes down to one child are merged.
+///
+/// @par Values
+/// Leaves are slotted pages holding as many records as their values leave
+/// room for.  A value longer than `LeafPage::kMaxInlineValue` (about a
+/// quarter of a page) is stored on a chain of overflow pages and the leaf
+/// keeps only its length and first page.  Values are arbitrary bytes,
+/// including NULs.
+///
+/// @par Key types
+/// @p Key is stored as its raw bytes, so it must be trivially copyable;
+/// @p Compare is a default-constructible strict weak order on it.  Page
+/// layouts are compile-time constants of sizeof(Key), and in-page searches
+/// are specialised at compile time: signed 32- and 64-bit integers in
+/// ascending order get the SIMD count of key_search.h, other types and
+/// orders a branch-free binary search through @p Compare.  An index file
+/// records its key size and cannot be opened with keys of another size.
+///
+/// Keys must be 4 or 8 bytes wide: recovery replays log records into pages
+/// of those two layouts only.  The member functions are compiled once in
+/// bplus_tree.cpp for int32_t and int64_t keys with std::less; other 4- and
+/// 8-byte key types or orders are added there.
 ///
 /// @par Thread safety
-/// Not thread-safe.  External locking is required for concurrent access.
+/// `Search`, `RangeQuery`, `Scan`, `Insert` and `Delete` may be called, and
+/// cursors used, from any number of threads.  Every buffer pool frame
+/// carries a reader/writer latch and a version that is odd while the page
+/// is exclusively latched.  Point lookups and writers descend optimistically
+/// (`Options::optimistic_reads`): they read the internal nodes without
+/// latching them, validate each node's version after reading it, and
+/// restart on a mismatch.  Only the leaf is latched, shared for a lookup and
+/// exclusive for a writer, and kept only if its parent still validates.
+/// After a few failed attempts, and for scans and range queries, the
+/// descent falls back to latch crabbing with shared latches on at most a
+/// parent and a child.  A writer whose leaf is full or would underflow
+/// starts over with exclusive crabbing from the root, keeping latches on
+/// the nodes that may split or merge.  `Sync` and `Checkpoint` are safe to
+/// call concurrently with the above.
 ///
 /// @par Example
 /// @code
@@ -43,38 +97,147 @@ class TreeVisualizer;
 ///       std::cout << value << std::endl;
 ///   }
 /// @endcode
-class BPlusTree {
+template <typename Key, typename Compare = std::less<Key>>
+class BasicBPlusTree {
+    static_assert(std::is_trivially_copyable_v<Key>, "keys are stored as raw bytes");
+    static_assert(sizeof(Key) == sizeof(int32_t) || sizeof(Key) == sizeof(int64_t),
+                  "recovery knows only 4- and 8-byte key layouts");
+
 public:
+    using key_type    = Key;
+    using key_compare = Compare;
+
     /// Open (or create) a B+ tree backed by the given file.
     /// @param index_file  Path to the index file.
     /// @param pool_size   Number of buffer pool frames (default 1024 = 4 MB).
     /// @param enable_wal  Enable write-ahead logging for crash recovery.
-    explicit BPlusTree(const std::string& index_file = DEFAULT_INDEX_FILE,
-                       size_t pool_size = DEFAULT_POOL_SIZE,
-                       bool enable_wal = true);
-    ~BPlusTree();
+    /// @throws std::runtime_error if the file holds keys of another size or
+    ///         its log has changes that cannot be redone.
+    explicit BasicBPlusTree(const std::string& index_file = DEFAULT_INDEX_FILE,
+                            size_t pool_size = DEFAULT_POOL_SIZE,
+                            bool enable_wal = true);
+
+    /// Open (or create) a B+ tree backed by the given file.
+    /// @param index_file  Path to the index file.
+    /// @param options     Buffer pool and WAL settings.
+    /// @throws std::runtime_error if the file holds keys of another size or
+    ///         its log has changes that cannot be redone.
+    BasicBPlusTree(const std::string& index_file, const Options& options);
+    ~BasicBPlusTree();
 
     // Non-copyable
-    BPlusTree(const BPlusTree&)            = delete;
-    BPlusTree& operator=(const BPlusTree&) = delete;
+    BasicBPlusTree(const BasicBPlusTree&)            = delete;
+    BasicBPlusTree& operator=(const BasicBPlusTree&) = delete;
 
     // -- Core operations -----------------------------------------------------
 
-    /// Insert a key-value pair (upsert semantics).
-    Status Insert(key_t key, const char* data);
+    /// Insert a key-value pair (upsert semantics): the @p len bytes at
+    /// @p data.
+    /// @return InvalidArg if @p len exceeds MAX_VALUE_SIZE.
+    Status Insert(Key key, const char* data, size_t len);
+
+    /// Insert a NUL-terminated string value (without the NUL).
+    Status Insert(Key key, const char* value) {
+        return Insert(key, value, std::strlen(value));
+    }
 
-    /// Point lookup (raw buffer).
-    Status Search(key_t key, char* data_out) const;
+    /// Point lookup into a caller buffer.  Copies at most @p buf_size bytes
+    /// of the value to @p buf; @p len receives its full length, so a short
+    /// buffer is detected by len > buf_size.
+    Status Search(Key key, char* buf, size_t buf_size, size_t& len) const;
 
     /// Point lookup (std::string).
-    Status Search(key_t key, std::string& value_out) const;
+    Status Search(Key key, std::string& value_out) const;
+
+    /// Delete a key.  Rebalances nodes that drain below
+    /// `Options::merge_threshold` via redistribute / merge.
+    Status Delete(Key key);
+
+    // -- Batches -------------------------------------------------------------
 
-    /// Delete a key.  Rebalances underful nodes via redistribute / merge.
-    Status Delete(key_t key);
+    /// Look up every key in @p keys, in any order.  On return values[i] holds
+    /// the value of keys[i] if statuses[i] is OK.  The keys are visited in
+    /// sorted order and consecutive keys that fall into the same leaf share
+    /// one descent; moving on re-descends only from the lowest ancestor
+    /// whose key range still holds the next key.
+    std::vector<Status> MultiGet(const std::vector<Key>& keys,
+                                 std::vector<std::string>& values) const;
+
+    /// Insert (upsert) every record of @p records, in any order.  Of
+    /// records with the same key the last one wins.  Records are applied
+    /// in key order, sharing descents like `MultiGet`; only a record that
+    /// splits its leaf takes the full `Insert` path.  Holds the leaf it is
+    /// filling exclusively and its ancestors shared, so other writers on
+    /// those nodes wait.
+    Status InsertBatch(const std::vector<std::pair<Key, std::string>>& records);
 
     /// Range query -- returns all records with keys in [lower, upper].
-    Status RangeQuery(key_t lower, key_t upper,
-                      std::vector<std::pair<key_t, std::string>>& results) const;
+    /// Copies every value; prefer `Scan` or a `Cursor` for large ranges.
+    Status RangeQuery(Key lower, Key upper,
+                      std::vector<std::pair<Key, std::string>>& results) const;
+
+    // -- Scans ---------------------------------------------------------------
+
+    /// Called by `Scan` for each record in key order.  @p value points into
+    /// the pinned leaf (or a copy of an overflow value) and is only valid
+    /// during the call.
+    /// @return false to stop the scan.
+    using ScanCallback = std::function<bool(Key key, std::string_view value)>;
+
+    /// Visit the records with keys in [lower, upper] in ascending order,
+    /// without copying them.  Stops after @p limit records or when @p fn
+    /// returns false.
+    /// @return InvalidArg if lower > upper.
+    Status Scan(Key lower, Key upper, const ScanCallback& fn,
+                size_t limit = SIZE_MAX) const;
+
+    class Cursor;
+
+    /// A cursor over @p this tree, not yet positioned.
+    [[nodiscard]] Cursor NewCursor() const;
+
+    // -- Bulk loading --------------------------------------------------------
+
+    /// Produces the records of a bulk load: stores the next key in @p key
+    /// and its value in @p value, which must stay valid until the next call.
+    /// @return false once there are no more records.
+    using BulkLoadSource = std::function<bool(Key& key, std::string_view& value)>;
+
+    /// Build the tree bottom-up from records in strictly increasing key
+    /// order.  Leaves are packed left to right with @p fill_factor of their
+    /// capacity in use, then each internal level is built on top of the one
+    /// below.  Nothing is logged; the tree is checkpointed once it is
+    /// complete, and if the process dies before that it comes back empty.
+    /// Other operations wait until the load is done.
+    ///
+    /// @param fill_factor  Fraction of each node to fill, in (0, 1].  Nodes
+    ///                     never get less than their minimum occupancy.
+    /// @return InvalidArg if the tree is not empty, the fill factor is out
+    ///         of range, a value is too long or the keys are not strictly
+    ///         increasing (the tree is left empty).
+    Status BulkLoad(const BulkLoadSource& next, double fill_factor = 1.0);
+
+    /// Bulk load the (key, value) pairs in [first, last); values are
+    /// anything convertible to std::string_view.
+    template <typename Iter>
+    Status BulkLoad(Iter first, Iter last, double fill_factor = 1.0) {
+        // An iterator that yields pairs by value would leave the view
+        // dangling once it moves on, so those values are copied.
+        std::string copy;
+        return BulkLoad([&](Key& key, std::string_view& value) {
+            if (first == last) return false;
+            const auto& [k, v] = *first;
+            key = k;
+            if constexpr (std::is_reference_v<decltype(*first)>) {
+                value = std::string_view(v);
+            } else {
+                copy.assign(std::string_view(v));
+                value = copy;
+            }
+            ++first;
+            return true;
+        }, fill_factor);
+    }
 
     // -- Utilities -----------------------------------------------------------
 
@@ -82,58 +245,452 @@ public:
     void Sync();
     [[nodiscard]] std::string FilePath() const;
 
-    /// Force a WAL checkpoint: flush all dirty pages, then truncate the log.
+    /// Force a WAL checkpoint.  The checkpoint is fuzzy: writers wait only
+    /// while the buffer pool's dirty page table is captured, then proceed
+    /// while those pages are written; the log is then cut back to the
+    /// checkpoint's begin record.
     void Checkpoint();
 
+    /// Give the space of freed pages back to the file system: move the
+    /// pages past the tree's own size into the free slots below it, in
+    /// key order for the leaves, point everything at the new places and
+    /// cut the file there.  Writers wait meanwhile, and so does every read
+    /// that descends from the root under latches: a lookup whose
+    /// optimistic descent fails or is turned off, and the start of a scan,
+    /// range query or cursor seek.  Optimistic lookups and cursors already
+    /// on a leaf carry on, but a thread holding a cursor must not call it.
+    /// The new layout is checkpointed (flushed without a WAL) before the
+    /// file shrinks.  A compressed file frees its slots instead.
+    /// @return IOError if a page could not be pinned.  The tree is intact
+    ///         but the file keeps its size, and its free pages are not
+    ///         reused until a later run reclaims them.
+    Status Compact();
+
+    /// Pages allocated in the index file, including the metadata page and
+    /// pages on the free list.
+    [[nodiscard]] size_t PageCount() const;
+
     /// Buffer pool statistics.
     [[nodiscard]] size_t BufferPoolHits()   const;
     [[nodiscard]] size_t BufferPoolMisses() const;
     [[nodiscard]] double BufferPoolHitRate() const;
+    [[nodiscard]] size_t BufferPoolShards()  const;
+    [[nodiscard]] ShardStats BufferPoolShardStats(size_t shard) const;
+
+    /// Pages loaded by scan read-ahead, and how many of them were then used.
+    [[nodiscard]] size_t BufferPoolPrefetches()    const;
+    [[nodiscard]] size_t BufferPoolPrefetchHits()  const;
+
+    /// Pages written back by the page cleaner, and pages dirty right now.
+    [[nodiscard]] size_t BufferPoolCleanerWrites() const;
+    [[nodiscard]] size_t BufferPoolDirtyPages()    const;
+
+    /// Internal pages whose child pointers are swizzled right now.
+    [[nodiscard]] size_t BufferPoolSwizzledPages() const;
 
     /// WAL statistics.
     [[nodiscard]] size_t WALBytesWritten()   const;
     [[nodiscard]] size_t WALRecordsWritten() const;
+    [[nodiscard]] size_t WALSyncCount()      const;
     [[nodiscard]] bool   WALEnabled()        const;
 
+    /// What crash recovery did when the tree was opened.
+    [[nodiscard]] RecoveryStats WALRecoveryStats() const;
+
+    /// Optimistic descents that found a node changed under them and
+    /// started again (see Options::optimistic_reads).
+    [[nodiscard]] size_t OptimisticRestarts() const;
+
+    /// Size and estimated false-positive rate of the key filter (see
+    /// Options::bloom_bits_per_key); all zero without one.  Scans the
+    /// whole filter.
+    [[nodiscard]] BloomFilterStats FilterStats() const;
+
     // Allow visualizer to inspect tree internals
     friend class TreeVisualizer;
 
 private:
+    using Leaf     = BasicLeafPage<Key>;
+    using Internal = BasicInternalPage<Key>;
+
+    /// Latches held by one Insert / Delete (latch crabbing).
+    ///
+    /// `path` lists the exclusively latched, pinned pages from the highest
+    /// ancestor that may still change down to the current node.  Ancestors
+    /// are released as soon as a node is found to be safe (it can absorb the
+    /// operation without splitting / underflowing).  Pages unlinked by merges
+    /// are freed only after every latch is dropped, as are the overflow
+    /// chains of values that were overwritten or deleted, and only once the
+    /// records that unlinked them are durable.  The destructor releases
+    /// everything that is still held.
+    struct WriteContext {
+        WriteContext(BasicBPlusTree& t, bool lock_root);
+        ~WriteContext();
+
+        WriteContext(const WriteContext&)            = delete;
+        WriteContext& operator=(const WriteContext&) = delete;
+
+        BasicBPlusTree&                     tree;
+        std::unique_lock<std::shared_mutex> root_lock;  ///< Held while the root may change.
+        int64_t              root  = INVALID_PAGE_ID;   ///< Root offset when the descent began.
+        std::vector<int64_t> path;
+        std::vector<int64_t> freed;
+        std::vector<int64_t> overflow;                   ///< First pages of dead chains.
+        uint64_t             drop_lsn = 0;               ///< Last record unlinking a freed page.
+        bool                 found = false;              ///< Delete: the key was present.
+    };
+
     // -- Page access helpers (through buffer pool) ---------------------------
-    char* PinPage(int64_t page_id) const;
-    void  UnpinPage(int64_t page_id, bool dirty) const;
+    char* PinPage(int64_t page_id, LatchMode mode = LatchMode::kNone) const;
+    void  UnpinPage(int64_t page_id, bool dirty,
+                    LatchMode mode = LatchMode::kNone) const;
     char* AllocPage(int64_t& page_id);
     void  DeallocPage(int64_t page_id);
 
+    // -- WAL logging (the page must be exclusively latched) ------------------
+
+    /// Log the whole page @p page and stamp its page LSN.  Used for new pages
+    /// and for changes that have no record-level form.
+    void LogPage(int64_t page_id, char* page);
+
+    /// Log a change just made to @p page as record @p type with @p len bytes
+    /// of payload, or as a full-page write if it is the first change to the
+    /// page since the last checkpoint.  Stamps the page LSN.
+    void LogChange(int64_t page_id, char* page, LogRecordType type,
+                   const void* payload, uint32_t len);
+
+    /// `LogChange` for an insert or update of record @p slot of a leaf.
+    void LogLeafSlot(int64_t leaf_off, char* page, LogRecordType type, int slot);
+
+    /// Trade a shared latch on a pinned page for an exclusive one.  Only safe
+    /// while a latch above the page prevents it from being split or merged.
+    char* RelatchExclusive(int64_t page_id) const;
+
+    /// Unlatch every page on ctx.path except the last, and the root latch.
+    void ReleaseAncestors(WriteContext& ctx) const;
+
+    /// Unlatch all of ctx.path, then free the pages in ctx.freed and the
+    /// chains in ctx.overflow.
+    void ReleaseAll(WriteContext& ctx);
+
+    // -- Values --------------------------------------------------------------
+
+    /// Build the leaf cell for the @p len-byte value at @p data in @p cell
+    /// (Leaf::kMaxCellSize bytes), writing the value to overflow pages if it
+    /// is too long to keep inline.  Overflow pages are logged if @p log.
+    Status MakeCell(const char* data, size_t len, char* cell, bool log = true);
+
+    /// Store @p len bytes of @p data on a new chain of overflow pages.
+    /// @return The first page, or INVALID_PAGE_ID if allocation failed.
+    int64_t WriteOverflow(const char* data, size_t len, bool log);
+
+    /// Free the chain of overflow pages starting at @p head.
+    void FreeOverflow(int64_t head);
+
+    /// Append the @p len-byte value on the chain at @p head to @p out.
+    /// Chains never change once written and are freed only after their leaf
+    /// stops referring to them, so a latch on that leaf is all a reader
+    /// needs.
+    Status ReadOverflow(int64_t head, size_t len, std::string& out) const;
+
+    /// The value of record @p slot of @p leaf, wherever it is stored.
+    Status ReadValue(const Leaf& leaf, int slot, std::string& out) const;
+
     // -- Tree navigation -----------------------------------------------------
-    int64_t SearchLeaf(key_t key) const;
+
+    /// What a descent learnt about the leaf it reached.
+    struct LeafBounds {
+        /// Every key in the leaf is >= low (nullopt for the leftmost leaf).
+        std::optional<Key> low;
+        /// Every key under the leaf's parent is < parent_high, which is the
+        /// first key of the next parent's subtree (nullopt if the parent is
+        /// the rightmost on its level, or the leaf is the root).
+        std::optional<Key> parent_high;
+        /// If set, receives the leaves to the right of this one under the
+        /// same parent, in order.
+        std::vector<int64_t>* siblings = nullptr;
+    };
+
+    /// Descend to the leaf that may contain @p key (the leftmost leaf if
+    /// it is nullopt) with shared latch crabbing.  If @p before, descend
+    /// instead to the leaf that may hold the largest key < @p key (the
+    /// rightmost leaf if it is nullopt).  The leaf is returned pinned and
+    /// latched in @p leaf_mode; the caller must release it with
+    /// `UnpinPage(leaf_off, ..., leaf_mode)`.  If @p bounds is given it is
+    /// filled in on the way down.
+    /// @return nullptr if the tree is empty.
+    char* SearchLeaf(const std::optional<Key>& key, LatchMode leaf_mode,
+                     int64_t& leaf_off, LeafBounds* bounds = nullptr,
+                     bool before = false) const;
+
+    /// True if the key filter rules @p key out (counted as a negative).
+    bool FilterExcludes(const Key& key) const;
+
+    /// Fill filter_ with the keys in the leaves.
+    void BuildFilter(size_t bits_per_key);
+
+    /// Descents an optimistic search makes before it falls back to crabbing.
+    static constexpr int kOptimisticAttempts = 4;
+
+    /// The plain-key case of `SearchLeaf` without latching internal nodes:
+    /// read each one through `BufferPool::ReadOptimistic`, validating it
+    /// before its child is trusted, and restart on a conflict.  Only the
+    /// leaf is pinned and latched, after which its parent is validated once
+    /// more, so no split or merge can have moved the key elsewhere.
+    /// @return false to fall back to crabbing: a node is not resident, the
+    ///         attempts ran out, or a page is not in the current layout.
+    ///         Otherwise @p page is the leaf (nullptr if the tree is empty).
+    bool SearchLeafOptimistic(Key key, LatchMode leaf_mode, int64_t& leaf_off,
+                              char*& page) const;
+
+    // -- Batch helpers -------------------------------------------------------
+
+    /// A root-to-leaf path that stays latched across the keys of a batch:
+    /// internal nodes shared, the leaf in `leaf_mode`.  Each node records the
+    /// separator its keys stay below (nullopt on the right edge).
+    struct BatchPath {
+        struct Node {
+            int64_t              off;
+            char*                page;
+            std::optional<Key> high;
+        };
+        std::vector<Node> nodes;
+        LatchMode         leaf_mode = LatchMode::kShared;
+    };
+
+    /// Latch the path to the leaf for @p key.  Nodes of the current path
+    /// whose ranges still hold the key are kept; below the lowest of them
+    /// the path is released and descended again.  Keys must come in
+    /// ascending order.
+    /// @return The leaf page, or nullptr (with nothing latched) if the tree
+    ///         is empty.
+    char* BatchSeek(BatchPath& path, Key key) const;
+
+    /// Unlatch and unpin everything on @p path.
+    void BatchRelease(BatchPath& path) const;
 
     // -- Insert helpers ------------------------------------------------------
-    bool InsertRecursive(int64_t node_off, key_t key, const char* data,
-                         key_t& split_key, int64_t& new_off);
-    bool InsertIntoLeaf(int64_t leaf_off, key_t key, const char* data,
-                        key_t& split_key, int64_t& new_leaf_off);
-    bool InsertIntoInternal(int64_t node_off, key_t key, int64_t child_off,
-                            key_t& split_key, int64_t& new_node_off);
+
+    /// Insert with exclusive crabbing from the root, splitting as needed.
+    /// @pre checkpoint_latch_ is held shared; @p cell is from `MakeCell`.
+    Status InsertPessimistic(Key key, const char* cell);
+    bool InsertRecursive(WriteContext& ctx, int64_t node_off, Key key,
+                         const char* cell, Key& split_key, int64_t& new_off);
+    /// Store @p cell under @p key in the leaf, splitting it by bytes if it
+    /// has no room.  The overflow chain of a replaced value is queued on
+    /// ctx.overflow.
+    bool InsertIntoLeaf(WriteContext& ctx, int64_t leaf_off, Key key, const char* cell,
+                        Key& split_key, int64_t& new_leaf_off);
+    bool InsertIntoInternal(int64_t node_off, Key key, int64_t child_off,
+                            Key& split_key, int64_t& new_node_off);
 
     // -- Delete helpers (with rebalancing) ------------------------------------
     // Returns true if the child became underful and the parent should fix it.
-    bool DeleteRecursive(int64_t node_off, key_t key);
-    bool DeleteFromLeaf(int64_t leaf_off, key_t key);
-    void FixChild(int64_t parent_off, int child_idx);
-    void FixLeafChild(int64_t parent_off, int child_idx);
-    void FixInternalChild(int64_t parent_off, int child_idx);
+    bool DeleteRecursive(WriteContext& ctx, int64_t node_off, Key key);
+    bool DeleteFromLeaf(WriteContext& ctx, int64_t leaf_off, Key key);
+    void FixChild(WriteContext& ctx, int64_t parent_off, int child_idx);
+    void FixLeafChild(WriteContext& ctx, int64_t parent_off, int child_idx);
+    void FixInternalChild(WriteContext& ctx, int64_t parent_off, int child_idx);
+
+    /// Sharp checkpoint: flush every dirty page and empty the log.
+    /// @pre checkpoint_latch_ is held exclusively and the WAL is enabled.
+    void CheckpointLocked();
+
+    /// `Compact`: point the references of @p page (children, next leaf,
+    /// overflow chains) at new places; @p moved maps page numbers to their
+    /// new offsets, INVALID_PAGE_ID for pages that stay.
+    void RemapReferences(char* page, const std::vector<int64_t>& moved) const;
 
     // -- Metadata ------------------------------------------------------------
     void WriteMetadata();
     void ReadMetadata();
 
+    /// Bring a file from an older format version up to FILE_FORMAT_VERSION
+    /// by rewriting its pages in the current layouts.
+    void UpgradeFormat();
+
     // -- State ---------------------------------------------------------------
     std::unique_ptr<DiskManager>   disk_;
     std::unique_ptr<WriteAheadLog> wal_;    ///< Destroyed AFTER pool_.
     std::unique_ptr<BufferPool>    pool_;   ///< Destroyed first (may flush via WAL).
-    int64_t root_offset_      = INVALID_PAGE_ID;
-    int64_t next_page_offset_ = PAGE_SIZE;
+    /// Atomic so optimistic descents can read it without root_latch_.
+    std::atomic<int64_t> root_offset_{INVALID_PAGE_ID};
+
+    Compare less_;                  ///< Key order
+    size_t scan_read_ahead_  = 0;   ///< Options::scan_read_ahead
+    bool   optimistic_reads_ = true;  ///< Options::optimistic_reads
+
+    /// A non-root node below these underflows: Options::merge_threshold of
+    /// Leaf::kMinUsed and Internal::kMinKeys (at least one key).
+    size_t leaf_min_used_     = Leaf::kMinUsed;
+    int    internal_min_keys_ = Internal::kMinKeys;
+
+    /// Hashes of every key added since the tree was opened; null without
+    /// Options::bloom_bits_per_key.
+    std::unique_ptr<BloomFilter> filter_;
+
+    /// Restarts of optimistic descents (written only on a conflict).
+    mutable std::atomic<size_t> optimistic_restarts_{0};
+
+    /// Guards root_offset_.  Readers hold it shared until the root page is
+    /// latched; writers hold it exclusively while the root may split/shrink.
+    mutable std::shared_mutex root_latch_;
+
+    /// Writers hold it shared for a whole operation, `Checkpoint` holds it
+    /// exclusively while it takes the dirty page table and logs its begin
+    /// record, so no operation straddles the redo point.
+    std::shared_mutex checkpoint_latch_;
+
+    /// One checkpoint at a time.  Taken only while holding checkpoint_latch_
+    /// exclusively; `Checkpoint` keeps it while the table is written.
+    std::mutex checkpoint_run_latch_;
+};
+
+/// The tree with int keys.
+using BPlusTree = BasicBPlusTree<key_t>;
+
+// ============================================================================
+// BasicBPlusTree::Cursor
+// ============================================================================
+
+/// Walks the records of a tree in key order without copying them.
+///
+/// A positioned cursor keeps exactly one leaf pinned and shared-latched, and
+/// `key()` / `value()` read straight out of that frame (an overflow value
+/// is copied into the cursor); the `string_view` stays valid until the
+/// cursor moves or is destroyed.  `Next` crabs to the
+/// next leaf along the chain.  `Prev` releases its leaf before re-descending
+/// from the root, so it never waits on a left sibling while holding a latch.
+///
+/// An optional upper bound and record limit end the iteration early; either
+/// makes the cursor invalid, releasing its leaf, once it is stepped past.
+/// Stopping early is just a matter of dropping the cursor (or `Reset`).
+///
+/// While a cursor is positioned, writers that reach its leaf wait for it.
+/// A thread must not write to the tree while it holds a positioned cursor.
+///
+/// @code
+///   auto cur = tree.NewCursor();
+///   cur.SetUpperBound(200);
+///   for (cur.Seek(100); cur.Valid(); cur.Next()) {
+///       std::cout << cur.key() << " " << cur.value() << "\n";
+///   }
+/// @endcode
+template <typename Key, typename Compare>
+class BasicBPlusTree<Key, Compare>::Cursor {
+public:
+    explicit Cursor(const BasicBPlusTree& tree)
+        : tree_(&tree), read_ahead_(tree.scan_read_ahead_) {}
+    ~Cursor() { Reset(); }
+
+    Cursor(Cursor&& other) noexcept { *this = std::move(other); }
+    Cursor& operator=(Cursor&& other) noexcept;
+
+    Cursor(const Cursor&)            = delete;
+    Cursor& operator=(const Cursor&) = delete;
+
+    // -- Bounds --------------------------------------------------------------
+
+    /// Stop at keys above @p upper.  `SeekToLast` starts at the largest key
+    /// <= @p upper.
+    void SetUpperBound(Key upper) { upper_ = upper; }
+
+    /// Stop after @p limit records have been visited since the last seek
+    /// (counting the one the seek landed on).
+    void SetLimit(size_t limit) { limit_ = limit; }
+
+    /// Read up to @p max_leaves leaves ahead of a forward scan (0 = off;
+    /// the default is Options::scan_read_ahead).  After a seek the cursor
+    /// knows the upcoming leaves from their parent and hands the next
+    /// `window` of them to `BufferPool::Prefetch`.  The window starts at
+    /// kInitialReadAhead, doubles each time the scan has consumed a whole
+    /// window, and halves when the prefetch queue is full.
+    void SetReadAhead(size_t max_leaves) { read_ahead_ = max_leaves; }
+
+    /// First read-ahead window after a seek, in leaves.
+    static constexpr size_t kInitialReadAhead = 2;
+
+    // -- Positioning ---------------------------------------------------------
+
+    /// Move to the first record with a key >= @p key.
+    void Seek(Key key) { SeekTo(key); }
+
+    /// Move to the first record.
+    void SeekToFirst() { SeekTo(std::nullopt); }
+
+    /// Move to the last record within the upper bound.
+    void SeekToLast();
+
+    /// Move to the following record.  @pre Valid()
+    void Next();
+
+    /// Move to the preceding record.  @pre Valid()
+    void Prev();
+
+    /// Release the leaf and leave the cursor unpositioned.
+    void Reset();
+
+    // -- Access --------------------------------------------------------------
+
+    [[nodiscard]] bool Valid() const { return page_ != nullptr; }
+
+    /// Key of the current record.  @pre Valid()
+    [[nodiscard]] Key key() const;
+
+    /// Value of the current record, pointing into the pinned leaf or, for
+    /// an overflow value, into a copy held by the cursor.  @pre Valid()
+    [[nodiscard]] std::string_view value() const;
+
+private:
+    /// Move to the first record with a key >= @p key (the first record if
+    /// nullopt).
+    void SeekTo(const std::optional<Key>& key);
+
+    /// Position on the largest key < @p bound, or <= it if @p inclusive (the
+    /// largest key if @p bound is nullopt), or become invalid.
+    void SeekBackward(std::optional<Key> bound, bool inclusive);
+
+    /// Starting at slot_ of the pinned leaf, skip to the next leaf while the
+    /// slot is past the end, then `Admit` the record.
+    void Settle();
+
+    /// Count the current record against the limit; become invalid if it is
+    /// past the upper bound or the limit.
+    void Admit();
+
+    /// Descend to the leaf for @p key and stand before its first key >= it
+    /// (its first key if nullopt).  Collects the read-ahead list if
+    /// read-ahead is on.
+    void Descend(const std::optional<Key>& key);
+
+    /// The scan moved on to leaf @p leaf_off: advance in the read-ahead list,
+    /// grow the window and `Prefetch`.
+    void ReadAhead(int64_t leaf_off);
+
+    /// Hand the leaves up to a window past the current one, not handed over
+    /// yet, to the buffer pool.
+    void Prefetch();
+
+    const BasicBPlusTree* tree_ = nullptr;
+    char*            page_     = nullptr;   ///< Pinned, shared-latched leaf.
+    int64_t          leaf_off_ = INVALID_PAGE_ID;
+    int              slot_     = 0;
+    std::optional<Key> upper_;              ///< nullopt: no upper bound
+    size_t           limit_    = SIZE_MAX;
+    size_t           visited_  = 0;         ///< Records visited since the seek.
+    mutable std::string overflow_;          ///< Last overflow value read.
+
+    // -- Read-ahead ----------------------------------------------------------
+    size_t               read_ahead_ = 0;   ///< Largest window (0 = off).
+    size_t               window_     = 0;   ///< Current window, in leaves.
+    size_t               run_        = 0;   ///< Leaves consumed in this window.
+    std::vector<int64_t> ahead_;            ///< Upcoming leaves (same parent).
+    size_t               ahead_pos_  = 0;   ///< Next expected entry of ahead_.
+    size_t               issued_     = 0;   ///< Entries of ahead_ prefetched.
+    std::optional<Key> parent_high_;      ///< Where the next parent starts.
 };
 
+extern template class BasicBPlusTree<int32_t>;
+extern template class BasicBPlusTree<int64_t>;
+
 }  // namespace bptree
@@ -1,14 +1,35 @@
 #pragma once
 
 /// @file buffer_pool.h
-/// @brief LRU buffer pool that caches fixed-size pages between the B+ tree
-///        and the DiskManager.
+/// @brief Buffer pool that caches fixed-size pages between the B+ tree and
+///        the DiskManager, with a pluggable replacement policy.
 ///
 /// Design:
 ///   - Fixed number of in-memory page frames (configurable at construction).
 ///   - Each frame has a pin count; only unpinned frames are eviction candidates.
 ///   - A dirty flag triggers write-back on eviction.
-///   - LRU replacement policy via a doubly-linked list.
+///   - With a WAL attached, write-back first forces the log up to the page
+///     LSN that the caller stamped when it logged its change.
+///   - Pluggable replacement policy (LRU, CLOCK or LRU-K, see replacer.h).
+///     Uses are recorded lock-free when a page is fetched.
+///   - Frames are partitioned into shards by page_id.  Each shard has its
+///     own latch, page table, free list and replacer, so misses in
+///     different shards never contend.
+///   - Hits are lock-free: a lookup in the shard's open-addressing page
+///     table followed by one atomic pin increment.
+///   - Every frame carries a reader/writer latch.  Callers that share the
+///     pool between threads fetch pages with a `LatchMode` and release the
+///     latch again through `UnpinPage`.
+///   - Read-ahead: `Prefetch` hands pages to a background thread that loads
+///     them into unpinned frames before they are fetched.
+///   - Optimistic reads: every frame carries a version that is odd while
+///     its page is exclusively latched or the frame is being reassigned.
+///     `ReadOptimistic` / `Validate` let a reader look at a resident page
+///     without pinning or latching it and find out afterwards whether
+///     what it saw was consistent.
+///   - Pointer swizzling: the internal pages a descent goes through can
+///     keep, beside the frame, the frame of each resident child, so the
+///     next descent follows it without a page-table lookup.
 ///
 /// Typical usage:
 /// @code
@@ -21,41 +42,137 @@
 
 #include "config.h"
 #include "disk_manager.h"
+#include "frame_arena.h"
+#include "page_table.h"
+#include "replacer.h"
 
+#include <atomic>
+#include <climits>
+#include <condition_variable>
 #include <cstdint>
-#include <list>
-#include <unordered_map>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <shared_mutex>
+#include <thread>
 #include <vector>
 
 namespace bptree { class WriteAheadLog; }  // forward declaration
 
 namespace bptree {
 
+/// How a fetched page is latched for the caller.
+enum class LatchMode {
+    kNone,       ///< Pin only; the caller synchronises access itself.
+    kShared,     ///< Reader latch: any number of concurrent holders.
+    kExclusive,  ///< Writer latch: sole access to the page contents.
+};
+
 /// Metadata kept per in-memory page frame.
+///
+/// The metadata fields are atomics so a hit can pin a frame without taking
+/// any latch.  While a shard (re)assigns a frame it adds `kEvicting` to
+/// pin_count; a lock-free pin that observes a negative count backs off.
+///
+/// `version` is a sequence lock over `data`: it is made odd when the frame
+/// is latched exclusively or claimed for another page, and even again when
+/// the latch is released or the frame published.  A reader that sees the
+/// same even version before and after reading saw no change.
 struct PageFrame {
-    int64_t page_id   = INVALID_PAGE_ID;  ///< Byte offset in the file.
-    int     pin_count = 0;                ///< Number of active users.
-    bool    dirty     = false;            ///< True if modified since last flush.
-    char    data[PAGE_SIZE]{};            ///< In-memory copy of the page.
+    static constexpr int kEvicting = INT_MIN / 2;
+
+    std::atomic<int64_t>  page_id{INVALID_PAGE_ID};  ///< Byte offset in the file.
+    std::atomic<int>      pin_count{0};              ///< Number of active users.
+    std::atomic<bool>     dirty{false};              ///< True if modified since last flush.
+    std::atomic<bool>     prefetched{false};         ///< Read ahead, not fetched since.
+    /// Recovery LSN: every change logged before it is on disk.  The next
+    /// LSN when the page was last read or written.
+    std::atomic<uint64_t> rec_lsn{0};
+    std::atomic<uint64_t> version{0};                ///< Odd while `data` changes.
+    /// Swizzle table of the page's children, or -1 (see `ReadChildOptimistic`).
+    std::atomic<int32_t>  swizzle{-1};
+    std::shared_mutex     latch;                     ///< Guards `data` (not the metadata).
+    char*   data = nullptr;                          ///< In-memory copy of the page
+                                                     ///< (PAGE_SIZE bytes, PAGE_SIZE-aligned).
+};
+
+/// Per-shard counters, see `BufferPool::GetShardStats`.
+struct ShardStats {
+    size_t frames             = 0;  ///< Frames owned by the shard.
+    size_t hits               = 0;  ///< Fetches served from the pool.
+    size_t misses             = 0;  ///< Fetches that had to read the page.
+    size_t evictions          = 0;  ///< Frames reclaimed from another page.
+    size_t latch_acquisitions = 0;  ///< Times the shard latch was taken.
+    size_t latch_contentions  = 0;  ///< ... of which had to wait for it.
+    size_t prefetches         = 0;  ///< Pages loaded by read-ahead.
+    size_t prefetch_hits      = 0;  ///< ... later fetched (counted once).
+    size_t prefetch_unused    = 0;  ///< ... evicted or freed before a fetch.
+    size_t dirty_evictions    = 0;  ///< Evictions that had to write the page.
+    int    numa_node          = -1; ///< Node its frames are placed on (-1: none).
+};
+
+/// The dirty page table taken by `BufferPool::BeginCheckpoint`.
+struct DirtyPageTable {
+    size_t   pages      = 0;  ///< Frames dirty when the checkpoint began.
+    uint64_t oldest_lsn = 0;  ///< Smallest recovery LSN among them.
+};
+
+/// Settings of the background page cleaner, see `BufferPool::StartCleaner`.
+struct CleanerOptions {
+    /// Fraction of each shard's frames, coldest first, that the cleaner
+    /// keeps clean, so that evictions find a victim with nothing to write.
+    double clean_fraction = 0.1;
+
+    /// Fraction of the pool dirty that wakes the cleaner at once.  It then
+    /// writes the coldest dirty frames until at most `dirty_low_water` of
+    /// the pool is dirty.
+    double dirty_high_water = 0.5;
+    double dirty_low_water  = 0.25;
+
+    /// Longest the cleaner sleeps between passes, in milliseconds.
+    uint32_t interval_ms = 20;
 };
 
-/// An LRU buffer pool that sits between the B+ tree and the DiskManager.
+/// A buffer pool that sits between the B+ tree and the DiskManager.
 ///
 /// The pool owns a fixed number of page frames.  Pages are read from disk on
 /// first access and cached.  When the pool is full and a new page is needed,
-/// the least-recently-used unpinned frame is evicted (flushed if dirty).
+/// an unpinned frame chosen by the replacement policy is evicted (flushed if
+/// dirty).
 ///
 /// Pin semantics:
 ///   - `FetchPage` increments pin_count and returns a writable pointer.
 ///   - `UnpinPage` decrements pin_count.  Only frames with pin_count == 0
 ///     are eligible for eviction.
 ///   - Callers MUST unpin every page they fetch.
+///
+/// Thread safety:
+///   All member functions are thread-safe.  Page-table updates, free lists
+///   and victim selection are guarded by the latch of the page's shard; a
+///   hit takes no latch at all.  Page contents are guarded by the per-frame
+///   latch requested through `LatchMode`.  A frame latch is never acquired
+///   while a shard latch is held, so holding frame latches across calls
+///   into the pool cannot deadlock.
+///
+/// Sharding:
+///   A page can only live in its own shard's frames, so a shard can run out
+///   of unpinned frames while others still have room.  The shard count is
+///   clamped so that every shard owns at least `kMinFramesPerShard` frames.
 class BufferPool {
 public:
     /// Create a buffer pool with @p pool_size page frames backed by @p disk.
-    /// @param disk      The disk manager to read/write pages from.
-    /// @param pool_size Number of page frames (default 1024 = 4 MB).
-    explicit BufferPool(DiskManager& disk, size_t pool_size = 1024);
+    /// @param disk       The disk manager to read/write pages from.
+    /// @param pool_size  Number of page frames (default 1024 = 4 MB).
+    /// @param num_shards Number of independently latched partitions.
+    /// @param policy     Page replacement policy.
+    /// @param huge_pages What backs the frames (see `FrameArena`).
+    /// @param numa       Place each shard's frames on a NUMA node, round
+    ///                   robin over the online nodes (on hosts with more
+    ///                   than one).
+    explicit BufferPool(DiskManager& disk, size_t pool_size = 1024,
+                        size_t num_shards = 1,
+                        ReplacementPolicy policy = ReplacementPolicy::kLRU,
+                        HugePages huge_pages = HugePages::kOff, bool numa = false);
 
     ~BufferPool();
 
@@ -64,21 +181,69 @@ public:
     BufferPool& operator=(const BufferPool&) = delete;
 
     /// Fetch the page at @p page_id (byte offset) into the pool.
-    /// Increments pin_count.  Returns a writable pointer into the frame's
-    /// data buffer.
+    /// Increments pin_count, then acquires the frame latch in @p mode
+    /// (blocking).  Returns a writable pointer into the frame's data buffer.
     ///
     /// @return nullptr if the page cannot be fetched (all frames pinned).
-    char* FetchPage(int64_t page_id);
+    char* FetchPage(int64_t page_id, LatchMode mode = LatchMode::kNone);
 
-    /// Decrement pin_count for @p page_id.  Mark dirty if @p dirty is true.
+    /// Release the latch taken in @p mode, then decrement pin_count for
+    /// @p page_id.  Mark dirty if @p dirty is true.  With a WAL attached the
+    /// caller must have logged the change and stamped the page LSN first.
     /// @return false if the page is not in the pool.
-    bool UnpinPage(int64_t page_id, bool dirty);
+    bool UnpinPage(int64_t page_id, bool dirty,
+                   LatchMode mode = LatchMode::kNone);
+
+    /// A page read without a pin or latch, see `ReadOptimistic`.
+    struct OptimisticPage {
+        const char*      data    = nullptr;
+        const PageFrame* frame   = nullptr;
+        int64_t          page_id = INVALID_PAGE_ID;
+        uint64_t         version = 0;
+    };
+
+    /// Look up @p page_id without pinning or latching it.  Nothing is
+    /// written except the replacer's access record.  The bytes at
+    /// `page.data` may change at any time: whatever is derived from them
+    /// must be checked with `Validate` before it is trusted, and reads must
+    /// stay inside the page whatever they find.
+    /// @return false if the page is not resident or is being changed.
+    bool ReadOptimistic(int64_t page_id, OptimisticPage& page) const;
+
+    /// True if the page read by `ReadOptimistic` has not changed or left
+    /// its frame since, so everything read from it so far is consistent.
+    bool Validate(const OptimisticPage& page) const;
+
+    /// Pin and latch in @p mode the frame of a page read by
+    /// `ReadOptimistic`, as `FetchPage` would, but never read from disk.
+    /// The caller still validates what led it to the page.
+    /// @return nullptr if the page has left its frame since.
+    char* PinOptimistic(const OptimisticPage& page, LatchMode mode);
+
+    /// Swizzle child pointers of up to one page in `kFramesPerSwizzleTable`
+    /// (see `ReadChildOptimistic`), for pages of up to
+    /// @p children_per_page children.  Call before the pool is shared.
+    void EnableSwizzling(size_t children_per_page);
+
+    /// `ReadOptimistic` for @p child, found in slot @p slot of @p parent
+    /// (itself read optimistically).  With swizzling enabled, the frame
+    /// last seen in that slot is tried first; only if it no longer holds
+    /// @p child is the page table consulted, and the slot updated.  Swizzled
+    /// pointers live beside the frame, not in the page, so the page as
+    /// written back and logged never holds one; a pointer to a frame that
+    /// was since evicted or reused just fails its check.
+    bool ReadChildOptimistic(const OptimisticPage& parent, int slot, int64_t child,
+                             OptimisticPage& page);
+
+    /// Pages whose child pointers are being swizzled.
+    [[nodiscard]] size_t SwizzledPages() const { return swizzled_.load(std::memory_order_relaxed); }
 
     /// Write a dirty page back to disk without evicting it.
     /// @return false if the page is not in the pool.
     bool FlushPage(int64_t page_id);
 
-    /// Flush all dirty pages to disk.
+    /// Flush all dirty pages to disk, in `DiskManager::WritePages` batches
+    /// of up to `kWriteBackBatch` pages.
     void FlushAllPages();
 
     /// Allocate a new page via DiskManager and bring it into the pool (pinned).
@@ -91,58 +256,267 @@ public:
     /// @return false if the page is pinned or not in the pool.
     bool DeletePage(int64_t page_id);
 
+    /// Drop every page at or past byte @p end from the pool, dirty or not,
+    /// then `DiskManager::Truncate` the file there.  Read-ahead stops
+    /// short of the new end.
+    /// @return false, with nothing changed, if one of them is pinned.
+    bool Truncate(int64_t end);
+
+    // -- Read-ahead ---------------------------------------------------------
+
+    /// Start loading the pages in @p page_ids in the background.  Pages that
+    /// are already resident are skipped.  For the rest the kernel is asked
+    /// to start reading them (`DiskManager::WillNeed`), then a prefetch
+    /// thread reads them into frames, evicting as a miss would, up to
+    /// `kPrefetchBatch` pages per `DiskManager::ReadPages` batch.  Loaded
+    /// pages stay unpinned until someone fetches them.
+    ///
+    /// @return How many of the pages, from the front, were taken: fewer than
+    ///         @p count when the prefetch queue is full.
+    size_t Prefetch(const int64_t* page_ids, size_t count);
+
+    // -- Page cleaner -------------------------------------------------------
+
+    /// Start a background thread that writes dirty pages back ahead of
+    /// their eviction, so a miss rarely waits for someone else's write (and
+    /// the log force before it).  Each pass pins the dirty, unpinned frames
+    /// among each shard's coldest (`Replacer::Coldest`) and writes them in
+    /// page order, so adjacent pages go out together.  Frames being
+    /// modified are skipped.  A pass runs every `interval_ms`, when the pool
+    /// passes the high water mark, and when an eviction had to write.
+    /// Does nothing if the cleaner is running.
+    void StartCleaner(const CleanerOptions& options = {});
+
+    /// Stop the cleaner thread, if any (the destructor does too).
+    void StopCleaner();
+
+    /// Frames holding a page modified since it was last written.
+    [[nodiscard]] size_t DirtyCount() const { return dirty_frames_.load(std::memory_order_relaxed); }
+
+    /// Pages written back by the cleaner.
+    [[nodiscard]] size_t CleanerWrites() const { return cleaner_writes_.load(std::memory_order_relaxed); }
+
+    // -- Fuzzy checkpoints ---------------------------------------------------
+
+    /// Take the dirty page table of a checkpoint whose redo point is
+    /// @p redo_lsn: the frames dirty now, every one with a recovery LSN
+    /// not after it.  The caller keeps pages from being modified meanwhile.
+    DirtyPageTable BeginCheckpoint(uint64_t redo_lsn);
+
+    /// Make sure every page of the table has been written since, then sync
+    /// the file.  The cleaner writes them, if it runs, in page order on
+    /// its passes; otherwise the caller does.  Either way pages can be
+    /// fetched and modified throughout; a page modified again is written
+    /// once more only if it is still dirty from before the checkpoint.
+    void FlushCheckpoint();
+
     // -- WAL integration ----------------------------------------------------
 
-    /// Attach a WAL to the buffer pool.  When set, dirty pages are logged
-    /// to the WAL before being written to disk (WAL protocol).
+    /// Attach a WAL to the buffer pool.  When set, a page is only written to
+    /// disk once the log is durable up to its page LSN (WAL protocol).
     void SetWAL(WriteAheadLog* wal) { wal_ = wal; }
 
     // -- Statistics ----------------------------------------------------------
 
     [[nodiscard]] size_t PoolSize()    const { return pool_size_; }
-    [[nodiscard]] size_t PagesInUse()  const { return page_table_.size(); }
-    [[nodiscard]] size_t HitCount()    const { return hits_; }
-    [[nodiscard]] size_t MissCount()   const { return misses_; }
+    [[nodiscard]] size_t PagesInUse()  const;
+    [[nodiscard]] size_t HitCount()    const;
+    [[nodiscard]] size_t MissCount()   const;
+    [[nodiscard]] size_t PrefetchCount()    const;  ///< Pages read ahead.
+    [[nodiscard]] size_t PrefetchHitCount() const;  ///< ... and then fetched.
     [[nodiscard]] double HitRate()     const {
-        size_t total = hits_ + misses_;
-        return total == 0 ? 0.0 : static_cast<double>(hits_) / total;
+        size_t hits  = HitCount();
+        size_t total = hits + MissCount();
+        return total == 0 ? 0.0 : static_cast<double>(hits) / total;
     }
 
+    [[nodiscard]] size_t NumShards() const { return shards_.size(); }
+    [[nodiscard]] ReplacementPolicy Policy() const { return policy_; }
+
+    /// Snapshot of the counters of shard @p shard (< NumShards()).
+    [[nodiscard]] ShardStats GetShardStats(size_t shard) const;
+
+    /// Smallest number of frames a shard is given.
+    static constexpr size_t kMinFramesPerShard = 16;
+
+    /// The prefetch queue holds at most PoolSize() / kPrefetchQueueDivisor
+    /// pages, so read-ahead cannot flush most of the pool by itself.
+    static constexpr size_t kPrefetchQueueDivisor = 4;
+
+    /// Most pages the prefetch thread reads in one batch.
+    static constexpr size_t kPrefetchBatch = 32;
+
+    /// Most pages FlushAllPages writes in one batch.
+    static constexpr size_t kWriteBackBatch = 64;
+
+    /// One swizzle table per this many frames: internal pages are few.
+    static constexpr size_t kFramesPerSwizzleTable = 16;
+
 private:
-    /// Find a victim frame to evict (LRU among unpinned).
-    /// Returns the index into frames_, or -1 if all frames are pinned.
-    int FindVictim();
+    /// One partition of the pool.  Aligned so shards do not share cache
+    /// lines.
+    struct alignas(64) Shard {
+        Shard(int begin, int end, ReplacementPolicy policy);
 
-    /// Evict a frame: flush if dirty, remove from page table and LRU list.
-    void EvictFrame(int frame_idx);
+        int begin;                     ///< First frame index owned.
+        int end;                       ///< One past the last frame index.
+        PageTable table;               ///< page_id -> frame index.
+        std::vector<int> free_list;    ///< Frames not holding any page.
+        std::unique_ptr<Replacer> replacer;  ///< Indexed by frame - begin.
+        int numa_node = -1;            ///< Node its frames are placed on.
 
-    /// Touch a frame: move it to the back of the LRU list (most recent).
-    void TouchFrame(int frame_idx);
+        /// Guards table writes, free_list and frame (re)assignment.
+        mutable std::mutex latch;
 
-    DiskManager& disk_;
-    size_t       pool_size_;
+        // Stats
+        std::atomic<size_t> hits{0};
+        std::atomic<size_t> misses{0};
+        std::atomic<size_t> evictions{0};
+        std::atomic<size_t> prefetches{0};
+        std::atomic<size_t> prefetch_hits{0};
+        std::atomic<size_t> prefetch_unused{0};
+        std::atomic<size_t> dirty_evictions{0};
+        mutable std::atomic<size_t> latch_acquisitions{0};
+        mutable std::atomic<size_t> latch_contentions{0};
+    };
 
-    std::vector<PageFrame> frames_;
+    size_t ShardIndex(int64_t page_id) const {
+        auto page_no = static_cast<size_t>(page_id / static_cast<int64_t>(PAGE_SIZE));
+        return page_no % shards_.size();
+    }
+    Shard& ShardFor(int64_t page_id) const { return *shards_[ShardIndex(page_id)]; }
+
+    /// Take @p s's latch, counting contention.
+    std::unique_lock<std::mutex> LockShard(Shard& s) const;
+
+    /// Pin @p f if it currently holds @p page_id.  Lock-free.
+    static bool TryPin(PageFrame& f, int64_t page_id);
+
+    /// Pin the resident frame holding @p page_id without any latch.
+    /// @return nullptr if not resident or currently being reassigned.
+    PageFrame* PinResident(Shard& s, int64_t page_id);
+
+    /// Pin the frame holding @p page_id, loading it on a miss.
+    /// @pre s.latch is held.  @return nullptr if all frames are pinned.
+    PageFrame* PinFrame(Shard& s, int64_t page_id);
+
+    /// Claim a frame for a new page: a free frame, else the replacer's
+    /// victim (written back and unmapped).  The frame is returned carrying
+    /// `kEvicting`; `Publish` hands it out.
+    /// @pre s.latch is held.  @return -1 if every frame is pinned.
+    int ClaimFrame(Shard& s);
 
-    /// Maps page_id (byte offset) -> frame index.
-    std::unordered_map<int64_t, int> page_table_;
+    /// Map a claimed frame to @p page_id and pin it once for the caller.
+    /// @pre s.latch is held.
+    void Publish(Shard& s, int frame_idx, int64_t page_id);
 
-    /// LRU list: front = least recently used, back = most recently used.
-    /// Stores frame indices.  Only unpinned frames appear in this list.
-    std::list<int> lru_list_;
+    /// Acquire / release a frame latch in @p mode.
+    static void Latch(PageFrame& f, LatchMode mode);
+    static void Unlatch(PageFrame& f, LatchMode mode);
 
-    /// Reverse map: frame index -> iterator into lru_list_ (for O(1) removal).
-    std::unordered_map<int, std::list<int>::iterator> lru_map_;
+    /// Write a pinned frame back to disk if it is dirty, under its shared
+    /// latch, after forcing the log up to its page LSN.
+    void WriteBack(PageFrame& f);
 
-    /// Free frame indices (frames not currently holding any page).
-    std::vector<int> free_list_;
+    /// Unmap frame @p idx of @p s without writing it back and put it on the
+    /// free list.  @pre s.latch is held and the frame carries kEvicting.
+    void DropFrame(Shard& s, int idx);
+
+    /// Count a read-ahead page of @p s that leaves the pool unfetched.
+    static void DropPrefetched(Shard& s, PageFrame& f);
+
+    /// Body of the prefetch thread: load queued pages until stopped.
+    void PrefetchLoop();
+
+    /// Load the @p count pages at @p page_ids into unpinned frames, skipping
+    /// resident ones, with one batched read.
+    void LoadAhead(const int64_t* page_ids, size_t count);
+
+    /// Write back the dirty ones of the frames @p frames (pinned by the
+    /// caller) in batches; frames whose latch is taken go one at a time
+    /// afterwards, or are skipped unless @p wait_for_busy.
+    /// @return The number of pages written.
+    size_t WriteBackAll(const std::vector<int>& frames, bool wait_for_busy);
+
+    /// Mark a pinned frame dirty / clean, keeping dirty_frames_.
+    void MarkDirty(PageFrame& f);
+    bool MarkClean(PageFrame& f);  ///< @return whether it was dirty
+
+    /// Body of the cleaner thread, and one pass of it.
+    void CleanerLoop();
+    void CleanPass();
+    void WakeCleaner();
+
+    /// Write the pages of the checkpoint table not written since it was
+    /// taken.  The cleaner skips busy frames and counts its writes; the
+    /// checkpointing thread waits for them.
+    /// @return How many are left.
+    size_t WriteCheckpointPages(bool from_cleaner);
+
+    /// The WAL's next LSN: a lower bound of any change made from now on.
+    uint64_t NextLSN() const;
+
+    /// Give @p f a swizzle table, if one is free.  @return its index or -1.
+    int32_t AttachSwizzle(PageFrame& f);
+
+    /// Return the swizzle table of @p f, which is being reassigned.
+    void DetachSwizzle(PageFrame& f);
+
+    DiskManager&      disk_;
+    size_t            pool_size_;
+    ReplacementPolicy policy_;
+
+    std::vector<PageFrame> frames_;
+    /// Page memory of all frames in one PAGE_SIZE-aligned block, so they
+    /// can be read and written with O_DIRECT.
+    FrameArena arena_;
+    std::vector<std::unique_ptr<Shard>> shards_;
 
     /// Optional WAL for crash recovery (not owned).
     WriteAheadLog* wal_ = nullptr;
 
-    // Stats
-    size_t hits_   = 0;
-    size_t misses_ = 0;
+    // -- Read-ahead (the thread starts on the first Prefetch) ---------------
+    std::mutex              prefetch_latch_;   ///< Guards the queue and stop flag.
+    std::condition_variable prefetch_cv_;      ///< Wakes the prefetch thread.
+    std::deque<int64_t>     prefetch_queue_;
+    bool                    prefetch_stop_ = false;
+    std::once_flag          prefetch_started_;
+    std::thread             prefetcher_;
+
+    // -- Pointer swizzling (see EnableSwizzling) -----------------------------
+    /// Slots per table; 0 while swizzling is off.
+    size_t                  swizzle_slots_ = 0;
+    /// Frame index + 1 per slot (0: none), one table after another.  Tables
+    /// are recycled but never freed, so a reader may look at a table
+    /// after it has moved to another frame; every hint is checked.
+    std::unique_ptr<std::atomic<uint32_t>[]> swizzle_hints_;
+    std::mutex              swizzle_latch_;    ///< Guards the free tables.
+    std::vector<int32_t>    swizzle_free_;
+    std::atomic<size_t>     swizzled_{0};
+
+    // -- Page cleaner ---------------------------------------------------------
+    std::atomic<size_t>     dirty_frames_{0};
+    std::atomic<size_t>     cleaner_writes_{0};
+    CleanerOptions          cleaner_options_;
+    /// Dirty frames that wake the cleaner (SIZE_MAX while it is stopped).
+    std::atomic<size_t>     cleaner_high_water_{SIZE_MAX};
+    std::mutex              cleaner_latch_;    ///< Guards the stop flag.
+    /// Held by a cleaner pass while it writes and by FlushAllPages, so a
+    /// flush cannot return while a page the cleaner marked clean is still
+    /// on its way to disk.
+    std::mutex              cleaner_write_latch_;
+    std::condition_variable cleaner_cv_;
+    std::atomic<bool>       cleaner_wake_{false};
+    bool                    cleaner_stop_ = false;
+    std::thread             cleaner_;
+
+    // -- Checkpoint ---------------------------------------------------------
+    std::mutex              checkpoint_latch_;   ///< Guards the table.
+    std::vector<int>        checkpoint_frames_;  ///< Frames still to write.
+    uint64_t                checkpoint_redo_lsn_ = 0;
+    /// The cleaner is asked to write the table (guarded by cleaner_latch_).
+    bool                    checkpoint_requested_ = false;
+    std::condition_variable checkpoint_cv_;      ///< Signals the table written.
 };
 
 }  // namespace bptree
@@ -0,0 +1,123 @@
+#pragma once
+
+/// @file client.h
+/// @brief Blocking client of `Server`, with pipelining.
+///
+/// The one-call methods (`Get`, `Put`, `MultiGet`, `Scan`, ...) each send a
+/// request and wait for its answer, so no pipelined responses may be
+/// outstanding when they are called.  To pipeline, queue any number of
+/// requests with the `Queue*` methods, `Flush` them and `Receive` the
+/// responses, which come back in the order the requests were queued.
+/// `Flush` also reads what arrives while it writes, so a deep pipeline
+/// cannot deadlock against the server's backpressure.
+///
+/// A client is not thread-safe; use one per thread.
+///
+/// @code
+///   bptree::Client client;
+///   if (client.Connect("127.0.0.1", bptree::DEFAULT_SERVER_PORT).ok()) {
+///       client.Put(42, "hello");
+///       std::string value;
+///       client.Get(42, value);
+///   }
+/// @endcode
+
+#include "config.h"
+#include "protocol.h"
+#include "status.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+namespace bptree {
+
+/// One response frame.
+struct ClientResponse {
+    WireOp   op = WireOp::kError;
+    uint32_t id = 0;
+
+    /// kPut, kScanEnd and kError: the outcome.
+    Status status;
+
+    /// kGet and kDelete: one per key; kGet values are set where OK.
+    std::vector<Status>      statuses;
+    std::vector<std::string> values;
+
+    /// kScan: one chunk of records.
+    std::vector<std::pair<key_t, std::string>> records;
+};
+
+class Client {
+public:
+    Client() = default;
+    ~Client() { Close(); }
+
+    Client(const Client&)            = delete;
+    Client& operator=(const Client&) = delete;
+
+    /// Connect to a server at IPv4 @p address.
+    /// @return IOError if the connection fails.
+    Status Connect(const std::string& address, uint16_t port);
+    void Close();
+    [[nodiscard]] bool Connected() const { return fd_ >= 0; }
+
+    // -- One round trip each -------------------------------------------------
+
+    /// @return NotFound if @p key is absent.
+    Status Get(key_t key, std::string& value);
+    Status Put(key_t key, std::string_view value);
+    Status Delete(key_t key);
+
+    /// `BPlusTree::MultiGet` over the wire: @p statuses and @p values get
+    /// one entry per key.  @return the connection's status.
+    Status MultiGet(const std::vector<key_t>& keys, std::vector<std::string>& values,
+                    std::vector<Status>& statuses);
+
+    /// `BPlusTree::InsertBatch` over the wire.
+    Status PutBatch(const std::vector<std::pair<key_t, std::string>>& records);
+
+    /// Visit the records with keys in [lower, upper] in order, at most
+    /// @p limit of them (0: all), as the server streams them.  If @p fn
+    /// returns false the rest of the scan is still read, but not visited.
+    Status Scan(key_t lower, key_t upper,
+                const std::function<bool(key_t key, std::string_view value)>& fn,
+                uint32_t limit = 0);
+
+    // -- Pipelining ----------------------------------------------------------
+
+    /// Queue a request; nothing is sent before `Flush`.  @return its id.
+    uint32_t QueueGet(const std::vector<key_t>& keys);
+    uint32_t QueuePut(const std::vector<std::pair<key_t, std::string>>& records);
+    uint32_t QueueDelete(const std::vector<key_t>& keys);
+    uint32_t QueueScan(key_t lower, key_t upper, uint32_t limit = 0);
+
+    /// Send every queued request.
+    Status Flush();
+
+    /// Wait for the next response frame.  A scan answers with any number
+    /// of kScan frames, then kScanEnd.
+    /// @return IOError if the connection failed, Corruption if the frame
+    ///         could not be parsed.
+    Status Receive(ClientResponse& response);
+
+private:
+    /// Read what the socket has into in_, waiting for at least one byte if
+    /// @p wait.  @return false if the connection failed or closed.
+    bool Fill(bool wait);
+
+    /// Send the queued requests and wait for one response of kind @p op.
+    Status RoundTrip(WireOp op, ClientResponse& response);
+
+    int         fd_ = -1;
+    uint32_t    next_id_ = 0;
+    std::string out_;           ///< queued requests
+    std::string in_;            ///< received, from in_pos_ on not yet parsed
+    size_t      in_pos_ = 0;
+};
+
+}  // namespace bptree
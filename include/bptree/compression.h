@@ -0,0 +1,42 @@
+#pragma once
+
+/// @file compression.h
+/// @brief Page compression codecs.
+///
+/// `LZ4Compress` / `LZ4Decompress` read and write the LZ4 *block* format
+/// (no frame header, no checksum): a sequence of
+/// `[token | literal length… | literals | offset(2) | match length…]`
+/// ending in literals.  Any LZ4 block decoder reads what the compressor
+/// writes.  The compressor is the single-pass greedy one with a 4096-entry
+/// hash table of 4-byte sequences, which is plenty for 4 KB pages.
+///
+/// @code
+///   char buf[LZ4CompressBound(PAGE_SIZE)];
+///   size_t n = LZ4Compress(page, PAGE_SIZE, buf, sizeof(buf));
+///   LZ4Decompress(buf, n, page, PAGE_SIZE);   // true
+/// @endcode
+
+#include <cstddef>
+#include <cstdint>
+
+namespace bptree {
+
+/// How `DiskManager` stores pages in the index file.
+enum class PageCompression : int64_t {
+    kNone = 0,  ///< one page per PAGE_SIZE bytes of the file, memory-mapped
+    kLZ4  = 1,  ///< LZ4-compressed pages packed in 512-byte sectors
+};
+
+/// Largest output of `LZ4Compress` for @p len input bytes.
+constexpr size_t LZ4CompressBound(size_t len) { return len + len / 255 + 16; }
+
+/// Compress @p len bytes at @p src into @p dst (@p capacity bytes).
+/// Returns the compressed size, or 0 if it would exceed @p capacity.
+size_t LZ4Compress(const char* src, size_t len, char* dst, size_t capacity);
+
+/// Decompress the @p len-byte block at @p src into exactly @p out_len bytes
+/// at @p dst.  Returns false if the block is malformed or does not
+/// decompress to @p out_len bytes; never reads or writes out of bounds.
+bool LZ4Decompress(const char* src, size_t len, char* dst, size_t out_len);
+
+}  // namespace bptree
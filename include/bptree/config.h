@@ -12,35 +12,99 @@ namespace bptree {
 // Page layout
 // ---------------------------------------------------------------------------
 constexpr size_t   PAGE_SIZE          = 4096;   ///< Bytes per disk page
-constexpr size_t   DATA_SIZE          = 100;    ///< Fixed record payload size
-
-// ---------------------------------------------------------------------------
-// B+ tree fan-out (derived from page size)
-// ---------------------------------------------------------------------------
-/// Leaf: 16-byte header + N * (4-byte key + 100-byte data) <= PAGE_SIZE
-constexpr int LEAF_MAX_KEYS     = 35;
-
-/// Internal: 8-byte header + (N+1)*8-byte children + N*4-byte keys <= PAGE_SIZE
-constexpr int INTERNAL_MAX_KEYS = 100;
+constexpr size_t   DATA_SIZE          = 100;    ///< Payload size of fixed-size leaves (format <= 3)
+constexpr size_t   MAX_VALUE_SIZE     = 0xFFFFFFFF;  ///< Longest value (32-bit length)
 
 // ---------------------------------------------------------------------------
 // Type aliases
 // ---------------------------------------------------------------------------
 using page_id_t  = int64_t;
-using key_t      = int;
+using key_t      = int;   ///< Key type of `BPlusTree` (see BasicBPlusTree)
 
 constexpr page_id_t INVALID_PAGE_ID   = -1;
 constexpr page_id_t HEADER_PAGE_SIZE  = PAGE_SIZE;  ///< byte-size of metadata page
 
+// ---------------------------------------------------------------------------
+// B+ tree fan-out (derived from page size and key size)
+//
+// Leaves are slotted and hold as many records as their values leave room
+// for (see LeafPage); only the fixed-payload leaves of format version 3 had
+// a record count.
+// ---------------------------------------------------------------------------
+/// Fixed-payload leaf: 16-byte header + N * (key + 1-byte slot), padded to 8,
+/// + N * 100-byte data + page LSN <= PAGE_SIZE.  Slots are one byte, so at
+/// most 256.
+constexpr int LeafMaxKeys(size_t key_size) {
+    size_t n = (PAGE_SIZE - 16 - 7 - 8) / (key_size + 1 + DATA_SIZE);
+    return static_cast<int>(n < 256 ? n : 256);
+}
+
+/// Internal: 8-byte header + N * key, padded to 8, + (N+1) * 8-byte children
+/// + page LSN <= PAGE_SIZE.
+constexpr int InternalMaxKeys(size_t key_size) {
+    return static_cast<int>((PAGE_SIZE - 8 - 7 - 8 - 8) / (key_size + 8));
+}
+
+constexpr int INTERNAL_MAX_KEYS = InternalMaxKeys(sizeof(key_t));  ///< 338 for int keys
+
+// ---------------------------------------------------------------------------
+// Page type: the int at byte 4 of every tree page.
+// ---------------------------------------------------------------------------
+constexpr int PAGE_TYPE_LEGACY_INTERNAL = 0;  ///< internal, interleaved [child|key] slots
+constexpr int PAGE_TYPE_LEGACY_LEAF     = 1;  ///< leaf, [key|data] records
+constexpr int PAGE_TYPE_V2_INTERNAL     = 2;  ///< internal, separate arrays for 100 int keys
+constexpr int PAGE_TYPE_V2_LEAF         = 3;  ///< leaf, key array + payload slots for 35 records
+constexpr int PAGE_TYPE_INTERNAL        = 4;  ///< internal, arrays sized by key size
+constexpr int PAGE_TYPE_V3_LEAF         = 5;  ///< leaf, key array + payload slots sized by key size
+constexpr int PAGE_TYPE_LEAF            = 6;  ///< leaf, slotted with variable-length cells
+constexpr int PAGE_TYPE_OVERFLOW        = 7;  ///< part of a value too long for its leaf
+constexpr int PAGE_TYPE_PREFIX_LEAF     = 8;  ///< leaf as type 6, keys stored after a shared prefix
+
+// ---------------------------------------------------------------------------
+// Page LSN: the last 8 bytes of every tree page hold the LSN of the last WAL
+// record that modified it (0 = never logged, e.g. files written before page
+// LSNs existed).
+// ---------------------------------------------------------------------------
+constexpr size_t PAGE_LSN_OFFSET = PAGE_SIZE - 8;
+
 // ---------------------------------------------------------------------------
 // Metadata page layout (page 0)
 //   [0..7]   root_offset      (int64_t, -1 if tree is empty)
 //   [8..15]  next_page_off    (int64_t, next free offset)
 //   [16..23] free_list_head   (int64_t, first free page, -1 if none)
+//   [24..31] format_version   (int64_t, FILE_FORMAT_VERSION; 0 in files
+//                              written before it existed)
+//   [32..39] key_size         (int64_t, bytes per key; 0 until the tree
+//                              records it, and in files from before
+//                              version 3, which have int keys)
+//   [40..47] compression      (int64_t, PageCompression; 0 = none)
+//   [48..55] page_map         (int64_t, file offset of the first page map
+//                              directory block of a compressed file; 0 if
+//                              none was written yet)
 // ---------------------------------------------------------------------------
 constexpr size_t META_ROOT_OFFSET     = 0;
 constexpr size_t META_NEXT_PAGE       = 8;
 constexpr size_t META_FREE_LIST_HEAD  = 16;
+constexpr size_t META_FORMAT_VERSION  = 24;
+constexpr size_t META_KEY_SIZE        = 32;
+constexpr size_t META_COMPRESSION     = 40;
+constexpr size_t META_PAGE_MAP        = 48;
+
+/// Page format of the index file.  A file whose pages all use the current
+/// layouts has this version; older files are upgraded when opened.
+///   0 = internal pages with interleaved [child|key] slots
+///   1 = internal pages with separate key and child arrays
+///   2 = leaves with a dense key array and indirect payload slots
+///   3 = page arrays sized from PAGE_SIZE and the key size (38 records per
+///       leaf and 338 keys per internal page for int keys, instead of 35
+///       and 100); the key size is recorded in the metadata
+///   4 = slotted leaves with variable-length values; long values on
+///       overflow pages
+///   5 = leaves may store integer keys as suffixes of a shared prefix
+///       (version 4 pages are valid as they are)
+///   6 = the metadata records the page compression; compressed files pack
+///       pages behind a page map (uncompressed files are unchanged)
+constexpr int64_t FILE_FORMAT_VERSION = 6;
 
 // ---------------------------------------------------------------------------
 // Free page: when a page is freed, byte 0..7 contains the offset of the
@@ -51,12 +115,12 @@ constexpr size_t FREE_PAGE_NEXT_OFFSET = 0;
 // ---------------------------------------------------------------------------
 // Buffer pool default size
 // ---------------------------------------------------------------------------
-constexpr size_t DEFAULT_POOL_SIZE = 1024;  ///< 1024 frames = 4 MB
+constexpr size_t DEFAULT_POOL_SIZE   = 1024;  ///< 1024 frames = 4 MB
+constexpr size_t DEFAULT_POOL_SHARDS = 1;     ///< single partition
 
 // ---------------------------------------------------------------------------
-// B+ tree rebalancing thresholds
+// B+ tree rebalancing thresholds (leaves: LeafPage::kMinUsed bytes)
 // ---------------------------------------------------------------------------
-constexpr int LEAF_MIN_KEYS     = (LEAF_MAX_KEYS + 1) / 2;      ///< ceil(order/2)
 constexpr int INTERNAL_MIN_KEYS = (INTERNAL_MAX_KEYS + 1) / 2;  ///< ceil(order/2)
 
 // ---------------------------------------------------------------------------
@@ -64,4 +128,9 @@ constexpr int INTERNAL_MIN_KEYS = (INTERNAL_MAX_KEYS + 1) / 2;  ///< ceil(order/
 // ---------------------------------------------------------------------------
 constexpr const char* DEFAULT_INDEX_FILE = "bptree.idx";
 
+// ---------------------------------------------------------------------------
+// Network server (server.h)
+// ---------------------------------------------------------------------------
+constexpr uint16_t DEFAULT_SERVER_PORT = 7878;
+
 }  // namespace bptree
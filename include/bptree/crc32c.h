@@ -0,0 +1,39 @@
+#pragma once
+
+/// @file crc32c.h
+/// @brief CRC32C (Castagnoli) checksums with runtime-selected hardware
+///        acceleration.
+///
+/// Implementations:
+///   - **SSE4.2**: the x86 `crc32` instruction, 8 bytes per step.
+///   - **ARMv8**:  the `crc32c` instructions of the ARMv8 CRC extension.
+///   - **Slicing-by-8**: portable table-driven fallback, 8 bytes per step
+///     through eight 256-entry tables.
+///
+/// The implementation is picked once, on first use, from what the CPU
+/// reports; all of them produce identical results.
+///
+/// Checksums can be computed incrementally:
+/// @code
+///   uint32_t crc = CRC32C(header, header_len);
+///   crc = CRC32C(payload, payload_len, crc);   // == CRC32C of both
+/// @endcode
+
+#include <cstddef>
+#include <cstdint>
+
+namespace bptree {
+
+/// CRC32C of @p len bytes at @p data, continuing from @p crc (the result of
+/// a previous call, or 0 to start).
+uint32_t CRC32C(const void* data, size_t len, uint32_t crc = 0);
+
+/// Slicing-by-8 CRC32C; same contract as `CRC32C`, never uses special
+/// instructions.
+uint32_t CRC32CPortable(const void* data, size_t len, uint32_t crc = 0);
+
+/// Name of the implementation `CRC32C` uses ("sse4.2", "armv8" or
+/// "slicing-by-8").
+const char* CRC32CImplementation();
+
+}  // namespace bptree
@@ -1,15 +1,28 @@
 #pragma once
 
 /// @file disk_manager.h
-/// @brief Manages a memory-mapped index file.  Provides page-level access and
-///        allocation over a single backing file.
+/// @brief Manages the index file.  Provides page-level access and allocation
+///        over a single backing file, memory-mapped, read with O_DIRECT or
+///        compressed.
 
+#include "compression.h"
 #include "config.h"
+#include "io_ring.h"
 #include "status.h"
+#include <memory>
+#include <shared_mutex>
 #include <string>
+#include <vector>
 
 namespace bptree {
 
+/// How `DiskManager` reads and writes the pages of an uncompressed file.
+/// Either backend reads the same files.
+enum class DiskBackend {
+    kMmap,    ///< map the whole file and copy pages in and out of the mapping
+    kDirect,  ///< pread / pwrite with O_DIRECT, bypassing the page cache
+};
+
 /// Manages a single index file via mmap.
 ///
 /// Responsibilities:
@@ -19,11 +32,51 @@ namespace bptree {
 ///   - Expose raw pointers into the mapped region
 ///   - Sync dirty pages to disk
 ///
-/// Thread safety: **not thread-safe**.  External synchronisation is required.
+/// **Compressed files** (`PageCompression::kLZ4`) keep the same page
+/// offsets, but only the metadata page sits at its offset and is mapped.
+/// `WritePage` compresses a page into 1-8 512-byte sectors and writes it to
+/// a fresh slot; `ReadPage` decompresses it.  A page that does not save a
+/// sector is stored as it is.  A 4 KB block of the file holds slots of one
+/// size (8 one-sector slots, 4 of two, ...), so pages pack without
+/// fragmenting the free space.  The page map from page to slot lives in map
+/// blocks (512 slot references each) listed in a chain of directory blocks:
+///
+///   slot reference  = first sector << 4 | sectors   (0 = never written,
+///                                                    reads as zeros)
+///   directory block = [next directory block offset(8) | 511 map block offsets(8)]
+///
+/// A write updates its map entry on disk right away, so the file is as
+/// current as a mapped one when the process dies.  The slot a page had
+/// before is reused only after `Sync` has made the new entry durable.
+/// `PageData` is not available for compressed files.
+///
+/// **The direct backend** (`DiskBackend::kDirect`) maps only the metadata
+/// page too, and reads and writes the others with `pread` / `pwrite` on a
+/// descriptor opened with `O_DIRECT`.  The buffer pool is then the only
+/// cache of the pages: nothing is held twice, memory use is the pool's,
+/// and growing the file is an `ftruncate` with no remap.  Buffers that are
+/// not PAGE_SIZE-aligned go through an aligned bounce buffer.  Where the
+/// file system refuses `O_DIRECT` (tmpfs, for one) the backend falls back
+/// to buffered `pread` / `pwrite`; see `UsesDirectIO`.  Compressed files
+/// always use buffered I/O, since their slots are 512-byte sectors.
+/// `PageData` is not available with the direct backend.  With
+/// `IoEngine::kUring` its batches (`ReadPages` / `WritePages`) go to the
+/// device through one io_uring submission.
+///
+/// Thread safety: `ReadPage`, `WritePage`, the metadata accessors and the
+/// allocation functions are safe to call concurrently.  Growing the file
+/// remaps it, so raw pointers returned by `PageData` are only stable while no
+/// other thread can allocate; prefer the copying accessors in concurrent code.
 class DiskManager {
 public:
-    /// Open (or create) the index file at @p path.
-    explicit DiskManager(const std::string& path = DEFAULT_INDEX_FILE);
+    /// Open (or create) the index file at @p path.  @p compression applies
+    /// to a new file; an existing one keeps the compression it was created
+    /// with.  @p backend and @p engine are chosen on every open; @p engine
+    /// applies to the direct backend.
+    explicit DiskManager(const std::string& path = DEFAULT_INDEX_FILE,
+                         PageCompression compression = PageCompression::kNone,
+                         DiskBackend backend = DiskBackend::kMmap,
+                         IoEngine engine = IoEngine::kSync);
 
     ~DiskManager();
 
@@ -37,9 +90,30 @@ public:
 
     /// Return a writable pointer to the page at byte @p offset.
     /// @pre offset is page-aligned and within allocated range.
+    /// @throws std::logic_error for a compressed file or the direct backend.
     [[nodiscard]] char*       PageData(int64_t offset);
     [[nodiscard]] const char* PageData(int64_t offset) const;
 
+    /// Copy the page at byte @p offset into @p out (PAGE_SIZE bytes).
+    void ReadPage(int64_t offset, char* out) const;
+
+    /// Copy PAGE_SIZE bytes from @p data into the page at byte @p offset.
+    void WritePage(int64_t offset, const char* data);
+
+    /// Batch versions: read / write the @p count pages at byte @p offsets
+    /// into @p out / from @p data.  One io_uring submission for the whole
+    /// batch where `UsesIoUring`.  Otherwise the direct backend writes each
+    /// run of adjacent pages with one `pwritev`, and the rest goes page by
+    /// page.
+    void ReadPages(const int64_t* offsets, char* const* out, size_t count) const;
+    void WritePages(const int64_t* offsets, const char* const* data, size_t count);
+
+    /// Ask the kernel to start reading the @p count pages from byte
+    /// @p offset into memory (`MADV_WILLNEED`) without waiting for them.
+    /// Pages outside the file are ignored, and so is the call with direct
+    /// I/O, which has no page cache to read into.
+    void WillNeed(int64_t offset, size_t count = 1) const;
+
     /// Allocate a fresh zeroed page.  Returns its byte offset.
     int64_t AllocatePage();
 
@@ -57,18 +131,37 @@ public:
     [[nodiscard]] int64_t FreeListHead() const;
     void SetFreeListHead(int64_t offset);
 
+    /// Read / write the page format version (FILE_FORMAT_VERSION for new
+    /// files, 0 for files from before versioning).
+    [[nodiscard]] int64_t FormatVersion() const;
+    void SetFormatVersion(int64_t version);
+
+    /// Read / write the size of the tree's keys in bytes (sizeof(int) until
+    /// a tree records it, and for files from before it was recorded).
+    [[nodiscard]] size_t KeySize() const;
+    void SetKeySize(size_t size);
+
     /// Free a page: push it onto the free list for later reuse.
     void FreePage(int64_t page_offset);
 
     /// Try to reuse a freed page.  Returns INVALID_PAGE_ID if none available.
     int64_t ReclaimPage();
 
+    /// Drop every page at or past byte @p end: the next-page pointer moves
+    /// back to it (persisted right away) and the file is cut to it.  A
+    /// compressed file frees the pages' slots instead, its tail going once
+    /// `Sync` has made the map durable.
+    /// @pre No page at or past @p end is on the free list or still in use.
+    void Truncate(int64_t end);
+
     /// Persist the metadata page synchronously.
     void FlushMetadata();
 
     // -- Synchronisation -----------------------------------------------------
 
-    /// Flush all dirty pages to disk (synchronous).
+    /// Flush all dirty pages to disk (synchronous).  A compressed file then
+    /// reuses the slots its pages were moved away from.  With the direct
+    /// backend pages are already written, and this flushes the device.
     void Sync();
 
     /// Schedule a background flush (asynchronous).
@@ -76,18 +169,88 @@ public:
 
     // -- Queries -------------------------------------------------------------
 
+    /// Size of the page space: every page lies below this offset.  The
+    /// file's size unless it is compressed.
     [[nodiscard]] size_t      FileSize()  const { return file_size_; }
     [[nodiscard]] bool        IsValid()   const { return fd_ >= 0 && mapped_ != nullptr; }
     [[nodiscard]] std::string FilePath()  const { return path_; }
 
+    /// How the file stores its pages.
+    [[nodiscard]] PageCompression Compression() const { return compression_; }
+    [[nodiscard]] bool IsCompressed() const { return compression_ != PageCompression::kNone; }
+
+    /// How the pages are read and written, as requested on open.
+    [[nodiscard]] DiskBackend Backend() const { return backend_; }
+
+    /// True if page reads and writes bypass the page cache: the direct
+    /// backend on an uncompressed file, where the file system allows it.
+    [[nodiscard]] bool UsesDirectIO() const { return direct_io_; }
+
+    /// True if page batches go through io_uring.
+    [[nodiscard]] bool UsesIoUring() const { return ring_ && ring_->IsAsync(); }
+
+    /// Bytes the file takes on disk: FileSize() unless it is compressed.
+    [[nodiscard]] size_t StoredSize() const;
+
 private:
     /// Ensure the mapped region is at least @p required bytes.
+    /// @pre latch_ is held exclusively.
     void EnsureCapacity(int64_t required);
 
+    /// Unlocked metadata field access (caller holds latch_).
+    [[nodiscard]] int64_t ReadMeta(size_t field) const;
+    void WriteMeta(size_t field, int64_t value);
+
+    /// Pop the free-list head.  @pre latch_ is held exclusively.
+    int64_t ReclaimPageLocked();
+
+    /// Page copies without taking latch_.  @pre latch_ is held (exclusively
+    /// for WritePageLocked on a compressed file).
+    void ReadPageLocked(int64_t offset, char* out) const;
+    void WritePageLocked(int64_t offset, const char* data);
+
+    /// True if every page is mapped (mmap backend, uncompressed).
+    [[nodiscard]] bool MapsPages() const { return !packed_ && backend_ == DiskBackend::kMmap; }
+
+    /// Batches on the direct backend: whether the page at @p offset can go
+    /// straight to io_fd_ from @p buf (an aligned buffer, not the metadata
+    /// page); write runs of adjacent pages with `pwritev`; run ring
+    /// requests and throw if any failed.  @pre latch_ is held.
+    static constexpr int kMaxRun = 64;
+    [[nodiscard]] bool BatchablePage(int64_t offset, const char* buf) const;
+    void WriteRuns(const int64_t* offsets, const char* const* data, size_t count);
+    void SubmitPages(std::vector<IoRequest>& reqs) const;
+
+    /// Direct backend: one page through io_fd_, bounced if the caller's
+    /// buffer is not PAGE_SIZE-aligned.
+    void ReadDirect(int64_t offset, char* out) const;
+    void WriteDirect(int64_t offset, const char* data);
+
+    /// Compressed files: load the page map; make everything durable and
+    /// free replaced slots.  @pre latch_ is held exclusively.
+    void LoadPageMap();
+    void SyncPacked();
+
+    /// Page map and slot allocator of a compressed file (disk_manager.cpp).
+    struct PackedPages;
+
     std::string path_;
     int         fd_        = -1;
     char*       mapped_    = nullptr;
     size_t      file_size_ = 0;
+    size_t      mapped_size_ = 0;
+
+    DiskBackend backend_   = DiskBackend::kMmap;
+    int         io_fd_     = -1;     ///< direct backend: page I/O (fd_ if no O_DIRECT)
+    bool        direct_io_ = false;  ///< io_fd_ was opened with O_DIRECT
+    std::unique_ptr<IoRing> ring_;   ///< direct backend with IoEngine::kUring
+
+    PageCompression              compression_ = PageCompression::kNone;
+    std::unique_ptr<PackedPages> packed_;  ///< null unless compressed
+
+    /// Shared for page / metadata access, exclusive for allocation and
+    /// remapping (which moves mapped_).
+    mutable std::shared_mutex latch_;
 };
 
 }  // namespace bptree
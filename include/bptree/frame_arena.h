@@ -0,0 +1,88 @@
+#pragma once
+
+/// @file frame_arena.h
+/// @brief Page memory of the buffer pool: one block of PAGE_SIZE frames,
+///        optionally on huge pages and spread over NUMA nodes.
+///
+/// A large pool on 4 KB pages needs one TLB entry per frame, so lookups
+/// across a big resident tree miss in the TLB as often as in the cache.
+/// `FrameArena` maps all frames as one anonymous region instead:
+///
+///   - `HugePages::kExplicit` asks for pages from the hugetlbfs pool
+///     (`MAP_HUGETLB`): 1 GB pages when the arena is at least that large,
+///     else 2 MB.  Without reserved huge pages it falls back to
+///     `kTransparent`.
+///   - `HugePages::kTransparent` maps normal memory and asks for
+///     transparent huge pages (`MADV_HUGEPAGE`); the kernel backs it with
+///     2 MB pages where it can.
+///   - `HugePages::kOff` maps normal memory.
+///
+/// Frames are PAGE_SIZE-aligned either way, as O_DIRECT needs, and start
+/// zeroed.  The memory is not touched here, so `BindToNode` can still
+/// place ranges of it on a NUMA node before first use.
+///
+/// @code
+///   FrameArena arena(1024, HugePages::kExplicit);
+///   char* frame = arena.Frame(7);           // PAGE_SIZE bytes
+///   arena.BindToNode(0, 512, 0);            // frames 0..511 on node 0
+/// @endcode
+
+#include "config.h"
+
+#include <cstddef>
+#include <vector>
+
+namespace bptree {
+
+/// What backs the frames of a `FrameArena`.
+enum class HugePages {
+    kOff,          ///< 4 KB pages
+    kTransparent,  ///< transparent huge pages where the kernel has them
+    kExplicit,     ///< reserved huge pages, else transparent ones
+};
+
+/// One mapping holding a buffer pool's frames (see file comment).
+class FrameArena {
+public:
+    /// Map @p frames zeroed frames backed as @p huge_pages asks.
+    /// @throws std::bad_alloc if no mapping can be made.
+    explicit FrameArena(size_t frames, HugePages huge_pages = HugePages::kOff);
+    ~FrameArena();
+
+    FrameArena(const FrameArena&)            = delete;
+    FrameArena& operator=(const FrameArena&) = delete;
+
+    /// Frame @p i (< Frames()).
+    [[nodiscard]] char* Frame(size_t i) const { return base_ + i * PAGE_SIZE; }
+
+    [[nodiscard]] size_t Frames() const { return frames_; }
+
+    /// What the arena got: `kExplicit` only if reserved huge pages were
+    /// mapped, `kTransparent` if the kernel took the advice.
+    [[nodiscard]] HugePages Backing() const { return backing_; }
+
+    /// Size of the pages the mapping was made with (4 KB, 2 MB or 1 GB;
+    /// transparent huge pages report 2 MB, whether or not the kernel found
+    /// any to give).
+    [[nodiscard]] size_t PageSize() const { return page_size_; }
+
+    /// Place frames [@p begin, @p end) on NUMA node @p node, preferring it
+    /// rather than failing when it is full.  Only whole pages of the
+    /// mapping inside the range move; pages shared with the neighbouring
+    /// ranges keep the default policy.  Takes effect for memory not yet
+    /// touched.
+    /// @return false if the kernel refused (no NUMA support, or no such node).
+    bool BindToNode(size_t begin, size_t end, int node);
+
+    /// The online NUMA nodes, from sysfs; {0} if it cannot be read.
+    static std::vector<int> NumaNodes();
+
+private:
+    char*     base_      = nullptr;
+    size_t    frames_    = 0;
+    size_t    bytes_     = 0;  ///< mapped, rounded up to page_size_
+    size_t    page_size_ = PAGE_SIZE;
+    HugePages backing_   = HugePages::kOff;
+};
+
+}  // namespace bptree
@@ -0,0 +1,107 @@
+#pragma once
+
+/// @file io_ring.h
+/// @brief Batched file I/O over io_uring, with a synchronous fallback.
+///
+/// `IoRing::Submit` runs a batch of reads, writes and data syncs and waits
+/// for all of them.  With `IoEngine::kUring` the batch goes to the kernel
+/// in one `io_uring_enter` call (per ring's worth of requests), so the
+/// device sees the whole batch at once instead of one request per
+/// syscall.  A request with `link` set holds the next one back until it has
+/// completed, which orders a write before the sync that covers it.
+///
+/// Kernels without io_uring (before 5.6, or with it disabled) and
+/// `IoEngine::kSync` run the same batch one request at a time with
+/// `pread` / `pwrite` / `fdatasync`; the results are the same.
+///
+/// @code
+///   IoRing ring(IoEngine::kUring);
+///   IoRequest reqs[2];
+///   reqs[0] = {IoOp::kWrite, fd, buf, len, -1, true};  // append, then
+///   reqs[1] = {IoOp::kSync,  fd};                      // fdatasync
+///   ring.Submit(reqs, 2);   // reqs[i].result: bytes done or -errno
+/// @endcode
+
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <sys/types.h>
+
+namespace bptree {
+
+/// How `DiskManager` batches and the WAL submits their I/O.
+enum class IoEngine {
+    kSync,   ///< one syscall per request
+    kUring,  ///< batches through io_uring where the kernel has it
+};
+
+enum class IoOp { kRead, kWrite, kSync };
+
+/// One request of a batch.
+struct IoRequest {
+    IoOp    op     = IoOp::kRead;
+    int     fd     = -1;
+    void*   buf    = nullptr;
+    size_t  len    = 0;
+    int64_t offset = 0;      ///< -1: at (and advancing) the file position
+    bool    link   = false;  ///< the next request waits for this one to succeed
+    ssize_t result = 0;      ///< out: bytes transferred (0 for kSync) or -errno
+};
+
+/// A submission / completion ring pair (see file comment).
+///
+/// Thread safety: `Submit` is safe to call concurrently; batches from
+/// different threads run one after the other.
+class IoRing {
+public:
+    static constexpr unsigned kDefaultEntries = 64;
+
+    /// Set up a ring of @p entries requests for @p engine.  Falls back to
+    /// synchronous I/O if the kernel refuses the ring.
+    explicit IoRing(IoEngine engine = IoEngine::kUring, unsigned entries = kDefaultEntries);
+    ~IoRing();
+
+    IoRing(const IoRing&)            = delete;
+    IoRing& operator=(const IoRing&) = delete;
+
+    /// True if batches go through io_uring.
+    [[nodiscard]] bool IsAsync() const { return async_; }
+
+    /// Run the @p count requests at @p reqs and wait for all of them.
+    /// Reads and writes are completed in full unless they fail (a read
+    /// stops short at end of file).  A request after a failed linked one
+    /// is not run and gets -ECANCELED.
+    void Submit(IoRequest* reqs, size_t count);
+
+private:
+    /// Queue @p count requests, enter the kernel and reap every completion.
+    /// If the kernel stops taking them, requests it never took get
+    /// -ECANCELED (Submit runs them) after the ones it took have completed;
+    /// one whose completion cannot be reaped gets -EIO.
+    void SubmitRing(IoRequest* reqs, size_t count);
+
+    int      ring_fd_   = -1;
+    unsigned entries_   = 0;
+    bool     async_     = false;  ///< cleared if the kernel stops taking batches
+
+    // Submission ring.
+    void*     sq_ring_     = nullptr;
+    size_t    sq_ring_size_ = 0;
+    unsigned* sq_tail_     = nullptr;
+    unsigned* sq_mask_     = nullptr;
+    unsigned* sq_array_    = nullptr;
+    void*     sqes_        = nullptr;
+    size_t    sqes_size_   = 0;
+
+    // Completion ring (shares sq_ring_ when the kernel maps both at once).
+    void*     cq_ring_     = nullptr;
+    size_t    cq_ring_size_ = 0;
+    unsigned* cq_head_     = nullptr;
+    unsigned* cq_tail_     = nullptr;
+    unsigned* cq_mask_     = nullptr;
+    void*     cqes_        = nullptr;
+
+    std::mutex latch_;  ///< one batch at a time
+};
+
+}  // namespace bptree
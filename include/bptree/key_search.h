@@ -0,0 +1,244 @@
+#pragma once
+
+/// @file key_search.h
+/// @brief In-page key search: SIMD counting over dense key arrays and
+///        branch-free binary search over records.
+///
+/// Both report positions in a sorted run of keys:
+///   - **lower bound**: number of keys <  key (first slot with key >= key)
+///   - **upper bound**: number of keys <= key (first slot with key >  key)
+///
+/// Dense arrays (keys packed back to back, as in a page's key array) of 32-
+/// or 64-bit integers are searched by comparing a whole vector of keys per
+/// step and counting the matches, which for the few hundred keys of a page
+/// beats binary search: the loads are independent, there is nothing to
+/// mispredict, and the array is a few dozen cache lines at most.  The
+/// instruction set is chosen at compile time:
+///
+///   - **AVX2**: 8 (32-bit) or 4 (64-bit) keys per compare
+///   - **SSE2**: 4 keys per compare (baseline on x86-64); 64-bit keys need
+///     SSE4.2 for 2 per compare
+///   - **NEON**: 4 or 2 keys per compare (AArch64)
+///   - **Scalar**: branch-free binary search
+///
+/// Other key types and orders, and keys spread out at a fixed stride, are
+/// searched by a branch-free binary search whose halving step compiles to a
+/// conditional move.  `KeySearch` picks between them at compile time from
+/// the key type and comparator, so there is no dispatch at run time.
+///
+/// Key arrays need no particular alignment.  All functions are inline.
+
+#include "config.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <type_traits>
+
+#if defined(__AVX2__) || defined(__SSE2__)
+#include <immintrin.h>
+#elif defined(__aarch64__) && defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
+
+namespace bptree {
+
+namespace detail {
+
+template <typename Key = key_t>
+inline Key LoadKey(const char* p) {
+    Key k;
+    std::memcpy(&k, p, sizeof(k));
+    return k;
+}
+
+}  // namespace detail
+
+// ============================================================================
+// Strided keys: branch-free binary search
+// ============================================================================
+
+/// Number of the @p n sorted keys at @p keys, @p keys + @p stride, ... that
+/// are below @p key in the order of @p less (or, if @p or_equal, not above
+/// it).
+template <typename Key, typename Compare = std::less<Key>>
+inline int KeySearchStrided(const char* keys, size_t stride, int n, const Key& key,
+                            bool or_equal, const Compare& less = Compare()) {
+    if (n <= 0) return 0;
+    // probe <= key is !(key < probe).
+    auto before = [&](const Key& probe) {
+        return or_equal ? !less(key, probe) : less(probe, key);
+    };
+    // The answer lies in [base, base + len]; each step halves len without a
+    // data-dependent branch.
+    const char* base = keys;
+    size_t len = static_cast<size_t>(n);
+    while (len > 1) {
+        size_t half  = len / 2;
+        Key    probe = detail::LoadKey<Key>(base + (half - 1) * stride);
+        base = before(probe) ? base + half * stride : base;
+        len -= half;
+    }
+    size_t idx = static_cast<size_t>(base - keys) / stride;
+    return static_cast<int>(idx) + (before(detail::LoadKey<Key>(base)) ? 1 : 0);
+}
+
+inline int LowerBoundStrided(const char* keys, size_t stride, int n, key_t key) {
+    return KeySearchStrided(keys, stride, n, key, /*or_equal=*/false);
+}
+
+inline int UpperBoundStrided(const char* keys, size_t stride, int n, key_t key) {
+    return KeySearchStrided(keys, stride, n, key, /*or_equal=*/true);
+}
+
+// ============================================================================
+// Dense keys: vector compare and count
+// ============================================================================
+
+/// Name of the dense-array search compiled in for 32-bit keys ("avx2",
+/// "sse2", "neon" or "scalar").
+inline const char* KeySearchImplementation() {
+#if defined(__AVX2__)
+    return "avx2";
+#elif defined(__SSE2__)
+    return "sse2";
+#elif defined(__aarch64__) && defined(__ARM_NEON)
+    return "neon";
+#else
+    return "scalar";
+#endif
+}
+
+/// Number of the @p n sorted keys packed at @p keys that are below @p key
+/// (or, if @p or_equal, not above it).
+inline int KeySearchDense(const char* keys, int n, key_t key, bool or_equal) {
+    int count = 0;
+    int i     = 0;
+#if defined(__AVX2__)
+    const __m256i k = _mm256_set1_epi32(key);
+    for (; i + 8 <= n; i += 8) {
+        __m256i v  = _mm256_loadu_si256(
+            reinterpret_cast<const __m256i*>(keys + i * sizeof(key_t)));
+        // <= is the complement of >, so count the lanes above key instead.
+        __m256i m = or_equal ? _mm256_cmpgt_epi32(v, k) : _mm256_cmpgt_epi32(k, v);
+        int bits  = __builtin_popcount(_mm256_movemask_ps(_mm256_castsi256_ps(m)));
+        count += or_equal ? 8 - bits : bits;
+    }
+#elif defined(__SSE2__)
+    const __m128i k = _mm_set1_epi32(key);
+    for (; i + 4 <= n; i += 4) {
+        __m128i v  = _mm_loadu_si128(
+            reinterpret_cast<const __m128i*>(keys + i * sizeof(key_t)));
+        __m128i m = or_equal ? _mm_cmpgt_epi32(v, k) : _mm_cmplt_epi32(v, k);
+        int bits  = __builtin_popcount(_mm_movemask_ps(_mm_castsi128_ps(m)));
+        count += or_equal ? 4 - bits : bits;
+    }
+#elif defined(__aarch64__) && defined(__ARM_NEON)
+    const int32x4_t k = vdupq_n_s32(key);
+    for (; i + 4 <= n; i += 4) {
+        int32x4_t  v = vld1q_s32(reinterpret_cast<const int32_t*>(keys + i * sizeof(key_t)));
+        uint32x4_t m = or_equal ? vcleq_s32(v, k) : vcltq_s32(v, k);
+        count += static_cast<int>(vaddvq_u32(vshrq_n_u32(m, 31)));
+    }
+#endif
+    // The remaining keys (all of them without SIMD).
+    return count + KeySearchStrided(keys + i * sizeof(key_t), sizeof(key_t),
+                                    n - i, key, or_equal);
+}
+
+inline int LowerBoundDense(const char* keys, int n, key_t key) {
+    return KeySearchDense(keys, n, key, /*or_equal=*/false);
+}
+
+inline int UpperBoundDense(const char* keys, int n, key_t key) {
+    return KeySearchDense(keys, n, key, /*or_equal=*/true);
+}
+
+// ============================================================================
+// Dense 64-bit keys
+// ============================================================================
+
+/// Name of the dense-array search compiled in for 64-bit keys ("avx2",
+/// "sse4.2", "neon" or "scalar").
+inline const char* KeySearchImplementation64() {
+#if defined(__AVX2__)
+    return "avx2";
+#elif defined(__SSE4_2__)
+    return "sse4.2";
+#elif defined(__aarch64__) && defined(__ARM_NEON)
+    return "neon";
+#else
+    return "scalar";
+#endif
+}
+
+/// `KeySearchDense` for 64-bit keys.
+inline int KeySearchDense64(const char* keys, int n, int64_t key, bool or_equal) {
+    int count = 0;
+    int i     = 0;
+#if defined(__AVX2__)
+    const __m256i k = _mm256_set1_epi64x(key);
+    for (; i + 4 <= n; i += 4) {
+        __m256i v = _mm256_loadu_si256(
+            reinterpret_cast<const __m256i*>(keys + i * sizeof(int64_t)));
+        __m256i m = or_equal ? _mm256_cmpgt_epi64(v, k) : _mm256_cmpgt_epi64(k, v);
+        int bits  = __builtin_popcount(_mm256_movemask_pd(_mm256_castsi256_pd(m)));
+        count += or_equal ? 4 - bits : bits;
+    }
+#elif defined(__SSE4_2__)
+    const __m128i k = _mm_set1_epi64x(key);
+    for (; i + 2 <= n; i += 2) {
+        __m128i v = _mm_loadu_si128(
+            reinterpret_cast<const __m128i*>(keys + i * sizeof(int64_t)));
+        __m128i m = or_equal ? _mm_cmpgt_epi64(v, k) : _mm_cmpgt_epi64(k, v);
+        int bits  = __builtin_popcount(_mm_movemask_pd(_mm_castsi128_pd(m)));
+        count += or_equal ? 2 - bits : bits;
+    }
+#elif defined(__aarch64__) && defined(__ARM_NEON)
+    const int64x2_t k = vdupq_n_s64(key);
+    for (; i + 2 <= n; i += 2) {
+        int64x2_t  v = vld1q_s64(reinterpret_cast<const int64_t*>(keys + i * sizeof(int64_t)));
+        uint64x2_t m = or_equal ? vcleq_s64(v, k) : vcltq_s64(v, k);
+        count += static_cast<int>(vaddvq_u64(vshrq_n_u64(m, 63)));
+    }
+#endif
+    return count + KeySearchStrided(keys + i * sizeof(int64_t), sizeof(int64_t),
+                                    n - i, key, or_equal);
+}
+
+inline int LowerBoundDense64(const char* keys, int n, int64_t key) {
+    return KeySearchDense64(keys, n, key, /*or_equal=*/false);
+}
+
+inline int UpperBoundDense64(const char* keys, int n, int64_t key) {
+    return KeySearchDense64(keys, n, key, /*or_equal=*/true);
+}
+
+// ============================================================================
+// Any key type
+// ============================================================================
+
+/// True if `KeySearch` counts @p Key keys ordered by @p Compare with SIMD.
+template <typename Key, typename Compare>
+constexpr bool kKeySearchIsDense =
+    std::is_same_v<Compare, std::less<Key>> && std::is_integral_v<Key> &&
+    std::is_signed_v<Key> && (sizeof(Key) == 4 || sizeof(Key) == 8);
+
+/// Number of the @p n sorted keys packed at @p keys that are below @p key in
+/// the order of @p less (or, if @p or_equal, not above it): the SIMD count
+/// for signed 32- and 64-bit integers in ascending order, the branch-free
+/// binary search for everything else.
+template <typename Key, typename Compare = std::less<Key>>
+inline int KeySearch(const char* keys, int n, const Key& key, bool or_equal,
+                     const Compare& less = Compare()) {
+    if constexpr (kKeySearchIsDense<Key, Compare> && sizeof(Key) == 4) {
+        return KeySearchDense(keys, n, static_cast<int32_t>(key), or_equal);
+    } else if constexpr (kKeySearchIsDense<Key, Compare>) {
+        return KeySearchDense64(keys, n, static_cast<int64_t>(key), or_equal);
+    } else {
+        return KeySearchStrided(keys, sizeof(Key), n, key, or_equal, less);
+    }
+}
+
+}  // namespace bptree
@@ -0,0 +1,217 @@
+#pragma once
+
+/// @file metrics.h
+/// @brief Process-wide latency histograms and event counters.
+///
+/// Each thread records into its own shard of plain counters (a relaxed
+/// load and store, no atomic read-modify-write), so recording never
+/// contends.  `Metrics::Snapshot` sums the shards; a thread's counts are
+/// folded into the totals when it exits.
+///
+/// Histograms are log-linear (HDR-style): eight sub-buckets per power of
+/// two, so any value is within 12.5% of its bucket's bounds, from 1 ns up.
+///
+/// Instrumentation goes through the macros below.  Built with the CMake
+/// option `BPTREE_METRICS=OFF` they expand to nothing; `Metrics` itself
+/// still exists and reports zeros.
+///
+/// @code
+///   BPTREE_TIME(Histogram::kSearch);        // until the end of the scope
+///   BPTREE_COUNT(Counter::kLeafSplits);
+///
+///   MetricsSnapshot s = Metrics::Instance().Snapshot();
+///   s.Get(Histogram::kInsert).Percentile(0.99);   // nanoseconds
+///   std::cout << s.ToPrometheus();
+///   Metrics::Instance().Log();              // one JSON line via Logger
+/// @endcode
+
+#include "logger.h"
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#ifndef BPTREE_METRICS
+#define BPTREE_METRICS 1
+#endif
+
+namespace bptree {
+
+/// Timed operations.
+enum class Histogram {
+    kSearch,      ///< BPlusTree::Search
+    kInsert,      ///< BPlusTree::Insert
+    kDelete,      ///< BPlusTree::Delete
+    kRangeQuery,  ///< BPlusTree::RangeQuery
+    kWALSync,     ///< one fdatasync of the WAL (or write + sync batch)
+    kEviction,    ///< reclaiming a victim frame, its write-back included
+    kMissRead,    ///< reading a page in on a buffer pool miss
+    kCheckpoint,  ///< BPlusTree::Checkpoint
+    kCount
+};
+
+/// Counted events.
+enum class Counter {
+    kLeafSplits,
+    kInternalSplits,
+    kLeafMerges,
+    kLeafRedistributions,
+    kInternalMerges,
+    kInternalRedistributions,
+    kEvictions,
+    kDirtyEvictions,
+    kFilterNegatives,
+    kFilterFalsePositives,
+    kCount
+};
+
+/// Snake-case names, as used in the exports.
+const char* HistogramName(Histogram h);
+const char* CounterName(Counter c);
+
+/// Summed buckets of one histogram.
+struct HistogramSnapshot {
+    /// Eight sub-buckets for each of 62 powers of two past the first eight.
+    static constexpr int kSubBuckets = 8;
+    static constexpr int kBuckets    = 62 * kSubBuckets;
+
+    uint64_t count = 0;
+    uint64_t sum   = 0;  ///< nanoseconds
+    uint64_t max   = 0;
+    std::array<uint64_t, kBuckets> buckets{};
+
+    /// The bucket of @p value, and the largest value it holds.
+    static int      BucketOf(uint64_t value);
+    static uint64_t BucketHigh(int bucket);
+
+    /// Upper bound of the bucket holding the @p q quantile (0..1), clamped
+    /// to max; 0 if empty.
+    [[nodiscard]] uint64_t Percentile(double q) const;
+    [[nodiscard]] double   Mean() const { return count ? static_cast<double>(sum) / count : 0; }
+};
+
+/// Totals at one point in time.
+struct MetricsSnapshot {
+    std::array<HistogramSnapshot, static_cast<size_t>(Histogram::kCount)> histograms;
+    std::array<uint64_t, static_cast<size_t>(Counter::kCount)> counters{};
+
+    [[nodiscard]] const HistogramSnapshot& Get(Histogram h) const {
+        return histograms[static_cast<size_t>(h)];
+    }
+    [[nodiscard]] uint64_t Get(Counter c) const { return counters[static_cast<size_t>(c)]; }
+
+    /// {"histograms": {"search": {"count": .., "mean_ns": .., "p50_ns": ..,
+    /// "p99_ns": .., "p999_ns": .., "max_ns": ..}, ..}, "counters": {..}}
+    [[nodiscard]] std::string ToJSON() const;
+
+    /// Prometheus text format: a summary in seconds per histogram
+    /// (`bptree_search_seconds`), a `_total` counter per counter.
+    [[nodiscard]] std::string ToPrometheus() const;
+};
+
+/// The registry of per-thread shards (see file comment).
+class Metrics {
+public:
+    static Metrics& Instance() {
+        static Metrics instance;
+        return instance;
+    }
+
+    /// Record one sample of @p nanos in @p h.
+    void Record(Histogram h, uint64_t nanos) {
+        Shard& s = LocalShard();
+        auto& hist = s.histograms[static_cast<size_t>(h)];
+        Bump(hist.buckets[HistogramSnapshot::BucketOf(nanos)], 1);
+        Bump(hist.count, 1);
+        Bump(hist.sum, nanos);
+        if (nanos > hist.max.load(std::memory_order_relaxed)) {
+            hist.max.store(nanos, std::memory_order_relaxed);
+        }
+    }
+    /// Count @p n events of @p c.
+    void Add(Counter c, uint64_t n = 1) {
+        Bump(LocalShard().counters[static_cast<size_t>(c)], n);
+    }
+
+    [[nodiscard]] MetricsSnapshot Snapshot() const;
+
+    /// Zero every histogram and counter.  Samples recorded concurrently
+    /// may survive it.
+    void Reset();
+
+    /// Write the snapshot as one JSON line through `Logger`.
+    void Log(LogLevel level = LogLevel::INFO) const;
+
+    Metrics(const Metrics&)            = delete;
+    Metrics& operator=(const Metrics&) = delete;
+
+private:
+    struct HistogramShard {
+        std::array<std::atomic<uint64_t>, HistogramSnapshot::kBuckets> buckets{};
+        std::atomic<uint64_t> count{0};
+        std::atomic<uint64_t> sum{0};
+        std::atomic<uint64_t> max{0};
+    };
+    /// Written by its thread only; read by snapshots.
+    struct Shard {
+        std::array<HistogramShard, static_cast<size_t>(Histogram::kCount)> histograms;
+        std::array<std::atomic<uint64_t>, static_cast<size_t>(Counter::kCount)> counters{};
+    };
+    friend struct ShardOwner;
+
+    Metrics() = default;
+
+    static void Bump(std::atomic<uint64_t>& v, uint64_t n) {
+        v.store(v.load(std::memory_order_relaxed) + n, std::memory_order_relaxed);
+    }
+
+    /// This thread's shard, registered on first use.
+    Shard& LocalShard();
+    void   Retire(Shard* shard);   ///< fold an exiting thread's counts in
+    static void AddTo(MetricsSnapshot& out, const Shard& s);
+
+    mutable std::mutex  latch_;    ///< Guards shards_ and retired_.
+    std::vector<Shard*> shards_;   ///< Live threads.
+    MetricsSnapshot     retired_;  ///< Exited threads, summed.
+};
+
+/// Records the time from construction to destruction in a histogram.
+class ScopedLatency {
+public:
+    explicit ScopedLatency(Histogram h) : h_(h), start_(std::chrono::steady_clock::now()) {}
+    ~ScopedLatency() {
+        auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now() - start_).count();
+        Metrics::Instance().Record(h_, static_cast<uint64_t>(ns));
+    }
+
+    ScopedLatency(const ScopedLatency&)            = delete;
+    ScopedLatency& operator=(const ScopedLatency&) = delete;
+
+private:
+    Histogram h_;
+    std::chrono::steady_clock::time_point start_;
+};
+
+}  // namespace bptree
+
+#define BPTREE_METRICS_CONCAT2(a, b) a##b
+#define BPTREE_METRICS_CONCAT(a, b)  BPTREE_METRICS_CONCAT2(a, b)
+
+#if BPTREE_METRICS
+/// Time the rest of the enclosing scope into histogram @p h.
+#define BPTREE_TIME(h) \
+    ::bptree::ScopedLatency BPTREE_METRICS_CONCAT(bptree_latency_, __LINE__)(::bptree::h)
+/// Count one (or @p n) of @p c.
+#define BPTREE_COUNT(c)     ::bptree::Metrics::Instance().Add(::bptree::c)
+#define BPTREE_COUNT_N(c, n) ::bptree::Metrics::Instance().Add(::bptree::c, (n))
+#else
+#define BPTREE_TIME(h)       ((void)0)
+#define BPTREE_COUNT(c)      ((void)0)
+#define BPTREE_COUNT_N(c, n) ((void)0)
+#endif
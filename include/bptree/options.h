@@ -0,0 +1,137 @@
+#pragma once
+
+/// @file options.h
+/// @brief Tunables used when opening a BPlusTree.
+
+#include "compression.h"
+#include "config.h"
+#include "disk_manager.h"
+#include "frame_arena.h"
+#include "replacer.h"
+
+#include <cstddef>
+#include <cstdint>
+
+namespace bptree {
+
+/// Options controlling how a `BPlusTree` is opened.  The defaults match the
+/// positional `BPlusTree` constructor.
+///
+/// @code
+///   bptree::Options opts;
+///   opts.pool_size   = 16384;   // 64 MB
+///   opts.pool_shards = 16;
+///   bptree::BPlusTree tree("my_index.idx", opts);
+/// @endcode
+struct Options {
+    /// Number of buffer pool frames (default 1024 = 4 MB).
+    size_t pool_size = DEFAULT_POOL_SIZE;
+
+    /// Number of buffer pool partitions.  More shards let concurrent misses
+    /// proceed in parallel; see `BufferPool` for the per-shard minimum.
+    size_t pool_shards = DEFAULT_POOL_SHARDS;
+
+    /// Buffer pool page replacement policy.  `kLRUK` keeps large range
+    /// scans from flushing frequently used pages out of the pool.
+    ReplacementPolicy replacement_policy = ReplacementPolicy::kLRU;
+
+    /// What backs the buffer pool's frames.  Huge pages cut TLB misses on
+    /// large pools; `kExplicit` needs pages reserved in
+    /// /proc/sys/vm/nr_hugepages and falls back to `kTransparent`.  See
+    /// `FrameArena`.
+    HugePages pool_huge_pages = HugePages::kTransparent;
+
+    /// On multi-socket hosts, place each buffer pool shard's frames on a
+    /// NUMA node, round robin.  Use with `pool_shards` >= the node count.
+    bool pool_numa = false;
+
+    /// Enable write-ahead logging for crash recovery.
+    bool enable_wal = true;
+
+    /// Batch WAL syncs across concurrent writers (see `WALOptions`).
+    bool wal_group_commit = false;
+
+    /// Longest a WAL batch is held open for more records, in microseconds.
+    uint32_t wal_group_commit_latency_us = 0;
+
+    /// Buffered WAL bytes that start a batch on their own.
+    size_t wal_group_commit_bytes = 1 << 20;
+
+    /// Threads that verify and replay the WAL when the tree is opened
+    /// (0 = one per hardware thread).
+    unsigned wal_recovery_threads = 0;
+
+    /// Most leaves a forward scan reads ahead of itself (0 = off).  Scans
+    /// start with a small window and double it while they keep going; see
+    /// `BPlusTree::Cursor::SetReadAhead`.
+    size_t scan_read_ahead = 0;
+
+    /// Point lookups and the first pass of writes walk the internal levels
+    /// without pinning or latching them, validating frame versions instead
+    /// and retrying on a conflict (optimistic lock coupling).  Only the
+    /// leaf is latched.  Off, they crab down with shared latches.
+    bool optimistic_reads = true;
+
+    /// Let internal pages keep the buffer pool frame of each resident
+    /// child beside them, so optimistic descents follow it instead of
+    /// looking the child up (pointer swizzling).  The pages themselves
+    /// keep file offsets.  Needs optimistic_reads.
+    bool swizzle_pointers = true;
+
+    /// How full a delete keeps nodes, as a fraction of the usual minimum
+    /// (half a leaf's bytes, half an internal node's keys).  At 1 an
+    /// underfull node borrows from or merges with a sibling right away.
+    /// Lower, nodes drain further first, which spares mass deletes most
+    /// of that merge churn for sparser pages; at 0 only empty leaves and
+    /// internal nodes down to one child are merged.  `BPlusTree::Compact`
+    /// gives the space back.
+    double merge_threshold = 1.0;
+
+    /// Bits per key of an in-memory Bloom filter over the keys, so that
+    /// `Search` and `MultiGet` answer most lookups of absent keys without
+    /// reading a page; 0 (the default) keeps no filter.  About 10 gives a
+    /// 1% false-positive rate.  The filter is built from the leaves when
+    /// the tree opens, and deleted keys stay in it until the next open.
+    /// Keys are hashed by their bytes, so `Compare` must treat only
+    /// identical keys as equal.
+    size_t bloom_bits_per_key = 0;
+
+    /// How a new index file stores its pages.  `kLZ4` compresses each page
+    /// as it is written back and packs it into 512-byte sectors, trading
+    /// CPU on buffer pool misses for less read I/O and storage; frames in
+    /// the pool stay uncompressed.  An existing file keeps the setting it
+    /// was created with.  See `DiskManager`.
+    PageCompression page_compression = PageCompression::kNone;
+
+    /// How pages move between the file and the buffer pool.  `kMmap` maps
+    /// the file and copies pages out of the page cache, so cached pages
+    /// are held twice; it suits small indexes.  `kDirect` reads and writes
+    /// with O_DIRECT, making the pool the only cache: memory use is
+    /// `pool_size` pages and growing the file never remaps it.  Compressed
+    /// files ignore it.  See `DiskManager`.
+    DiskBackend disk_backend = DiskBackend::kMmap;
+
+    /// How batches of I/O are submitted.  `kUring` sends the direct
+    /// backend's read-ahead and write-back batches, and each WAL group
+    /// commit (write linked to fdatasync), through io_uring; kernels
+    /// without it run them synchronously.  See `IoRing`.
+    IoEngine io_engine = IoEngine::kSync;
+
+    /// Write dirty pages back from a background thread ahead of their
+    /// eviction, so misses rarely wait for a write (see
+    /// `BufferPool::StartCleaner`).
+    bool page_cleaner = false;
+
+    /// Fraction of each shard's coldest frames the cleaner keeps clean.
+    double page_cleaner_clean_fraction = 0.1;
+
+    /// Dirty fraction of the pool that wakes the cleaner at once, and the
+    /// one it then writes back down to.
+    double page_cleaner_dirty_high_water = 0.5;
+    double page_cleaner_dirty_low_water  = 0.25;
+
+    /// Longest the cleaner sleeps between passes, in milliseconds.
+    uint32_t page_cleaner_interval_ms = 20;
+};
+
+}  // namespace bptree
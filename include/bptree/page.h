@@ -7,8 +7,15 @@
 /// nodes stored in a flat char* buffer, hiding all the byte-level arithmetic.
 
 #include "config.h"
+#include "key_search.h"
+#include <algorithm>
 #include <cstring>
 #include <cassert>
+#include <functional>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <vector>
 
 namespace bptree {
 
@@ -35,38 +42,122 @@ inline void WriteAt(char* base, size_t off, T v) {
 // PageType detector  (works on any raw page)
 // ============================================================================
 
-/// Check the is_leaf flag at byte 4 of any page.
+/// Page type tag at byte 4 of any tree page (PAGE_TYPE_*).
+inline int PageType(const char* data) {
+    return detail::ReadAt<int>(data, 4);
+}
+
+/// Check whether a page is a leaf (in any layout).
 inline bool PageIsLeaf(const char* data) {
-    return detail::ReadAt<int>(data, 4) == 1;
+    int type = PageType(data);
+    return type == PAGE_TYPE_LEAF || type == PAGE_TYPE_PREFIX_LEAF ||
+           type == PAGE_TYPE_V3_LEAF || type == PAGE_TYPE_V2_LEAF ||
+           type == PAGE_TYPE_LEGACY_LEAF;
+}
+
+/// LSN of the last WAL record that modified the page.
+inline uint64_t PageLSN(const char* data) {
+    return detail::ReadAt<uint64_t>(data, PAGE_LSN_OFFSET);
+}
+
+inline void SetPageLSN(char* data, uint64_t lsn) {
+    detail::WriteAt<uint64_t>(data, PAGE_LSN_OFFSET, lsn);
 }
 
 // ============================================================================
-// LeafPage
+// BasicFixedLeafPage
 // ============================================================================
 ///
-/// Layout (all multi-byte values little-endian on x86):
+/// The leaf layout of format version 3, with a fixed DATA_SIZE payload per
+/// record.  Only read to upgrade a file, and to replay logs written before
+/// leaves became slotted (WAL format version 3 and older).
+///
+/// Layout for @p Key keys of K = sizeof(Key) bytes and N = kMaxKeys records
+/// (all multi-byte values little-endian on x86):
 ///
 ///   Offset  Size   Field
 ///   ------  -----  --------------------------------
 ///   0       4      num_keys       (int)
-///   4       4      is_leaf = 1    (int)
+///   4       4      type = 5       (int, PAGE_TYPE_V3_LEAF)
 ///   8       8      next_leaf      (int64_t, offset or -1)
-///   16      N×104  records[]      — each record is [key(4) | data(100)]
+///   16      N×K    keys[]         (Key, sorted)
+///   16+N×K  N×1    slots[]        (uint8_t, payload slot of each key)
+///   (8-aligned) N×100 payloads[]  (DATA_SIZE bytes each)
+///   4088    8      page_lsn       (uint64_t, see PageLSN)
+///
+///   Record i is keys[i] with payloads[slots[i]].  slots[] is always a
+///   permutation of 0..kMaxKeys-1: entries past num_keys name the free
+///   payloads, so an insert takes slots[num_keys] and a shift moves keys and
+///   slot bytes, never payloads.  A search reads only the dense key array
+///   (2-5 cache lines).
 ///
-///   Max records per page: LEAF_MAX_KEYS (35)
-///   Total used: 16 + 35 × 104 = 3656 bytes  (fits in 4096)
+///   N is `LeafMaxKeys(K)`: 38 records for int keys (keys at 16, slots at
+///   168, payloads at 208), 37 for 8-byte keys.
 ///
-class LeafPage {
+///   Files with int keys from before format version 2 store [key(4) |
+///   data(100)] records back to back after the header under type
+///   PAGE_TYPE_LEGACY_LEAF; version 2 files use this layout sized for 35
+///   records under type PAGE_TYPE_V2_LEAF.  `UpgradeLegacy` converts either
+///   in place.
+///
+template <typename Key>
+class BasicFixedLeafPage {
 public:
-    explicit LeafPage(char* raw) : d_(raw) { assert(raw); }
+    static_assert(std::is_trivially_copyable_v<Key>, "keys are stored as raw bytes");
+
+    using key_type = Key;
+
+    static constexpr int kMaxKeys = LeafMaxKeys(sizeof(Key));
+    static constexpr int kMinKeys = (kMaxKeys + 1) / 2;  ///< ceil(order/2)
+
+    explicit BasicFixedLeafPage(char* raw) : d_(raw) { assert(raw); }
 
     // -- Static factory ------------------------------------------------------
 
     /// Zero-initialise a raw page as a leaf.
     static void Init(char* raw) {
         std::memset(raw, 0, PAGE_SIZE);
-        detail::WriteAt<int>(raw, 4, 1);                  // is_leaf = 1
+        detail::WriteAt<int>(raw, 4, PAGE_TYPE_V3_LEAF);
         detail::WriteAt<int64_t>(raw, 8, INVALID_PAGE_ID); // next = -1
+        for (int i = 0; i < kMaxKeys; ++i) {
+            raw[kSlotsOffset + i] = static_cast<char>(i);
+        }
+    }
+
+    /// True if @p raw is a leaf in a layout older than this one (only files
+    /// with int keys have them).
+    static bool IsLegacy(const char* raw) {
+        int type = PageType(raw);
+        return sizeof(Key) == sizeof(int) &&
+               (type == PAGE_TYPE_LEGACY_LEAF || type == PAGE_TYPE_V2_LEAF);
+    }
+
+    /// Rewrite a leaf in an older layout in this one.  The records, the next
+    /// leaf and the page LSN are kept.
+    static void UpgradeLegacy(char* raw) {
+        if constexpr (sizeof(Key) == sizeof(int)) {
+            int      n    = detail::ReadAt<int>(raw, 0);
+            int64_t  next = detail::ReadAt<int64_t>(raw, 8);
+            uint64_t lsn  = bptree::PageLSN(raw);
+            char records[kMaxKeys * kRecordSize];
+            if (PageType(raw) == PAGE_TYPE_LEGACY_LEAF) {
+                std::memcpy(records, raw + kHeaderSize, static_cast<size_t>(n) * kRecordSize);
+            } else {
+                for (int i = 0; i < n; ++i) {
+                    char* out  = records + static_cast<size_t>(i) * kRecordSize;
+                    auto  slot = static_cast<unsigned char>(raw[kV2SlotsOffset + i]);
+                    std::memcpy(out, raw + kKeysOffset + i * sizeof(Key), sizeof(Key));
+                    std::memcpy(out + sizeof(Key), raw + kV2PayloadOffset + slot * DATA_SIZE,
+                                DATA_SIZE);
+                }
+            }
+
+            Init(raw);
+            BasicFixedLeafPage leaf(raw);
+            leaf.SetNextLeaf(next);
+            leaf.SetPageLSN(lsn);
+            leaf.AppendRecords(records, n);
+        }
     }
 
     // -- Accessors -----------------------------------------------------------
@@ -77,72 +168,859 @@ public:
     [[nodiscard]] int64_t  NextLeaf() const { return detail::ReadAt<int64_t>(d_, 8); }
     void                   SetNextLeaf(int64_t v) { detail::WriteAt<int64_t>(d_, 8, v); }
 
+    [[nodiscard]] uint64_t PageLSN()  const { return bptree::PageLSN(d_); }
+    void                   SetPageLSN(uint64_t lsn) { bptree::SetPageLSN(d_, lsn); }
+
     // -- Per-record access ---------------------------------------------------
+    //
+    // Setters may address slot NumKeys() .. kMaxKeys-1 to fill records in
+    // before raising NumKeys.
 
-    [[nodiscard]] int KeyAt(int idx) const {
-        return detail::ReadAt<int>(d_, RecordOffset(idx));
+    [[nodiscard]] Key KeyAt(int idx) const {
+        return detail::ReadAt<Key>(d_, KeyOffset(idx));
     }
 
-    void SetKeyAt(int idx, int key) {
-        detail::WriteAt<int>(d_, RecordOffset(idx), key);
+    void SetKeyAt(int idx, const Key& key) {
+        detail::WriteAt<Key>(d_, KeyOffset(idx), key);
     }
 
     void GetData(int idx, char* out) const {
-        std::memcpy(out, d_ + RecordOffset(idx) + 4, DATA_SIZE);
+        std::memcpy(out, d_ + PayloadOffset(idx), DATA_SIZE);
+    }
+
+    /// The DATA_SIZE payload bytes of record @p idx, in place.
+    [[nodiscard]] const char* DataAt(int idx) const {
+        return d_ + PayloadOffset(idx);
     }
 
     void SetData(int idx, const char* data) {
-        std::memcpy(d_ + RecordOffset(idx) + 4, data, DATA_SIZE);
+        std::memcpy(d_ + PayloadOffset(idx), data, DATA_SIZE);
     }
 
-    void SetRecord(int idx, int key, const char* data) {
+    void SetRecord(int idx, const Key& key, const char* data) {
         SetKeyAt(idx, key);
         SetData(idx, data);
     }
 
-    void GetRecord(int idx, int& key, char* data) const {
+    void GetRecord(int idx, Key& key, char* data) const {
         key = KeyAt(idx);
         GetData(idx, data);
     }
 
+    // -- Search --------------------------------------------------------------
+    //
+    // Keys are in the order of @p less, the tree's comparator.
+
+    /// First slot whose key is >= @p key (NumKeys() if none).
+    template <typename Compare = std::less<Key>>
+    [[nodiscard]] int LowerBound(const Key& key, const Compare& less = Compare()) const {
+        return KeySearch(d_ + kKeysOffset, NumKeys(), key, /*or_equal=*/false, less);
+    }
+
+    /// First slot whose key is > @p key (NumKeys() if none).
+    template <typename Compare = std::less<Key>>
+    [[nodiscard]] int UpperBound(const Key& key, const Compare& less = Compare()) const {
+        return KeySearch(d_ + kKeysOffset, NumKeys(), key, /*or_equal=*/true, less);
+    }
+
+    /// Slot holding @p key, or -1.
+    template <typename Compare = std::less<Key>>
+    [[nodiscard]] int Find(const Key& key, const Compare& less = Compare()) const {
+        int idx = LowerBound(key, less);
+        return idx < NumKeys() && !less(key, KeyAt(idx)) ? idx : -1;
+    }
+
+    // -- Record-level edits --------------------------------------------------
+    //
+    // The tree and WAL redo both go through these, so a logged change replays
+    // to exactly the bytes it produced.
+
+    /// Insert a record at @p idx, shifting records idx.. one to the right.
+    void InsertAt(int idx, const Key& key, const char* data) {
+        int  n    = NumKeys();
+        char free = d_[kSlotsOffset + n];
+        std::memmove(d_ + KeyOffset(idx + 1), d_ + KeyOffset(idx),
+                     static_cast<size_t>(n - idx) * sizeof(Key));
+        std::memmove(d_ + kSlotsOffset + idx + 1, d_ + kSlotsOffset + idx,
+                     static_cast<size_t>(n - idx));
+        d_[kSlotsOffset + idx] = free;
+        SetRecord(idx, key, data);
+        SetNumKeys(n + 1);
+    }
+
+    /// Remove the record at @p idx, shifting later records one to the left.
+    void RemoveAt(int idx) {
+        int  n    = NumKeys();
+        char slot = d_[kSlotsOffset + idx];
+        std::memmove(d_ + KeyOffset(idx), d_ + KeyOffset(idx + 1),
+                     static_cast<size_t>(n - idx - 1) * sizeof(Key));
+        std::memmove(d_ + kSlotsOffset + idx, d_ + kSlotsOffset + idx + 1,
+                     static_cast<size_t>(n - idx - 1));
+        d_[kSlotsOffset + n - 1] = slot;
+        SetNumKeys(n - 1);
+    }
+
+    /// Pack @p count records starting at @p idx into @p out as
+    /// [key | data(100)] records (the WAL's record format).
+    void CopyRecords(int idx, int count, char* out) const {
+        for (int i = 0; i < count; ++i, out += kRecordSize) {
+            Key key = KeyAt(idx + i);
+            std::memcpy(out, &key, sizeof(key));
+            GetData(idx + i, out + sizeof(key));
+        }
+    }
+
+    /// Append @p count packed records (as written by CopyRecords).
+    void AppendRecords(const char* records, int count) {
+        int n = NumKeys();
+        for (int i = 0; i < count; ++i, records += kRecordSize) {
+            SetRecord(n + i, detail::ReadAt<Key>(records, 0), records + sizeof(Key));
+        }
+        SetNumKeys(n + count);
+    }
+
+    /// Append @p count records of @p src starting at @p idx.
+    void AppendFrom(const BasicFixedLeafPage& src, int idx, int count) {
+        int n = NumKeys();
+        std::memcpy(d_ + KeyOffset(n), src.d_ + KeyOffset(idx),
+                    static_cast<size_t>(count) * sizeof(Key));
+        for (int i = 0; i < count; ++i) {
+            std::memcpy(d_ + PayloadOffset(n + i), src.d_ + src.PayloadOffset(idx + i), DATA_SIZE);
+        }
+        SetNumKeys(n + count);
+    }
+
+    static constexpr size_t kRecordSize = sizeof(Key) + DATA_SIZE;  // key + payload
+
 private:
     char* d_;
 
-    static constexpr size_t kHeaderSize  = 16;  // 4 + 4 + 8
-    static constexpr size_t kRecordSize  = 4 + DATA_SIZE;  // key + payload
+    static constexpr size_t kHeaderSize    = 16;  // 4 + 4 + 8
+    static constexpr size_t kKeysOffset    = kHeaderSize;
+    static constexpr size_t kSlotsOffset   = kKeysOffset + kMaxKeys * sizeof(Key);
+    static constexpr size_t kPayloadOffset = (kSlotsOffset + kMaxKeys + 7) & ~size_t{7};
 
-    static constexpr size_t RecordOffset(int idx) {
-        return kHeaderSize + static_cast<size_t>(idx) * kRecordSize;
+    // Format version 2 (int keys, 35 records).
+    static constexpr int    kV2MaxKeys       = 35;
+    static constexpr size_t kV2SlotsOffset   = kKeysOffset + kV2MaxKeys * sizeof(int);
+    static constexpr size_t kV2PayloadOffset = (kV2SlotsOffset + kV2MaxKeys + 7) & ~size_t{7};
+
+    static constexpr size_t KeyOffset(int idx) {
+        return kKeysOffset + static_cast<size_t>(idx) * sizeof(Key);
+    }
+
+    [[nodiscard]] size_t PayloadOffset(int idx) const {
+        auto slot = static_cast<unsigned char>(d_[kSlotsOffset + idx]);
+        return kPayloadOffset + slot * DATA_SIZE;
     }
+
+    static_assert(kMaxKeys <= 256, "payload slots are one byte");
+    static_assert(kPayloadOffset + kMaxKeys * DATA_SIZE <= PAGE_LSN_OFFSET,
+                  "leaf payloads overlap the page LSN");
+    static_assert(sizeof(Key) != sizeof(int) ||
+                  kHeaderSize + kMaxKeys * kRecordSize <= PAGE_LSN_OFFSET,
+                  "legacy leaf records overlap the page LSN");
 };
 
+using FixedLeafPage = BasicFixedLeafPage<key_t>;
+
 // ============================================================================
-// InternalPage
+// BasicLeafPage
 // ============================================================================
 ///
-/// Layout:
+/// Slotted layout for @p Key keys of K = sizeof(Key) bytes and n records
+/// with values of any length:
 ///
-///   Offset  Size   Field
-///   ------  -----  --------------------------------
-///   0       4      num_keys       (int)
-///   4       4      is_leaf = 0    (int)
-///   8       N×12   slots[]        — each slot is [child(8) | key(4)]
+///   Offset      Size   Field
+///   ----------  -----  --------------------------------
+///   0           4      num_keys       (int, n)
+///   4           4      type = 6 or 8  (int, PAGE_TYPE_LEAF / _PREFIX_LEAF)
+///   8           8      next_leaf      (int64_t, offset or -1)
+///   16          2      heap_start     (uint16_t, lowest byte used by cells)
+///   18          2      frag_bytes     (uint16_t, dead cell bytes in the heap)
+///   20          4      prefix         (uint32_t, type 8: high half of keys)
+///   24          n×W    keys[]         (sorted; W = K, or K/2 in type 8)
+///   24+n×W      n×2    cell_offsets[] (uint16_t, cell of each key)
+///   ...                free space
+///   heap_start         cells          (grow down from the page LSN)
+///   4088        8      page_lsn       (uint64_t, see PageLSN)
+///
+///   Record i is keys[i] with the cell at cell_offsets[i].  A cell is a
+///   2-byte header -- the size of its body, with kOverflowFlag set if the
+///   body is a reference to overflow pages -- followed by the body: the
+///   value itself, or [length(4) | first overflow page(8)].  The offsets
+///   array follows the keys, so both move as n changes; a search still
+///   reads only the dense key array.
+///
+///   Removing a record leaves its cell behind as fragmentation (unless it is
+///   the lowest cell); an insert that finds too little contiguous space
+///   compacts the heap first.  Every edit is deterministic, so WAL redo of
+///   the same edits rebuilds the same bytes.  Bytes an edit frees are
+///   zeroed, so a page written to a compressed file costs about its live
+///   records (see PageCompression).
+///
+///   Capacity is counted in bytes: a record takes kEntrySize + its cell.
+///   Records are at most kMaxRecordSize (a quarter of the page), so a
+///   split always leaves room for the record that caused it, and a leaf
+///   below kMinUsed that cannot borrow from a sibling can merge with it.
+///
+///   Prefix compression: integer keys of 4 or 8 bytes that all share their
+///   high half are stored once as `prefix`, and each key as its low half
+///   (type 8; kPrefixable).  An insert of a key outside the prefix widens
+///   the page to full keys first; a removal that leaves only keys sharing
+///   one narrows it again.  A search compares the search key against the
+///   prefix's range once and then counts in the suffix array, which for
+///   8-byte keys is a 32-bit SIMD search.
+///
+///   Splits, borrows and merges are decided on `UsedBytes`, which counts
+///   every key at full width, so they hold whatever the layout of the pages
+///   they produce; whether a record fits is decided on `FreeBytes`, the
+///   space the page really has left.  A prefixed page therefore takes more
+///   records before it splits.
+///
+///   Fixed-payload leaves of format version 3 and older (see
+///   BasicFixedLeafPage) are converted by `UpgradeLegacy`.
+///
+template <typename Key>
+class BasicLeafPage {
+public:
+    static_assert(std::is_trivially_copyable_v<Key>, "keys are stored as raw bytes");
+
+    using key_type = Key;
+
+    static constexpr size_t kHeaderSize     = 24;
+    /// Bytes available to records: everything between header and page LSN.
+    static constexpr size_t kCapacity       = PAGE_LSN_OFFSET - kHeaderSize;
+    /// Bytes a record takes besides its cell: the key and the cell offset.
+    static constexpr size_t kEntrySize      = sizeof(Key) + sizeof(uint16_t);
+    static constexpr size_t kCellHeaderSize = sizeof(uint16_t);
+    static constexpr size_t kMaxRecordSize  = kCapacity / 4;
+    static constexpr size_t kMaxCellSize    = kMaxRecordSize - kEntrySize;
+    /// Longer values are stored on overflow pages.
+    static constexpr size_t kMaxInlineValue = kMaxCellSize - kCellHeaderSize;
+    /// A non-root leaf with fewer used bytes is underful.
+    static constexpr size_t kMinUsed        = (kCapacity - kMaxRecordSize) / 2;
+
+    /// True if keys are stored as suffixes of a page prefix when they can be.
+    static constexpr bool   kPrefixable  = std::is_integral_v<Key> &&
+                                           (sizeof(Key) == 4 || sizeof(Key) == 8);
+    /// Bytes of a key in a prefixed page.
+    static constexpr size_t kSuffixSize  = kPrefixable ? sizeof(Key) / 2 : sizeof(Key);
+
+    static constexpr uint16_t kOverflowFlag    = 0x8000;
+    static constexpr size_t   kOverflowRefSize = 4 + 8;  // length + first page
+
+    explicit BasicLeafPage(char* raw) : d_(raw) { assert(raw); }
+
+    // -- Static factory ------------------------------------------------------
+
+    /// Zero-initialise a raw page as an empty leaf.  Its first record sets
+    /// the prefix.
+    static void Init(char* raw) {
+        std::memset(raw, 0, PAGE_SIZE);
+        detail::WriteAt<int>(raw, 4, PAGE_TYPE_LEAF);
+        detail::WriteAt<int64_t>(raw, 8, INVALID_PAGE_ID); // next = -1
+        detail::WriteAt<uint16_t>(raw, kHeapStartOffset, static_cast<uint16_t>(PAGE_LSN_OFFSET));
+    }
+
+    /// True if @p raw is a leaf with fixed-size payloads.
+    static bool IsLegacy(const char* raw) {
+        return PageType(raw) == PAGE_TYPE_V3_LEAF || BasicFixedLeafPage<Key>::IsLegacy(raw);
+    }
+
+    /// Rewrite a fixed-payload leaf in this layout.  The next leaf and the
+    /// page LSN are kept; each value is its payload up to the first NUL, as
+    /// those layouts held C strings.  If the records do not all fit, the
+    /// largest values are stored elsewhere by @p spill(data, len), which
+    /// returns the first overflow page.
+    template <typename Spill>
+    static void UpgradeLegacy(char* raw, Spill&& spill) {
+        using Fixed = BasicFixedLeafPage<Key>;
+        if (Fixed::IsLegacy(raw)) Fixed::UpgradeLegacy(raw);
+
+        Fixed old(raw);
+        int n = old.NumKeys();
+        std::vector<Key>         keys(n);
+        std::vector<std::string> values(n);
+        size_t total = 0;
+        for (int i = 0; i < n; ++i) {
+            keys[i] = old.KeyAt(i);
+            const char* data = old.DataAt(i);
+            values[i].assign(data, ::strnlen(data, DATA_SIZE));
+            total += kEntrySize + kCellHeaderSize + values[i].size();
+        }
+
+        std::vector<int64_t> heads(n, INVALID_PAGE_ID);
+        if (total > kCapacity) {
+            std::vector<int> by_size(n);
+            for (int i = 0; i < n; ++i) by_size[i] = i;
+            std::stable_sort(by_size.begin(), by_size.end(), [&](int a, int b) {
+                return values[a].size() > values[b].size();
+            });
+            for (int i : by_size) {
+                if (total <= kCapacity) break;
+                heads[i] = spill(values[i].data(), values[i].size());
+                total   -= values[i].size() - kOverflowRefSize;
+            }
+        }
+
+        int64_t  next = old.NextLeaf();
+        uint64_t lsn  = old.PageLSN();
+        Init(raw);
+        BasicLeafPage leaf(raw);
+        leaf.SetNextLeaf(next);
+        leaf.SetPageLSN(lsn);
+        char cell[kMaxCellSize];
+        for (int i = 0; i < n; ++i) {
+            if (heads[i] != INVALID_PAGE_ID) {
+                MakeOverflowCell(cell, static_cast<uint32_t>(values[i].size()), heads[i]);
+            } else {
+                MakeCell(cell, values[i].data(), values[i].size());
+            }
+            leaf.InsertAt(i, keys[i], cell);
+        }
+    }
+
+    // -- Cells ---------------------------------------------------------------
+
+    /// Write a cell holding @p len bytes of @p data to @p out.
+    /// @pre len <= kMaxInlineValue.  @return The cell's size.
+    static size_t MakeCell(char* out, const char* data, size_t len) {
+        assert(len <= kMaxInlineValue);
+        detail::WriteAt<uint16_t>(out, 0, static_cast<uint16_t>(len));
+        if (len > 0) std::memcpy(out + kCellHeaderSize, data, len);
+        return kCellHeaderSize + len;
+    }
+
+    /// Write a cell referring to a @p len-byte value stored on overflow
+    /// pages from @p head on.  @return The cell's size.
+    static size_t MakeOverflowCell(char* out, uint32_t len, int64_t head) {
+        detail::WriteAt<uint16_t>(out, 0, static_cast<uint16_t>(kOverflowFlag | kOverflowRefSize));
+        detail::WriteAt<uint32_t>(out, kCellHeaderSize, len);
+        detail::WriteAt<int64_t>(out, kCellHeaderSize + 4, head);
+        return kCellHeaderSize + kOverflowRefSize;
+    }
+
+    /// Size of the cell at @p cell, header included.
+    static size_t CellSizeOf(const char* cell) {
+        return kCellHeaderSize + (detail::ReadAt<uint16_t>(cell, 0) & ~kOverflowFlag);
+    }
+
+    static bool CellIsOverflow(const char* cell) {
+        return (detail::ReadAt<uint16_t>(cell, 0) & kOverflowFlag) != 0;
+    }
+
+    /// First overflow page of an overflow cell.  @pre CellIsOverflow(cell)
+    static int64_t CellOverflowHead(const char* cell) {
+        return detail::ReadAt<int64_t>(cell, kCellHeaderSize + 4);
+    }
+
+    /// Bytes a record with a @p cell_size-byte cell takes in a leaf.
+    static constexpr size_t RecordSize(size_t cell_size) { return kEntrySize + cell_size; }
+
+    // -- Accessors -----------------------------------------------------------
+
+    [[nodiscard]] int      NumKeys()  const { return detail::ReadAt<int>(d_, 0); }
+
+    [[nodiscard]] int64_t  NextLeaf() const { return detail::ReadAt<int64_t>(d_, 8); }
+    void                   SetNextLeaf(int64_t v) { detail::WriteAt<int64_t>(d_, 8, v); }
+
+    [[nodiscard]] uint64_t PageLSN()  const { return bptree::PageLSN(d_); }
+    void                   SetPageLSN(uint64_t lsn) { bptree::SetPageLSN(d_, lsn); }
+
+    /// True if the keys are stored as suffixes of Prefix().
+    [[nodiscard]] bool IsPrefixed() const {
+        return kPrefixable && PageType(d_) == PAGE_TYPE_PREFIX_LEAF;
+    }
+
+    /// High half shared by all keys.  @pre IsPrefixed()
+    [[nodiscard]] uint32_t Prefix() const { return detail::ReadAt<uint32_t>(d_, kPrefixOffset); }
+
+    /// Bytes the records would take with full keys (entries and live
+    /// cells): the measure of fill for splits, borrows and merges.
+    [[nodiscard]] size_t UsedBytes() const {
+        return static_cast<size_t>(NumKeys()) * kEntrySize + CellBytes();
+    }
+
+    /// Bytes still available to records, fragmentation included.
+    [[nodiscard]] size_t FreeBytes() const {
+        return kCapacity - static_cast<size_t>(NumKeys()) * EntrySize() - CellBytes();
+    }
+
+    /// True if a @p cell_size-byte cell for @p key can be stored without a
+    /// split: in place of the cell of record @p idx if idx >= 0 (which must
+    /// hold @p key), otherwise as a new record.
+    [[nodiscard]] bool HasRoom(const Key& key, int idx, size_t cell_size) const {
+        if (idx >= 0) return FreeBytes() + CellSize(idx) >= cell_size;
+        int n = NumKeys();
+        size_t entries = n == 0              ? kSuffixSize + sizeof(uint16_t)
+                       : !FitsPrefix(key)    ? static_cast<size_t>(n) * (sizeof(Key) - kSuffixSize) +
+                                               kEntrySize
+                                             : EntrySize();
+        return FreeBytes() >= entries + cell_size;
+    }
+
+    // -- Per-record access ---------------------------------------------------
+
+    [[nodiscard]] Key KeyAt(int idx) const {
+        if (IsPrefixed()) return Join(Prefix(), detail::ReadAt<Suffix>(d_, KeyOffset(idx)));
+        return detail::ReadAt<Key>(d_, KeyOffset(idx));
+    }
+
+    /// The cell of record @p idx, in place.
+    [[nodiscard]] const char* CellAt(int idx) const { return d_ + CellOffset(idx); }
+
+    [[nodiscard]] size_t CellSize(int idx) const { return CellSizeOf(CellAt(idx)); }
+
+    /// Bytes record @p idx takes.
+    [[nodiscard]] size_t RecordSizeAt(int idx) const { return RecordSize(CellSize(idx)); }
+
+    /// True if the value of record @p idx is on overflow pages.
+    [[nodiscard]] bool IsOverflow(int idx) const { return CellIsOverflow(CellAt(idx)); }
+
+    /// The value of record @p idx, in place.  @pre !IsOverflow(idx)
+    [[nodiscard]] std::string_view Value(int idx) const {
+        const char* cell = CellAt(idx);
+        return {cell + kCellHeaderSize, CellSizeOf(cell) - kCellHeaderSize};
+    }
+
+    /// Length of the value of record @p idx, inline or not.
+    [[nodiscard]] size_t ValueSize(int idx) const {
+        const char* cell = CellAt(idx);
+        return CellIsOverflow(cell) ? detail::ReadAt<uint32_t>(cell, kCellHeaderSize)
+                                    : CellSizeOf(cell) - kCellHeaderSize;
+    }
+
+    /// First overflow page of the value of record @p idx.  @pre IsOverflow(idx)
+    [[nodiscard]] int64_t OverflowHead(int idx) const {
+        return CellOverflowHead(CellAt(idx));
+    }
+    /// Point record @p idx at the chain starting at @p head, which holds
+    /// the same value.  @pre IsOverflow(idx)
+    void SetOverflowHead(int idx, int64_t head) {
+        detail::WriteAt<int64_t>(d_ + CellOffset(idx), kCellHeaderSize + 4, head);
+    }
+
+    // -- Search --------------------------------------------------------------
+    //
+    // Keys are in the order of @p less, the tree's comparator.
+
+    /// First slot whose key is >= @p key (NumKeys() if none).
+    template <typename Compare = std::less<Key>>
+    [[nodiscard]] int LowerBound(const Key& key, const Compare& less = Compare()) const {
+        return Search(key, /*or_equal=*/false, less);
+    }
+
+    /// First slot whose key is > @p key (NumKeys() if none).
+    template <typename Compare = std::less<Key>>
+    [[nodiscard]] int UpperBound(const Key& key, const Compare& less = Compare()) const {
+        return Search(key, /*or_equal=*/true, less);
+    }
+
+    /// Slot holding @p key, or -1.
+    template <typename Compare = std::less<Key>>
+    [[nodiscard]] int Find(const Key& key, const Compare& less = Compare()) const {
+        int idx = LowerBound(key, less);
+        return idx < NumKeys() && !less(key, KeyAt(idx)) ? idx : -1;
+    }
+
+    // -- Record-level edits --------------------------------------------------
+    //
+    // The tree and WAL redo both go through these, so a logged change replays
+    // to exactly the bytes it produced.  Cells passed in must not point into
+    // this page: an edit may compact it.
+
+    /// Insert a record at @p idx, shifting records idx.. one to the right.
+    /// @pre HasRoom(key, -1, CellSizeOf(cell))
+    void InsertAt(int idx, const Key& key, const char* cell) {
+        int    n    = NumKeys();
+        size_t size = CellSizeOf(cell);
+        assert(HasRoom(key, -1, size));
+        if (n == 0) {
+            SetPrefix(kPrefixable, HighHalf(key));
+        } else if (!FitsPrefix(key)) {
+            Widen();
+        }
+        size_t width = KeyWidth();
+        if (HeapStart() - EntriesEnd(n) < width + sizeof(uint16_t) + size) Compact();
+
+        size_t heap = HeapStart() - size;
+        std::memcpy(d_ + heap, cell, size);
+        SetHeapStart(heap);
+
+        // The offsets move up by one key, and those from idx on by one more
+        // offset; then the keys from idx on move up by one key.
+        char* offsets = d_ + OffsetsBase(n);
+        std::memmove(offsets + width + (idx + 1) * 2, offsets + idx * 2,
+                     static_cast<size_t>(n - idx) * 2);
+        std::memmove(offsets + width, offsets, static_cast<size_t>(idx) * 2);
+        std::memmove(d_ + KeyOffset(idx + 1), d_ + KeyOffset(idx),
+                     static_cast<size_t>(n - idx) * width);
+        WriteKey(idx, key);
+        SetNumKeys(n + 1);
+        SetCellOffset(idx, heap);
+    }
+
+    /// Remove the record at @p idx, shifting later records one to the left.
+    void RemoveAt(int idx) {
+        int    n     = NumKeys();
+        size_t width = KeyWidth();
+        FreeCell(CellOffset(idx));
+        char* offsets = d_ + OffsetsBase(n);
+        std::memmove(d_ + KeyOffset(idx), d_ + KeyOffset(idx + 1),
+                     static_cast<size_t>(n - idx - 1) * width);
+        std::memmove(offsets - width, offsets, static_cast<size_t>(idx) * 2);
+        std::memmove(offsets - width + idx * 2, offsets + (idx + 1) * 2,
+                     static_cast<size_t>(n - idx - 1) * 2);
+        std::memset(d_ + EntriesEnd(n) - width - 2, 0, width + 2);
+        SetNumKeys(n - 1);
+        Narrow();
+    }
+
+    /// Replace the cell of record @p idx.
+    /// @pre HasRoom(KeyAt(idx), idx, CellSizeOf(cell))
+    void SetCell(int idx, const char* cell) {
+        size_t size = CellSizeOf(cell);
+        if (size == CellSize(idx)) {
+            std::memcpy(d_ + CellOffset(idx), cell, size);
+            return;
+        }
+        Key key = KeyAt(idx);
+        RemoveAt(idx);
+        InsertAt(idx, key, cell);
+    }
+
+    /// Keep the first @p count records and drop the rest.
+    void Truncate(int count) {
+        int n = NumKeys();
+        for (int i = count; i < n; ++i) FreeCell(CellOffset(i));
+        std::memmove(d_ + OffsetsBase(count), d_ + OffsetsBase(n),
+                     static_cast<size_t>(count) * 2);
+        size_t end = EntriesEnd(n);
+        SetNumKeys(count);
+        std::memset(d_ + EntriesEnd(count), 0, end - EntriesEnd(count));
+        Narrow();
+    }
+
+    /// Move the live cells to the end of the page, in record order, so the
+    /// free space is contiguous.
+    void Compact() {
+        char   heap[PAGE_SIZE];
+        size_t top = PAGE_LSN_OFFSET;
+        int    n   = NumKeys();
+        for (int i = 0; i < n; ++i) {
+            size_t size = CellSize(i);
+            top -= size;
+            std::memcpy(heap + top, CellAt(i), size);
+            SetCellOffset(i, top);
+        }
+        std::memcpy(d_ + top, heap + top, PAGE_LSN_OFFSET - top);
+        std::memset(d_ + EntriesEnd(n), 0, top - EntriesEnd(n));
+        SetHeapStart(top);
+        SetFragBytes(0);
+    }
+
+    /// Bytes `CopyRecords(idx, count, ...)` writes.
+    [[nodiscard]] size_t PackedSize(int idx, int count) const {
+        size_t bytes = 0;
+        for (int i = 0; i < count; ++i) bytes += sizeof(Key) + CellSize(idx + i);
+        return bytes;
+    }
+
+    /// Pack @p count records starting at @p idx into @p out as [key | cell]
+    /// records (the WAL's record format).  @return The bytes written.
+    size_t CopyRecords(int idx, int count, char* out) const {
+        char* p = out;
+        for (int i = 0; i < count; ++i) {
+            Key    key  = KeyAt(idx + i);
+            size_t size = CellSize(idx + i);
+            std::memcpy(p, &key, sizeof(key));
+            std::memcpy(p + sizeof(key), CellAt(idx + i), size);
+            p += sizeof(key) + size;
+        }
+        return static_cast<size_t>(p - out);
+    }
+
+    /// Append @p count packed records (as written by CopyRecords).
+    void AppendRecords(const char* records, int count) {
+        for (int i = 0; i < count; ++i) {
+            const char* cell = records + sizeof(Key);
+            InsertAt(NumKeys(), detail::ReadAt<Key>(records, 0), cell);
+            records = cell + CellSizeOf(cell);
+        }
+    }
+
+    /// Append @p count records of @p src starting at @p idx.
+    void AppendFrom(const BasicLeafPage& src, int idx, int count) {
+        for (int i = 0; i < count; ++i) {
+            InsertAt(NumKeys(), src.KeyAt(idx + i), src.CellAt(idx + i));
+        }
+    }
+
+private:
+    char* d_;
+
+    static constexpr size_t kHeapStartOffset = 16;
+    static constexpr size_t kFragBytesOffset = 18;
+    static constexpr size_t kPrefixOffset    = 20;
+    static constexpr size_t kKeysOffset      = kHeaderSize;
+
+    /// A key's low half, stored with its top bit flipped so that signed
+    /// order is the unsigned order of the halves.
+    using Suffix = std::conditional_t<sizeof(Key) == 8, int32_t, int16_t>;
+
+    // -- Keys ----------------------------------------------------------------
+
+    [[nodiscard]] size_t KeyWidth()  const { return IsPrefixed() ? kSuffixSize : sizeof(Key); }
+    [[nodiscard]] size_t EntrySize() const { return KeyWidth() + sizeof(uint16_t); }
+
+    static uint32_t HighHalf(const Key& key) {
+        if constexpr (kPrefixable) {
+            using U = std::make_unsigned_t<Key>;
+            return static_cast<uint32_t>(static_cast<U>(key) >> (kSuffixSize * 8));
+        } else {
+            return 0;
+        }
+    }
+
+    static Suffix LowHalf(const Key& key) {
+        if constexpr (kPrefixable) {
+            using U  = std::make_unsigned_t<Suffix>;
+            auto low = static_cast<U>(static_cast<std::make_unsigned_t<Key>>(key));
+            return static_cast<Suffix>(static_cast<U>(low ^ (U{1} << (kSuffixSize * 8 - 1))));
+        } else {
+            return 0;
+        }
+    }
+
+    static Key Join(uint32_t high, Suffix low) {
+        if constexpr (kPrefixable) {
+            using U  = std::make_unsigned_t<Key>;
+            using US = std::make_unsigned_t<Suffix>;
+            auto bits = static_cast<US>(static_cast<US>(low) ^ (US{1} << (kSuffixSize * 8 - 1)));
+            return static_cast<Key>(static_cast<U>(static_cast<U>(high) << (kSuffixSize * 8)) |
+                                    static_cast<U>(bits));
+        } else {
+            return Key{};
+        }
+    }
+
+    /// True if @p key can be added without widening the page.
+    [[nodiscard]] bool FitsPrefix(const Key& key) const {
+        return !IsPrefixed() || HighHalf(key) == Prefix();
+    }
+
+    void WriteKey(int idx, const Key& key) {
+        if (IsPrefixed()) {
+            detail::WriteAt<Suffix>(d_, KeyOffset(idx), LowHalf(key));
+        } else {
+            detail::WriteAt<Key>(d_, KeyOffset(idx), key);
+        }
+    }
+
+    void SetPrefix(bool prefixed, uint32_t prefix) {
+        detail::WriteAt<int>(d_, 4, prefixed ? PAGE_TYPE_PREFIX_LEAF : PAGE_TYPE_LEAF);
+        detail::WriteAt<uint32_t>(d_, kPrefixOffset, prefixed ? prefix : 0);
+    }
+
+    /// Rewrite the keys and offsets with keys @p prefixed or at full width.
+    void Relayout(bool prefixed, uint32_t prefix) {
+        int    n     = NumKeys();
+        size_t width = prefixed ? kSuffixSize : sizeof(Key);
+        if (HeapStart() < kKeysOffset + static_cast<size_t>(n) * (width + sizeof(uint16_t))) {
+            Compact();
+        }
+        std::vector<Key>    keys(n);
+        std::vector<size_t> offsets(n);
+        for (int i = 0; i < n; ++i) {
+            keys[i]    = KeyAt(i);
+            offsets[i] = CellOffset(i);
+        }
+        size_t end = EntriesEnd(n);
+        SetPrefix(prefixed, prefix);
+        for (int i = 0; i < n; ++i) {
+            WriteKey(i, keys[i]);
+            SetCellOffset(i, offsets[i]);
+        }
+        if (EntriesEnd(n) < end) std::memset(d_ + EntriesEnd(n), 0, end - EntriesEnd(n));
+    }
+
+    /// Store every key at full width.
+    void Widen() { Relayout(false, 0); }
+
+    /// Store the keys as suffixes if they all share a high half again.
+    void Narrow() {
+        if constexpr (kPrefixable) {
+            int n = NumKeys();
+            if (n == 0 || IsPrefixed()) return;
+            uint32_t high = HighHalf(KeyAt(0));
+            if (HighHalf(KeyAt(n - 1)) != high) return;  // the usual case: no scan
+            for (int i = 1; i < n - 1; ++i) {
+                if (HighHalf(KeyAt(i)) != high) return;
+            }
+            Relayout(true, high);
+        }
+    }
+
+    template <typename Compare>
+    [[nodiscard]] int Search(const Key& key, bool or_equal, const Compare& less) const {
+        int n = NumKeys();
+        if (!IsPrefixed()) return KeySearch(d_ + kKeysOffset, n, key, or_equal, less);
+        if constexpr (std::is_same_v<Compare, std::less<Key>>) {
+            // Keys outside the prefix's range sort before or after all.
+            if (n == 0) return 0;
+            if (HighHalf(key) != Prefix()) return less(key, KeyAt(0)) ? 0 : n;
+            return KeySearch(d_ + kKeysOffset, n, LowHalf(key), or_equal);
+        } else {
+            // The suffixes are only ordered like the keys for std::less.
+            int lo = 0;
+            while (n > 0) {
+                int  half  = n / 2;
+                Key  probe = KeyAt(lo + half);
+                bool right = or_equal ? !less(key, probe) : less(probe, key);
+                lo = right ? lo + half + 1 : lo;
+                n  = right ? n - half - 1 : half;
+            }
+            return lo;
+        }
+    }
+
+    // -- Layout --------------------------------------------------------------
+
+    [[nodiscard]] size_t KeyOffset(int idx) const {
+        return kKeysOffset + static_cast<size_t>(idx) * KeyWidth();
+    }
+
+    /// Start of the cell offsets of a leaf with @p n records.
+    [[nodiscard]] size_t OffsetsBase(int n) const { return KeyOffset(n); }
+
+    /// End of the keys and offsets of a leaf with @p n records.
+    [[nodiscard]] size_t EntriesEnd(int n) const {
+        return kKeysOffset + static_cast<size_t>(n) * EntrySize();
+    }
+
+    /// Bytes of the live cells.
+    [[nodiscard]] size_t CellBytes() const { return PAGE_LSN_OFFSET - HeapStart() - FragBytes(); }
+
+    void SetNumKeys(int n) { detail::WriteAt<int>(d_, 0, n); }
+
+    [[nodiscard]] size_t HeapStart() const { return detail::ReadAt<uint16_t>(d_, kHeapStartOffset); }
+    void SetHeapStart(size_t off) {
+        detail::WriteAt<uint16_t>(d_, kHeapStartOffset, static_cast<uint16_t>(off));
+    }
+
+    [[nodiscard]] size_t FragBytes() const { return detail::ReadAt<uint16_t>(d_, kFragBytesOffset); }
+    void SetFragBytes(size_t bytes) {
+        detail::WriteAt<uint16_t>(d_, kFragBytesOffset, static_cast<uint16_t>(bytes));
+    }
+
+    [[nodiscard]] size_t CellOffset(int idx) const {
+        return detail::ReadAt<uint16_t>(d_, OffsetsBase(NumKeys()) + static_cast<size_t>(idx) * 2);
+    }
+
+    void SetCellOffset(int idx, size_t off) {
+        detail::WriteAt<uint16_t>(d_, OffsetsBase(NumKeys()) + static_cast<size_t>(idx) * 2,
+                                  static_cast<uint16_t>(off));
+    }
+
+    /// Give back the cell at @p off: the lowest cell shrinks the heap, any
+    /// other becomes fragmentation.
+    void FreeCell(size_t off) {
+        size_t size = CellSizeOf(d_ + off);
+        std::memset(d_ + off, 0, size);
+        if (off == HeapStart()) {
+            SetHeapStart(off + size);
+        } else {
+            SetFragBytes(FragBytes() + size);
+        }
+    }
+
+    static_assert(kOverflowRefSize + kCellHeaderSize <= kMaxCellSize,
+                  "overflow references must fit in a cell");
+    static_assert(PAGE_SIZE <= 0x10000, "cell offsets are 16-bit");
+};
+
+using LeafPage = BasicLeafPage<key_t>;
+
+
+// ============================================================================
+// BasicInternalPage
+// ============================================================================
+///
+/// Layout for @p Key keys of K = sizeof(Key) bytes and N = kMaxKeys keys:
 ///
-///   For N keys there are N+1 children.  child[i] < key[i] <= child[i+1].
-///   The last child occupies the `child` part of slot N (its `key` part is unused).
+///   Offset  Size     Field
+///   ------  -------  --------------------------------
+///   0       4        num_keys       (int)
+///   4       4        type = 4       (int, PAGE_TYPE_INTERNAL)
+///   8       N×K      keys[]         (Key, N slots)
+///   (8-aligned) (N+1)×8 children[]  (int64_t, N + 1 slots)
+///   4088    8        page_lsn       (uint64_t, see PageLSN)
 ///
-///   Max keys per page: INTERNAL_MAX_KEYS (100)
-///   Total used: 8 + 101 × 12 = 1220 bytes  (fits in 4096)
+///   For n keys there are n+1 children.  child[i] < key[i] <= child[i+1].
+///   Keeping the keys in one dense array lets a search compare a vector of
+///   them at a time (see key_search.h).
 ///
-class InternalPage {
+///   N is `InternalMaxKeys(K)`: 338 keys for int keys (children at 1360),
+///   254 for 8-byte keys.
+///
+///   Files with int keys from before format version 1 interleave the two
+///   arrays as [child(8) | key(4)] slots under type
+///   PAGE_TYPE_LEGACY_INTERNAL; versions 1 and 2 use this layout sized for
+///   100 keys under type PAGE_TYPE_V2_INTERNAL.  `UpgradeLegacy` converts
+///   either in place.
+///
+template <typename Key>
+class BasicInternalPage {
 public:
-    explicit InternalPage(char* raw) : d_(raw) { assert(raw); }
+    static_assert(std::is_trivially_copyable_v<Key>, "keys are stored as raw bytes");
+
+    using key_type = Key;
+
+    static constexpr int kMaxKeys = InternalMaxKeys(sizeof(Key));
+    static constexpr int kMinKeys = (kMaxKeys + 1) / 2;  ///< ceil(order/2)
+
+    explicit BasicInternalPage(char* raw) : d_(raw) { assert(raw); }
 
     // -- Static factory ------------------------------------------------------
 
     static void Init(char* raw) {
         std::memset(raw, 0, PAGE_SIZE);
-        detail::WriteAt<int>(raw, 4, 0);  // is_leaf = 0
+        detail::WriteAt<int>(raw, 4, PAGE_TYPE_INTERNAL);
+    }
+
+    /// True if @p raw is an internal page in an older layout (only files
+    /// with int keys have them).
+    static bool IsLegacy(const char* raw) {
+        int type = PageType(raw);
+        return sizeof(Key) == sizeof(int) &&
+               (type == PAGE_TYPE_LEGACY_INTERNAL || type == PAGE_TYPE_V2_INTERNAL);
+    }
+
+    /// Rewrite an internal page in an older layout in the current one.  The
+    /// entries and the page LSN are kept.
+    static void UpgradeLegacy(char* raw) {
+        if constexpr (sizeof(Key) == sizeof(int)) {
+            int     n = detail::ReadAt<int>(raw, 0);
+            Key     keys[kMaxKeys];
+            int64_t children[kMaxKeys + 1];
+            if (PageType(raw) == PAGE_TYPE_LEGACY_INTERNAL) {
+                for (int i = 0; i <= n; ++i) {
+                    size_t slot = kHeaderSize + static_cast<size_t>(i) * kLegacySlotSize;
+                    children[i] = detail::ReadAt<int64_t>(raw, slot);
+                    if (i < n) keys[i] = detail::ReadAt<Key>(raw, slot + 8);
+                }
+            } else {
+                std::memcpy(keys, raw + kKeysOffset, static_cast<size_t>(n) * sizeof(Key));
+                std::memcpy(children, raw + kV2ChildrenOffset,
+                            static_cast<size_t>(n + 1) * sizeof(int64_t));
+            }
+            std::memset(raw + 4, 0, kChildrenOffset + kChildrenSize - 4);
+            detail::WriteAt<int>(raw, 4, PAGE_TYPE_INTERNAL);
+            std::memcpy(raw + kKeysOffset, keys, static_cast<size_t>(n) * sizeof(Key));
+            std::memcpy(raw + kChildrenOffset, children,
+                        static_cast<size_t>(n + 1) * sizeof(int64_t));
+        }
     }
 
     // -- Accessors -----------------------------------------------------------
@@ -150,33 +1028,149 @@ public:
     [[nodiscard]] int NumKeys()    const { return detail::ReadAt<int>(d_, 0); }
     void              SetNumKeys(int n)  { detail::WriteAt<int>(d_, 0, n); }
 
+    [[nodiscard]] uint64_t PageLSN() const { return bptree::PageLSN(d_); }
+    void                   SetPageLSN(uint64_t lsn) { bptree::SetPageLSN(d_, lsn); }
+
     // -- Child / key access --------------------------------------------------
 
     [[nodiscard]] int64_t ChildAt(int idx) const {
-        return detail::ReadAt<int64_t>(d_, SlotOffset(idx));
+        return detail::ReadAt<int64_t>(d_, ChildOffset(idx));
     }
 
     void SetChildAt(int idx, int64_t child) {
-        detail::WriteAt<int64_t>(d_, SlotOffset(idx), child);
+        detail::WriteAt<int64_t>(d_, ChildOffset(idx), child);
+    }
+
+    [[nodiscard]] Key KeyAt(int idx) const {
+        return detail::ReadAt<Key>(d_, KeyOffset(idx));
+    }
+
+    void SetKeyAt(int idx, const Key& key) {
+        detail::WriteAt<Key>(d_, KeyOffset(idx), key);
+    }
+
+    // -- Search --------------------------------------------------------------
+
+    /// Index of the child whose subtree holds @p key: the number of keys
+    /// that are <= @p key.
+    template <typename Compare = std::less<Key>>
+    [[nodiscard]] int ChildIndex(const Key& key, const Compare& less = Compare()) const {
+        return KeySearch(d_ + kKeysOffset, NumKeys(), key, /*or_equal=*/true, less);
+    }
+
+    /// ChildIndex over the first @p n keys, for a page read without a
+    /// latch: its key count was checked against kMaxKeys once and must not
+    /// be read again.
+    template <typename Compare = std::less<Key>>
+    [[nodiscard]] int ChildIndexIn(int n, const Key& key, const Compare& less = Compare()) const {
+        return KeySearch(d_ + kKeysOffset, n, key, /*or_equal=*/true, less);
     }
 
-    [[nodiscard]] int KeyAt(int idx) const {
-        return detail::ReadAt<int>(d_, SlotOffset(idx) + 8);
+    /// First key index whose key is >= @p key (NumKeys() if none).
+    template <typename Compare = std::less<Key>>
+    [[nodiscard]] int LowerBound(const Key& key, const Compare& less = Compare()) const {
+        return KeySearch(d_ + kKeysOffset, NumKeys(), key, /*or_equal=*/false, less);
     }
 
-    void SetKeyAt(int idx, int key) {
-        detail::WriteAt<int>(d_, SlotOffset(idx) + 8, key);
+    // -- Entry-level edits ---------------------------------------------------
+
+    /// Insert @p key at @p idx with @p child to its right (child idx+1),
+    /// shifting key[idx..] and child[idx+1..] one to the right.
+    void InsertAt(int idx, const Key& key, int64_t child) {
+        int n = NumKeys();
+        std::memmove(d_ + KeyOffset(idx + 1), d_ + KeyOffset(idx),
+                     static_cast<size_t>(n - idx) * sizeof(Key));
+        std::memmove(d_ + ChildOffset(idx + 2), d_ + ChildOffset(idx + 1),
+                     static_cast<size_t>(n - idx) * sizeof(int64_t));
+        SetKeyAt(idx, key);
+        SetChildAt(idx + 1, child);
+        SetNumKeys(n + 1);
+    }
+
+    /// Remove key[idx] and the child to its right (child idx+1).
+    void RemoveAt(int idx) {
+        int n = NumKeys();
+        std::memmove(d_ + KeyOffset(idx), d_ + KeyOffset(idx + 1),
+                     static_cast<size_t>(n - idx - 1) * sizeof(Key));
+        std::memmove(d_ + ChildOffset(idx + 1), d_ + ChildOffset(idx + 2),
+                     static_cast<size_t>(n - idx - 1) * sizeof(int64_t));
+        SetNumKeys(n - 1);
     }
 
 private:
     char* d_;
 
-    static constexpr size_t kHeaderSize = 8;   // 4 + 4
-    static constexpr size_t kSlotSize   = 12;  // child(8) + key(4)
+    static constexpr size_t kHeaderSize     = 8;   // 4 + 4
+    static constexpr size_t kKeysOffset     = kHeaderSize;
+    static constexpr size_t kChildrenOffset =
+        (kKeysOffset + kMaxKeys * sizeof(Key) + 7) & ~size_t{7};
+    static constexpr size_t kChildrenSize   = (kMaxKeys + 1) * sizeof(int64_t);
+    static constexpr size_t kLegacySlotSize = 12;  // child(8) + key(4)
 
-    static constexpr size_t SlotOffset(int idx) {
-        return kHeaderSize + static_cast<size_t>(idx) * kSlotSize;
+    // Format versions 1 and 2 (int keys, 100 keys).
+    static constexpr size_t kV2ChildrenOffset = kKeysOffset + 100 * sizeof(int);
+
+    static constexpr size_t KeyOffset(int idx) {
+        return kKeysOffset + static_cast<size_t>(idx) * sizeof(Key);
+    }
+
+    static constexpr size_t ChildOffset(int idx) {
+        return kChildrenOffset + static_cast<size_t>(idx) * sizeof(int64_t);
     }
+
+    static_assert(kChildrenOffset + kChildrenSize <= PAGE_LSN_OFFSET,
+                  "internal children overlap the page LSN");
+    static_assert(sizeof(Key) != sizeof(int) ||
+                  kHeaderSize + (kMaxKeys + 1) * kLegacySlotSize <= PAGE_LSN_OFFSET,
+                  "legacy internal slots overlap the page LSN");
+};
+
+using InternalPage = BasicInternalPage<key_t>;
+
+// ============================================================================
+// OverflowPage
+// ============================================================================
+///
+/// One page of a value too long to store in its leaf.  A value is split
+/// into a chain of these, linked through `next`.
+///
+///   Offset  Size   Field
+///   ------  -----  --------------------------------
+///   0       4      length         (int, value bytes on this page)
+///   4       4      type = 7       (int, PAGE_TYPE_OVERFLOW)
+///   8       8      next           (int64_t, next page of the value or -1)
+///   16      ...    data
+///   4088    8      page_lsn       (uint64_t, see PageLSN)
+///
+class OverflowPage {
+public:
+    static constexpr size_t kHeaderSize = 16;
+    static constexpr size_t kCapacity   = PAGE_LSN_OFFSET - kHeaderSize;
+
+    explicit OverflowPage(char* raw) : d_(raw) { assert(raw); }
+
+    /// Zero-initialise a raw page as the last page of a chain.
+    static void Init(char* raw) {
+        std::memset(raw, 0, PAGE_SIZE);
+        detail::WriteAt<int>(raw, 4, PAGE_TYPE_OVERFLOW);
+        detail::WriteAt<int64_t>(raw, 8, INVALID_PAGE_ID);
+    }
+
+    [[nodiscard]] size_t  Length()   const { return static_cast<size_t>(detail::ReadAt<int>(d_, 0)); }
+    [[nodiscard]] int64_t NextPage() const { return detail::ReadAt<int64_t>(d_, 8); }
+    void                  SetNextPage(int64_t v) { detail::WriteAt<int64_t>(d_, 8, v); }
+
+    [[nodiscard]] const char* Data() const { return d_ + kHeaderSize; }
+
+    /// Store @p len bytes of @p data.  @pre len <= kCapacity
+    void SetData(const char* data, size_t len) {
+        assert(len <= kCapacity);
+        std::memcpy(d_ + kHeaderSize, data, len);
+        detail::WriteAt<int>(d_, 0, static_cast<int>(len));
+    }
+
+private:
+    char* d_;
 };
 
 }  // namespace bptree
@@ -0,0 +1,82 @@
+#pragma once
+
+/// @file page_table.h
+/// @brief Open-addressing page_id -> frame map with lock-free lookups.
+///
+/// Design:
+///   - Fixed-capacity linear-probing table sized to a power of two at least
+///     twice the number of frames it indexes, so probes stay short.
+///   - Each slot is a single 64-bit atomic word packing the page number and
+///     the frame index, so a reader never sees a torn (page, frame) pair.
+///   - Deletion uses backward-shift instead of tombstones, so the table
+///     never degrades under insert / erase churn.
+///
+/// Slot encoding:
+/// @code
+///   [ page_no + 1 (40 bits) | frame index (24 bits) ]     0 = empty slot
+/// @endcode
+///
+/// Concurrency:
+///   `Find` may run concurrently with one writer.  Writers (`Insert` /
+///   `Erase`) must be serialised by the caller.  While a backward shift is
+///   moving entries, a concurrent `Find` can miss an entry that is present;
+///   it never returns a frame for the wrong page.  Callers that need an
+///   exact answer repeat the lookup under their writer latch.
+
+#include "config.h"
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+
+namespace bptree {
+
+class PageTable {
+public:
+    /// Create a table able to hold @p max_entries mappings.
+    explicit PageTable(size_t max_entries);
+
+    // Non-copyable, non-movable.
+    PageTable(const PageTable&)            = delete;
+    PageTable& operator=(const PageTable&) = delete;
+
+    /// Frame index mapped to @p page_id, or -1 if absent.  Lock-free.
+    [[nodiscard]] int Find(int64_t page_id) const;
+
+    /// Map @p page_id to @p frame.  @pre page_id is not present and the
+    /// table holds fewer than max_entries mappings.
+    void Insert(int64_t page_id, int frame);
+
+    /// Remove the mapping for @p page_id.
+    /// @return false if it was not present.
+    bool Erase(int64_t page_id);
+
+    [[nodiscard]] size_t Size() const { return size_.load(std::memory_order_relaxed); }
+
+    /// Largest frame index that fits in a slot.
+    static constexpr int kMaxFrames = (1 << 24) - 1;
+
+private:
+    static constexpr int      kFrameBits = 24;
+    static constexpr uint64_t kFrameMask = (uint64_t{1} << kFrameBits) - 1;
+
+    static uint64_t Pack(int64_t page_id, int frame) {
+        auto page_no = static_cast<uint64_t>(page_id / static_cast<int64_t>(PAGE_SIZE));
+        return ((page_no + 1) << kFrameBits) | static_cast<uint64_t>(frame);
+    }
+    static uint64_t Tag(int64_t page_id) { return Pack(page_id, 0) >> kFrameBits; }
+    static uint64_t TagOf(uint64_t slot) { return slot >> kFrameBits; }
+    static int FrameOf(uint64_t slot) { return static_cast<int>(slot & kFrameMask); }
+
+    /// Home slot of an entry with tag @p tag (Fibonacci hashing).
+    size_t Home(uint64_t tag) const {
+        return static_cast<size_t>((tag * 0x9E3779B97F4A7C15ull) >> shift_);
+    }
+
+    size_t mask_;   ///< capacity - 1
+    int    shift_;  ///< 64 - log2(capacity)
+    std::unique_ptr<std::atomic<uint64_t>[]> slots_;
+    std::atomic<size_t> size_{0};
+};
+
+}  // namespace bptree
@@ -0,0 +1,159 @@
+#pragma once
+
+/// @file protocol.h
+/// @brief Length-prefixed binary wire protocol of `Server` and `Client`.
+///
+/// Every message is a frame: a 9-byte header, then `length` bytes of body.
+///
+///   [u32 length][u8 op][u32 id][body ...]
+///
+/// Integers are in host byte order (little-endian on the supported
+/// platforms, as in the index file); keys are `key_t`.  A client may send
+/// any number of requests without waiting (pipelining): the server answers
+/// them in order, each response carrying the id of its request.
+///
+/// Requests and their responses, by op:
+///
+///   kGet     u32 n, n x key             -> u32 n, n x (status, [u32 len, value] if OK)
+///   kPut     u32 n, n x (key, u32 len, value)
+///                                       -> status of the batch
+///   kDelete  u32 n, n x key             -> u32 n, n x status
+///   kScan    key lower, key upper, u32 limit (0: none)
+///                                       -> kScan frames of u32 n, n x (key, u32 len, value),
+///                                          then one kScanEnd frame: status
+///
+/// A status is a u8 code, followed for codes other than OK and NotFound by
+/// a u16 length and the message.  A malformed request gets a kError frame
+/// (status InvalidArg) and the server closes the connection after it.
+
+#include "config.h"
+#include "status.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <string_view>
+
+namespace bptree {
+
+enum class WireOp : uint8_t {
+    kGet     = 1,
+    kPut     = 2,
+    kDelete  = 3,
+    kScan    = 4,
+    kScanEnd = 5,     ///< response only: the last frame of a scan
+    kError   = 0xFF,  ///< response only: the request could not be parsed
+};
+
+constexpr size_t   kFrameHeaderSize = 9;
+constexpr uint32_t kMaxFrameBytes   = 64u << 20;  ///< Largest body either side accepts.
+
+struct FrameHeader {
+    uint32_t length = 0;   ///< body bytes
+    WireOp   op     = WireOp::kError;
+    uint32_t id     = 0;
+};
+
+/// Parse a header from the kFrameHeaderSize bytes at @p p.
+inline FrameHeader DecodeFrameHeader(const char* p) {
+    FrameHeader h;
+    std::memcpy(&h.length, p, 4);
+    h.op = static_cast<WireOp>(static_cast<uint8_t>(p[4]));
+    std::memcpy(&h.id, p + 5, 4);
+    return h;
+}
+
+/// Appends frames to a string.  `Begin` writes a header with a placeholder
+/// length and `End` fills it in, so a body can be written piece by piece.
+class FrameWriter {
+public:
+    explicit FrameWriter(std::string& out) : out_(out) {}
+
+    /// Start a frame; @return its offset, for `End`.
+    size_t Begin(WireOp op, uint32_t id) {
+        size_t at = out_.size();
+        char header[kFrameHeaderSize] = {};
+        header[4] = static_cast<char>(op);
+        std::memcpy(header + 5, &id, 4);
+        out_.append(header, kFrameHeaderSize);
+        return at;
+    }
+
+    /// Finish the frame begun at @p at.
+    void End(size_t at) {
+        auto length = static_cast<uint32_t>(out_.size() - at - kFrameHeaderSize);
+        std::memcpy(&out_[at], &length, 4);
+    }
+
+    void U8(uint8_t v)   { out_.push_back(static_cast<char>(v)); }
+    void U16(uint16_t v) { Raw(&v, sizeof(v)); }
+    void U32(uint32_t v) { Raw(&v, sizeof(v)); }
+    void Key(key_t k)    { Raw(&k, sizeof(k)); }
+
+    /// u32 length, then the bytes.
+    void Bytes(std::string_view v) {
+        U32(static_cast<uint32_t>(v.size()));
+        out_.append(v.data(), v.size());
+    }
+
+    void PutStatus(const Status& s);
+
+    /// Body bytes written since @p at was begun.
+    [[nodiscard]] size_t BodySize(size_t at) const {
+        return out_.size() - at - kFrameHeaderSize;
+    }
+
+private:
+    void Raw(const void* p, size_t n) { out_.append(static_cast<const char*>(p), n); }
+
+    std::string& out_;
+};
+
+/// Reads a frame body.  Every getter returns false, and leaves the reader
+/// failed, once the body is too short.
+class FrameReader {
+public:
+    explicit FrameReader(std::string_view body) : p_(body.data()), end_(p_ + body.size()) {}
+
+    bool U8(uint8_t& v)   { return Raw(&v, sizeof(v)); }
+    bool U16(uint16_t& v) { return Raw(&v, sizeof(v)); }
+    bool U32(uint32_t& v) { return Raw(&v, sizeof(v)); }
+    bool Key(key_t& k)    { return Raw(&k, sizeof(k)); }
+
+    /// A u32 length and that many bytes, viewed in place.
+    bool Bytes(std::string_view& v) {
+        uint32_t n;
+        if (!U32(n) || Remaining() < n) return Fail();
+        v = std::string_view(p_, n);
+        p_ += n;
+        return true;
+    }
+
+    bool GetStatus(Status& s);
+
+    /// True once the whole body was read without a failure.
+    [[nodiscard]] bool Done() const { return !failed_ && p_ == end_; }
+
+    /// Bytes left: a count that its elements could not fit in is bogus.
+    [[nodiscard]] size_t Remaining() const { return static_cast<size_t>(end_ - p_); }
+
+private:
+    bool Raw(void* out, size_t n) {
+        if (failed_ || static_cast<size_t>(end_ - p_) < n) return Fail();
+        std::memcpy(out, p_, n);
+        p_ += n;
+        return true;
+    }
+    bool Fail() {
+        failed_ = true;
+        p_      = end_;
+        return false;
+    }
+
+    const char* p_;
+    const char* end_;
+    bool        failed_ = false;
+};
+
+}  // namespace bptree
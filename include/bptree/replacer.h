@@ -0,0 +1,211 @@
+#pragma once
+
+/// @file replacer.h
+/// @brief Page replacement policies used by the BufferPool.
+///
+/// A Replacer tracks how the frames of one buffer pool shard are used and
+/// picks the frame to evict on a miss.  Frames are identified by their index
+/// within the shard (0 .. num_frames-1).
+///
+/// Policies:
+///   - **LRU**:   evict the frame whose last use is oldest.  Hits set a
+///                reference bit; the list order is brought up to date
+///                lazily as the victim search reaches referenced frames.
+///   - **CLOCK**: second-chance sweep over a reference bit array; no
+///                per-access ordering work at all.
+///   - **LRU-K**: evict the frame whose K-th most recent use is oldest
+///                (frames used fewer than K times go first).  A page touched
+///                once by a large scan never displaces pages that are used
+///                repeatedly, such as the upper levels of the tree.
+///
+/// Time is a logical clock that advances once per page load.  Uses within
+/// the same tick count as one (a "correlated reference"), so the several
+/// pins a single operation takes on a page do not make it look hot.
+///
+/// Concurrency:
+///   `RecordAccess` is lock-free and may be called from any thread at any
+///   time.  `RecordLoad`, `Remove`, `Victim` and `Coldest` are serialised by
+///   the owner (the shard latch).
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <vector>
+
+namespace bptree {
+
+/// Page replacement policy of a BufferPool.
+enum class ReplacementPolicy {
+    kLRU,    ///< Least recently used.
+    kClock,  ///< CLOCK / second chance.
+    kLRUK,   ///< LRU-K (K = 2), scan resistant.
+};
+
+/// Human-readable policy name ("LRU", "CLOCK", "LRU-2").
+const char* ReplacementPolicyName(ReplacementPolicy policy);
+
+/// Replacement state for the frames of one buffer pool shard.
+class Replacer {
+public:
+    virtual ~Replacer() = default;
+
+    /// The frame's page was fetched while resident.
+    virtual void RecordAccess(int frame) = 0;
+
+    /// The frame now holds a freshly loaded page.
+    virtual void RecordLoad(int frame) = 0;
+
+    /// The frame no longer holds a page.
+    virtual void Remove(int frame) = 0;
+
+    /// Choose a victim among the frames for which @p evictable returns true
+    /// (the owner rejects pinned frames).  The owner still has to claim the
+    /// frame and calls again if it lost a race.
+    /// @return the chosen frame, or -1 if no frame is evictable.
+    virtual int Victim(const std::function<bool(int)>& evictable) = 0;
+
+    /// Up to @p n frames in the order `Victim` would pick them, coldest
+    /// first, without changing any state.  The page cleaner writes these
+    /// back ahead of their eviction.
+    virtual std::vector<int> Coldest(size_t n) const = 0;
+};
+
+/// Create a replacer for @p num_frames frames.
+std::unique_ptr<Replacer> MakeReplacer(ReplacementPolicy policy,
+                                       size_t num_frames);
+
+// ============================================================================
+// Policies
+// ============================================================================
+
+/// One reference bit per frame, packed 64 to a word.  Setting a bit that
+/// is already set is a plain load, so hot frames do not bounce cache lines.
+class ReferenceBits {
+public:
+    explicit ReferenceBits(size_t num_frames);
+
+    void Set(int frame);
+    void Clear(int frame);
+    bool TestAndClear(int frame);
+    [[nodiscard]] bool Test(int frame) const;
+
+private:
+    std::unique_ptr<std::atomic<uint64_t>[]> words_;
+};
+
+/// LRU over an intrusive doubly-linked list of the frames holding pages,
+/// least recently used first.  `RecordAccess` only sets the frame's
+/// reference bit, unless the frame reached the recent end in the current
+/// tick; `Victim` moves the referenced and the pinned frames it meets to
+/// the recent end, clearing the bit, and evicts the first other one.
+/// Every move consumes a use (or skips a frame in use), so a miss costs
+/// O(1) amortised, not a walk of the shard.
+class LruReplacer : public Replacer {
+public:
+    explicit LruReplacer(size_t num_frames);
+
+    void RecordAccess(int frame) override;
+    void RecordLoad(int frame) override;
+    void Remove(int frame) override;
+    int  Victim(const std::function<bool(int)>& evictable) override;
+    std::vector<int> Coldest(size_t n) const override;
+
+private:
+    [[nodiscard]] bool Linked(int frame) const { return prev_[frame] != -1 || head_ == frame; }
+    void Unlink(int frame);
+    void PushBack(int frame);
+
+    std::atomic<uint64_t> clock_{1};
+    std::unique_ptr<std::atomic<uint64_t>[]> moved_;  ///< tick the frame reached the tail
+    ReferenceBits    referenced_;
+    std::vector<int> prev_, next_;   ///< -1 at the ends of the list
+    int              head_ = -1;     ///< least recently used
+    int              tail_ = -1;
+    size_t           linked_ = 0;
+};
+
+/// CLOCK with one reference bit per frame.
+class ClockReplacer : public Replacer {
+public:
+    explicit ClockReplacer(size_t num_frames);
+
+    void RecordAccess(int frame) override;
+    void RecordLoad(int frame) override;
+    void Remove(int frame) override;
+    int  Victim(const std::function<bool(int)>& evictable) override;
+    std::vector<int> Coldest(size_t n) const override;
+
+private:
+    size_t        num_frames_;
+    size_t        hand_ = 0;
+    ReferenceBits ref_bits_;
+};
+
+/// LRU-K: keeps the last K use times of every frame, and a min-heap of
+/// the loaded frames by rank (K uses or not, then the K-th or last use).
+/// `RecordAccess` stays lock-free and only moves a frame's rank later, so
+/// heap entries may be stale but never rank a frame too late; `Victim`
+/// re-pushes a stale entry with the frame's current rank when it surfaces.
+/// A miss costs O(log n) per use since the frame was last pushed, not a
+/// walk of the shard.
+class LruKReplacer : public Replacer {
+public:
+    explicit LruKReplacer(size_t num_frames, size_t k = 2);
+
+    void RecordAccess(int frame) override;
+    void RecordLoad(int frame) override;
+    void Remove(int frame) override;
+    int  Victim(const std::function<bool(int)>& evictable) override;
+    std::vector<int> Coldest(size_t n) const override;
+
+private:
+    /// Position in the victim order, earliest first; the frame breaks ties.
+    struct Rank {
+        bool     full;   ///< used at least K times
+        uint64_t time;   ///< K-th most recent use if full, else the last
+        int      frame;
+
+        bool operator<(const Rank& o) const {
+            if (full != o.full) return !full;
+            if (time != o.time) return time < o.time;
+            return frame < o.frame;
+        }
+        bool operator==(const Rank& o) const {
+            return full == o.full && time == o.time && frame == o.frame;
+        }
+    };
+
+    /// A heap entry is live while its generation matches the frame's.
+    struct Entry {
+        Rank     rank;
+        uint32_t gen;
+    };
+
+    [[nodiscard]] Rank RankOf(int frame) const;
+    void Push(const Entry& e);
+    void PopFront();
+    void Rebuild();
+
+    /// history_[frame * k_ + i] = time of the (i+1)-th most recent use,
+    /// 0 if the frame has been used fewer than i+1 times.
+    std::atomic<uint64_t>& History(int frame, size_t i) {
+        return history_[static_cast<size_t>(frame) * k_ + i];
+    }
+    const std::atomic<uint64_t>& History(int frame, size_t i) const {
+        return history_[static_cast<size_t>(frame) * k_ + i];
+    }
+
+    size_t num_frames_;
+    size_t k_;
+    std::atomic<uint64_t> clock_{1};
+    std::unique_ptr<std::atomic<uint64_t>[]> history_;
+
+    // Owned by the shard latch.
+    std::vector<Entry>    heap_;     ///< binary min-heap, children of i at 2i+1, 2i+2
+    std::vector<uint32_t> gen_;      ///< bumped by RecordLoad and Remove
+    std::vector<bool>     loaded_;   ///< the frame holds a page
+};
+
+}  // namespace bptree
@@ -0,0 +1,151 @@
+#pragma once
+
+/// @file server.h
+/// @brief TCP server that shares one `BPlusTree` between processes.
+///
+/// Design:
+///   - Event loops: `threads` loops, each an epoll instance on its own
+///     thread serving a share of the connections.  Loop 0 also owns the
+///     listening socket and deals accepted connections out round-robin
+///     through each loop's eventfd.  A loop runs requests itself: tree
+///     operations are short, and a loop blocked on a page read leaves the
+///     others running.
+///   - Pipelining: each readable event reads everything the socket has,
+///     runs every complete frame in order and answers them all with one
+///     `send`.  Batched requests map onto the tree's batch paths: GET onto
+///     `MultiGet`, PUT onto `InsertBatch`, DEL onto `Delete` per key.
+///   - Streamed scans: a SCAN is answered in chunks of about
+///     `scan_chunk_bytes`, read with a `Cursor` that is released after each
+///     round, so neither the server nor the client holds the whole range
+///     and no leaf stays latched while the loop serves anyone else.
+///   - Backpressure: once a connection has `output_high_water` bytes
+///     unsent, its loop stops reading from it and stops producing scan
+///     chunks until the client has caught up.
+///
+/// See protocol.h for the wire format.
+///
+/// @code
+///   bptree::BPlusTree tree("my_index.idx");
+///   bptree::Server server(tree, {});
+///   if (server.Start().ok()) { /* ... */ server.Stop(); }
+/// @endcode
+
+#include "bplus_tree.h"
+#include "protocol.h"
+#include "status.h"
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace bptree {
+
+struct ServerOptions {
+    /// IPv4 address to listen on.
+    std::string address = "127.0.0.1";
+
+    /// Port to listen on; 0 picks a free one (see `Server::Port`).
+    uint16_t port = DEFAULT_SERVER_PORT;
+
+    /// Event loops (0 = one per hardware thread).
+    unsigned threads = 0;
+
+    /// Scan records sent per response frame, in bytes (a frame may exceed
+    /// it by one record).
+    size_t scan_chunk_bytes = 64 << 10;
+
+    /// Unsent bytes at which a connection stops being read.
+    size_t output_high_water = 4 << 20;
+};
+
+/// Counts since `Start`.
+struct ServerStats {
+    size_t accepted    = 0;  ///< connections accepted
+    size_t connections = 0;  ///< connections open now
+    size_t requests    = 0;  ///< frames answered
+    size_t bytes_in    = 0;
+    size_t bytes_out   = 0;
+};
+
+class Server {
+public:
+    /// A server for @p tree, which must outlive it.
+    Server(BPlusTree& tree, const ServerOptions& options);
+    ~Server();
+
+    Server(const Server&)            = delete;
+    Server& operator=(const Server&) = delete;
+
+    /// Bind, listen and start the event loops.
+    /// @return IOError if the socket cannot be set up; InvalidArg for an
+    ///         address that is not IPv4.
+    Status Start();
+
+    /// Close every connection and join the loops.  Requests already read
+    /// are answered first only if their loop gets to them.
+    void Stop();
+
+    /// The port listened on (the one chosen for port 0).
+    [[nodiscard]] uint16_t Port() const { return port_; }
+
+    [[nodiscard]] ServerStats Stats() const;
+
+private:
+    struct Connection;
+    struct Loop;
+
+    void Run(Loop& loop);
+
+    /// Accept every pending connection and hand each to the next loop.
+    void Accept();
+
+    /// Take the connections other loops handed over to @p loop.
+    void Adopt(Loop& loop);
+
+    /// Read what @p c has sent, then `Drive` it.
+    void OnReadable(Loop& loop, Connection& c);
+
+    /// Run complete frames and scan chunks and send the answers until the
+    /// connection is out of input or blocked on output; then set its epoll
+    /// interest to match.  Closes it on an error.
+    void Drive(Loop& loop, Connection& c);
+
+    /// Run the complete frames in @p c's input, in order, while its output
+    /// is below the high water mark and no scan is streaming.
+    /// @return true if any frame was run.
+    bool RunFrames(Connection& c);
+
+    /// Answer one request.  @return false on a malformed request.
+    bool Handle(Connection& c, const FrameHeader& h, std::string_view body);
+
+    /// Append scan chunks for @p c's open scan until its output reaches the
+    /// high water mark or the scan ends.  @return true if any was added.
+    bool StreamScan(Connection& c);
+
+    /// Send what @p c has queued.  @return false if the connection failed.
+    bool Flush(Connection& c);
+
+    void Close(Loop& loop, Connection& c);
+
+    BPlusTree&    tree_;
+    ServerOptions options_;
+    uint16_t      port_      = 0;
+    int           listen_fd_ = -1;
+
+    std::vector<std::unique_ptr<Loop>> loops_;
+    std::vector<std::thread>           threads_;
+    size_t                             next_loop_ = 0;  ///< Round-robin; loop 0 only.
+    std::atomic<bool>                  stopping_{false};
+
+    std::atomic<size_t> accepted_{0};
+    std::atomic<size_t> connections_{0};
+    std::atomic<size_t> requests_{0};
+    std::atomic<size_t> bytes_in_{0};
+    std::atomic<size_t> bytes_out_{0};
+};
+
+}  // namespace bptree
@@ -33,6 +33,8 @@ public:
     [[nodiscard]] bool IsNotFound()  const { return code_ == Code::kNotFound; }
     [[nodiscard]] bool IsIOError()   const { return code_ == Code::kIOError; }
     [[nodiscard]] bool IsCorruption()const { return code_ == Code::kCorruption; }
+    [[nodiscard]] bool IsInvalidArg()const { return code_ == Code::kInvalidArg; }
+    [[nodiscard]] bool IsFull()      const { return code_ == Code::kFull; }
 
     [[nodiscard]] std::string ToString() const {
         switch (code_) {
@@ -5,6 +5,7 @@
 
 #include "config.h"
 #include "page.h"
+#include <functional>
 #include <string>
 #include <sstream>
 #include <iostream>
@@ -15,7 +16,8 @@
 namespace bptree {
 
 // Forward declaration
-class BPlusTree;
+template <typename Key, typename Compare> class BasicBPlusTree;
+using BPlusTree = BasicBPlusTree<key_t, std::less<key_t>>;
 
 /// Visualizer for B+ tree structure.
 ///
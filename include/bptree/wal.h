@@ -4,17 +4,48 @@
 /// @brief Write-Ahead Log (WAL) for crash recovery.
 ///
 /// Design:
-///   - Append-only log file storing full page after-images.
+///   - Append-only log file storing record-level changes, with a full page
+///     image the first time a page changes after a checkpoint.
 ///   - Redo-only recovery: on crash, replay logged page writes to restore
 ///     the data file to a consistent state.
-///   - Checkpoint support: flush all dirty pages, then truncate the log.
-///   - CRC32 checksum per record for integrity verification.
+///   - Fuzzy checkpoints: the pages dirty when a checkpoint begins are
+///     written while writers carry on, then the log is truncated up to the
+///     checkpoint's redo point.  Records logged meanwhile are kept.
+///   - CRC32C checksum per record for integrity verification (hardware
+///     accelerated where available, see crc32c.h).
 ///
-/// WAL protocol (enforced by BufferPool):
-///   Before a dirty page is written back to disk, its after-image must first
-///   be appended to the WAL and fsynced.  This guarantees that on crash we
-///   can always redo any page write that reached the data file, plus any that
-///   did not.
+/// WAL protocol (logged by BPlusTree, enforced by BufferPool):
+///   Every change to a page is logged while the page is latched, and the
+///   record's LSN is stored in the page (`PageLSN`).  Before a dirty page is
+///   written back to disk the log must be durable up to that LSN
+///   (`WaitDurable`); the page itself is not logged again.  This guarantees
+///   that on crash we can always redo any page write that reached the data
+///   file, plus any that did not.  LSNs never restart, not even after
+///   truncation.
+///
+/// Record-level logging:
+///   Most changes are logged as the edit itself -- "insert this record at
+///   slot 7" is the record plus 8 bytes instead of a 4 KB page.  Redo of such a delta
+///   needs the page it was made to, so the first change to a page after a
+///   checkpoint began (page LSN <= checkpoint LSN) logs the page's whole
+///   after-image instead (a full-page write).  New pages and the rare
+///   rebalancing between internal nodes are also logged as images.  Redo
+///   applies images unconditionally and a delta only if the page's LSN is
+///   older than the record, so replaying a change that already reached the
+///   data file is harmless.
+///
+/// Group commit:
+///   With `WALOptions::group_commit`, appends only copy the record into an
+///   in-memory log buffer.  A batch is everything buffered so far, written
+///   with one `write` and made durable with one `fdatasync`; every caller
+///   waiting in `WaitDurable` on an LSN inside it is released by that sync.
+///   Without a latency window the waiters write batches themselves and the
+///   sync runs outside the write latch, so the next batch is written while
+///   the previous one syncs.  With `max_latency_us` a background flusher
+///   holds each batch open that long to let more records join.  The flusher
+///   also starts a batch once `max_batch_bytes` are buffered.
+///   Without group commit every record is written straight to the file with
+///   one `writev` and `WaitDurable` syncs in the caller's thread.
 ///
 /// File format:
 /// @code
@@ -24,16 +55,36 @@
 ///   ...
 /// @endcode
 ///
+/// Checkpoints:
+///   `BeginCheckpoint` logs the size and oldest recovery LSN of the buffer
+///   pool's dirty page table and moves the full-page-write threshold to its
+///   own LSN, the redo point.  The pages of the table are then written in
+///   the background.  `EndCheckpoint(redo)` logs that they are on disk and
+///   drops every record up to the redo point: the rest of the log is copied
+///   into a new file that replaces the old one.
+///
 /// Recovery:
-///   1. Open WAL file.
-///   2. Read all valid records.
-///   3. Apply all PAGE_WRITE records after the last completed checkpoint.
+///   1. Map the log file and index its records in one pass over the
+///      headers; payloads stay in the mapping.
+///   2. Verify the checksums in parallel; the log ends at the first record
+///      that fails.
+///   3. Partition the records after the redo point of the last completed
+///      checkpoint by page.  Each thread redoes its pages one at a time,
+///      starting from a page's last image (earlier records are overwritten
+///      by it anyway), and writes each page once.
 ///   4. Truncate the log.
 
 #include "config.h"
+#include "io_ring.h"
 
+#include <atomic>
+#include <condition_variable>
 #include <cstdint>
+#include <memory>
+#include <mutex>
 #include <string>
+#include <string_view>
+#include <thread>
 #include <vector>
 
 namespace bptree {
@@ -48,19 +99,103 @@ class DiskManager;
 enum class LogRecordType : uint32_t {
     kInvalid         = 0,
     kPageWrite       = 1,  ///< Full page after-image (page_id + PAGE_SIZE bytes)
-    kCheckpointBegin = 2,  ///< Marks the start of a checkpoint
-    kCheckpointEnd   = 3,  ///< Marks the end of a checkpoint (all pages flushed)
+    kCheckpointBegin = 2,  ///< Marks the start of a checkpoint (CheckpointLog)
+    kCheckpointEnd   = 3,  ///< Its pages are flushed (CheckpointLog, redo point)
+
+    // Record-level changes (payloads below).
+    kLeafInsert      = 4,  ///< LeafSlotLog + cell: LeafPage::InsertAt
+    kLeafUpdate      = 5,  ///< LeafSlotLog + cell: LeafPage::SetCell
+    kLeafDelete      = 6,  ///< SlotLog:     LeafPage::RemoveAt
+    kLeafSplit       = 7,  ///< LeafLinkLog: keep `count` records, relink
+    kLeafMerge       = 8,  ///< LeafLinkLog + `count` packed records appended, relink
+    kInternalInsert  = 9,  ///< InternalSlotLog: InternalPage::InsertAt
+    kInternalDelete  = 10, ///< SlotLog:         InternalPage::RemoveAt
+    kInternalSetKey  = 11, ///< InternalSlotLog: InternalPage::SetKeyAt
 };
 
+// ============================================================================
+// Record-level payloads
+// ============================================================================
+
+// Keys are stored as the tree's key type, so the payloads of a tree with
+// other than int keys are the Basic* forms for that type.
+
+/// kLeafInsert / kLeafUpdate: the record at `slot`, followed by its cell
+/// (see LeafPage).  The key is unused on update.
+template <typename Key>
+struct BasicLeafSlotLog {
+    int32_t slot;
+    Key     key;
+};
+
+/// kLeafInsert / kLeafUpdate in logs of format version 3 and older, whose
+/// leaves had fixed-size payloads (see FixedLeafPage).
+template <typename Key>
+struct BasicLeafSlotLogV3 {
+    int32_t slot;
+    Key     key;
+    char    data[DATA_SIZE];
+};
+
+/// kLeafDelete / kInternalDelete: the slot removed.
+struct SlotLog {
+    int32_t slot;
+};
+
+/// kInternalInsert / kInternalSetKey: key at `slot`; `child` goes to its
+/// right (child slot+1) on insert and is unused otherwise.
+template <typename Key>
+struct BasicInternalSlotLog {
+    int32_t slot;
+    Key     key;
+    int64_t child;
+};
+
+/// kLeafSplit / kLeafMerge: record count and the new next-leaf link.  A
+/// merge is followed by the records as packed by LeafPage::CopyRecords
+/// ([key | data(100)] records in logs of version 3 and older).
+struct LeafLinkLog {
+    int32_t count;
+    int32_t reserved;
+    int64_t next_leaf;
+};
+
+/// kCheckpointBegin: the dirty page table's oldest recovery LSN and size.
+/// kCheckpointEnd: the redo point, records up to which are on disk (in logs
+/// of version 4 and older, an end record without payload: all of them).
+struct CheckpointLog {
+    uint64_t lsn;
+    uint64_t dirty_pages;
+};
+
+using LeafSlotLog     = BasicLeafSlotLog<key_t>;
+using LeafSlotLogV3   = BasicLeafSlotLogV3<key_t>;
+using InternalSlotLog = BasicInternalSlotLog<key_t>;
+
+static_assert(sizeof(LeafSlotLog) == 8);
+static_assert(sizeof(LeafSlotLogV3) == 8 + DATA_SIZE);
+static_assert(sizeof(InternalSlotLog) == 16);
+static_assert(sizeof(LeafLinkLog) == 16);
+static_assert(sizeof(CheckpointLog) == 16);
+
 // ============================================================================
 // On-disk structures
 // ============================================================================
 
+/// Current WAL format version.  Older files are still read:
+///   - 1: page images only, CRC32 checksums.
+///   - 2: adds record-level records.
+///   - 3: CRC32C checksums, chained over header and payload.
+///   - 4: leaf records carry variable-length cells for slotted leaves.
+///   - 5: checkpoint records carry a CheckpointLog; redo starts after the
+///        end record's redo point, not after the end record.
+constexpr uint32_t WAL_FORMAT_VERSION = 5;
+
 /// WAL file header (written at offset 0).
 struct WALFileHeader {
     uint32_t magic    = 0x57414C31;  ///< "WAL1" in ASCII
-    uint32_t version  = 1;
-    uint64_t checkpoint_lsn = 0;     ///< LSN of the last completed checkpoint
+    uint32_t version  = WAL_FORMAT_VERSION;
+    uint64_t checkpoint_lsn = 0;     ///< Redo point of the last completed checkpoint
 };
 
 static_assert(sizeof(WALFileHeader) == 16);
@@ -71,36 +206,87 @@ struct LogRecordHeader {
     LogRecordType   type      = LogRecordType::kInvalid;
     int64_t         page_id   = INVALID_PAGE_ID;
     uint32_t        data_len  = 0;      ///< Bytes of payload following this header
-    uint32_t        checksum  = 0;      ///< CRC32 of (header fields + data)
+    uint32_t        checksum  = 0;      ///< CRC32C of (header fields + data)
 };
 
 static_assert(sizeof(LogRecordHeader) == 32);
 
+/// What the last `WriteAheadLog::Recover` did.
+struct RecoveryStats {
+    size_t   records      = 0;  ///< Valid records in the log.
+    size_t   bytes        = 0;  ///< Their size, headers included.
+    size_t   redone       = 0;  ///< Records applied to pages.
+    size_t   superseded   = 0;  ///< Skipped: a later image of the page follows.
+    size_t   pages        = 0;  ///< Pages written to the data file.
+    size_t   failed       = 0;  ///< Changes that did not apply to their page.
+    unsigned threads      = 0;  ///< Threads that verified and applied them.
+    double   scan_seconds = 0;  ///< Mapping the log and verifying checksums.
+    double   redo_seconds = 0;  ///< Applying the records and syncing.
+
+    /// Log bytes recovered per second, end to end.
+    [[nodiscard]] double MBPerSecond() const {
+        double seconds = scan_seconds + redo_seconds;
+        return seconds > 0 ? static_cast<double>(bytes) / (1 << 20) / seconds : 0;
+    }
+};
+
+// ============================================================================
+// WALOptions
+// ============================================================================
+
+/// Group-commit settings of a WriteAheadLog.
+struct WALOptions {
+    /// Buffer records in memory and let a background flusher batch them.
+    bool group_commit = false;
+
+    /// How long the flusher may wait for more records to join a batch once
+    /// a caller is waiting (0 = flush as soon as anyone waits).
+    uint32_t max_latency_us = 0;
+
+    /// Buffered bytes that start a batch without anyone waiting.  Appends
+    /// block while twice this much is buffered.
+    size_t max_batch_bytes = 1 << 20;
+
+    /// With `kUring`, a group-commit batch is written and synced by one
+    /// io_uring submission: the write linked to an fdatasync.
+    IoEngine io_engine = IoEngine::kSync;
+
+    /// Threads that verify and replay the log on open and in `Recover`
+    /// (0 = one per hardware thread).  Small logs use fewer.
+    unsigned recovery_threads = 0;
+};
+
 // ============================================================================
 // WriteAheadLog
 // ============================================================================
 
 /// Append-only write-ahead log with redo-only crash recovery.
 ///
+/// Logging, checkpointing and flushing are thread-safe; `Recover` must run
+/// before the log is shared between threads.
+///
 /// Typical lifecycle:
 /// @code
 ///   // On open:
 ///   WriteAheadLog wal("index.wal");
 ///   wal.Recover(disk);           // replay after crash
 ///
-///   // During operation (called by BufferPool before flush):
-///   wal.LogPageWrite(page_id, data);
-///   wal.Flush();
+///   // During operation (BPlusTree logs, BufferPool waits before flush):
+///   uint64_t lsn = wal.LogRecord(LogRecordType::kLeafDelete, page_id,
+///                                &rec, sizeof(rec));
+///   wal.WaitDurable(lsn);
 ///
-///   // Periodic checkpoint:
-///   wal.BeginCheckpoint();
-///   pool.FlushAllPages();        // flushes dirty pages (which logs them)
-///   wal.EndCheckpoint();
+///   // Periodic checkpoint (writers continue after BeginCheckpoint):
+///   DirtyPageTable dpt = pool.BeginCheckpoint(wal.CurrentLSN());
+///   uint64_t redo = wal.BeginCheckpoint(dpt.oldest_lsn, dpt.pages);
+///   pool.FlushCheckpoint();      // writes back the table's pages
+///   wal.EndCheckpoint(redo);
 /// @endcode
 class WriteAheadLog {
 public:
     /// Open (or create) a WAL file at @p path.
-    explicit WriteAheadLog(const std::string& path);
+    explicit WriteAheadLog(const std::string& path,
+                           const WALOptions& options = {});
 
     ~WriteAheadLog();
 
@@ -114,59 +300,191 @@ public:
     /// @return The LSN assigned to this record.
     uint64_t LogPageWrite(int64_t page_id, const char* page_data);
 
-    /// Mark the beginning of a checkpoint.
-    uint64_t BeginCheckpoint();
-
-    /// Mark the end of a checkpoint, then truncate the log.
-    uint64_t EndCheckpoint();
-
-    /// Force-flush (fsync) the WAL file to stable storage.
+    /// Append a record-level change of @p type to page @p page_id, with
+    /// @p len bytes of payload (see the record-level payloads above).
+    /// @return The LSN assigned to this record.
+    uint64_t LogRecord(LogRecordType type, int64_t page_id,
+                       const void* payload, uint32_t len);
+
+    /// Mark the beginning of a checkpoint whose dirty page table holds
+    /// @p dirty_pages pages, the oldest with recovery LSN @p oldest_lsn.
+    /// Changes from now on make a full-page write of each page first.
+    /// @return The checkpoint's redo point (the record's LSN).
+    uint64_t BeginCheckpoint(uint64_t oldest_lsn = 0, uint64_t dirty_pages = 0);
+
+    /// Mark the end of the checkpoint that began at @p redo_lsn, whose
+    /// pages are now on disk, and drop every record up to it.  With 0, every
+    /// change logged so far is on disk and the whole log is truncated.
+    /// Appends wait while the rest of the log is copied to a new file.
+    uint64_t EndCheckpoint(uint64_t redo_lsn = 0);
+
+    /// Make every record appended so far durable.
     void Flush();
 
+    /// Block until every record up to and including @p lsn is on stable
+    /// storage.  Returns immediately if it already is.
+    void WaitDurable(uint64_t lsn);
+
     // -- Recovery ------------------------------------------------------------
 
     /// Replay logged page writes to @p disk to restore consistency.
-    /// Should be called once on startup before normal operations.
-    /// @return Number of pages recovered.
+    /// Should be called once on startup before normal operations.  A change
+    /// that does not apply to its page (a malformed payload, or a page of
+    /// another layout) is counted in `RecoveryStats::failed`; that page is
+    /// left as it was and the log is kept for another attempt.
+    /// @return Number of records applied.
     size_t Recover(DiskManager& disk);
 
+    /// Counters and timings of the last `Recover`.
+    [[nodiscard]] const RecoveryStats& LastRecovery() const { return last_recovery_; }
+
     // -- Queries -------------------------------------------------------------
 
     [[nodiscard]] uint64_t    CurrentLSN()         const { return next_lsn_; }
-    [[nodiscard]] uint64_t    CheckpointLSN()      const { return checkpoint_lsn_; }
+    /// Redo point of the latest checkpoint, from when it begins; a page
+    /// not changed since is logged whole on its next change.
+    [[nodiscard]] uint64_t    CheckpointLSN()      const { return checkpoint_lsn_.load(std::memory_order_acquire); }
+    [[nodiscard]] uint64_t    DurableLSN()         const { return durable_lsn_; }
+    [[nodiscard]] size_t      SyncCount()          const { return syncs_; }
+    [[nodiscard]] bool        GroupCommit()        const { return options_.group_commit; }
     [[nodiscard]] size_t      BytesWritten()        const { return bytes_written_; }
     [[nodiscard]] size_t      RecordsWritten()      const { return records_written_; }
     [[nodiscard]] std::string FilePath()            const { return path_; }
     [[nodiscard]] bool        IsEnabled()           const { return fd_ >= 0; }
+    /// Format version of the open file; records appended before the next
+    /// truncation keep it, truncation upgrades to WAL_FORMAT_VERSION.
+    [[nodiscard]] uint32_t    FormatVersion()       const { return version_; }
 
     // -- Utility -------------------------------------------------------------
 
-    /// Compute CRC32 of a buffer.
+    /// Compute CRC32 (ISO 3309) of a buffer; checksum of version 1-2 logs.
     static uint32_t CRC32(const void* data, size_t len);
 
+    /// Checksum of a record with header @p hdr (checksum field ignored) and
+    /// @p data_len bytes of @p data, as written in format @p version.
+    static uint32_t RecordChecksum(const LogRecordHeader& hdr, const char* data,
+                                   uint32_t data_len,
+                                   uint32_t version = WAL_FORMAT_VERSION);
+
 private:
-    /// Append a raw log record (header + optional data).
-    void AppendRecord(LogRecordType type, int64_t page_id,
-                      const char* data, uint32_t data_len);
+    /// Append a raw log record (header + optional data) to the log buffer,
+    /// or straight to the file without group commit.
+    /// @pre latch_ is held.  @return The LSN assigned to the record.
+    uint64_t AppendRecord(LogRecordType type, int64_t page_id,
+                          const char* data, uint32_t data_len);
+
+    /// Write out the buffer and sync, making every appended record durable.
+    /// @pre io_latch_ and latch_ are held.
+    void DrainLocked();
 
-    /// Read all valid records from the WAL file.
+    /// fdatasync without group commit; advances the durable LSN.
+    void SyncDirect();
+
+    /// Group commit: write everything buffered as one batch.
+    /// @pre io_latch_ is held.  @param[out] end Last LSN in the batch.
+    /// @return false on I/O error.
+    bool WriteBatch(uint64_t& end);
+
+    /// Group commit with io_uring: write and sync everything buffered as
+    /// one linked pair, then release its waiters.  @pre io_latch_ is held.
+    /// @param[out] end Last LSN in the batch.  @return false on I/O error.
+    bool WriteSyncBatch(uint64_t& end);
+
+    /// Group commit: sync the file once the batch ending at @p end has been
+    /// written, then release its waiters.  @return false on I/O error.
+    bool SyncBatch(uint64_t end);
+
+    /// Body of the group-commit flusher thread.
+    void FlusherLoop();
+
+    /// A record of the mapped log; the payload points into the mapping.
     struct RecoveryRecord {
-        LogRecordHeader header;
-        std::vector<char> data;
+        LogRecordHeader  header;
+        std::string_view data;
+    };
+
+    /// The log file mapped read-only, with its valid records in order.
+    struct LogScan {
+        const char* map  = nullptr;
+        size_t      size = 0;
+        size_t      end  = 0;  ///< Offset just past the last valid record
+        std::vector<RecoveryRecord> records;
+
+        LogScan() = default;
+        LogScan(const LogScan&)            = delete;
+        LogScan& operator=(const LogScan&) = delete;
+        ~LogScan();
     };
-    std::vector<RecoveryRecord> ReadAllRecords();
+
+    /// Map the log into @p scan and index its valid records.  Checksums of
+    /// records ending at or before @p verified_end are taken as checked.
+    void ScanLog(LogScan& scan, size_t verified_end) const;
+
+    /// Threads to use on @p records records.
+    [[nodiscard]] unsigned RecoveryThreads(size_t records) const;
+
+    /// Apply a record-level change, logged in format @p version, to @p page
+    /// of a tree with @p key_size-byte keys.
+    /// @return false if the payload is malformed or the key size unknown.
+    static bool RedoRecord(const RecoveryRecord& rec, char* page, size_t key_size,
+                           uint32_t version);
+
+    /// RedoRecord for @p Key keys.
+    template <typename Key>
+    static bool RedoRecordAs(const RecoveryRecord& rec, char* page, uint32_t version);
+
+    /// Apply a leaf change from a log of format version 3 or older to a
+    /// fixed-payload leaf.
+    template <typename Key>
+    static bool RedoFixedLeaf(const RecoveryRecord& rec, char* page);
 
     /// Truncate the WAL file (reset to just the file header).
     void Truncate();
 
+    /// Drop the records up to @p lsn: copy the rest into a new file with
+    /// the header for @p lsn and move it over the log.  Truncates if only
+    /// checkpoint records are left.  @pre io_latch_ and latch_ are held and
+    /// the buffer is drained.
+    void TruncateThrough(uint64_t lsn);
+
     std::string path_;
     int         fd_         = -1;
-    uint64_t    next_lsn_   = 1;
-    uint64_t    checkpoint_lsn_ = 0;
+    std::atomic<uint64_t> next_lsn_{1};
+    std::atomic<uint64_t> checkpoint_lsn_{0};
+    uint32_t    version_ = WAL_FORMAT_VERSION;
+
+    /// End of the records whose checksums the constructor verified; 0 once
+    /// the file has been rewritten.
+    size_t      verified_end_ = 0;
+    RecoveryStats last_recovery_;
+
+    WALOptions  options_;
+
+    /// Serialises appends (LSN order == file order) and checkpoints.
+    std::mutex  latch_;
+
+    /// Serialises file writes of the flusher with checkpoints.  Taken before
+    /// latch_.
+    std::mutex  io_latch_;
+
+    // Group commit state (guarded by latch_; batch_ by io_latch_).
+    std::vector<char>       buffer_;         ///< Appended, not yet written
+    std::vector<char>       batch_;          ///< Being written by WriteBatch
+    uint64_t                requested_lsn_ = 0;
+    bool                    stop_   = false;
+    bool                    failed_ = false;
+    std::condition_variable flush_cv_;       ///< Wakes the flusher
+    std::condition_variable durable_cv_;     ///< Wakes waiters and blocked appends
+    std::thread             flusher_;
+    std::unique_ptr<IoRing> ring_;           ///< group commit with io_uring
+
+    std::atomic<uint64_t> written_lsn_{0};   ///< Last LSN handed to the file
+    std::atomic<uint64_t> durable_lsn_{0};   ///< Last LSN known to be synced
 
     // Stats
-    size_t bytes_written_   = 0;
-    size_t records_written_ = 0;
+    std::atomic<size_t> bytes_written_{0};
+    std::atomic<size_t> records_written_{0};
+    std::atomic<size_t> syncs_{0};
 };
 
 }  // namespace bptree
@@ -0,0 +1,105 @@
+/// @file bloom_filter.cpp
+/// @brief Layered, blocked Bloom filter.
+
+#include "bptree/bloom_filter.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace bptree {
+
+BloomFilter::Layer::Layer(size_t capacity_, double bits_per_key)
+    : blocks(std::max<size_t>(1, static_cast<size_t>(std::ceil(capacity_ * bits_per_key /
+                                                               kBlockBits)))),
+      capacity(capacity_),
+      // ln 2 bits set per bit of the key's share: the optimum.
+      hashes(std::clamp(static_cast<int>(std::lround(bits_per_key * 0.6931)), 1, 16)) {
+    // One block per cache line: over-allocate by a line and align.
+    storage.reset(new std::atomic<uint64_t>[blocks * kBlockWords + kBlockWords]());
+    auto addr = reinterpret_cast<uintptr_t>(storage.get());
+    constexpr uintptr_t kLine = kBlockWords * sizeof(uint64_t);
+    words = reinterpret_cast<std::atomic<uint64_t>*>((addr + kLine - 1) & ~(kLine - 1));
+}
+
+BloomFilter::BloomFilter(size_t bits_per_key, size_t capacity)
+    : bits_per_key_(std::max<size_t>(bits_per_key, 1)) {
+    layers_[0] = std::make_unique<Layer>(std::max(capacity, kMinCapacity),
+                                         static_cast<double>(bits_per_key_));
+    num_layers_.store(1, std::memory_order_release);
+}
+
+size_t BloomFilter::Masks(const Layer& layer, uint64_t hash, uint64_t* masks) const {
+    // The block from the high 32 bits (multiply-shift onto [0, blocks);
+    // layers stay far below 2^32 blocks), then k bit positions from a
+    // multiplicative sequence over the whole hash.
+    auto block = static_cast<size_t>(((hash >> 32) * layer.blocks) >> 32);
+    std::fill(masks, masks + kBlockWords, 0);
+    uint64_t g = hash ^ (hash >> 31);
+    for (int i = 0; i < layer.hashes; ++i) {
+        g *= 0x9E3779B97F4A7C15ull;
+        unsigned bit = static_cast<unsigned>(g >> 55);  // 0..511
+        masks[bit / 64] |= uint64_t{1} << (bit % 64);
+    }
+    return block;
+}
+
+void BloomFilter::Add(uint64_t hash) {
+    int n = num_layers_.load(std::memory_order_acquire);
+    Layer& layer = *layers_[n - 1];
+    uint64_t masks[kBlockWords];
+    std::atomic<uint64_t>* words = layer.words + Masks(layer, hash, masks) * kBlockWords;
+    for (size_t w = 0; w < kBlockWords; ++w) {
+        if (masks[w] != 0) words[w].fetch_or(masks[w], std::memory_order_release);
+    }
+    if (layer.keys.fetch_add(1, std::memory_order_relaxed) + 1 == layer.capacity) Grow(n - 1);
+}
+
+bool BloomFilter::MayContain(uint64_t hash) const {
+    // Newest first: recent keys are the likeliest to be looked up.
+    uint64_t masks[kBlockWords];
+    for (int i = num_layers_.load(std::memory_order_acquire); i-- > 0;) {
+        const Layer& layer = *layers_[i];
+        const std::atomic<uint64_t>* words = layer.words + Masks(layer, hash, masks) * kBlockWords;
+        bool all = true;
+        for (size_t w = 0; w < kBlockWords && all; ++w) {
+            all = (words[w].load(std::memory_order_acquire) & masks[w]) == masks[w];
+        }
+        if (all) return true;
+    }
+    return false;
+}
+
+void BloomFilter::Grow(int full) {
+    std::lock_guard<std::mutex> guard(grow_latch_);
+    int n = num_layers_.load(std::memory_order_relaxed);
+    if (n != full + 1 || n == kMaxLayers) return;
+    layers_[n] = std::make_unique<Layer>(layers_[n - 1]->capacity * 2,
+                                         bits_per_key_ + n * kExtraBitsPerLayer);
+    num_layers_.store(n + 1, std::memory_order_release);
+}
+
+BloomFilterStats BloomFilter::Stats() const {
+    BloomFilterStats st;
+    double pass_none = 1;  // chance that no layer lets a new key through
+    int n = num_layers_.load(std::memory_order_acquire);
+    for (int i = 0; i < n; ++i) {
+        const Layer& layer = *layers_[i];
+        double fpr = 0;
+        for (size_t b = 0; b < layer.blocks; ++b) {
+            int set = 0;
+            for (size_t w = 0; w < kBlockWords; ++w) {
+                set += __builtin_popcountll(
+                    layer.words[b * kBlockWords + w].load(std::memory_order_relaxed));
+            }
+            fpr += std::pow(static_cast<double>(set) / kBlockBits, layer.hashes);
+        }
+        pass_none *= 1 - fpr / static_cast<double>(layer.blocks);
+        st.bits += layer.blocks * kBlockBits;
+        st.keys += layer.keys.load(std::memory_order_relaxed);
+    }
+    st.layers        = static_cast<size_t>(n);
+    st.estimated_fpr = 1 - pass_none;
+    return st;
+}
+
+}  // namespace bptree
@@ -1,41 +1,229 @@
 /// @file bplus_tree.cpp
-/// @brief B+ tree implementation with buffer pool integration and delete
-///        rebalancing (redistribute / merge).
+/// @brief B+ tree implementation with buffer pool integration, latch
+///        crabbing, and delete rebalancing (redistribute / merge).
 
 #include "bptree/bplus_tree.h"
+#include "bptree/metrics.h"
 #include "bptree/page.h"
 
 #include <algorithm>
+#include <cassert>
 #include <cstring>
+#include <mutex>
+#include <stdexcept>
+#include <thread>
 #include <vector>
 
 namespace bptree {
 
+namespace {
+
+/// True if inserting @p key with a @p cell_size-byte cell into the node
+/// cannot make it split.
+template <typename Key>
+bool SafeForInsert(const char* page, const Key& key, size_t cell_size) {
+    using Leaf     = BasicLeafPage<Key>;
+    using Internal = BasicInternalPage<Key>;
+    if (PageIsLeaf(page)) return Leaf(const_cast<char*>(page)).HasRoom(key, -1, cell_size);
+    return Internal(const_cast<char*>(page)).NumKeys() < Internal::kMaxKeys;
+}
+
+/// True if deleting from the node cannot make it underflow, for leaves
+/// that keep @p leaf_min_used bytes and internal nodes that keep
+/// @p internal_min_keys keys.
+template <typename Key>
+bool SafeForDelete(const char* page, bool is_root, size_t leaf_min_used,
+                   int internal_min_keys) {
+    using Leaf     = BasicLeafPage<Key>;
+    using Internal = BasicInternalPage<Key>;
+    if (PageIsLeaf(page)) {
+        // The record to delete is not known yet: assume the largest.
+        Leaf leaf(const_cast<char*>(page));
+        return leaf.NumKeys() > 1 &&
+               (is_root || leaf.UsedBytes() >= leaf_min_used + Leaf::kMaxRecordSize);
+    }
+    int n = Internal(const_cast<char*>(page)).NumKeys();
+    return is_root ? n > 1 : n > internal_min_keys;
+}
+
+/// Key filter hash of @p key: its bytes, folded into 64 bits and mixed
+/// (the MurmurHash3 finalizer), so equal keys must be equal bytes.
+template <typename Key>
+uint64_t KeyHash(const Key& key) {
+    uint64_t h = sizeof(Key);
+    const char* bytes = reinterpret_cast<const char*>(&key);
+    for (size_t i = 0; i < sizeof(Key); i += 8) {
+        uint64_t word = 0;
+        std::memcpy(&word, bytes + i, std::min<size_t>(8, sizeof(Key) - i));
+        h = (h ^ word) * 0x9E3779B97F4A7C15ull;
+    }
+    h ^= h >> 33;
+    h *= 0xFF51AFD7ED558CCDull;
+    h ^= h >> 33;
+    h *= 0xC4CEB9FE1A85EC53ull;
+    h ^= h >> 33;
+    return h;
+}
+
+/// Options equivalent to the positional constructor arguments.
+Options MakeOptions(size_t pool_size, bool enable_wal) {
+    Options opts;
+    opts.pool_size  = pool_size;
+    opts.enable_wal = enable_wal;
+    return opts;
+}
+
+// -- WAL payloads, built from the page after the change ----------------------
+
+/// Largest kLeafInsert / kLeafUpdate payload.
+template <typename Key>
+constexpr size_t kLeafSlotLogMax = sizeof(BasicLeafSlotLog<Key>) + BasicLeafPage<Key>::kMaxCellSize;
+
+/// kLeafInsert / kLeafUpdate payload for record @p slot of @p leaf, written
+/// to @p out (kLeafSlotLogMax bytes).  @return Its size.
+template <typename Key>
+uint32_t LeafSlot(const BasicLeafPage<Key>& leaf, int slot, char* out) {
+    BasicLeafSlotLog<Key> rec{};
+    rec.slot = slot;
+    rec.key  = leaf.KeyAt(slot);
+    size_t size = leaf.CellSize(slot);
+    std::memcpy(out, &rec, sizeof(rec));
+    std::memcpy(out + sizeof(rec), leaf.CellAt(slot), size);
+    return static_cast<uint32_t>(sizeof(rec) + size);
+}
+
+template <typename Key>
+BasicInternalSlotLog<Key> InternalSlot(const BasicInternalPage<Key>& node, int slot) {
+    BasicInternalSlotLog<Key> rec{};
+    rec.slot  = slot;
+    rec.key   = node.KeyAt(slot);
+    rec.child = node.ChildAt(slot + 1);
+    return rec;
+}
+
+/// kLeafMerge payload for the last @p count records appended to @p leaf.
+template <typename Key>
+std::vector<char> LeafMerge(const BasicLeafPage<Key>& leaf, int count) {
+    LeafLinkLog link{};
+    link.count     = count;
+    link.next_leaf = leaf.NextLeaf();
+
+    size_t bytes = leaf.PackedSize(leaf.NumKeys() - count, count);
+    std::vector<char> rec(sizeof(link) + bytes);
+    std::memcpy(rec.data(), &link, sizeof(link));
+    leaf.CopyRecords(leaf.NumKeys() - count, count, rec.data() + sizeof(link));
+    return rec;
+}
+
+}  // namespace
+
 // ============================================================================
 // Construction / destruction
 // ============================================================================
 
-BPlusTree::BPlusTree(const std::string& index_file, size_t pool_size,
-                     bool enable_wal)
-    : disk_(std::make_unique<DiskManager>(index_file)),
-      pool_(std::make_unique<BufferPool>(*disk_, pool_size))
+template <typename Key, typename Compare>
+BasicBPlusTree<Key, Compare>::BasicBPlusTree(const std::string& index_file,
+                                             size_t pool_size, bool enable_wal)
+    : BasicBPlusTree(index_file, MakeOptions(pool_size, enable_wal))
 {
+}
+
+template <typename Key, typename Compare>
+BasicBPlusTree<Key, Compare>::BasicBPlusTree(const std::string& index_file,
+                                             const Options& options)
+    : disk_(std::make_unique<DiskManager>(index_file, options.page_compression,
+                                          options.disk_backend, options.io_engine)),
+      pool_(std::make_unique<BufferPool>(*disk_, options.pool_size,
+                                         options.pool_shards,
+                                         options.replacement_policy,
+                                         options.pool_huge_pages, options.pool_numa))
+{
+    // Pages are laid out for one key size.  A file takes the key size of
+    // the first tree to open it, before anything is written or recovered.
+    if (disk_->NextPageOffset() <= static_cast<int64_t>(PAGE_SIZE)) {
+        disk_->SetKeySize(sizeof(Key));
+        disk_->FlushMetadata();
+    } else if (disk_->KeySize() != sizeof(Key)) {
+        throw std::runtime_error("BPlusTree: " + index_file + " has " +
+                                 std::to_string(disk_->KeySize()) + "-byte keys, not " +
+                                 std::to_string(sizeof(Key)));
+    }
+
     // Set up WAL if enabled.
-    if (enable_wal) {
+    if (options.enable_wal) {
         std::string wal_path = index_file + ".wal";
-        wal_ = std::make_unique<WriteAheadLog>(wal_path);
-
-        // Run crash recovery: replay any pending page writes.
+        WALOptions wal_options;
+        wal_options.group_commit     = options.wal_group_commit;
+        wal_options.max_latency_us   = options.wal_group_commit_latency_us;
+        wal_options.max_batch_bytes  = options.wal_group_commit_bytes;
+        wal_options.io_engine        = options.io_engine;
+        wal_options.recovery_threads = options.wal_recovery_threads;
+        wal_ = std::make_unique<WriteAheadLog>(wal_path, wal_options);
+
+        // Run crash recovery: replay any pending page writes.  A change
+        // that cannot be applied leaves its page behind the log, so the
+        // tree cannot be trusted.
         wal_->Recover(*disk_);
+        if (size_t failed = wal_->LastRecovery().failed) {
+            throw std::runtime_error("BPlusTree: " + std::to_string(failed) +
+                                     " log records of " + wal_path + " could not be redone");
+        }
 
         // Attach WAL to the buffer pool so flushes are logged.
         pool_->SetWAL(wal_.get());
+
+        // Records appended now would be read back in the format of the
+        // log's header: start an empty log in the current one first.
+        if (wal_->FormatVersion() < WAL_FORMAT_VERSION) CheckpointLocked();
+    }
+
+    if (options.page_cleaner) {
+        CleanerOptions cleaner_options;
+        cleaner_options.clean_fraction   = options.page_cleaner_clean_fraction;
+        cleaner_options.dirty_high_water = options.page_cleaner_dirty_high_water;
+        cleaner_options.dirty_low_water  = options.page_cleaner_dirty_low_water;
+        cleaner_options.interval_ms      = options.page_cleaner_interval_ms;
+        pool_->StartCleaner(cleaner_options);
+    }
+
+    scan_read_ahead_  = options.scan_read_ahead;
+    optimistic_reads_ = options.optimistic_reads;
+    double threshold  = std::clamp(options.merge_threshold, 0.0, 1.0);
+    leaf_min_used_    = static_cast<size_t>(threshold * Leaf::kMinUsed);
+    internal_min_keys_ = std::max(1, static_cast<int>(threshold * Internal::kMinKeys));
+    if (options.optimistic_reads && options.swizzle_pointers) {
+        pool_->EnableSwizzling(Internal::kMaxKeys + 1);
     }
 
     ReadMetadata();
+    if (disk_->FormatVersion() < FILE_FORMAT_VERSION) UpgradeFormat();
+    if (options.bloom_bits_per_key > 0) BuildFilter(options.bloom_bits_per_key);
 }
 
-BPlusTree::~BPlusTree() {
+template <typename Key, typename Compare>
+void BasicBPlusTree<Key, Compare>::BuildFilter(size_t bits_per_key) {
+    // Walk the leaves once for the hashes, then size the filter for twice
+    // as many keys so that inserts have room before it adds a layer.
+    std::vector<uint64_t> hashes;
+    int64_t leaf_off;
+    char* page = SearchLeaf(std::nullopt, LatchMode::kShared, leaf_off);
+    while (page) {
+        Leaf leaf(page);
+        for (int i = 0; i < leaf.NumKeys(); ++i) hashes.push_back(KeyHash(leaf.KeyAt(i)));
+        int64_t next = leaf.NextLeaf();
+        UnpinPage(leaf_off, false, LatchMode::kShared);
+        leaf_off = next;
+        page = next != INVALID_PAGE_ID ? PinPage(next, LatchMode::kShared) : nullptr;
+    }
+
+    filter_ = std::make_unique<BloomFilter>(
+        bits_per_key, std::max(2 * hashes.size(), BloomFilter::kMinCapacity));
+    for (uint64_t h : hashes) filter_->Add(h);
+}
+
+template <typename Key, typename Compare>
+BasicBPlusTree<Key, Compare>::~BasicBPlusTree() {
+    pool_->StopCleaner();
     WriteMetadata();
     pool_->FlushAllPages();
 
@@ -49,135 +237,606 @@ BPlusTree::~BPlusTree() {
 // Metadata persistence (page 0 -- accessed via DiskManager directly)
 // ============================================================================
 
-void BPlusTree::WriteMetadata() {
+template <typename Key, typename Compare>
+void BasicBPlusTree<Key, Compare>::WriteMetadata() {
+    // next_page_offset is owned by DiskManager::AllocatePage.
     disk_->SetRootOffset(root_offset_);
-    disk_->SetNextPageOffset(next_page_offset_);
     disk_->FlushMetadata();
 }
 
-void BPlusTree::ReadMetadata() {
+template <typename Key, typename Compare>
+void BasicBPlusTree<Key, Compare>::ReadMetadata() {
     if (disk_->FileSize() >= PAGE_SIZE) {
-        root_offset_      = disk_->RootOffset();
-        next_page_offset_  = disk_->NextPageOffset();
+        root_offset_ = disk_->RootOffset();
 
-        if (next_page_offset_ < static_cast<int64_t>(PAGE_SIZE)) {
-            next_page_offset_ = PAGE_SIZE;
+        if (disk_->NextPageOffset() < static_cast<int64_t>(PAGE_SIZE)) {
+            disk_->SetNextPageOffset(PAGE_SIZE);
         }
         if (root_offset_ != INVALID_PAGE_ID &&
             (root_offset_ < static_cast<int64_t>(PAGE_SIZE) ||
              root_offset_ >= static_cast<int64_t>(disk_->FileSize()))) {
-            root_offset_      = INVALID_PAGE_ID;
-            next_page_offset_ = PAGE_SIZE;
+            root_offset_ = INVALID_PAGE_ID;
+            disk_->SetNextPageOffset(PAGE_SIZE);
         }
     }
 }
 
+template <typename Key, typename Compare>
+void BasicBPlusTree<Key, Compare>::UpgradeFormat() {
+    // Every page carries its own type, so pages are converted one at a time
+    // and a crash part-way through leaves a mix of layouts that the next open
+    // finishes.  Converted pages are logged in full, with a checkpoint every
+    // so often to keep the log short; the version is recorded once every
+    // page is on disk.  Version 4 pages are all still valid (leaves take a
+    // prefix as they change), so from there only the version is recorded.
+    constexpr size_t kPagesPerCheckpoint = 1024;
+    size_t converted = 0;
+    auto visit = [&](int64_t off, auto&& inspect) {
+        char* page = PinPage(off);
+        if (!page) return;
+        bool legacy = PageIsLeaf(page) ? Leaf::IsLegacy(page)
+                                       : Internal::IsLegacy(page);
+        if (legacy) {
+            if (PageIsLeaf(page)) {
+                Leaf::UpgradeLegacy(page, [&](const char* data, size_t len) {
+                    return WriteOverflow(data, len, /*log=*/true);
+                });
+            } else {
+                Internal::UpgradeLegacy(page);
+            }
+            LogPage(off, page);
+        }
+        inspect(page);
+        UnpinPage(off, legacy);
+        if (legacy && wal_ && ++converted % kPagesPerCheckpoint == 0) CheckpointLocked();
+    };
+
+    if (root_offset_ != INVALID_PAGE_ID && disk_->FormatVersion() < 4) {
+        // Leftmost path: the height of the tree and the first leaf.
+        int     internal_levels = 0;
+        int64_t leaf            = root_offset_;  // internal until the loop ends
+        for (bool at_leaf = false; !at_leaf;) {
+            int64_t child = INVALID_PAGE_ID;
+            visit(leaf, [&](char* page) {
+                at_leaf = PageIsLeaf(page);
+                if (!at_leaf) child = Internal(page).ChildAt(0);
+            });
+            if (!at_leaf) {
+                if (child == INVALID_PAGE_ID) break;
+                leaf = child;
+                ++internal_levels;
+            }
+        }
+
+        // Internal levels, top down.
+        std::vector<int64_t> level = {root_offset_};
+        for (int depth = 0; depth < internal_levels; ++depth) {
+            bool last = depth + 1 == internal_levels;
+            std::vector<int64_t> children;
+            for (int64_t off : level) {
+                visit(off, [&](char* page) {
+                    if (last) return;
+                    Internal node(page);
+                    for (int i = 0; i <= node.NumKeys(); ++i) children.push_back(node.ChildAt(i));
+                });
+            }
+            level.swap(children);
+        }
+
+        // Leaves, along the chain.
+        while (leaf != INVALID_PAGE_ID && leaf >= static_cast<int64_t>(PAGE_SIZE)) {
+            int64_t next = INVALID_PAGE_ID;
+            visit(leaf, [&](char* page) { next = Leaf(page).NextLeaf(); });
+            leaf = next;
+        }
+    }
+
+    if (wal_) {
+        CheckpointLocked();
+    } else {
+        pool_->FlushAllPages();
+    }
+    disk_->Sync();
+    disk_->SetFormatVersion(FILE_FORMAT_VERSION);
+    disk_->SetKeySize(sizeof(Key));
+    disk_->FlushMetadata();
+}
+
 // ============================================================================
 // Page access helpers (through buffer pool)
 // ============================================================================
 
-char* BPlusTree::PinPage(int64_t page_id) const {
-    return pool_->FetchPage(page_id);
+template <typename Key, typename Compare>
+char* BasicBPlusTree<Key, Compare>::PinPage(int64_t page_id, LatchMode mode) const {
+    return pool_->FetchPage(page_id, mode);
 }
 
-void BPlusTree::UnpinPage(int64_t page_id, bool dirty) const {
-    pool_->UnpinPage(page_id, dirty);
+template <typename Key, typename Compare>
+void BasicBPlusTree<Key, Compare>::UnpinPage(int64_t page_id, bool dirty, LatchMode mode) const {
+    pool_->UnpinPage(page_id, dirty, mode);
 }
 
-char* BPlusTree::AllocPage(int64_t& page_id) {
-    char* data = pool_->NewPage(page_id);
-    next_page_offset_ = disk_->NextPageOffset();
-    return data;
+template <typename Key, typename Compare>
+char* BasicBPlusTree<Key, Compare>::AllocPage(int64_t& page_id) {
+    return pool_->NewPage(page_id);
 }
 
-void BPlusTree::DeallocPage(int64_t page_id) {
-    pool_->DeletePage(page_id);
+template <typename Key, typename Compare>
+void BasicBPlusTree<Key, Compare>::DeallocPage(int64_t page_id) {
+    // A reader's lock-free pin attempt can hold the frame for a moment.  The
+    // frame must be gone before the page goes on the free list, or its
+    // write-back would later overwrite the free-list link.
+    while (!pool_->DeletePage(page_id)) std::this_thread::yield();
     disk_->FreePage(page_id);
 }
 
+// ============================================================================
+// WAL logging
+// ============================================================================
+
+template <typename Key, typename Compare>
+void BasicBPlusTree<Key, Compare>::LogPage(int64_t page_id, char* page) {
+    if (wal_) SetPageLSN(page, wal_->LogPageWrite(page_id, page));
+}
+
+template <typename Key, typename Compare>
+void BasicBPlusTree<Key, Compare>::LogChange(int64_t page_id, char* page, LogRecordType type,
+                                             const void* payload, uint32_t len) {
+    if (!wal_) return;
+
+    // Full-page write: a crash during write-back can leave a torn page that
+    // no delta applies to.  Logging the whole page on its first change after
+    // a checkpoint means redo always starts from an intact image.
+    if (PageLSN(page) <= wal_->CheckpointLSN()) {
+        LogPage(page_id, page);
+        return;
+    }
+    SetPageLSN(page, wal_->LogRecord(type, page_id, payload, len));
+}
+
+template <typename Key, typename Compare>
+void BasicBPlusTree<Key, Compare>::LogLeafSlot(int64_t leaf_off, char* page,
+                                               LogRecordType type, int slot) {
+    if (!wal_) return;
+    char rec[kLeafSlotLogMax<Key>];
+    uint32_t len = LeafSlot(Leaf(page), slot, rec);
+    LogChange(leaf_off, page, type, rec, len);
+}
+
+template <typename Key, typename Compare>
+char* BasicBPlusTree<Key, Compare>::RelatchExclusive(int64_t page_id) const {
+    UnpinPage(page_id, false, LatchMode::kShared);
+    return PinPage(page_id, LatchMode::kExclusive);
+}
+
+// ============================================================================
+// Latch crabbing bookkeeping
+// ============================================================================
+
+template <typename Key, typename Compare>
+BasicBPlusTree<Key, Compare>::WriteContext::WriteContext(BasicBPlusTree& t,
+                                                         bool lock_root)
+    : tree(t), root_lock(t.root_latch_, std::defer_lock)
+{
+    if (lock_root) {
+        root_lock.lock();
+        root = tree.root_offset_;
+    }
+}
+
+template <typename Key, typename Compare>
+BasicBPlusTree<Key, Compare>::WriteContext::~WriteContext() { tree.ReleaseAll(*this); }
+
+template <typename Key, typename Compare>
+void BasicBPlusTree<Key, Compare>::ReleaseAncestors(WriteContext& ctx) const {
+    if (ctx.path.size() > 1) {
+        for (size_t i = 0; i + 1 < ctx.path.size(); ++i) {
+            UnpinPage(ctx.path[i], false, LatchMode::kExclusive);
+        }
+        ctx.path.erase(ctx.path.begin(), ctx.path.end() - 1);
+    }
+    if (ctx.root_lock.owns_lock()) ctx.root_lock.unlock();
+}
+
+template <typename Key, typename Compare>
+void BasicBPlusTree<Key, Compare>::ReleaseAll(WriteContext& ctx) {
+    // Modified pages were already marked dirty by the helpers that wrote them.
+    for (int64_t off : ctx.path) UnpinPage(off, false, LatchMode::kExclusive);
+    ctx.path.clear();
+
+    // Merged-away pages are unreachable by now; readers that reached them
+    // before the merge only hold them briefly (see DeallocPage).  Freeing
+    // writes into the file directly, so under group commit the records that
+    // unlinked the pages must reach the log first: otherwise recovery could
+    // replay up to a parent that still points at a free-list page.
+    if (wal_ && ctx.drop_lsn && (!ctx.freed.empty() || !ctx.overflow.empty())) {
+        wal_->WaitDurable(ctx.drop_lsn);
+    }
+    for (int64_t off : ctx.freed) DeallocPage(off);
+    ctx.freed.clear();
+    for (int64_t head : ctx.overflow) FreeOverflow(head);
+    ctx.overflow.clear();
+}
+
+// ============================================================================
+// Values
+// ============================================================================
+
+template <typename Key, typename Compare>
+Status BasicBPlusTree<Key, Compare>::MakeCell(const char* data, size_t len, char* cell,
+                                              bool log) {
+    if (len > MAX_VALUE_SIZE) return Status::InvalidArg("value too long");
+    if (len <= Leaf::kMaxInlineValue) {
+        Leaf::MakeCell(cell, data, len);
+        return Status::OK();
+    }
+    int64_t head = WriteOverflow(data, len, log);
+    if (head == INVALID_PAGE_ID) return Status::IOError("cannot allocate page");
+    Leaf::MakeOverflowCell(cell, static_cast<uint32_t>(len), head);
+    return Status::OK();
+}
+
+template <typename Key, typename Compare>
+int64_t BasicBPlusTree<Key, Compare>::WriteOverflow(const char* data, size_t len, bool log) {
+    // Pages are allocated in value order, each held until the next one's
+    // offset is known.
+    int64_t head = INVALID_PAGE_ID, prev_off = INVALID_PAGE_ID;
+    char*   prev = nullptr;
+    auto finish = [&] {
+        if (log) LogPage(prev_off, prev);
+        UnpinPage(prev_off, true);
+    };
+    for (size_t pos = 0; pos < len; pos += OverflowPage::kCapacity) {
+        int64_t off;
+        char* page = AllocPage(off);
+        if (!page) {
+            if (prev) finish();
+            FreeOverflow(head);
+            return INVALID_PAGE_ID;
+        }
+        OverflowPage::Init(page);
+        OverflowPage(page).SetData(data + pos, std::min(len - pos, OverflowPage::kCapacity));
+        if (prev) {
+            OverflowPage(prev).SetNextPage(off);
+            finish();
+        } else {
+            head = off;
+        }
+        prev_off = off;
+        prev     = page;
+    }
+    if (prev) finish();
+    return head;
+}
+
+template <typename Key, typename Compare>
+void BasicBPlusTree<Key, Compare>::FreeOverflow(int64_t head) {
+    while (head != INVALID_PAGE_ID && head >= static_cast<int64_t>(PAGE_SIZE)) {
+        char* page = PinPage(head);
+        if (!page) return;
+        int64_t next = OverflowPage(page).NextPage();
+        UnpinPage(head, false);
+        DeallocPage(head);
+        head = next;
+    }
+}
+
+template <typename Key, typename Compare>
+Status BasicBPlusTree<Key, Compare>::ReadOverflow(int64_t head, size_t len,
+                                                  std::string& out) const {
+    out.reserve(out.size() + len);
+    while (len > 0) {
+        char* page = head >= static_cast<int64_t>(PAGE_SIZE) ? PinPage(head) : nullptr;
+        if (!page) return Status::IOError("broken overflow chain");
+        OverflowPage chunk(page);
+        size_t n = std::min({chunk.Length(), OverflowPage::kCapacity, len});
+        out.append(chunk.Data(), n);
+        len -= n;
+        int64_t next = chunk.NextPage();
+        UnpinPage(head, false);
+        head = next;
+    }
+    return Status::OK();
+}
+
+template <typename Key, typename Compare>
+Status BasicBPlusTree<Key, Compare>::ReadValue(const Leaf& leaf, int slot,
+                                               std::string& out) const {
+    out.clear();
+    if (!leaf.IsOverflow(slot)) {
+        out.assign(leaf.Value(slot));
+        return Status::OK();
+    }
+    return ReadOverflow(leaf.OverflowHead(slot), leaf.ValueSize(slot), out);
+}
+
 // ============================================================================
 // Utilities
 // ============================================================================
 
-bool BPlusTree::IsEmpty() const { return root_offset_ == INVALID_PAGE_ID; }
+template <typename Key, typename Compare>
+bool BasicBPlusTree<Key, Compare>::IsEmpty() const {
+    std::shared_lock<std::shared_mutex> guard(root_latch_);
+    return root_offset_ == INVALID_PAGE_ID;
+}
 
-void BPlusTree::Sync() { pool_->FlushAllPages(); }
+template <typename Key, typename Compare>
+void BasicBPlusTree<Key, Compare>::Sync() { pool_->FlushAllPages(); }
+
+template <typename Key, typename Compare>
+std::string BasicBPlusTree<Key, Compare>::FilePath() const { return disk_->FilePath(); }
+
+template <typename Key, typename Compare>
+size_t BasicBPlusTree<Key, Compare>::BufferPoolHits()   const { return pool_->HitCount(); }
+template <typename Key, typename Compare>
+size_t BasicBPlusTree<Key, Compare>::BufferPoolMisses() const { return pool_->MissCount(); }
+template <typename Key, typename Compare>
+double BasicBPlusTree<Key, Compare>::BufferPoolHitRate() const { return pool_->HitRate(); }
+template <typename Key, typename Compare>
+size_t BasicBPlusTree<Key, Compare>::BufferPoolShards()  const { return pool_->NumShards(); }
+template <typename Key, typename Compare>
+size_t BasicBPlusTree<Key, Compare>::BufferPoolPrefetches()   const { return pool_->PrefetchCount(); }
+template <typename Key, typename Compare>
+size_t BasicBPlusTree<Key, Compare>::BufferPoolPrefetchHits() const { return pool_->PrefetchHitCount(); }
+template <typename Key, typename Compare>
+size_t BasicBPlusTree<Key, Compare>::BufferPoolCleanerWrites() const { return pool_->CleanerWrites(); }
+template <typename Key, typename Compare>
+size_t BasicBPlusTree<Key, Compare>::BufferPoolDirtyPages()    const { return pool_->DirtyCount(); }
+template <typename Key, typename Compare>
+ShardStats BasicBPlusTree<Key, Compare>::BufferPoolShardStats(size_t shard) const {
+    return pool_->GetShardStats(shard);
+}
 
-std::string BPlusTree::FilePath() const { return disk_->FilePath(); }
+template <typename Key, typename Compare>
+size_t BasicBPlusTree<Key, Compare>::WALBytesWritten()   const { return wal_ ? wal_->BytesWritten() : 0; }
+template <typename Key, typename Compare>
+size_t BasicBPlusTree<Key, Compare>::WALRecordsWritten() const { return wal_ ? wal_->RecordsWritten() : 0; }
+template <typename Key, typename Compare>
+size_t BasicBPlusTree<Key, Compare>::WALSyncCount()      const { return wal_ ? wal_->SyncCount() : 0; }
+template <typename Key, typename Compare>
+bool   BasicBPlusTree<Key, Compare>::WALEnabled()        const { return wal_ != nullptr; }
+template <typename Key, typename Compare>
+RecoveryStats BasicBPlusTree<Key, Compare>::WALRecoveryStats() const {
+    return wal_ ? wal_->LastRecovery() : RecoveryStats{};
+}
+
+template <typename Key, typename Compare>
+size_t BasicBPlusTree<Key, Compare>::BufferPoolSwizzledPages() const {
+    return pool_->SwizzledPages();
+}
 
-size_t BPlusTree::BufferPoolHits()   const { return pool_->HitCount(); }
-size_t BPlusTree::BufferPoolMisses() const { return pool_->MissCount(); }
-double BPlusTree::BufferPoolHitRate() const { return pool_->HitRate(); }
+template <typename Key, typename Compare>
+size_t BasicBPlusTree<Key, Compare>::OptimisticRestarts() const {
+    return optimistic_restarts_.load(std::memory_order_relaxed);
+}
 
-size_t BPlusTree::WALBytesWritten()   const { return wal_ ? wal_->BytesWritten() : 0; }
-size_t BPlusTree::WALRecordsWritten() const { return wal_ ? wal_->RecordsWritten() : 0; }
-bool   BPlusTree::WALEnabled()        const { return wal_ != nullptr; }
+template <typename Key, typename Compare>
+BloomFilterStats BasicBPlusTree<Key, Compare>::FilterStats() const {
+    return filter_ ? filter_->Stats() : BloomFilterStats{};
+}
 
-void BPlusTree::Checkpoint() {
+template <typename Key, typename Compare>
+void BasicBPlusTree<Key, Compare>::Checkpoint() {
     if (!wal_) return;
+    BPTREE_TIME(Histogram::kCheckpoint);
+    // Writers are held off only while the dirty page table is taken and the
+    // begin record is logged; the table is written behind them.
+    std::unique_lock<std::shared_mutex> guard(checkpoint_latch_);
+    std::unique_lock<std::mutex> run(checkpoint_run_latch_);
+    DirtyPageTable dirty = pool_->BeginCheckpoint(wal_->CurrentLSN());
+    uint64_t redo = wal_->BeginCheckpoint(dirty.oldest_lsn, dirty.pages);
+    guard.unlock();
+
+    pool_->FlushCheckpoint();
+    wal_->EndCheckpoint(redo);
+}
+
+template <typename Key, typename Compare>
+void BasicBPlusTree<Key, Compare>::CheckpointLocked() {
+    std::lock_guard<std::mutex> run(checkpoint_run_latch_);
     wal_->BeginCheckpoint();
     pool_->FlushAllPages();
     wal_->EndCheckpoint();
 }
 
+template <typename Key, typename Compare>
+size_t BasicBPlusTree<Key, Compare>::PageCount() const {
+    return static_cast<size_t>(disk_->NextPageOffset()) / PAGE_SIZE;
+}
+
 // ============================================================================
 // Search
 // ============================================================================
 
-int64_t BPlusTree::SearchLeaf(key_t key) const {
-    if (root_offset_ == INVALID_PAGE_ID) return INVALID_PAGE_ID;
+template <typename Key, typename Compare>
+char* BasicBPlusTree<Key, Compare>::SearchLeaf(const std::optional<Key>& key,
+                                               LatchMode leaf_mode, int64_t& leaf_off,
+                                               LeafBounds* bounds, bool before) const {
+    if (key && !bounds && !before && optimistic_reads_) {
+        char* page;
+        if (SearchLeafOptimistic(*key, leaf_mode, leaf_off, page)) return page;
+    }
+
+    // Hold the root latch until the root page itself is latched, so a
+    // concurrent root split cannot hand us a stale root.
+    std::shared_lock<std::shared_mutex> root_guard(root_latch_);
+    if (root_offset_ == INVALID_PAGE_ID) return nullptr;
 
     int64_t current = root_offset_;
-    char* page = PinPage(current);
-    if (!page) return INVALID_PAGE_ID;
+    char* page = PinPage(current, LatchMode::kShared);
+    if (!page) return nullptr;
+    if (leaf_mode == LatchMode::kExclusive && PageIsLeaf(page)) {
+        page = RelatchExclusive(current);
+    }
+    root_guard.unlock();
 
+    std::optional<Key> high;  // every key under the current node is < high
+    if (bounds) {
+        bounds->low.reset();
+        bounds->parent_high.reset();
+        if (bounds->siblings) bounds->siblings->clear();
+    }
     while (!PageIsLeaf(page)) {
-        InternalPage node(page);
-        int n = node.NumKeys();
-        int i = 0;
-        while (i < n && key >= node.KeyAt(i)) ++i;
-        int64_t child = node.ChildAt(i);
-        UnpinPage(current, false);
+        Internal node(page);
+        // Child idx holds the keys in [key[idx-1], key[idx]).  Looking for
+        // the largest key < key, take the child whose range starts below it.
+        int idx = !key  ? (before ? node.NumKeys() : 0)
+                : before ? node.LowerBound(*key, less_)
+                         : node.ChildIndex(*key, less_);
+        int64_t child = node.ChildAt(idx);
+        if (bounds) {
+            // Overwritten level by level: the last node visited is the
+            // leaf's parent.
+            if (idx > 0) bounds->low = node.KeyAt(idx - 1);
+            bounds->parent_high = high;
+            if (idx < node.NumKeys()) high = node.KeyAt(idx);
+            if (bounds->siblings) {
+                bounds->siblings->clear();
+                for (int i = idx + 1; i <= node.NumKeys(); ++i) {
+                    bounds->siblings->push_back(node.ChildAt(i));
+                }
+            }
+        }
 
-        current = child;
-        if (current < static_cast<int64_t>(PAGE_SIZE)) return INVALID_PAGE_ID;
+        if (child < static_cast<int64_t>(PAGE_SIZE)) {
+            UnpinPage(current, false, LatchMode::kShared);
+            return nullptr;
+        }
+
+        // Crab: latch the child before letting go of the parent.  A writer
+        // re-latches its leaf exclusively while the parent is still held,
+        // since splitting or merging the leaf needs the parent exclusively.
+        char* child_page = PinPage(child, LatchMode::kShared);
+        if (child_page && leaf_mode == LatchMode::kExclusive &&
+            PageIsLeaf(child_page)) {
+            child_page = RelatchExclusive(child);
+        }
+        UnpinPage(current, false, LatchMode::kShared);
+        if (!child_page) return nullptr;
 
-        page = PinPage(current);
-        if (!page) return INVALID_PAGE_ID;
+        current = child;
+        page    = child_page;
     }
 
-    // Return with the leaf still pinned -- caller must unpin.
-    UnpinPage(current, false);
-    return current;
+    // Return with the leaf still pinned and latched -- caller must unpin.
+    leaf_off = current;
+    return page;
 }
 
-Status BPlusTree::Search(key_t key, char* data_out) const {
-    int64_t leaf_off = SearchLeaf(key);
-    if (leaf_off == INVALID_PAGE_ID) return Status::NotFound("key not found");
-
-    char* page = PinPage(leaf_off);
-    if (!page) return Status::IOError("cannot pin page");
+template <typename Key, typename Compare>
+bool BasicBPlusTree<Key, Compare>::SearchLeafOptimistic(Key key, LatchMode leaf_mode,
+                                                        int64_t& leaf_off, char*& page) const {
+    for (int attempt = 0; attempt < kOptimisticAttempts; ++attempt) {
+        if (attempt > 0) optimistic_restarts_.fetch_add(1, std::memory_order_relaxed);
 
-    LeafPage leaf(page);
-    int n = leaf.NumKeys();
-    for (int i = 0; i < n; ++i) {
-        if (leaf.KeyAt(i) == key) {
-            leaf.GetData(i, data_out);
-            UnpinPage(leaf_off, false);
-            return Status::OK();
+        int64_t root = root_offset_.load(std::memory_order_acquire);
+        if (root == INVALID_PAGE_ID) {
+            page = nullptr;
+            return true;
         }
+        BufferPool::OptimisticPage node, parent;
+        if (!pool_->ReadOptimistic(root, node)) return false;
+        if (root_offset_.load(std::memory_order_acquire) != root) continue;
+
+        // Nothing read from a node counts until the node validates, and
+        // until then every read must stay inside the page.
+        bool conflict = false;
+        while (PageType(node.data) == PAGE_TYPE_INTERNAL) {
+            Internal inner(const_cast<char*>(node.data));
+            int n = inner.NumKeys();
+            if (n < 0 || n > Internal::kMaxKeys) {
+                if (pool_->Validate(node)) return false;  // corrupt
+                conflict = true;
+                break;
+            }
+            int idx = inner.ChildIndexIn(n, key, less_);
+            int64_t child = inner.ChildAt(idx);
+            if (!pool_->Validate(node)) {
+                conflict = true;
+                break;
+            }
+            if (child < static_cast<int64_t>(PAGE_SIZE)) return false;
+
+            // The child's version counts only if the parent still pointed
+            // to it when the version was read.
+            parent = node;
+            if (!pool_->ReadChildOptimistic(parent, idx, child, node)) return false;
+            if (!pool_->Validate(parent)) {
+                conflict = true;
+                break;
+            }
+        }
+        if (conflict) continue;
+        bool leaf = PageIsLeaf(node.data);
+        if (!pool_->Validate(node)) continue;
+        if (!leaf) return false;  // a layout older than the current one
+
+        // Latch the leaf, then check that it still covers the key: a split
+        // or merge of it changes its parent (or, for a root leaf, the root).
+        // Pinned where it was read, never from disk: Compact may have
+        // dropped the page and cut the file since.
+        char* leaf_page = pool_->PinOptimistic(node, leaf_mode);
+        if (!leaf_page) continue;
+        bool covers = parent.frame ? pool_->Validate(parent)
+                                   : root_offset_.load(std::memory_order_acquire) == root;
+        if (covers && PageIsLeaf(leaf_page)) {
+            leaf_off = node.page_id;
+            page     = leaf_page;
+            return true;
+        }
+        UnpinPage(node.page_id, false, leaf_mode);
     }
-    UnpinPage(leaf_off, false);
-    return Status::NotFound("key not found");
+    optimistic_restarts_.fetch_add(1, std::memory_order_relaxed);
+    return false;
+}
+
+template <typename Key, typename Compare>
+bool BasicBPlusTree<Key, Compare>::FilterExcludes(const Key& key) const {
+    if (!filter_ || filter_->MayContain(KeyHash(key))) return false;
+    BPTREE_COUNT(Counter::kFilterNegatives);
+    return true;
 }
 
-Status BPlusTree::Search(key_t key, std::string& value_out) const {
-    char buf[DATA_SIZE];
-    Status s = Search(key, buf);
-    if (s.ok()) {
-        size_t len = ::strnlen(buf, DATA_SIZE);
-        value_out.assign(buf, len);
+template <typename Key, typename Compare>
+Status BasicBPlusTree<Key, Compare>::Search(Key key, char* buf, size_t buf_size,
+                                            size_t& len) const {
+    BPTREE_TIME(Histogram::kSearch);
+    if (FilterExcludes(key)) return Status::NotFound("key not found");
+    int64_t leaf_off;
+    char* page = SearchLeaf(key, LatchMode::kShared, leaf_off);
+    if (!page) return Status::NotFound("key not found");
+
+    Leaf leaf(page);
+    int i = leaf.Find(key, less_);
+    if (i < 0 && filter_) BPTREE_COUNT(Counter::kFilterFalsePositives);
+    Status s = i >= 0 ? Status::OK() : Status::NotFound("key not found");
+    if (i >= 0) {
+        len = leaf.ValueSize(i);
+        if (!leaf.IsOverflow(i)) {
+            std::memcpy(buf, leaf.Value(i).data(), std::min(len, buf_size));
+        } else {
+            std::string value;
+            s = ReadOverflow(leaf.OverflowHead(i), len, value);
+            std::memcpy(buf, value.data(), std::min(value.size(), buf_size));
+        }
     }
+    UnpinPage(leaf_off, false, LatchMode::kShared);
+    return s;
+}
+
+template <typename Key, typename Compare>
+Status BasicBPlusTree<Key, Compare>::Search(Key key, std::string& value_out) const {
+    BPTREE_TIME(Histogram::kSearch);
+    if (FilterExcludes(key)) return Status::NotFound("key not found");
+    int64_t leaf_off;
+    char* page = SearchLeaf(key, LatchMode::kShared, leaf_off);
+    if (!page) return Status::NotFound("key not found");
+
+    Leaf leaf(page);
+    int i = leaf.Find(key, less_);
+    if (i < 0 && filter_) BPTREE_COUNT(Counter::kFilterFalsePositives);
+    Status s = i >= 0 ? ReadValue(leaf, i, value_out) : Status::NotFound("key not found");
+    UnpinPage(leaf_off, false, LatchMode::kShared);
     return s;
 }
 
@@ -185,41 +844,396 @@ Status BPlusTree::Search(key_t key, std::string& value_out) const {
 // Range query
 // ============================================================================
 
-Status BPlusTree::RangeQuery(key_t lower, key_t upper,
-                             std::vector<std::pair<key_t, std::string>>& results) const {
+template <typename Key, typename Compare>
+Status BasicBPlusTree<Key, Compare>::RangeQuery(
+    Key lower, Key upper, std::vector<std::pair<Key, std::string>>& results) const {
+    BPTREE_TIME(Histogram::kRangeQuery);
     results.clear();
+    return Scan(lower, upper, [&](Key key, std::string_view value) {
+        results.emplace_back(key, std::string(value));
+        return true;
+    });
+}
 
-    if (lower > upper) return Status::InvalidArg("lower > upper");
-    if (root_offset_ == INVALID_PAGE_ID) return Status::OK();
+template <typename Key, typename Compare>
+Status BasicBPlusTree<Key, Compare>::Scan(Key lower, Key upper, const ScanCallback& fn,
+                                          size_t limit) const {
+    if (less_(upper, lower)) return Status::InvalidArg("lower > upper");
 
-    int64_t leaf_off = SearchLeaf(lower);
-    if (leaf_off == INVALID_PAGE_ID) return Status::OK();
+    Cursor cur(*this);
+    cur.SetUpperBound(upper);
+    cur.SetLimit(limit);
+    for (cur.Seek(lower); cur.Valid(); cur.Next()) {
+        if (!fn(cur.key(), cur.value())) break;
+    }
+    return Status::OK();
+}
 
-    while (leaf_off != INVALID_PAGE_ID && leaf_off >= static_cast<int64_t>(PAGE_SIZE)) {
-        char* page = PinPage(leaf_off);
-        if (!page) break;
+template <typename Key, typename Compare>
+typename BasicBPlusTree<Key, Compare>::Cursor BasicBPlusTree<Key, Compare>::NewCursor() const {
+    return Cursor(*this);
+}
 
-        LeafPage leaf(page);
-        int n = leaf.NumKeys();
+// ============================================================================
+// Cursor
+// ============================================================================
+
+template <typename Key, typename Compare>
+typename BasicBPlusTree<Key, Compare>::Cursor&
+BasicBPlusTree<Key, Compare>::Cursor::operator=(Cursor&& other) noexcept {
+    if (this != &other) {
+        Reset();
+        tree_     = other.tree_;
+        page_     = std::exchange(other.page_, nullptr);
+        leaf_off_ = std::exchange(other.leaf_off_, INVALID_PAGE_ID);
+        slot_     = other.slot_;
+        upper_    = other.upper_;
+        limit_    = other.limit_;
+        visited_  = other.visited_;
+        overflow_ = std::move(other.overflow_);
+
+        read_ahead_  = other.read_ahead_;
+        window_      = other.window_;
+        run_         = other.run_;
+        ahead_       = std::move(other.ahead_);
+        ahead_pos_   = other.ahead_pos_;
+        issued_      = other.issued_;
+        parent_high_ = other.parent_high_;
+    }
+    return *this;
+}
+
+template <typename Key, typename Compare>
+void BasicBPlusTree<Key, Compare>::Cursor::Reset() {
+    if (page_) tree_->UnpinPage(leaf_off_, false, LatchMode::kShared);
+    page_     = nullptr;
+    leaf_off_ = INVALID_PAGE_ID;
+}
 
-        bool done = false;
-        for (int i = 0; i < n; ++i) {
-            int k = leaf.KeyAt(i);
-            if (k > upper) { done = true; break; }
-            if (k >= lower) {
-                char buf[DATA_SIZE];
-                leaf.GetData(i, buf);
-                results.emplace_back(k, std::string(buf, ::strnlen(buf, DATA_SIZE)));
+template <typename Key, typename Compare>
+void BasicBPlusTree<Key, Compare>::Cursor::SeekTo(const std::optional<Key>& key) {
+    Reset();
+    visited_ = 0;
+    window_  = std::min(kInitialReadAhead, read_ahead_);
+    run_     = 0;
+    Descend(key);
+    Settle();
+}
+
+template <typename Key, typename Compare>
+void BasicBPlusTree<Key, Compare>::Cursor::Descend(const std::optional<Key>& key) {
+    LeafBounds bounds;
+    if (read_ahead_ > 0) bounds.siblings = &ahead_;
+    else ahead_.clear();
+
+    page_ = tree_->SearchLeaf(key, LatchMode::kShared, leaf_off_, &bounds);
+    ahead_pos_   = 0;
+    issued_      = 0;
+    parent_high_ = bounds.parent_high;
+    if (!page_) return;
+
+    slot_ = key ? Leaf(page_).LowerBound(*key, tree_->less_) : 0;
+    if (read_ahead_ > 0) Prefetch();
+}
+
+template <typename Key, typename Compare>
+void BasicBPlusTree<Key, Compare>::Cursor::SeekToLast() {
+    Reset();
+    visited_ = 0;
+    SeekBackward(upper_, /*inclusive=*/true);
+}
+
+template <typename Key, typename Compare>
+void BasicBPlusTree<Key, Compare>::Cursor::Next() {
+    assert(Valid());
+    ++slot_;
+    Settle();
+}
+
+template <typename Key, typename Compare>
+void BasicBPlusTree<Key, Compare>::Cursor::Prev() {
+    assert(Valid());
+    if (slot_ > 0) {
+        --slot_;
+        Admit();
+        return;
+    }
+    // The previous record is in a leaf to the left.  Writers latch siblings
+    // left to right, so waiting for it here could deadlock: let go of this
+    // leaf and descend again instead.
+    Key first = key();
+    Reset();
+    SeekBackward(first, /*inclusive=*/false);
+}
+
+template <typename Key, typename Compare>
+Key BasicBPlusTree<Key, Compare>::Cursor::key() const {
+    assert(Valid());
+    return Leaf(page_).KeyAt(slot_);
+}
+
+template <typename Key, typename Compare>
+std::string_view BasicBPlusTree<Key, Compare>::Cursor::value() const {
+    assert(Valid());
+    Leaf leaf(page_);
+    if (!leaf.IsOverflow(slot_)) return leaf.Value(slot_);
+    overflow_.clear();
+    tree_->ReadOverflow(leaf.OverflowHead(slot_), leaf.ValueSize(slot_), overflow_);
+    return overflow_;
+}
+
+template <typename Key, typename Compare>
+void BasicBPlusTree<Key, Compare>::Cursor::SeekBackward(std::optional<Key> bound,
+                                                        bool inclusive) {
+    // Backward moves do not read ahead.
+    ahead_.clear();
+    ahead_pos_ = 0;
+    issued_    = 0;
+    parent_high_.reset();
+
+    for (;;) {
+        LeafBounds bounds;
+        page_ = tree_->SearchLeaf(bound, LatchMode::kShared, leaf_off_, &bounds,
+                                  /*before=*/!inclusive || !bound);
+        if (!page_) return;
+        Leaf leaf(page_);
+        if (!bound) {
+            slot_ = leaf.NumKeys() - 1;
+        } else if (inclusive) {
+            slot_ = leaf.UpperBound(*bound, tree_->less_) - 1;
+        } else {
+            slot_ = leaf.LowerBound(*bound, tree_->less_) - 1;
+        }
+        if (slot_ >= 0) {
+            Admit();
+            return;
+        }
+        // Nothing before the bound in this leaf, so the answer lies left of
+        // its fence.
+        Reset();
+        if (!bounds.low) return;
+        bound     = bounds.low;
+        inclusive = false;
+    }
+}
+
+template <typename Key, typename Compare>
+void BasicBPlusTree<Key, Compare>::Cursor::Settle() {
+    // Crab along the leaf chain past the end of each leaf (and past empty
+    // leaves).  Holding this leaf while waiting for the next one is safe:
+    // writers latch siblings left to right too.
+    while (page_) {
+        Leaf leaf(page_);
+        if (slot_ < leaf.NumKeys()) break;
+
+        // Read-ahead only knows the leaves under one parent.  Past the last
+        // of them, descend again to where the next parent starts: that lands
+        // on the next leaf and lists the leaves after it.
+        if (read_ahead_ > 0 && ahead_pos_ == ahead_.size() && parent_high_) {
+            // Internal nodes borrowing from each other move separators, so
+            // keys at or above parent_high_ may have reached this leaf since
+            // the descent: skip past what was already visited.
+            std::optional<Key> seen;
+            if (leaf.NumKeys() > 0) seen = leaf.KeyAt(leaf.NumKeys() - 1);
+            tree_->UnpinPage(leaf_off_, false, LatchMode::kShared);
+            page_ = nullptr;
+            Descend(*parent_high_);
+            if (page_ && seen) {
+                slot_ = std::max(slot_, Leaf(page_).UpperBound(*seen, tree_->less_));
             }
+            continue;
         }
 
         int64_t next = leaf.NextLeaf();
-        UnpinPage(leaf_off, false);
+        char* next_page = nullptr;
+        if (next != INVALID_PAGE_ID && next >= static_cast<int64_t>(PAGE_SIZE)) {
+            next_page = tree_->PinPage(next, LatchMode::kShared);
+        }
+        tree_->UnpinPage(leaf_off_, false, LatchMode::kShared);
+        page_     = next_page;
+        leaf_off_ = next_page ? next : INVALID_PAGE_ID;
+        slot_     = 0;
+        if (page_ && read_ahead_ > 0) ReadAhead(leaf_off_);
+    }
+    if (page_) Admit();
+}
 
-        if (done) break;
-        leaf_off = next;
+template <typename Key, typename Compare>
+void BasicBPlusTree<Key, Compare>::Cursor::ReadAhead(int64_t leaf_off) {
+    // Writers may have split or merged leaves since the list was read, so
+    // look for this leaf in the rest of it rather than assume it is next.
+    auto it = std::find(ahead_.begin() + static_cast<std::ptrdiff_t>(ahead_pos_),
+                        ahead_.end(), leaf_off);
+    if (it != ahead_.end()) ahead_pos_ = static_cast<size_t>(it - ahead_.begin()) + 1;
+
+    if (++run_ >= window_) {
+        window_ = std::min(window_ * 2, read_ahead_);
+        run_    = 0;
     }
+    Prefetch();
+}
 
+template <typename Key, typename Compare>
+void BasicBPlusTree<Key, Compare>::Cursor::Prefetch() {
+    size_t want = std::min(ahead_pos_ + window_, ahead_.size());
+    issued_ = std::max(issued_, ahead_pos_);
+    if (want <= issued_) return;
+
+    size_t count = want - issued_;
+    size_t taken = tree_->pool_->Prefetch(ahead_.data() + issued_, count);
+    issued_ += taken;
+    // The prefetch thread is falling behind: back off.
+    if (taken < count) window_ = std::max<size_t>(window_ / 2, 1);
+}
+
+template <typename Key, typename Compare>
+void BasicBPlusTree<Key, Compare>::Cursor::Admit() {
+    if ((upper_ && tree_->less_(*upper_, key())) || ++visited_ > limit_) Reset();
+}
+
+// ============================================================================
+// Batches
+// ============================================================================
+
+template <typename Key, typename Compare>
+char* BasicBPlusTree<Key, Compare>::BatchSeek(BatchPath& path, Key key) const {
+    auto& nodes = path.nodes;
+
+    // Climb to the lowest node whose range still holds the key.  Keys come
+    // in ascending order, so only the upper bound can have been passed.
+    while (!nodes.empty() && nodes.back().high && !less_(key, *nodes.back().high)) {
+        const auto& n = nodes.back();
+        UnpinPage(n.off, false, PageIsLeaf(n.page) ? path.leaf_mode : LatchMode::kShared);
+        nodes.pop_back();
+    }
+    if (!nodes.empty() && PageIsLeaf(nodes.back().page)) return nodes.back().page;
+
+    if (nodes.empty()) {
+        std::shared_lock<std::shared_mutex> root_guard(root_latch_);
+        if (root_offset_ == INVALID_PAGE_ID) return nullptr;
+        int64_t off  = root_offset_;
+        char*   page = PinPage(off, LatchMode::kShared);
+        if (!page) return nullptr;
+        if (path.leaf_mode == LatchMode::kExclusive && PageIsLeaf(page)) {
+            page = RelatchExclusive(off);
+        }
+        nodes.push_back({off, page, std::nullopt});
+    }
+
+    // Descend as SearchLeaf does, but keep the ancestors latched.  Latches
+    // are still taken top-down, and the old leaf is released before the new
+    // one is latched, so this is ordinary crabbing that lets go later.
+    while (!PageIsLeaf(nodes.back().page)) {
+        Internal node(nodes.back().page);
+        int idx = node.ChildIndex(key, less_);
+        int64_t child = node.ChildAt(idx);
+        std::optional<Key> high = nodes.back().high;
+        if (idx < node.NumKeys()) high = node.KeyAt(idx);
+
+        char* page = child >= static_cast<int64_t>(PAGE_SIZE)
+                         ? PinPage(child, LatchMode::kShared) : nullptr;
+        if (!page) {
+            BatchRelease(path);
+            return nullptr;
+        }
+        if (path.leaf_mode == LatchMode::kExclusive && PageIsLeaf(page)) {
+            page = RelatchExclusive(child);
+        }
+        nodes.push_back({child, page, high});
+    }
+    return nodes.back().page;
+}
+
+template <typename Key, typename Compare>
+void BasicBPlusTree<Key, Compare>::BatchRelease(BatchPath& path) const {
+    for (const auto& n : path.nodes) {
+        UnpinPage(n.off, false, PageIsLeaf(n.page) ? path.leaf_mode : LatchMode::kShared);
+    }
+    path.nodes.clear();
+}
+
+template <typename Key, typename Compare>
+std::vector<Status> BasicBPlusTree<Key, Compare>::MultiGet(
+    const std::vector<Key>& keys, std::vector<std::string>& values) const {
+    std::vector<Status> statuses(keys.size(), Status::NotFound("key not found"));
+    values.assign(keys.size(), std::string());
+
+    // Keys the filter rules out are answered here and never sought.
+    std::vector<size_t> order;
+    order.reserve(keys.size());
+    for (size_t i = 0; i < keys.size(); ++i) {
+        if (!FilterExcludes(keys[i])) order.push_back(i);
+    }
+    std::sort(order.begin(), order.end(),
+              [&](size_t a, size_t b) { return less_(keys[a], keys[b]); });
+
+    BatchPath path;
+    for (size_t i : order) {
+        char* page = BatchSeek(path, keys[i]);
+        if (!page) break;  // empty tree
+
+        Leaf leaf(page);
+        int slot = leaf.Find(keys[i], less_);
+        if (slot < 0) {
+            if (filter_) BPTREE_COUNT(Counter::kFilterFalsePositives);
+            continue;
+        }
+        statuses[i] = ReadValue(leaf, slot, values[i]);
+    }
+    BatchRelease(path);
+    return statuses;
+}
+
+template <typename Key, typename Compare>
+Status BasicBPlusTree<Key, Compare>::InsertBatch(
+    const std::vector<std::pair<Key, std::string>>& records) {
+    std::shared_lock<std::shared_mutex> checkpoint_guard(checkpoint_latch_);
+
+    // A stable sort keeps equal keys in input order, so upserting them in
+    // turn leaves the last one.
+    std::vector<size_t> order(records.size());
+    for (size_t i = 0; i < order.size(); ++i) order[i] = i;
+    std::stable_sort(order.begin(), order.end(), [&](size_t a, size_t b) {
+        return less_(records[a].first, records[b].first);
+    });
+
+    // Overwritten overflow chains are freed once the batch is done.
+    WriteContext ctx(*this, /*lock_root=*/false);
+    BatchPath path;
+    path.leaf_mode = LatchMode::kExclusive;
+    for (size_t i : order) {
+        Key key = records[i].first;
+        const std::string& value = records[i].second;
+        char cell[Leaf::kMaxCellSize];
+        Status s = MakeCell(value.data(), value.size(), cell);
+        if (!s.ok()) {
+            BatchRelease(path);
+            return s;
+        }
+        if (filter_) filter_->Add(KeyHash(key));
+        size_t cell_size = Leaf::CellSizeOf(cell);
+
+        char* page = BatchSeek(path, key);
+        if (page) {
+            Leaf leaf(page);
+            if (leaf.HasRoom(key, leaf.Find(key, less_), cell_size)) {
+                Key     unused_key;
+                int64_t unused_off;
+                InsertIntoLeaf(ctx, path.nodes.back().off, key, cell, unused_key, unused_off);
+                continue;
+            }
+        }
+
+        // The leaf would split (or the tree is empty): let go of the path
+        // and take the full insert path for this record.
+        BatchRelease(path);
+        s = InsertPessimistic(key, cell);
+        if (!s.ok()) {
+            if (Leaf::CellIsOverflow(cell)) FreeOverflow(Leaf::CellOverflowHead(cell));
+            return s;
+        }
+    }
+    BatchRelease(path);
     return Status::OK();
 }
 
@@ -227,9 +1241,44 @@ Status BPlusTree::RangeQuery(key_t lower, key_t upper,
 // Insert
 // ============================================================================
 
-Status BPlusTree::Insert(key_t key, const char* data) {
-    char padded[DATA_SIZE]{};
-    std::memcpy(padded, data, std::min(std::strlen(data) + 1, DATA_SIZE));
+template <typename Key, typename Compare>
+Status BasicBPlusTree<Key, Compare>::Insert(Key key, const char* data, size_t len) {
+    BPTREE_TIME(Histogram::kInsert);
+    std::shared_lock<std::shared_mutex> checkpoint_guard(checkpoint_latch_);
+    char cell[Leaf::kMaxCellSize];
+    Status s = MakeCell(data, len, cell);
+    if (!s.ok()) return s;
+    // Before the record is visible, so no search can see it and be told no.
+    if (filter_) filter_->Add(KeyHash(key));
+
+    // Optimistic pass: shared latches down to an exclusively latched leaf.
+    // Enough whenever the leaf cannot split (the record fits).
+    {
+        WriteContext ctx(*this, /*lock_root=*/false);
+        int64_t leaf_off;
+        char* page = SearchLeaf(key, LatchMode::kExclusive, leaf_off);
+        if (page) {
+            Leaf leaf(page);
+            if (leaf.HasRoom(key, leaf.Find(key, less_), Leaf::CellSizeOf(cell))) {
+                Key     unused_key;
+                int64_t unused_off;
+                InsertIntoLeaf(ctx, leaf_off, key, cell, unused_key, unused_off);
+                UnpinPage(leaf_off, false, LatchMode::kExclusive);
+                return Status::OK();
+            }
+            UnpinPage(leaf_off, false, LatchMode::kExclusive);
+        }
+    }
+
+    s = InsertPessimistic(key, cell);
+    if (!s.ok() && Leaf::CellIsOverflow(cell)) FreeOverflow(Leaf::CellOverflowHead(cell));
+    return s;
+}
+
+template <typename Key, typename Compare>
+Status BasicBPlusTree<Key, Compare>::InsertPessimistic(Key key, const char* cell) {
+    // Exclusive crabbing from the root.
+    WriteContext ctx(*this, /*lock_root=*/true);
 
     // Empty tree -- create root leaf.
     if (root_offset_ == INVALID_PAGE_ID) {
@@ -237,10 +1286,9 @@ Status BPlusTree::Insert(key_t key, const char* data) {
         char* page = AllocPage(off);
         if (!page) return Status::IOError("cannot allocate page");
 
-        LeafPage::Init(page);
-        LeafPage leaf(page);
-        leaf.SetNumKeys(1);
-        leaf.SetRecord(0, key, padded);
+        Leaf::Init(page);
+        Leaf(page).InsertAt(0, key, cell);
+        LogPage(off, page);
 
         UnpinPage(off, true);
         root_offset_ = off;
@@ -248,21 +1296,23 @@ Status BPlusTree::Insert(key_t key, const char* data) {
         return Status::OK();
     }
 
-    key_t   split_key;
+    Key     split_key;
     int64_t new_off;
-    bool split = InsertRecursive(root_offset_, key, padded, split_key, new_off);
+    bool split = InsertRecursive(ctx, root_offset_, key, cell, split_key, new_off);
 
     if (split) {
+        // The old root was full, so ctx still holds the root latch.
         int64_t new_root;
         char* page = AllocPage(new_root);
         if (!page) return Status::IOError("cannot allocate page");
 
-        InternalPage::Init(page);
-        InternalPage root(page);
+        Internal::Init(page);
+        Internal root(page);
         root.SetNumKeys(1);
         root.SetKeyAt(0, split_key);
         root.SetChildAt(0, root_offset_);
         root.SetChildAt(1, new_off);
+        LogPage(new_root, page);
 
         UnpinPage(new_root, true);
         root_offset_ = new_root;
@@ -272,130 +1322,146 @@ Status BPlusTree::Insert(key_t key, const char* data) {
     return Status::OK();
 }
 
-bool BPlusTree::InsertRecursive(int64_t node_off, key_t key, const char* data,
-                                key_t& split_key, int64_t& new_off) {
-    char* page = PinPage(node_off);
+template <typename Key, typename Compare>
+bool BasicBPlusTree<Key, Compare>::InsertRecursive(WriteContext& ctx, int64_t node_off, Key key,
+                                                   const char* cell, Key& split_key,
+                                                   int64_t& new_off) {
+    char* page = PinPage(node_off, LatchMode::kExclusive);
+    ctx.path.push_back(node_off);
+
+    // A node with room cannot split, so nothing above it will change.
+    if (SafeForInsert<Key>(page, key, Leaf::CellSizeOf(cell))) {
+        ReleaseAncestors(ctx);
+    }
 
     if (PageIsLeaf(page)) {
-        UnpinPage(node_off, false);
-        return InsertIntoLeaf(node_off, key, data, split_key, new_off);
+        return InsertIntoLeaf(ctx, node_off, key, cell, split_key, new_off);
     }
 
-    InternalPage node(page);
-    int n = node.NumKeys();
-    int i = 0;
-    while (i < n && key >= node.KeyAt(i)) ++i;
-    int64_t child = node.ChildAt(i);
-    UnpinPage(node_off, false);
+    Internal node(page);
+    int64_t child = node.ChildAt(node.ChildIndex(key, less_));
 
-    key_t   child_split;
+    Key     child_split;
     int64_t child_new;
-    bool child_did_split = InsertRecursive(child, key, data,
+    bool child_did_split = InsertRecursive(ctx, child, key, cell,
                                            child_split, child_new);
     if (!child_did_split) return false;
 
     return InsertIntoInternal(node_off, child_split, child_new, split_key, new_off);
 }
 
-bool BPlusTree::InsertIntoLeaf(int64_t leaf_off, key_t key, const char* data,
-                               key_t& split_key, int64_t& new_leaf_off) {
+template <typename Key, typename Compare>
+bool BasicBPlusTree<Key, Compare>::InsertIntoLeaf(WriteContext& ctx, int64_t leaf_off, Key key,
+                                                  const char* cell, Key& split_key,
+                                                  int64_t& new_leaf_off) {
     char* page = PinPage(leaf_off);
-    LeafPage leaf(page);
-    int n = leaf.NumKeys();
-
-    // Existing key -- update.
-    for (int i = 0; i < n; ++i) {
-        if (leaf.KeyAt(i) == key) {
-            leaf.SetData(i, data);
+    Leaf leaf(page);
+    size_t cell_size = Leaf::CellSizeOf(cell);
+
+    int pos = leaf.LowerBound(key, less_);
+
+    // Existing key -- update in place if the new cell fits, otherwise drop
+    // the old record and insert the new one as if the key were absent.
+    if (pos < leaf.NumKeys() && !less_(key, leaf.KeyAt(pos))) {
+        if (leaf.IsOverflow(pos)) ctx.overflow.push_back(leaf.OverflowHead(pos));
+        if (leaf.HasRoom(key, pos, cell_size)) {
+            leaf.SetCell(pos, cell);
+            LogLeafSlot(leaf_off, page, LogRecordType::kLeafUpdate, pos);
+            ctx.drop_lsn = PageLSN(page);
             UnpinPage(leaf_off, true);
             return false;
         }
+        leaf.RemoveAt(pos);
+        SlotLog rec{pos};
+        LogChange(leaf_off, page, LogRecordType::kLeafDelete, &rec, sizeof(rec));
+        ctx.drop_lsn = PageLSN(page);
     }
 
     // Room available.
-    if (n < LEAF_MAX_KEYS) {
-        int i = n - 1;
-        while (i >= 0 && leaf.KeyAt(i) > key) {
-            int tk; char td[DATA_SIZE];
-            leaf.GetRecord(i, tk, td);
-            leaf.SetRecord(i + 1, tk, td);
-            --i;
-        }
-        leaf.SetRecord(i + 1, key, data);
-        leaf.SetNumKeys(n + 1);
+    if (leaf.HasRoom(key, -1, cell_size)) {
+        leaf.InsertAt(pos, key, cell);
+        LogLeafSlot(leaf_off, page, LogRecordType::kLeafInsert, pos);
         UnpinPage(leaf_off, true);
         return false;
     }
 
-    // Full -- split.
-    struct Rec { int k; char d[DATA_SIZE]; };
-    std::vector<Rec> recs(n);
-    for (int i = 0; i < n; ++i) leaf.GetRecord(i, recs[i].k, recs[i].d);
-
-    Rec nr; nr.k = key; std::memcpy(nr.d, data, DATA_SIZE);
-    auto it = std::lower_bound(recs.begin(), recs.end(), nr,
-                               [](const Rec& a, const Rec& b){ return a.k < b.k; });
-    recs.insert(it, nr);
-
-    int mid = static_cast<int>((recs.size() + 1) / 2);
+    BPTREE_COUNT(Counter::kLeafSplits);
+
+    // Full -- split by bytes.  Of the n + 1 records with the new one in
+    // place, the first m stay left: a record goes left while its middle is
+    // left of the middle of all of them.  Records are at most a quarter of
+    // a page, so both halves keep at least Leaf::kMinUsed bytes.  Sizes
+    // count keys at full width; a prefixed leaf holds at most 1.5 pages of
+    // those, so either half fits in a page even if it cannot stay prefixed.
+    // The upper records move to a new leaf and the new record is inserted
+    // into whichever half it belongs to, so the original page's change is a
+    // truncation plus at most one insert.
+    int    n      = leaf.NumKeys();
+    size_t record = Leaf::RecordSize(cell_size);
+    size_t total  = leaf.UsedBytes() + record;
+    auto size_at = [&](int i) {  // bytes of record i of the merged sequence
+        return i == pos ? record : leaf.RecordSizeAt(i < pos ? i : i - 1);
+    };
+    int    mid  = 0;
+    size_t left = 0;
+    while (mid < n + 1 && 2 * left + size_at(mid) < total) left += size_at(mid++);
+    mid = std::clamp(mid, 1, n);
+    int keep = pos < mid ? mid - 1 : mid;
 
     // New leaf.
     char* new_page = AllocPage(new_leaf_off);
-    LeafPage::Init(new_page);
-    LeafPage new_leaf(new_page);
-    new_leaf.SetNumKeys(static_cast<int>(recs.size()) - mid);
-    for (int i = mid; i < static_cast<int>(recs.size()); ++i) {
-        new_leaf.SetRecord(i - mid, recs[i].k, recs[i].d);
-    }
+    Leaf::Init(new_page);
+    Leaf new_leaf(new_page);
+    new_leaf.AppendFrom(leaf, keep, n - keep);
+    if (pos >= mid) new_leaf.InsertAt(pos - keep, key, cell);
 
     // Linked list.
     new_leaf.SetNextLeaf(leaf.NextLeaf());
+    LogPage(new_leaf_off, new_page);
+    split_key = new_leaf.KeyAt(0);
     UnpinPage(new_leaf_off, true);
 
     // Left half stays in the original page (still pinned from above).
-    leaf.SetNumKeys(mid);
-    for (int i = 0; i < mid; ++i) leaf.SetRecord(i, recs[i].k, recs[i].d);
+    leaf.Truncate(keep);
     leaf.SetNextLeaf(new_leaf_off);
+    LeafLinkLog link{};
+    link.count     = keep;
+    link.next_leaf = new_leaf_off;
+    LogChange(leaf_off, page, LogRecordType::kLeafSplit, &link, sizeof(link));
+    if (pos < mid) {
+        leaf.InsertAt(pos, key, cell);
+        LogLeafSlot(leaf_off, page, LogRecordType::kLeafInsert, pos);
+    }
     UnpinPage(leaf_off, true);
 
-    // Re-read split key.
-    char* npage = PinPage(new_leaf_off);
-    split_key = LeafPage(npage).KeyAt(0);
-    UnpinPage(new_leaf_off, false);
-
     return true;
 }
 
-bool BPlusTree::InsertIntoInternal(int64_t node_off, key_t key, int64_t child_off,
-                                   key_t& split_key, int64_t& new_node_off) {
+template <typename Key, typename Compare>
+bool BasicBPlusTree<Key, Compare>::InsertIntoInternal(int64_t node_off, Key key, int64_t child_off,
+                                                      Key& split_key, int64_t& new_node_off) {
     char* page = PinPage(node_off);
-    InternalPage node(page);
+    Internal node(page);
     int n = node.NumKeys();
 
     // Room available.
-    if (n < INTERNAL_MAX_KEYS) {
-        int i = n - 1;
-        while (i >= 0 && node.KeyAt(i) > key) {
-            node.SetKeyAt(i + 1, node.KeyAt(i));
-            node.SetChildAt(i + 2, node.ChildAt(i + 1));
-            --i;
-        }
-        node.SetKeyAt(i + 1, key);
-        node.SetChildAt(i + 2, child_off);
-        node.SetNumKeys(n + 1);
+    if (n < Internal::kMaxKeys) {
+        int i = node.ChildIndex(key, less_);
+        node.InsertAt(i, key, child_off);
+        BasicInternalSlotLog<Key> rec = InternalSlot(node, i);
+        LogChange(node_off, page, LogRecordType::kInternalInsert, &rec, sizeof(rec));
         UnpinPage(node_off, true);
         return false;
     }
 
     // Full -- split.
-    std::vector<int>     keys(n);
+    BPTREE_COUNT(Counter::kInternalSplits);
+    std::vector<Key>     keys(n);
     std::vector<int64_t> children(n + 1);
     for (int i = 0; i < n; ++i) keys[i] = node.KeyAt(i);
     for (int i = 0; i <= n; ++i) children[i] = node.ChildAt(i);
+    int pos = node.LowerBound(key, less_);
     UnpinPage(node_off, false);
-
-    int pos = 0;
-    while (pos < static_cast<int>(keys.size()) && keys[pos] < key) ++pos;
     keys.insert(keys.begin() + pos, key);
     children.insert(children.begin() + pos + 1, child_off);
 
@@ -404,8 +1470,8 @@ bool BPlusTree::InsertIntoInternal(int64_t node_off, key_t key, int64_t child_of
 
     // New internal node.
     char* new_page = AllocPage(new_node_off);
-    InternalPage::Init(new_page);
-    InternalPage new_node(new_page);
+    Internal::Init(new_page);
+    Internal new_node(new_page);
     int right_count = static_cast<int>(keys.size()) - mid - 1;
     new_node.SetNumKeys(right_count);
     for (int j = mid + 1; j < static_cast<int>(keys.size()); ++j) {
@@ -414,142 +1480,332 @@ bool BPlusTree::InsertIntoInternal(int64_t node_off, key_t key, int64_t child_of
     for (int j = mid + 1; j < static_cast<int>(children.size()); ++j) {
         new_node.SetChildAt(j - mid - 1, children[j]);
     }
+    LogPage(new_node_off, new_page);
     UnpinPage(new_node_off, true);
 
     // Write left half.
     page = PinPage(node_off);
-    node = InternalPage(page);
+    node = Internal(page);
     node.SetNumKeys(mid);
     for (int j = 0; j < mid; ++j) {
         node.SetKeyAt(j, keys[j]);
         node.SetChildAt(j, children[j]);
     }
     node.SetChildAt(mid, children[mid]);
+    LogPage(node_off, page);
     UnpinPage(node_off, true);
 
     return true;
 }
 
 // ============================================================================
-// Delete (with rebalancing)
+// Bulk load
 // ============================================================================
 
-Status BPlusTree::Delete(key_t key) {
-    if (root_offset_ == INVALID_PAGE_ID) return Status::NotFound("key not found");
+template <typename Key, typename Compare>
+Status BasicBPlusTree<Key, Compare>::BulkLoad(const BulkLoadSource& next, double fill_factor) {
+    if (!(fill_factor > 0.0 && fill_factor <= 1.0)) {
+        return Status::InvalidArg("bulk load fill factor must be in (0, 1]");
+    }
+
+    std::unique_lock<std::shared_mutex> checkpoint_guard(checkpoint_latch_);
+    std::unique_lock<std::shared_mutex> root_guard(root_latch_);
+    if (root_offset_ != INVALID_PAGE_ID) {
+        return Status::InvalidArg("bulk load needs an empty tree");
+    }
 
-    // Check existence first so we can return NotFound properly.
+    // Nothing below is logged, so records from before the tree became empty
+    // must not survive to be replayed onto the pages about to be reused.
+    if (wal_) CheckpointLocked();
+
+    const size_t leaf_fill = std::clamp(                    // bytes per leaf
+        static_cast<size_t>(fill_factor * Leaf::kCapacity + 0.5),
+        Leaf::kMinUsed, Leaf::kCapacity);
+    const int node_fill = std::clamp(                       // children per node
+        static_cast<int>(fill_factor * (Internal::kMaxKeys + 1) + 0.5),
+        Internal::kMinKeys + 1, Internal::kMaxKeys + 1);
+
+    std::vector<int64_t> pages;                      // everything allocated
+    std::vector<int64_t> chains;                     // overflow values
+    std::vector<std::pair<Key, int64_t>> level;      // (first key, page) per node
+    auto fail = [&](Status st) {
+        for (int64_t off : pages) DeallocPage(off);
+        for (int64_t head : chains) FreeOverflow(head);
+        return st;
+    };
+
+    // -- Leaves: packed left to right, each linked to the next. --------------
+    int64_t          leaf_off = INVALID_PAGE_ID;
+    char*            page     = nullptr;
+    Key              key;
+    std::string_view value;
+    char             cell[Leaf::kMaxCellSize];
+    while (next(key, value)) {
+        if (page) {
+            Leaf leaf(page);
+            if (!less_(leaf.KeyAt(leaf.NumKeys() - 1), key)) {
+                UnpinPage(leaf_off, false);
+                return fail(Status::InvalidArg("bulk load keys must be strictly increasing"));
+            }
+        }
+        Status st = MakeCell(value.data(), value.size(), cell, /*log=*/false);
+        if (!st.ok()) {
+            if (page) UnpinPage(leaf_off, false);
+            return fail(st);
+        }
+        if (Leaf::CellIsOverflow(cell)) chains.push_back(Leaf::CellOverflowHead(cell));
+
+        size_t cell_size = Leaf::CellSizeOf(cell);
+        if (!page || Leaf::kCapacity - Leaf(page).FreeBytes() >= leaf_fill ||
+            !Leaf(page).HasRoom(key, -1, cell_size)) {
+            int64_t new_off;
+            char* new_page = AllocPage(new_off);
+            if (!new_page) {
+                if (page) UnpinPage(leaf_off, false);
+                return fail(Status::IOError("cannot allocate page"));
+            }
+            Leaf::Init(new_page);
+            pages.push_back(new_off);
+            level.emplace_back(key, new_off);
+            if (page) {
+                Leaf(page).SetNextLeaf(new_off);
+                UnpinPage(leaf_off, true);
+            }
+            leaf_off = new_off;
+            page     = new_page;
+        }
+
+        Leaf leaf(page);
+        leaf.InsertAt(leaf.NumKeys(), key, cell);
+        if (filter_) filter_->Add(KeyHash(key));
+    }
+    if (!page) return Status::OK();  // no records
+
+    // The last leaf may be short of the minimum: merge it into its left
+    // neighbour if they fit in one leaf, otherwise move records over from
+    // the neighbour until the two are about even.  Leaves are packed by the
+    // bytes they really take, so with full keys the neighbour can hold more
+    // than a page: the last leaf never takes more than one.
+    Leaf last(page);
+    if (level.size() > 1 && last.UsedBytes() < Leaf::kMinUsed) {
+        int64_t prev_off = level[level.size() - 2].second;
+        Leaf prev(PinPage(prev_off));
+        int pn = prev.NumKeys();
+        int ln = last.NumKeys();
+        if (prev.UsedBytes() + last.UsedBytes() <= Leaf::kCapacity) {
+            prev.AppendFrom(last, 0, ln);
+            prev.SetNextLeaf(INVALID_PAGE_ID);
+            UnpinPage(prev_off, true);
+            UnpinPage(leaf_off, false);
+            DeallocPage(leaf_off);
+            pages.pop_back();
+            level.pop_back();
+            page = nullptr;
+        } else {
+            size_t total = prev.UsedBytes() + last.UsedBytes();
+            size_t moved = last.UsedBytes();
+            int    keep  = pn;
+            while (keep > 1 && 2 * moved + prev.RecordSizeAt(keep - 1) < total &&
+                   moved + prev.RecordSizeAt(keep - 1) <= Leaf::kCapacity) {
+                moved += prev.RecordSizeAt(--keep);
+            }
+            std::vector<char> tail(last.PackedSize(0, ln));
+            last.CopyRecords(0, ln, tail.data());
+            last.Truncate(0);
+            last.AppendFrom(prev, keep, pn - keep);
+            last.AppendRecords(tail.data(), ln);
+            prev.Truncate(keep);
+            level.back().first = last.KeyAt(0);
+            UnpinPage(prev_off, true);
+        }
+    }
+    if (page) UnpinPage(leaf_off, true);
+
+    // -- Internal levels, until a single node is left. ------------------------
+    while (level.size() > 1) {
+        // As few nodes as the fill factor allows, but never so few children
+        // per node that one falls below the minimum; sizes differ by at most
+        // one.
+        size_t n     = level.size();
+        size_t nodes = (n + node_fill - 1) / node_fill;
+        nodes = std::max<size_t>(1, std::min(nodes, n / (Internal::kMinKeys + 1)));
+
+        std::vector<std::pair<Key, int64_t>> parents;
+        parents.reserve(nodes);
+        size_t pos = 0;
+        for (size_t i = 0; i < nodes; ++i) {
+            int count = static_cast<int>(n / nodes + (i < n % nodes ? 1 : 0));
+            assert(count <= Internal::kMaxKeys + 1);
+
+            int64_t off;
+            char* npage = AllocPage(off);
+            if (!npage) return fail(Status::IOError("cannot allocate page"));
+            pages.push_back(off);
+
+            Internal::Init(npage);
+            Internal node(npage);
+            node.SetNumKeys(count - 1);
+            node.SetChildAt(0, level[pos].second);
+            for (int j = 1; j < count; ++j) {
+                node.SetKeyAt(j - 1, level[pos + j].first);
+                node.SetChildAt(j, level[pos + j].second);
+            }
+            UnpinPage(off, true);
+
+            parents.emplace_back(level[pos].first, off);
+            pos += count;
+        }
+        level.swap(parents);
+    }
+
+    // Make the pages durable before the metadata points at them -- there is
+    // no log to redo them from -- then checkpoint so the next change to
+    // each page is logged as a full-page write.
+    pool_->FlushAllPages();
+    disk_->Sync();
+    root_offset_ = level.front().second;
+    WriteMetadata();
+    if (wal_) CheckpointLocked();
+    return Status::OK();
+}
+
+// ============================================================================
+// Delete (with rebalancing)
+// ============================================================================
+
+template <typename Key, typename Compare>
+Status BasicBPlusTree<Key, Compare>::Delete(Key key) {
+    BPTREE_TIME(Histogram::kDelete);
+    std::shared_lock<std::shared_mutex> checkpoint_guard(checkpoint_latch_);
+    // Optimistic pass: enough whenever the leaf cannot underflow.
     {
-        char buf[DATA_SIZE];
-        Status s = Search(key, buf);
-        if (!s.ok()) return Status::NotFound("key not found");
+        int64_t leaf_off;
+        char* page = SearchLeaf(key, LatchMode::kExclusive, leaf_off);
+        if (!page) return Status::NotFound("key not found");
+
+        Leaf leaf(page);
+        int  found  = leaf.Find(key, less_);
+        bool exists = found >= 0;
+        if (!exists || (leaf.NumKeys() > 1 &&
+                        leaf.UsedBytes() - leaf.RecordSizeAt(found) >= leaf_min_used_)) {
+            if (exists) {
+                WriteContext ctx(*this, /*lock_root=*/false);
+                DeleteFromLeaf(ctx, leaf_off, key);
+            }
+            UnpinPage(leaf_off, false, LatchMode::kExclusive);
+            return exists ? Status::OK() : Status::NotFound("key not found");
+        }
+        UnpinPage(leaf_off, false, LatchMode::kExclusive);
     }
 
-    bool underful = DeleteRecursive(root_offset_, key);
+    // Pessimistic pass: exclusive crabbing from the root.
+    WriteContext ctx(*this, /*lock_root=*/true);
+    if (root_offset_ == INVALID_PAGE_ID) return Status::NotFound("key not found");
+
+    bool underful = DeleteRecursive(ctx, root_offset_, key);
+
+    // The key may have been removed by a concurrent writer in between.
+    if (!ctx.found) return Status::NotFound("key not found");
 
     if (underful) {
+        // The root was not safe, so ctx still holds the root latch.
         // Check if root is an empty internal node -- shrink the tree.
         char* page = PinPage(root_offset_);
+        int64_t old_root = root_offset_;
         if (!PageIsLeaf(page)) {
-            InternalPage root(page);
-            if (root.NumKeys() == 0) {
-                int64_t old_root = root_offset_;
-                root_offset_ = root.ChildAt(0);
-                UnpinPage(old_root, false);
-                DeallocPage(old_root);
-                WriteMetadata();
-                return Status::OK();
-            }
+            Internal root(page);
+            if (root.NumKeys() == 0) root_offset_ = root.ChildAt(0);
         } else {
-            LeafPage root(page);
-            if (root.NumKeys() == 0) {
-                int64_t old_root = root_offset_;
-                root_offset_ = INVALID_PAGE_ID;
-                UnpinPage(old_root, false);
-                DeallocPage(old_root);
-                WriteMetadata();
-                return Status::OK();
-            }
+            Leaf root(page);
+            if (root.NumKeys() == 0) root_offset_ = INVALID_PAGE_ID;
+        }
+        UnpinPage(old_root, false);
+
+        if (root_offset_ != old_root) {
+            ctx.freed.push_back(old_root);
+            WriteMetadata();
         }
-        UnpinPage(root_offset_, false);
     }
 
     return Status::OK();
 }
 
-bool BPlusTree::DeleteRecursive(int64_t node_off, key_t key) {
-    char* page = PinPage(node_off);
+template <typename Key, typename Compare>
+bool BasicBPlusTree<Key, Compare>::DeleteRecursive(WriteContext& ctx, int64_t node_off, Key key) {
+    char* page = PinPage(node_off, LatchMode::kExclusive);
+    ctx.path.push_back(node_off);
+
+    // A node above its minimum cannot underflow, so nothing above it will
+    // change.
+    if (SafeForDelete<Key>(page, node_off == ctx.root, leaf_min_used_, internal_min_keys_)) {
+        ReleaseAncestors(ctx);
+    }
 
     if (PageIsLeaf(page)) {
-        UnpinPage(node_off, false);
-        return DeleteFromLeaf(node_off, key);
+        return DeleteFromLeaf(ctx, node_off, key);
     }
 
     // Internal node -- find the child.
-    InternalPage node(page);
-    int n = node.NumKeys();
-    int i = 0;
-    while (i < n && key >= node.KeyAt(i)) ++i;
+    Internal node(page);
+    int     i     = node.ChildIndex(key, less_);
     int64_t child = node.ChildAt(i);
-    UnpinPage(node_off, false);
 
-    bool child_underful = DeleteRecursive(child, key);
+    bool child_underful = DeleteRecursive(ctx, child, key);
 
     if (child_underful) {
-        FixChild(node_off, i);
+        FixChild(ctx, node_off, i);
 
         // Check if this node is now underful.
-        page = PinPage(node_off);
-        InternalPage n2(page);
-        int nk = n2.NumKeys();
-        UnpinPage(node_off, false);
+        int nk = node.NumKeys();
 
         // Root is allowed to have fewer keys.
-        if (node_off == root_offset_) return (nk == 0);
-        return (nk < INTERNAL_MIN_KEYS);
+        if (node_off == ctx.root) return (nk == 0);
+        return (nk < internal_min_keys_);
     }
 
     return false;
 }
 
-bool BPlusTree::DeleteFromLeaf(int64_t leaf_off, key_t key) {
+template <typename Key, typename Compare>
+bool BasicBPlusTree<Key, Compare>::DeleteFromLeaf(WriteContext& ctx, int64_t leaf_off, Key key) {
     char* page = PinPage(leaf_off);
-    LeafPage leaf(page);
+    Leaf leaf(page);
     int n = leaf.NumKeys();
 
-    int found = -1;
-    for (int i = 0; i < n; ++i) {
-        if (leaf.KeyAt(i) == key) { found = i; break; }
-    }
+    int found = leaf.Find(key, less_);
 
     if (found == -1) {
         UnpinPage(leaf_off, false);
-        // Propagate NotFound via a non-underful return so the caller
-        // returns OK only for actual deletes.  We handle it simply by
-        // not modifying anything and returning false (not underful).
+        // Nothing modified; ctx.found stays false so the caller can report
+        // NotFound.
         return false;
     }
-
-    // Shift remaining records left.
-    for (int j = found; j < n - 1; ++j) {
-        int tk; char td[DATA_SIZE];
-        leaf.GetRecord(j + 1, tk, td);
-        leaf.SetRecord(j, tk, td);
-    }
-    leaf.SetNumKeys(n - 1);
+    ctx.found = true;
+
+    if (leaf.IsOverflow(found)) ctx.overflow.push_back(leaf.OverflowHead(found));
+    leaf.RemoveAt(found);
+    SlotLog rec{found};
+    LogChange(leaf_off, page, LogRecordType::kLeafDelete, &rec, sizeof(rec));
+    ctx.drop_lsn = PageLSN(page);
+    bool underful = leaf_off == ctx.root ? n - 1 == 0
+                                         : n - 1 == 0 || leaf.UsedBytes() < leaf_min_used_;
     UnpinPage(leaf_off, true);
-
-    // Is this leaf underful?
-    if (leaf_off == root_offset_) return (n - 1 == 0);
-    return (n - 1 < LEAF_MIN_KEYS);
+    return underful;
 }
 
 // ============================================================================
 // Rebalancing
+//
+// On entry the parent and the underful child are both exclusively latched
+// (they are on ctx.path).  Siblings are latched here and released before
+// returning; pages emptied by a merge are queued on ctx.freed and only
+// deallocated once every latch has been dropped.
 // ============================================================================
 
-void BPlusTree::FixChild(int64_t parent_off, int child_idx) {
+template <typename Key, typename Compare>
+void BasicBPlusTree<Key, Compare>::FixChild(WriteContext& ctx, int64_t parent_off, int child_idx) {
     char* ppage = PinPage(parent_off);
-    InternalPage parent(ppage);
+    Internal parent(ppage);
     int64_t child_off = parent.ChildAt(child_idx);
     UnpinPage(parent_off, false);
 
@@ -558,189 +1814,194 @@ void BPlusTree::FixChild(int64_t parent_off, int child_idx) {
     UnpinPage(child_off, false);
 
     if (child_is_leaf) {
-        FixLeafChild(parent_off, child_idx);
+        FixLeafChild(ctx, parent_off, child_idx);
     } else {
-        FixInternalChild(parent_off, child_idx);
+        FixInternalChild(ctx, parent_off, child_idx);
     }
 }
 
-void BPlusTree::FixLeafChild(int64_t parent_off, int child_idx) {
+template <typename Key, typename Compare>
+void BasicBPlusTree<Key, Compare>::FixLeafChild(WriteContext& ctx, int64_t parent_off, int child_idx) {
     char* ppage = PinPage(parent_off);
-    InternalPage parent(ppage);
+    Internal parent(ppage);
     int parent_keys = parent.NumKeys();
     int64_t child_off = parent.ChildAt(child_idx);
 
-    // Try to borrow from left sibling.
+    // Leaves are latched left to right -- the order range scans crab in --
+    // so the child is let go while its left sibling is taken.  Nobody can
+    // modify the child meanwhile: writers need the parent to reach it.
+    int64_t left_off = INVALID_PAGE_ID;
+    char* lpage = nullptr;
     if (child_idx > 0) {
-        int64_t left_off = parent.ChildAt(child_idx - 1);
-        UnpinPage(parent_off, false);
-
-        char* lpage = PinPage(left_off);
-        LeafPage left(lpage);
-        int left_n = left.NumKeys();
+        left_off = parent.ChildAt(child_idx - 1);
+        UnpinPage(child_off, false, LatchMode::kExclusive);
+        lpage = PinPage(left_off, LatchMode::kExclusive);
+        PinPage(child_off, LatchMode::kExclusive);
+    }
 
-        if (left_n > LEAF_MIN_KEYS) {
-            // Borrow the last record from left sibling.
-            int tk; char td[DATA_SIZE];
-            left.GetRecord(left_n - 1, tk, td);
-            left.SetNumKeys(left_n - 1);
-            UnpinPage(left_off, true);
+    char* cpage = PinPage(child_off);
+    Leaf child(cpage);
+    int cn = child.NumKeys();
+
+    // A sibling can lend its boundary record if it stays at the minimum
+    // (and not empty).  Records differ in size, so the child may take
+    // several to get there.
+    char cell[Leaf::kMaxCellSize];
+    auto can_lend = [this](const Leaf& sibling, int slot) {
+        return sibling.NumKeys() > 1 &&
+               sibling.UsedBytes() - sibling.RecordSizeAt(slot) >= leaf_min_used_;
+    };
+    auto underful = [this](const Leaf& leaf) {
+        return leaf.NumKeys() == 0 || leaf.UsedBytes() < leaf_min_used_;
+    };
 
-            // Insert at the front of child.
-            char* cpage = PinPage(child_off);
-            LeafPage child(cpage);
-            int cn = child.NumKeys();
-            // Shift right.
-            for (int j = cn - 1; j >= 0; --j) {
-                int k2; char d2[DATA_SIZE];
-                child.GetRecord(j, k2, d2);
-                child.SetRecord(j + 1, k2, d2);
-            }
-            child.SetRecord(0, tk, td);
-            child.SetNumKeys(cn + 1);
-            UnpinPage(child_off, true);
+    // Try to borrow from left sibling.
+    if (lpage) {
+        Leaf left(lpage);
+
+        if (can_lend(left, left.NumKeys() - 1)) {
+            // Borrow the last records from left sibling.
+            do {
+                int last = left.NumKeys() - 1;
+                Key tk = left.KeyAt(last);
+                std::memcpy(cell, left.CellAt(last), left.CellSize(last));
+                left.RemoveAt(last);
+                SlotLog del{last};
+                LogChange(left_off, lpage, LogRecordType::kLeafDelete, &del, sizeof(del));
+
+                // Insert at the front of child.
+                child.InsertAt(0, tk, cell);
+                LogLeafSlot(child_off, cpage, LogRecordType::kLeafInsert, 0);
+            } while (underful(child) && can_lend(left, left.NumKeys() - 1));
+            BPTREE_COUNT(Counter::kLeafRedistributions);
 
             // Update parent key.
-            ppage = PinPage(parent_off);
-            InternalPage p2(ppage);
-            p2.SetKeyAt(child_idx - 1, tk);
+            parent.SetKeyAt(child_idx - 1, child.KeyAt(0));
+            BasicInternalSlotLog<Key> key_rec = InternalSlot(parent, child_idx - 1);
+            LogChange(parent_off, ppage, LogRecordType::kInternalSetKey,
+                      &key_rec, sizeof(key_rec));
+
+            UnpinPage(left_off, true, LatchMode::kExclusive);
+            UnpinPage(child_off, true);
             UnpinPage(parent_off, true);
             return;
         }
-        UnpinPage(left_off, false);
-    } else {
-        UnpinPage(parent_off, false);
     }
 
     // Try to borrow from right sibling.
-    ppage = PinPage(parent_off);
-    parent = InternalPage(ppage);
+    int64_t right_off = INVALID_PAGE_ID;
+    char* rpage = nullptr;
     if (child_idx < parent_keys) {
-        int64_t right_off = parent.ChildAt(child_idx + 1);
-        UnpinPage(parent_off, false);
-
-        char* rpage = PinPage(right_off);
-        LeafPage right(rpage);
-        int right_n = right.NumKeys();
-
-        if (right_n > LEAF_MIN_KEYS) {
-            // Borrow the first record from right sibling.
-            int tk; char td[DATA_SIZE];
-            right.GetRecord(0, tk, td);
-            // Shift left in right.
-            for (int j = 0; j < right_n - 1; ++j) {
-                int k2; char d2[DATA_SIZE];
-                right.GetRecord(j + 1, k2, d2);
-                right.SetRecord(j, k2, d2);
-            }
-            right.SetNumKeys(right_n - 1);
-            // New first key of right.
-            int new_right_first = right.KeyAt(0);
-            UnpinPage(right_off, true);
-
-            // Append to child.
-            char* cpage = PinPage(child_off);
-            LeafPage child(cpage);
-            int cn = child.NumKeys();
-            child.SetRecord(cn, tk, td);
-            child.SetNumKeys(cn + 1);
+        right_off = parent.ChildAt(child_idx + 1);
+        rpage = PinPage(right_off, LatchMode::kExclusive);
+        Leaf right(rpage);
+
+        if (can_lend(right, 0)) {
+            // Borrow the first records from right sibling.
+            do {
+                Key tk = right.KeyAt(0);
+                std::memcpy(cell, right.CellAt(0), right.CellSize(0));
+                right.RemoveAt(0);
+                SlotLog del{0};
+                LogChange(right_off, rpage, LogRecordType::kLeafDelete, &del, sizeof(del));
+
+                // Append to child.
+                int end = child.NumKeys();
+                child.InsertAt(end, tk, cell);
+                LogLeafSlot(child_off, cpage, LogRecordType::kLeafInsert, end);
+            } while (underful(child) && can_lend(right, 0));
+            BPTREE_COUNT(Counter::kLeafRedistributions);
+
+            // Update parent key to the new first key of right.
+            parent.SetKeyAt(child_idx, right.KeyAt(0));
+            BasicInternalSlotLog<Key> key_rec = InternalSlot(parent, child_idx);
+            LogChange(parent_off, ppage, LogRecordType::kInternalSetKey,
+                      &key_rec, sizeof(key_rec));
+
+            if (lpage) UnpinPage(left_off, false, LatchMode::kExclusive);
+            UnpinPage(right_off, true, LatchMode::kExclusive);
             UnpinPage(child_off, true);
-
-            // Update parent key.
-            ppage = PinPage(parent_off);
-            InternalPage p2(ppage);
-            p2.SetKeyAt(child_idx, new_right_first);
             UnpinPage(parent_off, true);
             return;
         }
-        UnpinPage(right_off, false);
-    } else {
-        UnpinPage(parent_off, false);
     }
 
-    // Cannot borrow -- merge.
+    // Cannot borrow -- merge.  The child is below the minimum and the
+    // sibling below it plus one record, so the two fit in one leaf.
     // Always merge child into its left sibling if possible, otherwise
     // merge right sibling into child.
-    ppage = PinPage(parent_off);
-    parent = InternalPage(ppage);
-
-    int64_t left_off, right_off;
+    BPTREE_COUNT(Counter::kLeafMerges);
     int merge_key_idx;
-
-    if (child_idx > 0) {
-        // Merge child into left sibling.
-        left_off = parent.ChildAt(child_idx - 1);
-        right_off = child_off;
+    if (lpage) {
+        Leaf left(lpage);
+        assert(left.UsedBytes() + child.UsedBytes() <= Leaf::kCapacity);
+        left.AppendFrom(child, 0, cn);
+        left.SetNextLeaf(child.NextLeaf());
+        std::vector<char> rec = LeafMerge(left, cn);
+        LogChange(left_off, lpage, LogRecordType::kLeafMerge, rec.data(),
+                  static_cast<uint32_t>(rec.size()));
         merge_key_idx = child_idx - 1;
+
+        UnpinPage(left_off, true, LatchMode::kExclusive);
+        if (rpage) UnpinPage(right_off, false, LatchMode::kExclusive);
+        UnpinPage(child_off, false);
+        ctx.freed.push_back(child_off);
     } else {
-        // Merge right sibling into child.
-        left_off = child_off;
-        right_off = parent.ChildAt(child_idx + 1);
+        Leaf right(rpage);
+        int rn = right.NumKeys();
+        assert(child.UsedBytes() + right.UsedBytes() <= Leaf::kCapacity);
+        child.AppendFrom(right, 0, rn);
+        child.SetNextLeaf(right.NextLeaf());
+        std::vector<char> rec = LeafMerge(child, rn);
+        LogChange(child_off, cpage, LogRecordType::kLeafMerge, rec.data(),
+                  static_cast<uint32_t>(rec.size()));
         merge_key_idx = child_idx;
-    }
-    UnpinPage(parent_off, false);
 
-    // Copy all records from right into left.
-    char* lpage = PinPage(left_off);
-    LeafPage left(lpage);
-    int ln = left.NumKeys();
-
-    char* rpage = PinPage(right_off);
-    LeafPage right(rpage);
-    int rn = right.NumKeys();
-
-    for (int j = 0; j < rn; ++j) {
-        int tk; char td[DATA_SIZE];
-        right.GetRecord(j, tk, td);
-        left.SetRecord(ln + j, tk, td);
+        UnpinPage(right_off, false, LatchMode::kExclusive);
+        UnpinPage(child_off, true);
+        ctx.freed.push_back(right_off);
     }
-    left.SetNumKeys(ln + rn);
-    left.SetNextLeaf(right.NextLeaf());
-
-    UnpinPage(left_off, true);
-    UnpinPage(right_off, false);
-    DeallocPage(right_off);
 
     // Remove merge_key_idx from parent.
-    ppage = PinPage(parent_off);
-    parent = InternalPage(ppage);
-    int pn = parent.NumKeys();
-    for (int j = merge_key_idx; j < pn - 1; ++j) {
-        parent.SetKeyAt(j, parent.KeyAt(j + 1));
-        parent.SetChildAt(j + 1, parent.ChildAt(j + 2));
-    }
-    parent.SetNumKeys(pn - 1);
+    parent.RemoveAt(merge_key_idx);
+    SlotLog del{merge_key_idx};
+    LogChange(parent_off, ppage, LogRecordType::kInternalDelete, &del, sizeof(del));
+    ctx.drop_lsn = PageLSN(ppage);
     UnpinPage(parent_off, true);
 }
 
-void BPlusTree::FixInternalChild(int64_t parent_off, int child_idx) {
+template <typename Key, typename Compare>
+void BasicBPlusTree<Key, Compare>::FixInternalChild(WriteContext& ctx, int64_t parent_off, int child_idx) {
     char* ppage = PinPage(parent_off);
-    InternalPage parent(ppage);
+    Internal parent(ppage);
     int parent_keys = parent.NumKeys();
     int64_t child_off = parent.ChildAt(child_idx);
 
+    char* cpage = PinPage(child_off);
+    Internal child(cpage);
+    int cn = child.NumKeys();
+
+    // Internal siblings are only reachable through the parent we hold, so
+    // they can be latched in any order.
+    int64_t left_off = INVALID_PAGE_ID;
+    char* lpage = nullptr;
+
     // Try to borrow from left sibling.
     if (child_idx > 0) {
-        int64_t left_off = parent.ChildAt(child_idx - 1);
-        int parent_key = parent.KeyAt(child_idx - 1);
-        UnpinPage(parent_off, false);
+        left_off = parent.ChildAt(child_idx - 1);
+        Key parent_key = parent.KeyAt(child_idx - 1);
 
-        char* lpage = PinPage(left_off);
-        InternalPage left(lpage);
+        lpage = PinPage(left_off, LatchMode::kExclusive);
+        Internal left(lpage);
         int left_n = left.NumKeys();
 
-        if (left_n > INTERNAL_MIN_KEYS) {
+        if (left_n > internal_min_keys_) {
             // Borrow: take the last key from left, push parent key down to child.
-            int borrowed_key = left.KeyAt(left_n - 1);
+            Key borrowed_key = left.KeyAt(left_n - 1);
             int64_t borrowed_child = left.ChildAt(left_n);
             left.SetNumKeys(left_n - 1);
-            UnpinPage(left_off, true);
 
             // Prepend parent_key + borrowed_child to child.
-            char* cpage = PinPage(child_off);
-            InternalPage child(cpage);
-            int cn = child.NumKeys();
-            // Shift right.
             for (int j = cn - 1; j >= 0; --j) {
                 child.SetKeyAt(j + 1, child.KeyAt(j));
                 child.SetChildAt(j + 2, child.ChildAt(j + 1));
@@ -749,34 +2010,38 @@ void BPlusTree::FixInternalChild(int64_t parent_off, int child_idx) {
             child.SetKeyAt(0, parent_key);
             child.SetChildAt(0, borrowed_child);
             child.SetNumKeys(cn + 1);
-            UnpinPage(child_off, true);
 
             // Replace parent key with borrowed key.
-            ppage = PinPage(parent_off);
-            InternalPage p2(ppage);
-            p2.SetKeyAt(child_idx - 1, borrowed_key);
+            parent.SetKeyAt(child_idx - 1, borrowed_key);
+            BPTREE_COUNT(Counter::kInternalRedistributions);
+
+            // Rebalancing internal nodes is rare; log the siblings whole.
+            LogPage(left_off, lpage);
+            LogPage(child_off, cpage);
+            BasicInternalSlotLog<Key> key_rec = InternalSlot(parent, child_idx - 1);
+            LogChange(parent_off, ppage, LogRecordType::kInternalSetKey,
+                      &key_rec, sizeof(key_rec));
+
+            UnpinPage(left_off, true, LatchMode::kExclusive);
+            UnpinPage(child_off, true);
             UnpinPage(parent_off, true);
             return;
         }
-        UnpinPage(left_off, false);
-    } else {
-        UnpinPage(parent_off, false);
     }
 
     // Try to borrow from right sibling.
-    ppage = PinPage(parent_off);
-    parent = InternalPage(ppage);
+    int64_t right_off = INVALID_PAGE_ID;
+    char* rpage = nullptr;
     if (child_idx < parent_keys) {
-        int64_t right_off = parent.ChildAt(child_idx + 1);
-        int parent_key = parent.KeyAt(child_idx);
-        UnpinPage(parent_off, false);
+        right_off = parent.ChildAt(child_idx + 1);
+        Key parent_key = parent.KeyAt(child_idx);
 
-        char* rpage = PinPage(right_off);
-        InternalPage right(rpage);
+        rpage = PinPage(right_off, LatchMode::kExclusive);
+        Internal right(rpage);
         int right_n = right.NumKeys();
 
-        if (right_n > INTERNAL_MIN_KEYS) {
-            int borrowed_key = right.KeyAt(0);
+        if (right_n > internal_min_keys_) {
+            Key borrowed_key = right.KeyAt(0);
             int64_t borrowed_child = right.ChildAt(0);
             // Shift left in right.
             for (int j = 0; j < right_n - 1; ++j) {
@@ -785,55 +2050,46 @@ void BPlusTree::FixInternalChild(int64_t parent_off, int child_idx) {
             }
             right.SetChildAt(right_n - 1, right.ChildAt(right_n));
             right.SetNumKeys(right_n - 1);
-            UnpinPage(right_off, true);
 
             // Append parent_key + borrowed_child to child.
-            char* cpage = PinPage(child_off);
-            InternalPage child(cpage);
-            int cn = child.NumKeys();
             child.SetKeyAt(cn, parent_key);
             child.SetChildAt(cn + 1, borrowed_child);
             child.SetNumKeys(cn + 1);
-            UnpinPage(child_off, true);
 
             // Replace parent key with borrowed key.
-            ppage = PinPage(parent_off);
-            InternalPage p2(ppage);
-            p2.SetKeyAt(child_idx, borrowed_key);
+            parent.SetKeyAt(child_idx, borrowed_key);
+            BPTREE_COUNT(Counter::kInternalRedistributions);
+
+            LogPage(right_off, rpage);
+            LogPage(child_off, cpage);
+            BasicInternalSlotLog<Key> key_rec = InternalSlot(parent, child_idx);
+            LogChange(parent_off, ppage, LogRecordType::kInternalSetKey,
+                      &key_rec, sizeof(key_rec));
+
+            if (lpage) UnpinPage(left_off, false, LatchMode::kExclusive);
+            UnpinPage(right_off, true, LatchMode::kExclusive);
+            UnpinPage(child_off, true);
             UnpinPage(parent_off, true);
             return;
         }
-        UnpinPage(right_off, false);
-    } else {
-        UnpinPage(parent_off, false);
     }
 
-    // Cannot borrow -- merge.
-    ppage = PinPage(parent_off);
-    parent = InternalPage(ppage);
-
-    int64_t left_off, right_off;
+    // Cannot borrow -- merge: left + merge_key + right -> left.
+    BPTREE_COUNT(Counter::kInternalMerges);
     int merge_key_idx;
-
-    if (child_idx > 0) {
-        left_off = parent.ChildAt(child_idx - 1);
-        right_off = child_off;
+    int64_t dead_off;
+    Internal left(lpage ? lpage : cpage);
+    Internal right(lpage ? cpage : rpage);
+    if (lpage) {
         merge_key_idx = child_idx - 1;
+        dead_off = child_off;
     } else {
-        left_off = child_off;
-        right_off = parent.ChildAt(child_idx + 1);
         merge_key_idx = child_idx;
+        dead_off = right_off;
     }
-    int merge_key = parent.KeyAt(merge_key_idx);
-    UnpinPage(parent_off, false);
+    Key merge_key = parent.KeyAt(merge_key_idx);
 
-    // Merge: left + merge_key + right -> left.
-    char* lpage = PinPage(left_off);
-    InternalPage left(lpage);
     int ln = left.NumKeys();
-
-    char* rpage = PinPage(right_off);
-    InternalPage right(rpage);
     int rn = right.NumKeys();
 
     // Append merge_key.
@@ -846,21 +2102,190 @@ void BPlusTree::FixInternalChild(int64_t parent_off, int child_idx) {
         left.SetChildAt(ln + 2 + j, right.ChildAt(j + 1));
     }
     left.SetNumKeys(ln + 1 + rn);
+    LogPage(lpage ? left_off : child_off, lpage ? lpage : cpage);
 
-    UnpinPage(left_off, true);
-    UnpinPage(right_off, false);
-    DeallocPage(right_off);
+    if (lpage) UnpinPage(left_off, true, LatchMode::kExclusive);
+    if (rpage) UnpinPage(right_off, false, LatchMode::kExclusive);
+    UnpinPage(child_off, lpage == nullptr);
+    ctx.freed.push_back(dead_off);
 
     // Remove merge_key_idx from parent.
-    ppage = PinPage(parent_off);
-    parent = InternalPage(ppage);
-    int pn = parent.NumKeys();
-    for (int j = merge_key_idx; j < pn - 1; ++j) {
-        parent.SetKeyAt(j, parent.KeyAt(j + 1));
-        parent.SetChildAt(j + 1, parent.ChildAt(j + 2));
-    }
-    parent.SetNumKeys(pn - 1);
+    parent.RemoveAt(merge_key_idx);
+    SlotLog del{merge_key_idx};
+    LogChange(parent_off, ppage, LogRecordType::kInternalDelete, &del, sizeof(del));
+    ctx.drop_lsn = PageLSN(ppage);
     UnpinPage(parent_off, true);
 }
 
+// ============================================================================
+// Compaction
+// ============================================================================
+
+template <typename Key, typename Compare>
+Status BasicBPlusTree<Key, Compare>::Compact() {
+    // Writers and pessimistic descents wait; optimistic readers and cursors
+    // keep going, as they do across splits and merges.
+    std::unique_lock<std::shared_mutex> checkpoint_guard(checkpoint_latch_);
+    std::unique_lock<std::shared_mutex> root_guard(root_latch_);
+
+    // Walk the tree: internal levels top-down, the leaves in key order,
+    // then the overflow chains.  Each page's references are kept with it.
+    std::vector<int64_t> live;
+    std::vector<std::pair<int64_t, int64_t>> refs;  // (page, page it refers to)
+    std::vector<int64_t> chains;
+    auto refer = [&](int64_t from, int64_t to) {
+        if (to >= static_cast<int64_t>(PAGE_SIZE)) refs.emplace_back(from, to);
+    };
+    std::vector<int64_t> level;
+    if (root_offset_ != INVALID_PAGE_ID) level.push_back(root_offset_);
+    while (!level.empty()) {
+        std::vector<int64_t> below;
+        for (int64_t off : level) {
+            char* page = PinPage(off, LatchMode::kShared);
+            if (!page) return Status::IOError("cannot pin page");
+            live.push_back(off);
+            if (!PageIsLeaf(page)) {
+                Internal node(page);
+                for (int i = 0; i <= node.NumKeys(); ++i) {
+                    below.push_back(node.ChildAt(i));
+                    refer(off, node.ChildAt(i));
+                }
+            } else {
+                Leaf leaf(page);
+                refer(off, leaf.NextLeaf());
+                for (int i = 0; i < leaf.NumKeys(); ++i) {
+                    if (!leaf.IsOverflow(i)) continue;
+                    chains.push_back(leaf.OverflowHead(i));
+                    refer(off, leaf.OverflowHead(i));
+                }
+            }
+            UnpinPage(off, false, LatchMode::kShared);
+        }
+        level = std::move(below);
+    }
+    for (int64_t off : chains) {
+        while (off >= static_cast<int64_t>(PAGE_SIZE)) {
+            char* page = PinPage(off, LatchMode::kShared);
+            if (!page) return Status::IOError("cannot pin page");
+            live.push_back(off);
+            int64_t next = OverflowPage(page).NextPage();
+            refer(off, next);
+            UnpinPage(off, false, LatchMode::kShared);
+            off = next;
+        }
+    }
+
+    // Live pages past the boundary move to the free slots below it, taken
+    // in walk order, so each level and the leaf chain end up ascending.
+    const int64_t end      = disk_->NextPageOffset();
+    const int64_t boundary = static_cast<int64_t>((live.size() + 1) * PAGE_SIZE);
+    if (boundary >= end) return Status::OK();
+
+    std::vector<int64_t> moved(static_cast<size_t>(end) / PAGE_SIZE, INVALID_PAGE_ID);
+    std::vector<bool>    in_use(static_cast<size_t>(boundary) / PAGE_SIZE, false);
+    std::vector<int64_t> movers;
+    for (int64_t off : live) {
+        if (off < boundary) in_use[static_cast<size_t>(off) / PAGE_SIZE] = true;
+        else movers.push_back(off);
+    }
+    size_t slot = 1;
+    for (int64_t off : movers) {
+        while (in_use[slot]) ++slot;
+        moved[static_cast<size_t>(off) / PAGE_SIZE] = static_cast<int64_t>(slot++ * PAGE_SIZE);
+    }
+    auto moves = [&](int64_t off) {
+        return off >= static_cast<int64_t>(PAGE_SIZE) &&
+               moved[static_cast<size_t>(off) / PAGE_SIZE] != INVALID_PAGE_ID;
+    };
+
+    // Every page off the tree is either a slot about to be filled or past
+    // the new end.  Forget the free list first: a crash from here on can
+    // only leak pages.
+    disk_->SetFreeListHead(INVALID_PAGE_ID);
+    disk_->FlushMetadata();
+
+    // Copy each mover to its slot, already pointing at the new places.
+    for (int64_t off : movers) {
+        int64_t to = moved[static_cast<size_t>(off) / PAGE_SIZE];
+        char* src = PinPage(off, LatchMode::kShared);
+        if (!src) return Status::IOError("cannot pin page");
+        char* dst = PinPage(to, LatchMode::kExclusive);
+        if (!dst) {
+            UnpinPage(off, false, LatchMode::kShared);
+            return Status::IOError("cannot pin page");
+        }
+        std::memcpy(dst, src, PAGE_SIZE);
+        UnpinPage(off, false, LatchMode::kShared);
+        RemapReferences(dst, moved);
+        LogPage(to, dst);
+        UnpinPage(to, true, LatchMode::kExclusive);
+    }
+
+    // Point the pages that stay at the copies, in walk order.  The old
+    // copies are pointed there too, for readers still on them, but only in
+    // memory: they are dropped below, unlogged.
+    std::vector<int64_t> relink;
+    for (const auto& [from, to] : refs) {
+        if (moves(to) && !moves(from) && (relink.empty() || relink.back() != from)) {
+            relink.push_back(from);
+        }
+    }
+    for (int64_t off : relink) {
+        char* page = PinPage(off, LatchMode::kExclusive);
+        if (!page) return Status::IOError("cannot pin page");
+        RemapReferences(page, moved);
+        LogPage(off, page);
+        UnpinPage(off, true, LatchMode::kExclusive);
+    }
+    for (int64_t off : movers) {
+        char* page = PinPage(off, LatchMode::kExclusive);
+        if (!page) return Status::IOError("cannot pin page");
+        RemapReferences(page, moved);
+        UnpinPage(off, true, LatchMode::kExclusive);
+    }
+
+    // Make the new layout durable before the root moves into it.
+    if (wal_) CheckpointLocked();
+    else pool_->FlushAllPages();
+    if (moves(root_offset_)) {
+        root_offset_ = moved[static_cast<size_t>(root_offset_.load()) / PAGE_SIZE];
+        WriteMetadata();
+    }
+
+    // Nothing refers to the old copies now; wait for the readers still on
+    // them, then cut the file.
+    for (int64_t off : movers) {
+        while (!pool_->DeletePage(off)) std::this_thread::yield();
+    }
+    while (!pool_->Truncate(boundary)) std::this_thread::yield();
+    disk_->Sync();
+    return Status::OK();
+}
+
+template <typename Key, typename Compare>
+void BasicBPlusTree<Key, Compare>::RemapReferences(char* page,
+                                                   const std::vector<int64_t>& moved) const {
+    auto remap = [&](int64_t off) {
+        if (off < static_cast<int64_t>(PAGE_SIZE)) return off;
+        size_t idx = static_cast<size_t>(off) / PAGE_SIZE;
+        return idx < moved.size() && moved[idx] != INVALID_PAGE_ID ? moved[idx] : off;
+    };
+    if (PageType(page) == PAGE_TYPE_OVERFLOW) {
+        OverflowPage chain(page);
+        chain.SetNextPage(remap(chain.NextPage()));
+    } else if (!PageIsLeaf(page)) {
+        Internal node(page);
+        for (int i = 0; i <= node.NumKeys(); ++i) node.SetChildAt(i, remap(node.ChildAt(i)));
+    } else {
+        Leaf leaf(page);
+        leaf.SetNextLeaf(remap(leaf.NextLeaf()));
+        for (int i = 0; i < leaf.NumKeys(); ++i) {
+            if (leaf.IsOverflow(i)) leaf.SetOverflowHead(i, remap(leaf.OverflowHead(i)));
+        }
+    }
+}
+
+template class BasicBPlusTree<int32_t>;
+template class BasicBPlusTree<int64_t>;
+
 }  // namespace bptree
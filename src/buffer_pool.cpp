@@ -1,29 +1,94 @@
 /// @file buffer_pool.cpp
-/// @brief LRU buffer pool implementation.
+/// @brief Sharded buffer pool implementation.
 
 #include "bptree/buffer_pool.h"
+#include "bptree/metrics.h"
+#include "bptree/page.h"
 #include "bptree/wal.h"
 
+#include <algorithm>
 #include <cassert>
+#include <chrono>
+#include <cmath>
 #include <cstring>
 
 namespace bptree {
 
+namespace {
+
+/// Make a frame's version odd before its data changes.  The fence keeps
+/// the data stores after it, for a reader that validates with an acquire
+/// fence.  A frame claimed but not published stays odd.
+void BeginChange(PageFrame& f) {
+    f.version.fetch_or(1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+}
+
+/// Make it even again, publishing the data stores before it.
+void EndChange(PageFrame& f) {
+    f.version.fetch_add(1, std::memory_order_release);
+}
+
+}  // namespace
+
 // ============================================================================
 // Construction / destruction
 // ============================================================================
 
-BufferPool::BufferPool(DiskManager& disk, size_t pool_size)
-    : disk_(disk), pool_size_(pool_size), frames_(pool_size)
+BufferPool::Shard::Shard(int b, int e, ReplacementPolicy policy)
+    : begin(b), end(e), table(static_cast<size_t>(e - b)),
+      replacer(MakeReplacer(policy, static_cast<size_t>(e - b)))
 {
     // All frames start on the free list.
-    free_list_.reserve(pool_size);
-    for (int i = static_cast<int>(pool_size) - 1; i >= 0; --i) {
-        free_list_.push_back(i);
+    free_list.reserve(static_cast<size_t>(e - b));
+    for (int i = e - 1; i >= b; --i) free_list.push_back(i);
+}
+
+BufferPool::BufferPool(DiskManager& disk, size_t pool_size, size_t num_shards,
+                       ReplacementPolicy policy, HugePages huge_pages, bool numa)
+    : disk_(disk), pool_size_(pool_size), policy_(policy), frames_(pool_size),
+      arena_(pool_size, huge_pages)
+{
+    assert(pool_size <= static_cast<size_t>(PageTable::kMaxFrames));
+
+    for (size_t i = 0; i < pool_size; ++i) frames_[i].data = arena_.Frame(i);
+
+    num_shards = std::min(num_shards, pool_size / kMinFramesPerShard);
+    num_shards = std::max<size_t>(num_shards, 1);
+
+    // Contiguous frame ranges; the first (pool_size % n) shards get one extra.
+    size_t per   = pool_size / num_shards;
+    size_t extra = pool_size % num_shards;
+    int begin = 0;
+    for (size_t i = 0; i < num_shards; ++i) {
+        int end = begin + static_cast<int>(per + (i < extra ? 1 : 0));
+        shards_.push_back(std::make_unique<Shard>(begin, end, policy));
+        begin = end;
+    }
+
+    // The arena is untouched so far, so each shard's frames are first
+    // faulted in on its node.
+    std::vector<int> nodes = numa ? FrameArena::NumaNodes() : std::vector<int>{};
+    if (nodes.size() > 1) {
+        for (size_t i = 0; i < shards_.size(); ++i) {
+            Shard& s = *shards_[i];
+            int node = nodes[i % nodes.size()];
+            if (arena_.BindToNode(static_cast<size_t>(s.begin), static_cast<size_t>(s.end), node)) {
+                s.numa_node = node;
+            }
+        }
     }
 }
 
 BufferPool::~BufferPool() {
+    {
+        std::lock_guard<std::mutex> guard(prefetch_latch_);
+        prefetch_stop_ = true;
+    }
+    prefetch_cv_.notify_one();
+    if (prefetcher_.joinable()) prefetcher_.join();
+
+    StopCleaner();
     FlushAllPages();
 }
 
@@ -31,120 +96,672 @@ BufferPool::~BufferPool() {
 // FetchPage
 // ============================================================================
 
-char* BufferPool::FetchPage(int64_t page_id) {
+char* BufferPool::FetchPage(int64_t page_id, LatchMode mode) {
     assert(page_id >= 0);
 
-    // Already in pool?
-    auto it = page_table_.find(page_id);
-    if (it != page_table_.end()) {
-        ++hits_;
-        int idx = it->second;
-        PageFrame& f = frames_[idx];
-        ++f.pin_count;
-        // If it was in the LRU (unpinned), remove it (pinned pages are not
-        // eviction candidates).
-        auto lru_it = lru_map_.find(idx);
-        if (lru_it != lru_map_.end()) {
-            lru_list_.erase(lru_it->second);
-            lru_map_.erase(lru_it);
+    Shard& s = ShardFor(page_id);
+    PageFrame* f = PinResident(s, page_id);
+    if (f) {
+        s.hits.fetch_add(1, std::memory_order_relaxed);
+        s.replacer->RecordAccess(static_cast<int>(f - frames_.data()) - s.begin);
+    } else {
+        auto guard = LockShard(s);
+        f = PinFrame(s, page_id);
+    }
+    if (!f) return nullptr;
+    if (f->prefetched.load(std::memory_order_relaxed) &&
+        f->prefetched.exchange(false, std::memory_order_relaxed)) {
+        s.prefetch_hits.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    // The pin keeps the frame resident, so the latch can be taken after the
+    // shard latch is released.
+    Latch(*f, mode);
+    return f->data;
+}
+
+bool BufferPool::ReadOptimistic(int64_t page_id, OptimisticPage& page) const {
+    const Shard& s = ShardFor(page_id);
+    int idx = s.table.Find(page_id);
+    if (idx < 0) return false;
+
+    const PageFrame& f = frames_[idx];
+    uint64_t version = f.version.load(std::memory_order_acquire);
+    if ((version & 1) != 0 || f.page_id.load(std::memory_order_acquire) != page_id) {
+        return false;
+    }
+    s.replacer->RecordAccess(idx - s.begin);
+    page = {f.data, &f, page_id, version};
+    return true;
+}
+
+bool BufferPool::Validate(const OptimisticPage& page) const {
+    // Order the reads of the page before the version check; a writer
+    // that started since has made the version odd (or moved it on).
+    std::atomic_thread_fence(std::memory_order_acquire);
+    return page.frame->version.load(std::memory_order_relaxed) == page.version &&
+           page.frame->page_id.load(std::memory_order_relaxed) == page.page_id;
+}
+
+// ============================================================================
+// Pointer swizzling
+// ============================================================================
+
+void BufferPool::EnableSwizzling(size_t children_per_page) {
+    size_t tables = std::max<size_t>(pool_size_ / kFramesPerSwizzleTable, 1);
+    swizzle_hints_.reset(new std::atomic<uint32_t>[tables * children_per_page]);
+    for (size_t i = 0; i < tables * children_per_page; ++i) {
+        swizzle_hints_[i].store(0, std::memory_order_relaxed);
+    }
+    swizzle_free_.clear();
+    for (size_t t = tables; t-- > 0;) swizzle_free_.push_back(static_cast<int32_t>(t));
+    swizzle_slots_ = children_per_page;
+}
+
+bool BufferPool::ReadChildOptimistic(const OptimisticPage& parent, int slot, int64_t child,
+                                     OptimisticPage& page) {
+    if (swizzle_slots_ == 0 || slot < 0 || static_cast<size_t>(slot) >= swizzle_slots_) {
+        return ReadOptimistic(child, page);
+    }
+
+    // The parent is only read, so its frame metadata may be changed here.
+    auto& pf = const_cast<PageFrame&>(*parent.frame);
+    int32_t table = pf.swizzle.load(std::memory_order_acquire);
+    std::atomic<uint32_t>* hint = nullptr;
+    if (table >= 0) {
+        hint = &swizzle_hints_[static_cast<size_t>(table) * swizzle_slots_ + slot];
+        uint32_t frame = hint->load(std::memory_order_relaxed);
+        if (frame != 0 && frame <= pool_size_) {
+            const PageFrame& f = frames_[frame - 1];
+            uint64_t version = f.version.load(std::memory_order_acquire);
+            if ((version & 1) == 0 && f.page_id.load(std::memory_order_acquire) == child) {
+                const Shard& s = ShardFor(child);
+                s.replacer->RecordAccess(static_cast<int>(frame - 1) - s.begin);
+                page = {f.data, &f, child, version};
+                return true;
+            }
         }
-        return f.data;
     }
 
-    // Cache miss -- need a free frame.
-    ++misses_;
-    int frame_idx = -1;
+    if (!ReadOptimistic(child, page)) return false;
+    if (!hint) {
+        table = AttachSwizzle(pf);
+        if (table < 0) return true;
+        hint = &swizzle_hints_[static_cast<size_t>(table) * swizzle_slots_ + slot];
+    }
+    hint->store(static_cast<uint32_t>(page.frame - frames_.data()) + 1,
+                std::memory_order_relaxed);
+    return true;
+}
 
-    if (!free_list_.empty()) {
-        frame_idx = free_list_.back();
-        free_list_.pop_back();
-    } else {
-        frame_idx = FindVictim();
-        if (frame_idx == -1) return nullptr;  // all frames pinned
-        EvictFrame(frame_idx);
+int32_t BufferPool::AttachSwizzle(PageFrame& f) {
+    std::lock_guard<std::mutex> guard(swizzle_latch_);
+    if (swizzle_free_.empty()) return -1;
+    int32_t table = swizzle_free_.back();
+    for (size_t i = 0; i < swizzle_slots_; ++i) {
+        swizzle_hints_[static_cast<size_t>(table) * swizzle_slots_ + i].store(
+            0, std::memory_order_relaxed);
     }
 
-    // Read page from disk into frame.
-    PageFrame& f = frames_[frame_idx];
-    f.page_id   = page_id;
-    f.pin_count = 1;
-    f.dirty     = false;
+    // Lost to another reader, or to a claim of the frame: a table left on
+    // a frame that moved on just waits for its next claim.
+    int32_t none = -1;
+    if (!f.swizzle.compare_exchange_strong(none, table, std::memory_order_release)) {
+        return none;
+    }
+    swizzle_free_.pop_back();
+    swizzled_.fetch_add(1, std::memory_order_relaxed);
+    return table;
+}
+
+void BufferPool::DetachSwizzle(PageFrame& f) {
+    if (swizzle_slots_ == 0) return;
+    int32_t table = f.swizzle.exchange(-1, std::memory_order_acq_rel);
+    if (table < 0) return;
+    std::lock_guard<std::mutex> guard(swizzle_latch_);
+    swizzle_free_.push_back(table);
+    swizzled_.fetch_sub(1, std::memory_order_relaxed);
+}
 
-    const char* disk_page = disk_.PageData(page_id);
-    std::memcpy(f.data, disk_page, PAGE_SIZE);
+char* BufferPool::PinOptimistic(const OptimisticPage& page, LatchMode mode) {
+    auto& f = const_cast<PageFrame&>(*page.frame);
+    if (!TryPin(f, page.page_id)) return nullptr;
 
-    page_table_[page_id] = frame_idx;
+    Shard& s = ShardFor(page.page_id);
+    s.hits.fetch_add(1, std::memory_order_relaxed);
+    if (f.prefetched.load(std::memory_order_relaxed) &&
+        f.prefetched.exchange(false, std::memory_order_relaxed)) {
+        s.prefetch_hits.fetch_add(1, std::memory_order_relaxed);
+    }
+    Latch(f, mode);
     return f.data;
 }
 
+bool BufferPool::TryPin(PageFrame& f, int64_t page_id) {
+    if (page_id == INVALID_PAGE_ID) return false;
+
+    // Increment first, validate after: a frame being reassigned carries
+    // kEvicting, and a frame that was reassigned before our increment holds
+    // another page.  Either way the pin is undone.
+    int prev = f.pin_count.fetch_add(1, std::memory_order_acquire);
+    if (prev >= 0 && f.page_id.load(std::memory_order_acquire) == page_id) {
+        return true;
+    }
+    f.pin_count.fetch_sub(1, std::memory_order_release);
+    return false;
+}
+
+PageFrame* BufferPool::PinResident(Shard& s, int64_t page_id) {
+    int idx = s.table.Find(page_id);
+    if (idx < 0) return nullptr;
+    PageFrame& f = frames_[idx];
+    return TryPin(f, page_id) ? &f : nullptr;
+}
+
+PageFrame* BufferPool::PinFrame(Shard& s, int64_t page_id) {
+    // Under the latch the table is exact, and no frame of this shard carries
+    // kEvicting.
+    int idx = s.table.Find(page_id);
+    if (idx >= 0) {
+        s.hits.fetch_add(1, std::memory_order_relaxed);
+        s.replacer->RecordAccess(idx - s.begin);
+        frames_[idx].pin_count.fetch_add(1, std::memory_order_acquire);
+        return &frames_[idx];
+    }
+
+    // Cache miss -- need a free frame.
+    s.misses.fetch_add(1, std::memory_order_relaxed);
+    idx = ClaimFrame(s);
+    if (idx == -1) return nullptr;  // all frames pinned
+
+    // Read page from disk into frame.
+    PageFrame& f = frames_[idx];
+    f.dirty.store(false, std::memory_order_relaxed);
+    f.rec_lsn.store(NextLSN(), std::memory_order_relaxed);
+    {
+        BPTREE_TIME(Histogram::kMissRead);
+        disk_.ReadPage(page_id, f.data);
+    }
+
+    Publish(s, idx, page_id);
+    return &f;
+}
+
 // ============================================================================
 // UnpinPage
 // ============================================================================
 
-bool BufferPool::UnpinPage(int64_t page_id, bool dirty) {
-    auto it = page_table_.find(page_id);
-    if (it == page_table_.end()) return false;
+bool BufferPool::UnpinPage(int64_t page_id, bool dirty, LatchMode mode) {
+    Shard& s = ShardFor(page_id);
+
+    // A pinned page cannot leave the table, but a concurrent backward shift
+    // can hide it from a lock-free lookup; retry under the latch.
+    int idx = s.table.Find(page_id);
+    if (idx < 0 || frames_[idx].page_id.load(std::memory_order_relaxed) != page_id) {
+        auto guard = LockShard(s);
+        idx = s.table.Find(page_id);
+    }
+    if (idx < 0) return false;
 
-    int idx = it->second;
     PageFrame& f = frames_[idx];
+    if (f.pin_count.load(std::memory_order_relaxed) <= 0) return false;
+
+    if (dirty) MarkDirty(f);
+    Unlatch(f, mode);
+    f.pin_count.fetch_sub(1, std::memory_order_release);
+    return true;
+}
+
+// ============================================================================
+// Read-ahead
+// ============================================================================
+
+size_t BufferPool::Prefetch(const int64_t* page_ids, size_t count) {
+    std::call_once(prefetch_started_, [this] {
+        prefetcher_ = std::thread(&BufferPool::PrefetchLoop, this);
+    });
+
+    const int64_t end   = disk_.NextPageOffset();
+    const size_t  limit = std::max<size_t>(pool_size_ / kPrefetchQueueDivisor, 1);
+
+    // Advise the kernel in runs of adjacent pages, one call per run.
+    int64_t run_start = INVALID_PAGE_ID;
+    size_t  run_len   = 0;
+    auto flush_run = [&] {
+        if (run_len > 0) disk_.WillNeed(run_start, run_len);
+        run_len = 0;
+    };
+
+    size_t taken  = 0;
+    bool   queued = false;
+    for (; taken < count; ++taken) {
+        int64_t id = page_ids[taken];
+        if (id < static_cast<int64_t>(PAGE_SIZE) || id >= end) continue;
+        if (ShardFor(id).table.Find(id) >= 0) continue;  // resident
+
+        {
+            std::lock_guard<std::mutex> guard(prefetch_latch_);
+            if (prefetch_queue_.size() >= limit) break;
+            prefetch_queue_.push_back(id);
+        }
+        queued = true;
+
+        if (run_len > 0 && id == run_start + static_cast<int64_t>(run_len * PAGE_SIZE)) {
+            ++run_len;
+        } else {
+            flush_run();
+            run_start = id;
+            run_len   = 1;
+        }
+    }
+    flush_run();
+
+    if (queued) prefetch_cv_.notify_one();
+    return taken;
+}
+
+void BufferPool::PrefetchLoop() {
+    std::unique_lock<std::mutex> guard(prefetch_latch_);
+    for (;;) {
+        prefetch_cv_.wait(guard, [this] {
+            return prefetch_stop_ || !prefetch_queue_.empty();
+        });
+        if (prefetch_stop_) return;
+
+        int64_t batch[kPrefetchBatch];
+        size_t  n = 0;
+        while (n < kPrefetchBatch && !prefetch_queue_.empty()) {
+            batch[n++] = prefetch_queue_.front();
+            prefetch_queue_.pop_front();
+        }
+        guard.unlock();
+        LoadAhead(batch, n);
+        guard.lock();
+    }
+}
+
+void BufferPool::LoadAhead(const int64_t* page_ids, size_t count) {
+    // Hold the latch of every shard involved until the pages are published,
+    // as a miss does for its one page: nobody may load or write back a page
+    // while its read is in flight.  No other path holds two shard latches,
+    // so taking them in shard order cannot deadlock.
+    std::vector<size_t> involved;
+    for (size_t i = 0; i < count; ++i) involved.push_back(ShardIndex(page_ids[i]));
+    std::sort(involved.begin(), involved.end());
+    involved.erase(std::unique(involved.begin(), involved.end()), involved.end());
+    std::vector<std::unique_lock<std::mutex>> guards;
+    for (size_t shard : involved) guards.push_back(LockShard(*shards_[shard]));
+
+    // The file may have been truncated since the pages were queued; with
+    // the latches held it cannot be until they are loaded.
+    const int64_t end = disk_.NextPageOffset();
+
+    std::vector<int64_t> ids;
+    std::vector<char*>   bufs;
+    std::vector<int>     frames;
+    for (size_t i = 0; i < count; ++i) {
+        int64_t page_id = page_ids[i];
+        if (page_id >= end) continue;
+        Shard& s = ShardFor(page_id);
+        if (s.table.Find(page_id) >= 0) continue;
+        if (std::find(ids.begin(), ids.end(), page_id) != ids.end()) continue;
+
+        int idx = ClaimFrame(s);
+        if (idx == -1) continue;  // all frames pinned
+        frames_[idx].dirty.store(false, std::memory_order_relaxed);
+        frames_[idx].rec_lsn.store(NextLSN(), std::memory_order_relaxed);
+        ids.push_back(page_id);
+        bufs.push_back(frames_[idx].data);
+        frames.push_back(idx);
+    }
+    disk_.ReadPages(ids.data(), bufs.data(), ids.size());
+
+    for (size_t i = 0; i < ids.size(); ++i) {
+        Shard& s = ShardFor(ids[i]);
+        PageFrame& f = frames_[frames[i]];
+        f.prefetched.store(true, std::memory_order_relaxed);
+
+        // Publish pins the frame for a caller; there is none.
+        Publish(s, frames[i], ids[i]);
+        f.pin_count.fetch_sub(1, std::memory_order_release);
+        s.prefetches.fetch_add(1, std::memory_order_relaxed);
+    }
+}
+
+void BufferPool::DropPrefetched(Shard& s, PageFrame& f) {
+    if (f.prefetched.exchange(false, std::memory_order_relaxed)) {
+        s.prefetch_unused.fetch_add(1, std::memory_order_relaxed);
+    }
+}
+
+// ============================================================================
+// Page cleaner
+// ============================================================================
+
+void BufferPool::StartCleaner(const CleanerOptions& options) {
+    std::lock_guard<std::mutex> guard(cleaner_latch_);
+    if (cleaner_.joinable()) return;
+    cleaner_options_ = options;
+    cleaner_stop_    = false;
+    cleaner_high_water_.store(static_cast<size_t>(options.dirty_high_water * pool_size_),
+                              std::memory_order_relaxed);
+    cleaner_ = std::thread(&BufferPool::CleanerLoop, this);
+    if (DirtyCount() > cleaner_high_water_.load(std::memory_order_relaxed)) WakeCleaner();
+}
+
+void BufferPool::StopCleaner() {
+    {
+        std::lock_guard<std::mutex> guard(cleaner_latch_);
+        if (!cleaner_.joinable()) return;
+        cleaner_stop_ = true;
+        cleaner_high_water_.store(SIZE_MAX, std::memory_order_relaxed);
+    }
+    cleaner_cv_.notify_one();
+    checkpoint_cv_.notify_all();  // FlushCheckpoint finishes on its own
+    cleaner_.join();
+}
 
-    if (f.pin_count <= 0) return false;
+void BufferPool::WakeCleaner() {
+    if (!cleaner_wake_.exchange(true, std::memory_order_relaxed)) cleaner_cv_.notify_one();
+}
 
-    if (dirty) f.dirty = true;
-    --f.pin_count;
+void BufferPool::CleanerLoop() {
+    const auto interval = std::chrono::milliseconds(cleaner_options_.interval_ms);
+    std::unique_lock<std::mutex> guard(cleaner_latch_);
+    while (!cleaner_stop_) {
+        cleaner_cv_.wait_for(guard, interval, [this] {
+            return cleaner_stop_ || cleaner_wake_.load(std::memory_order_relaxed);
+        });
+        if (cleaner_stop_) return;
+        cleaner_wake_.store(false, std::memory_order_relaxed);
+        bool checkpoint = checkpoint_requested_;
+        guard.unlock();
+        CleanPass();
+
+        // A checkpoint's pages go out a pass at a time; busy frames wait
+        // for the next one.
+        size_t left = 0;
+        if (checkpoint) {
+            try {
+                left = WriteCheckpointPages(/*from_cleaner=*/true);
+            } catch (...) {
+                left = 0;  // FlushCheckpoint retries, and reports the error
+            }
+        }
+        guard.lock();
+        if (checkpoint && left == 0) {
+            checkpoint_requested_ = false;
+            checkpoint_cv_.notify_all();
+        } else if (checkpoint) {
+            // Try the busy frames again shortly.
+            cleaner_cv_.wait_for(guard, std::chrono::milliseconds(1), [this] { return cleaner_stop_; });
+            cleaner_wake_.store(true, std::memory_order_relaxed);
+        }
+    }
+}
 
-    // When pin_count reaches 0, add to LRU list (now eligible for eviction).
-    if (f.pin_count == 0) {
-        lru_list_.push_back(idx);
-        lru_map_[idx] = std::prev(lru_list_.end());
+void BufferPool::CleanPass() {
+    const CleanerOptions& o = cleaner_options_;
+    size_t dirty  = DirtyCount();
+    size_t low    = static_cast<size_t>(o.dirty_low_water * pool_size_);
+    bool   over   = dirty > cleaner_high_water_.load(std::memory_order_relaxed);
+    size_t excess = over && dirty > low ? dirty - low : 0;
+
+    // Pin the dirty frames among each shard's coldest; above the high water
+    // mark, keep going until the shard's part of the excess is covered.
+    std::vector<int> frames;
+    for (auto& shard : shards_) {
+        Shard& s = *shard;
+        auto   n      = static_cast<size_t>(s.end - s.begin);
+        auto   window = static_cast<size_t>(std::ceil(o.clean_fraction * static_cast<double>(n)));
+        size_t share  = (excess * n + pool_size_ - 1) / pool_size_;
+        size_t taken  = 0;
+
+        auto guard = LockShard(s);
+        std::vector<int> cold = s.replacer->Coldest(share > 0 ? n : window);
+        for (size_t i = 0; i < cold.size(); ++i) {
+            if (i >= window && taken >= share) break;
+            int idx = s.begin + cold[i];
+            PageFrame& f = frames_[idx];
+            if (!f.dirty.load(std::memory_order_relaxed) ||
+                f.pin_count.load(std::memory_order_relaxed) != 0) {
+                continue;
+            }
+            // Under the shard latch no frame carries kEvicting.
+            f.pin_count.fetch_add(1, std::memory_order_acquire);
+            frames.push_back(idx);
+            ++taken;
+        }
+    }
+    if (frames.empty()) return;
+
+    // In page order, so adjacent pages are written together.
+    std::sort(frames.begin(), frames.end(), [this](int a, int b) {
+        return frames_[a].page_id.load(std::memory_order_relaxed) <
+               frames_[b].page_id.load(std::memory_order_relaxed);
+    });
+    size_t written = 0;
+    try {
+        std::lock_guard<std::mutex> write_guard(cleaner_write_latch_);
+        written = WriteBackAll(frames, /*wait_for_busy=*/false);
+    } catch (...) {
+        // The pages stay dirty for eviction or the next flush to report.
+        for (int idx : frames) MarkDirty(frames_[idx]);
     }
+    cleaner_writes_.fetch_add(written, std::memory_order_relaxed);
+
+    for (int idx : frames) frames_[idx].pin_count.fetch_sub(1, std::memory_order_release);
+}
+
+void BufferPool::MarkDirty(PageFrame& f) {
+    if (f.dirty.load(std::memory_order_relaxed)) return;
+    if (f.dirty.exchange(true, std::memory_order_acq_rel)) return;
+    size_t dirty = dirty_frames_.fetch_add(1, std::memory_order_relaxed) + 1;
+    if (dirty > cleaner_high_water_.load(std::memory_order_relaxed)) WakeCleaner();
+}
+
+bool BufferPool::MarkClean(PageFrame& f) {
+    if (!f.dirty.exchange(false, std::memory_order_acq_rel)) return false;
+    dirty_frames_.fetch_sub(1, std::memory_order_relaxed);
+    // The frame's latch keeps out changes until the write is done.
+    f.rec_lsn.store(NextLSN(), std::memory_order_relaxed);
     return true;
 }
 
+uint64_t BufferPool::NextLSN() const {
+    return wal_ ? wal_->CurrentLSN() : 0;
+}
+
+// ============================================================================
+// Fuzzy checkpoints
+// ============================================================================
+
+DirtyPageTable BufferPool::BeginCheckpoint(uint64_t redo_lsn) {
+    std::lock_guard<std::mutex> guard(checkpoint_latch_);
+    checkpoint_redo_lsn_ = redo_lsn;
+    checkpoint_frames_.clear();
+
+    DirtyPageTable table;
+    table.oldest_lsn = redo_lsn;
+    for (size_t i = 0; i < frames_.size(); ++i) {
+        const PageFrame& f = frames_[i];
+        if (!f.dirty.load(std::memory_order_acquire)) continue;
+        checkpoint_frames_.push_back(static_cast<int>(i));
+        table.oldest_lsn = std::min(table.oldest_lsn, f.rec_lsn.load(std::memory_order_relaxed));
+    }
+    table.pages = checkpoint_frames_.size();
+    return table;
+}
+
+void BufferPool::FlushCheckpoint() {
+    {
+        std::unique_lock<std::mutex> guard(cleaner_latch_);
+        if (cleaner_.joinable() && !cleaner_stop_) {
+            checkpoint_requested_ = true;
+            WakeCleaner();
+            checkpoint_cv_.wait(guard, [this] { return !checkpoint_requested_ || cleaner_stop_; });
+        }
+    }
+
+    // Without a cleaner (or if it stopped) the caller writes them.  A frame
+    // that could not be pinned is being evicted, which writes it.
+    while (WriteCheckpointPages(/*from_cleaner=*/false) > 0) std::this_thread::yield();
+
+    std::lock_guard<std::mutex> write_guard(cleaner_write_latch_);
+    disk_.Sync();
+}
+
+size_t BufferPool::WriteCheckpointPages(bool from_cleaner) {
+    std::lock_guard<std::mutex> guard(checkpoint_latch_);
+
+    // Written since the table was taken: clean, or dirty again with a
+    // later recovery LSN (also if the frame now holds another page).
+    auto written = [this](int idx) {
+        const PageFrame& f = frames_[idx];
+        return !f.dirty.load(std::memory_order_acquire) ||
+               f.rec_lsn.load(std::memory_order_relaxed) > checkpoint_redo_lsn_;
+    };
+    auto drop_written = [&] {
+        checkpoint_frames_.erase(std::remove_if(checkpoint_frames_.begin(),
+                                                checkpoint_frames_.end(), written),
+                                 checkpoint_frames_.end());
+    };
+    drop_written();
+    if (checkpoint_frames_.empty()) return 0;
+
+    std::vector<int> frames;
+    for (int idx : checkpoint_frames_) {
+        PageFrame& f = frames_[idx];
+        if (TryPin(f, f.page_id.load(std::memory_order_acquire))) frames.push_back(idx);
+    }
+    std::sort(frames.begin(), frames.end(), [this](int a, int b) {
+        return frames_[a].page_id.load(std::memory_order_relaxed) <
+               frames_[b].page_id.load(std::memory_order_relaxed);
+    });
+    try {
+        std::lock_guard<std::mutex> write_guard(cleaner_write_latch_);
+        size_t written = WriteBackAll(frames, /*wait_for_busy=*/!from_cleaner);
+        if (from_cleaner) cleaner_writes_.fetch_add(written, std::memory_order_relaxed);
+    } catch (...) {
+        for (int idx : frames) frames_[idx].pin_count.fetch_sub(1, std::memory_order_release);
+        throw;
+    }
+    for (int idx : frames) frames_[idx].pin_count.fetch_sub(1, std::memory_order_release);
+
+    drop_written();
+    return checkpoint_frames_.size();
+}
+
 // ============================================================================
 // FlushPage / FlushAllPages
 // ============================================================================
 
 bool BufferPool::FlushPage(int64_t page_id) {
-    auto it = page_table_.find(page_id);
-    if (it == page_table_.end()) return false;
+    Shard& s = ShardFor(page_id);
+    PageFrame* f = PinResident(s, page_id);
+    if (!f) {
+        auto guard = LockShard(s);
+        int idx = s.table.Find(page_id);
+        if (idx < 0) return false;
+        f = &frames_[idx];
+        f->pin_count.fetch_add(1, std::memory_order_acquire);
+    }
 
-    int idx = it->second;
-    PageFrame& f = frames_[idx];
+    WriteBack(*f);
 
-    if (f.dirty) {
-        // WAL protocol: log before flush.
-        if (wal_) {
-            wal_->LogPageWrite(page_id, f.data);
-        }
-        char* disk_page = disk_.PageData(page_id);
-        std::memcpy(disk_page, f.data, PAGE_SIZE);
-        f.dirty = false;
-    }
+    f->pin_count.fetch_sub(1, std::memory_order_release);
     return true;
 }
 
 void BufferPool::FlushAllPages() {
-    // WAL protocol: flush the WAL before writing pages to disk.
+    std::lock_guard<std::mutex> cleaner_guard(cleaner_write_latch_);
+
+    // Pin every dirty frame so none of them can be evicted underneath us.
+    std::vector<int> dirty;
+    for (size_t i = 0; i < frames_.size(); ++i) {
+        PageFrame& f = frames_[i];
+        if (!f.dirty.load(std::memory_order_relaxed)) continue;
+        if (TryPin(f, f.page_id.load(std::memory_order_acquire))) {
+            dirty.push_back(static_cast<int>(i));
+        }
+    }
+
+    // WAL protocol: one log force covers every page; WriteBack then only
+    // syncs again for pages modified in the meantime.
     if (wal_) {
-        for (auto& [pid, idx] : page_table_) {
+        uint64_t max_lsn = 0;
+        for (int idx : dirty) {
             PageFrame& f = frames_[idx];
-            if (f.dirty) {
-                wal_->LogPageWrite(pid, f.data);
-            }
+            std::shared_lock<std::shared_mutex> page_guard(f.latch);
+            max_lsn = std::max(max_lsn, PageLSN(f.data));
         }
-        wal_->Flush();
+        wal_->WaitDurable(max_lsn);
     }
 
-    for (auto& [pid, idx] : page_table_) {
+    WriteBackAll(dirty, /*wait_for_busy=*/true);
+
+    for (int idx : dirty) {
+        frames_[idx].pin_count.fetch_sub(1, std::memory_order_release);
+    }
+    disk_.Sync();
+}
+
+size_t BufferPool::WriteBackAll(const std::vector<int>& frames, bool wait_for_busy) {
+    std::vector<int64_t>     ids;
+    std::vector<const char*> bufs;
+    std::vector<PageFrame*>  held;
+    auto write_batch = [&] {
+        try {
+            disk_.WritePages(ids.data(), bufs.data(), ids.size());
+        } catch (...) {
+            for (PageFrame* f : held) f->latch.unlock_shared();
+            throw;
+        }
+        for (PageFrame* f : held) f->latch.unlock_shared();
+        ids.clear();
+        bufs.clear();
+        held.clear();
+    };
+
+    // Waiting for a frame latch while holding others could deadlock with a
+    // writer crabbing down the tree, so a busy frame is left for later.
+    std::vector<int> busy;
+    size_t written = 0;
+    for (int idx : frames) {
         PageFrame& f = frames_[idx];
-        if (f.dirty) {
-            char* disk_page = disk_.PageData(pid);
-            std::memcpy(disk_page, f.data, PAGE_SIZE);
-            f.dirty = false;
+        if (!f.latch.try_lock_shared()) {
+            busy.push_back(idx);
+            continue;
         }
+        if (!MarkClean(f)) {
+            f.latch.unlock_shared();
+            continue;
+        }
+        if (wal_) wal_->WaitDurable(PageLSN(f.data));
+        ids.push_back(f.page_id.load(std::memory_order_relaxed));
+        bufs.push_back(f.data);
+        held.push_back(&f);
+        ++written;
+        if (held.size() == kWriteBackBatch) write_batch();
     }
-    disk_.Sync();
+    write_batch();
+
+    if (wait_for_busy) {
+        for (int idx : busy) WriteBack(frames_[idx]);
+    }
+    return written;
+}
+
+void BufferPool::WriteBack(PageFrame& f) {
+    // Writers hold the exclusive latch while modifying, so the shared latch
+    // gives a consistent image.  Clearing dirty *before* the copy means a
+    // concurrent modification re-marks the frame rather than being lost.
+    std::shared_lock<std::shared_mutex> page_guard(f.latch);
+    if (!MarkClean(f)) return;
+
+    // WAL protocol: the page's log records must be durable first.
+    if (wal_) wal_->WaitDurable(PageLSN(f.data));
+    disk_.WritePage(f.page_id.load(std::memory_order_relaxed), f.data);
 }
 
 // ============================================================================
@@ -155,27 +772,36 @@ char* BufferPool::NewPage(int64_t& page_id) {
     // Allocate on disk first.
     page_id = disk_.AllocatePage();
 
+    Shard& s = ShardFor(page_id);
+    auto guard = LockShard(s);
+
+    // A freed page whose frame could not be dropped is still mapped; reuse
+    // that frame rather than mapping the page twice.
+    int frame_idx = s.table.Find(page_id);
+    if (frame_idx >= 0) {
+        PageFrame& f = frames_[frame_idx];
+        f.pin_count.fetch_add(1, std::memory_order_acquire);
+        DropPrefetched(s, f);
+        MarkDirty(f);
+        BeginChange(f);
+        std::memset(f.data, 0, PAGE_SIZE);
+        EndChange(f);
+        return f.data;
+    }
+
     // Find a frame for it.
-    int frame_idx = -1;
-    if (!free_list_.empty()) {
-        frame_idx = free_list_.back();
-        free_list_.pop_back();
-    } else {
-        frame_idx = FindVictim();
-        if (frame_idx == -1) {
-            // Cannot evict -- caller should flush.
-            return nullptr;
-        }
-        EvictFrame(frame_idx);
+    frame_idx = ClaimFrame(s);
+    if (frame_idx == -1) {
+        // Cannot evict -- caller should flush.
+        return nullptr;
     }
 
     PageFrame& f = frames_[frame_idx];
-    f.page_id   = page_id;
-    f.pin_count = 1;
-    f.dirty     = true;   // new pages are dirty by definition
+    f.rec_lsn.store(NextLSN(), std::memory_order_relaxed);
+    MarkDirty(f);  // new pages are dirty by definition
     std::memset(f.data, 0, PAGE_SIZE);
 
-    page_table_[page_id] = frame_idx;
+    Publish(s, frame_idx, page_id);
     return f.data;
 }
 
@@ -184,78 +810,214 @@ char* BufferPool::NewPage(int64_t& page_id) {
 // ============================================================================
 
 bool BufferPool::DeletePage(int64_t page_id) {
-    auto it = page_table_.find(page_id);
-    if (it == page_table_.end()) return true;  // not in pool, nothing to do
+    Shard& s = ShardFor(page_id);
+    auto guard = LockShard(s);
 
-    int idx = it->second;
-    PageFrame& f = frames_[idx];
-    if (f.pin_count > 0) return false;  // still pinned
+    int idx = s.table.Find(page_id);
+    if (idx < 0) return true;  // not in pool, nothing to do
 
-    // Remove from LRU.
-    auto lru_it = lru_map_.find(idx);
-    if (lru_it != lru_map_.end()) {
-        lru_list_.erase(lru_it->second);
-        lru_map_.erase(lru_it);
+    PageFrame& f = frames_[idx];
+    int expected = 0;
+    if (!f.pin_count.compare_exchange_strong(expected, PageFrame::kEvicting,
+                                             std::memory_order_acq_rel)) {
+        return false;  // still pinned
     }
 
     // Do not flush -- the page is being freed.
-    f.page_id   = INVALID_PAGE_ID;
-    f.pin_count = 0;
-    f.dirty     = false;
+    DropFrame(s, idx);
+    return true;
+}
+
+bool BufferPool::Truncate(int64_t end) {
+    // Every shard latch, in shard order as LoadAhead takes them: nothing
+    // can be loaded past the end while it moves.
+    std::vector<std::unique_lock<std::mutex>> guards;
+    for (auto& shard : shards_) guards.push_back(LockShard(*shard));
+
+    std::vector<int> dropped;
+    for (size_t i = 0; i < frames_.size(); ++i) {
+        PageFrame& f = frames_[i];
+        if (f.page_id.load(std::memory_order_relaxed) < end) continue;  // INVALID too
+        int expected = 0;
+        if (!f.pin_count.compare_exchange_strong(expected, PageFrame::kEvicting,
+                                                 std::memory_order_acq_rel)) {
+            for (int idx : dropped) {
+                frames_[idx].pin_count.fetch_sub(PageFrame::kEvicting, std::memory_order_release);
+            }
+            return false;  // still pinned
+        }
+        dropped.push_back(static_cast<int>(i));
+    }
 
-    page_table_.erase(it);
-    free_list_.push_back(idx);
+    for (int idx : dropped) {
+        for (auto& shard : shards_) {
+            if (idx >= shard->begin && idx < shard->end) DropFrame(*shard, idx);
+        }
+    }
+    disk_.Truncate(end);
     return true;
 }
 
+void BufferPool::DropFrame(Shard& s, int idx) {
+    PageFrame& f = frames_[idx];
+    DropPrefetched(s, f);
+    DetachSwizzle(f);
+    s.table.Erase(f.page_id.load(std::memory_order_relaxed));
+    f.page_id.store(INVALID_PAGE_ID, std::memory_order_relaxed);
+    MarkClean(f);
+    f.pin_count.fetch_sub(PageFrame::kEvicting, std::memory_order_release);
+
+    s.replacer->Remove(idx - s.begin);
+    s.free_list.push_back(idx);
+}
+
 // ============================================================================
-// LRU internals
+// Statistics
 // ============================================================================
 
-int BufferPool::FindVictim() {
-    // Front of lru_list_ is the least recently used unpinned frame.
-    if (lru_list_.empty()) return -1;
-    return lru_list_.front();
+size_t BufferPool::PagesInUse() const {
+    size_t n = 0;
+    for (const auto& s : shards_) n += s->table.Size();
+    return n;
 }
 
-void BufferPool::EvictFrame(int frame_idx) {
-    PageFrame& f = frames_[frame_idx];
+size_t BufferPool::HitCount() const {
+    size_t n = 0;
+    for (const auto& s : shards_) n += s->hits.load(std::memory_order_relaxed);
+    return n;
+}
 
-    // Flush to disk if dirty.
-    if (f.dirty && f.page_id != INVALID_PAGE_ID) {
-        // WAL protocol: log before evict.
-        if (wal_) {
-            wal_->LogPageWrite(f.page_id, f.data);
-            wal_->Flush();
-        }
-        char* disk_page = disk_.PageData(f.page_id);
-        std::memcpy(disk_page, f.data, PAGE_SIZE);
-        f.dirty = false;
+size_t BufferPool::MissCount() const {
+    size_t n = 0;
+    for (const auto& s : shards_) n += s->misses.load(std::memory_order_relaxed);
+    return n;
+}
+
+size_t BufferPool::PrefetchCount() const {
+    size_t n = 0;
+    for (const auto& s : shards_) n += s->prefetches.load(std::memory_order_relaxed);
+    return n;
+}
+
+size_t BufferPool::PrefetchHitCount() const {
+    size_t n = 0;
+    for (const auto& s : shards_) n += s->prefetch_hits.load(std::memory_order_relaxed);
+    return n;
+}
+
+ShardStats BufferPool::GetShardStats(size_t shard) const {
+    const Shard& s = *shards_.at(shard);
+    ShardStats st;
+    st.frames             = static_cast<size_t>(s.end - s.begin);
+    st.hits               = s.hits.load(std::memory_order_relaxed);
+    st.misses             = s.misses.load(std::memory_order_relaxed);
+    st.evictions          = s.evictions.load(std::memory_order_relaxed);
+    st.latch_acquisitions = s.latch_acquisitions.load(std::memory_order_relaxed);
+    st.latch_contentions  = s.latch_contentions.load(std::memory_order_relaxed);
+    st.prefetches         = s.prefetches.load(std::memory_order_relaxed);
+    st.prefetch_hits      = s.prefetch_hits.load(std::memory_order_relaxed);
+    st.prefetch_unused    = s.prefetch_unused.load(std::memory_order_relaxed);
+    st.dirty_evictions    = s.dirty_evictions.load(std::memory_order_relaxed);
+    st.numa_node          = s.numa_node;
+    return st;
+}
+
+// ============================================================================
+// Shard internals
+// ============================================================================
+
+std::unique_lock<std::mutex> BufferPool::LockShard(Shard& s) const {
+    std::unique_lock<std::mutex> lock(s.latch, std::try_to_lock);
+    if (!lock.owns_lock()) {
+        s.latch_contentions.fetch_add(1, std::memory_order_relaxed);
+        lock.lock();
     }
+    s.latch_acquisitions.fetch_add(1, std::memory_order_relaxed);
+    return lock;
+}
 
-    // Remove from page table.
-    page_table_.erase(f.page_id);
+int BufferPool::ClaimFrame(Shard& s) {
+    if (!s.free_list.empty()) {
+        int idx = s.free_list.back();
+        s.free_list.pop_back();
+        // Only failed lock-free pins can touch a free frame; they undo their
+        // increment, so adding the marker keeps the count consistent.
+        frames_[idx].pin_count.fetch_add(PageFrame::kEvicting, std::memory_order_acq_rel);
+        BeginChange(frames_[idx]);
+        return idx;
+    }
 
-    // Remove from LRU list.
-    auto lru_it = lru_map_.find(frame_idx);
-    if (lru_it != lru_map_.end()) {
-        lru_list_.erase(lru_it->second);
-        lru_map_.erase(lru_it);
+    // A lock-free pin can race with the claim, in which case pick again.
+    auto evictable = [&](int local) {
+        return frames_[s.begin + local].pin_count.load(std::memory_order_relaxed) == 0;
+    };
+    for (;;) {
+        int local = s.replacer->Victim(evictable);
+        if (local == -1) return -1;
+
+        int victim = s.begin + local;
+        PageFrame& f = frames_[victim];
+        int expected = 0;
+        if (!f.pin_count.compare_exchange_strong(expected, PageFrame::kEvicting,
+                                                 std::memory_order_acq_rel)) {
+            continue;
+        }
+        BPTREE_TIME(Histogram::kEviction);
+        BPTREE_COUNT(Counter::kEvictions);
+
+        // Flush to disk if dirty.
+        int64_t old_page = f.page_id.load(std::memory_order_relaxed);
+        if (f.dirty.load(std::memory_order_relaxed)) {
+            // WAL protocol: force the log up to the page LSN before evict;
+            // usually an earlier sync already covered it.
+            if (wal_) wal_->WaitDurable(PageLSN(f.data));
+            disk_.WritePage(old_page, f.data);
+            MarkClean(f);
+            s.dirty_evictions.fetch_add(1, std::memory_order_relaxed);
+            BPTREE_COUNT(Counter::kDirtyEvictions);
+            WakeCleaner();  // it is falling behind
+        }
+
+        DropPrefetched(s, f);
+        DetachSwizzle(f);
+        BeginChange(f);
+        s.table.Erase(old_page);
+        f.page_id.store(INVALID_PAGE_ID, std::memory_order_relaxed);
+        s.evictions.fetch_add(1, std::memory_order_relaxed);
+        return victim;
     }
+}
 
-    f.page_id   = INVALID_PAGE_ID;
-    f.pin_count = 0;
+void BufferPool::Publish(Shard& s, int frame_idx, int64_t page_id) {
+    PageFrame& f = frames_[frame_idx];
+    f.page_id.store(page_id, std::memory_order_relaxed);
+    EndChange(f);
+    s.replacer->RecordLoad(frame_idx - s.begin);
+    s.table.Insert(page_id, frame_idx);
+
+    // Drop the marker and take the caller's pin in one step; the release
+    // publishes page_id and data to lock-free pinners.
+    f.pin_count.fetch_add(1 - PageFrame::kEvicting, std::memory_order_release);
+}
+
+// ============================================================================
+// Frame latches
+// ============================================================================
+
+void BufferPool::Latch(PageFrame& f, LatchMode mode) {
+    switch (mode) {
+        case LatchMode::kNone:      break;
+        case LatchMode::kShared:    f.latch.lock_shared(); break;
+        case LatchMode::kExclusive: f.latch.lock(); BeginChange(f); break;
+    }
 }
 
-void BufferPool::TouchFrame(int frame_idx) {
-    // Remove from current position and re-add at the back.
-    auto lru_it = lru_map_.find(frame_idx);
-    if (lru_it != lru_map_.end()) {
-        lru_list_.erase(lru_it->second);
-        lru_map_.erase(lru_it);
+void BufferPool::Unlatch(PageFrame& f, LatchMode mode) {
+    switch (mode) {
+        case LatchMode::kNone:      break;
+        case LatchMode::kShared:    f.latch.unlock_shared(); break;
+        case LatchMode::kExclusive: EndChange(f); f.latch.unlock(); break;
     }
-    lru_list_.push_back(frame_idx);
-    lru_map_[frame_idx] = std::prev(lru_list_.end());
 }
 
 }  // namespace bptree
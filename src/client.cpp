@@ -0,0 +1,315 @@
+/// @file client.cpp
+/// @brief Blocking, pipelining client of the network server.
+
+#include "bptree/client.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+
+#include <arpa/inet.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+namespace bptree {
+
+namespace {
+
+constexpr size_t kReadChunk = 64 << 10;
+
+/// Wait until @p fd has one of @p events.
+void Await(int fd, short events) {
+    pollfd p{fd, events, 0};
+    while (::poll(&p, 1, -1) < 0 && errno == EINTR) {}
+}
+
+}  // namespace
+
+// ============================================================================
+// Connection
+// ============================================================================
+
+Status Client::Connect(const std::string& address, uint16_t port) {
+    Close();
+    sockaddr_in addr{};
+    addr.sin_family = AF_INET;
+    addr.sin_port   = htons(port);
+    if (::inet_pton(AF_INET, address.c_str(), &addr.sin_addr) != 1) {
+        return Status::InvalidArg("not an IPv4 address: " + address);
+    }
+
+    int fd = ::socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (fd < 0) return Status::IOError(std::string("socket: ") + std::strerror(errno));
+    if (::connect(fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) < 0) {
+        Status st = Status::IOError(std::string("connect: ") + std::strerror(errno));
+        ::close(fd);
+        return st;
+    }
+    int one = 1;
+    ::setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+    // Non-blocking from here on, so that `Flush` can read while it writes.
+    ::fcntl(fd, F_SETFL, ::fcntl(fd, F_GETFL) | O_NONBLOCK);
+    fd_ = fd;
+    return Status::OK();
+}
+
+void Client::Close() {
+    if (fd_ >= 0) ::close(fd_);
+    fd_ = -1;
+    out_.clear();
+    in_.clear();
+    in_pos_ = 0;
+}
+
+// ============================================================================
+// One round trip each
+// ============================================================================
+
+Status Client::Get(key_t key, std::string& value) {
+    QueueGet({key});
+    ClientResponse r;
+    Status st = RoundTrip(WireOp::kGet, r);
+    if (!st.ok()) return st;
+    if (r.statuses[0].ok()) value = std::move(r.values[0]);
+    return r.statuses[0];
+}
+
+Status Client::Put(key_t key, std::string_view value) {
+    return PutBatch({{key, std::string(value)}});
+}
+
+Status Client::Delete(key_t key) {
+    QueueDelete({key});
+    ClientResponse r;
+    Status st = RoundTrip(WireOp::kDelete, r);
+    return st.ok() ? r.statuses[0] : st;
+}
+
+Status Client::MultiGet(const std::vector<key_t>& keys, std::vector<std::string>& values,
+                        std::vector<Status>& statuses) {
+    QueueGet(keys);
+    ClientResponse r;
+    Status st = RoundTrip(WireOp::kGet, r);
+    if (!st.ok()) return st;
+    values   = std::move(r.values);
+    statuses = std::move(r.statuses);
+    return Status::OK();
+}
+
+Status Client::PutBatch(const std::vector<std::pair<key_t, std::string>>& records) {
+    QueuePut(records);
+    ClientResponse r;
+    Status st = RoundTrip(WireOp::kPut, r);
+    return st.ok() ? r.status : st;
+}
+
+Status Client::Scan(key_t lower, key_t upper,
+                    const std::function<bool(key_t key, std::string_view value)>& fn,
+                    uint32_t limit) {
+    QueueScan(lower, upper, limit);
+    Status st = Flush();
+    if (!st.ok()) return st;
+
+    bool visiting = true;
+    ClientResponse r;
+    for (;;) {
+        st = Receive(r);
+        if (!st.ok()) return st;
+        switch (r.op) {
+            case WireOp::kScan:
+                for (const auto& [key, value] : r.records) {
+                    if (!visiting) break;
+                    visiting = fn(key, value);
+                }
+                break;
+            case WireOp::kScanEnd:
+            case WireOp::kError:
+                return r.status;
+            default:
+                return Status::Corruption("unexpected response to a scan");
+        }
+    }
+}
+
+Status Client::RoundTrip(WireOp op, ClientResponse& response) {
+    Status st = Flush();
+    if (st.ok()) st = Receive(response);
+    if (!st.ok()) return st;
+    if (response.op == WireOp::kError) return response.status;
+    if (response.op != op) return Status::Corruption("unexpected response");
+    return Status::OK();
+}
+
+// ============================================================================
+// Pipelining
+// ============================================================================
+
+uint32_t Client::QueueGet(const std::vector<key_t>& keys) {
+    FrameWriter w(out_);
+    uint32_t id = next_id_++;
+    size_t at = w.Begin(WireOp::kGet, id);
+    w.U32(static_cast<uint32_t>(keys.size()));
+    for (key_t k : keys) w.Key(k);
+    w.End(at);
+    return id;
+}
+
+uint32_t Client::QueuePut(const std::vector<std::pair<key_t, std::string>>& records) {
+    FrameWriter w(out_);
+    uint32_t id = next_id_++;
+    size_t at = w.Begin(WireOp::kPut, id);
+    w.U32(static_cast<uint32_t>(records.size()));
+    for (const auto& [k, v] : records) {
+        w.Key(k);
+        w.Bytes(v);
+    }
+    w.End(at);
+    return id;
+}
+
+uint32_t Client::QueueDelete(const std::vector<key_t>& keys) {
+    FrameWriter w(out_);
+    uint32_t id = next_id_++;
+    size_t at = w.Begin(WireOp::kDelete, id);
+    w.U32(static_cast<uint32_t>(keys.size()));
+    for (key_t k : keys) w.Key(k);
+    w.End(at);
+    return id;
+}
+
+uint32_t Client::QueueScan(key_t lower, key_t upper, uint32_t limit) {
+    FrameWriter w(out_);
+    uint32_t id = next_id_++;
+    size_t at = w.Begin(WireOp::kScan, id);
+    w.Key(lower);
+    w.Key(upper);
+    w.U32(limit);
+    w.End(at);
+    return id;
+}
+
+Status Client::Flush() {
+    if (fd_ < 0) return Status::IOError("not connected");
+    size_t pos = 0;
+    while (pos < out_.size()) {
+        ssize_t n = ::send(fd_, out_.data() + pos, out_.size() - pos, MSG_NOSIGNAL);
+        if (n > 0) {
+            pos += static_cast<size_t>(n);
+        } else if (n < 0 && errno == EINTR) {
+            continue;
+        } else if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+            // The server may be waiting for us to read its answers before
+            // it reads more: take them in while the socket is full.
+            Await(fd_, POLLIN | POLLOUT);
+            if (!Fill(false)) break;
+        } else {
+            break;
+        }
+    }
+    if (pos < out_.size()) {
+        Status st = Status::IOError(std::string("send: ") + std::strerror(errno));
+        Close();
+        return st;
+    }
+    out_.clear();
+    return Status::OK();
+}
+
+bool Client::Fill(bool wait) {
+    if (in_pos_ == in_.size()) {
+        in_.clear();
+        in_pos_ = 0;
+    } else if (in_pos_ > in_.size() / 2) {
+        in_.erase(0, in_pos_);
+        in_pos_ = 0;
+    }
+    for (;;) {
+        size_t old = in_.size();
+        in_.resize(old + kReadChunk);
+        ssize_t n = ::recv(fd_, &in_[old], kReadChunk, 0);
+        in_.resize(old + static_cast<size_t>(std::max<ssize_t>(n, 0)));
+        if (n > 0) return true;
+        if (n == 0) return false;
+        if (errno == EINTR) continue;
+        if (errno != EAGAIN && errno != EWOULDBLOCK) return false;
+        if (!wait) return true;
+        Await(fd_, POLLIN);
+    }
+}
+
+Status Client::Receive(ClientResponse& response) {
+    if (fd_ < 0) return Status::IOError("not connected");
+    FrameHeader h;
+    for (;;) {
+        size_t avail = in_.size() - in_pos_;
+        if (avail >= kFrameHeaderSize) {
+            h = DecodeFrameHeader(&in_[in_pos_]);
+            if (h.length > kMaxFrameBytes) {
+                Close();
+                return Status::Corruption("response frame too large");
+            }
+            if (avail >= kFrameHeaderSize + h.length) break;
+        }
+        if (!Fill(true)) {
+            Close();
+            return Status::IOError("connection closed");
+        }
+    }
+
+    FrameReader r(std::string_view(&in_[in_pos_ + kFrameHeaderSize], h.length));
+    in_pos_ += kFrameHeaderSize + h.length;
+    response.op = h.op;
+    response.id = h.id;
+    response.status = Status::OK();
+    response.statuses.clear();
+    response.values.clear();
+    response.records.clear();
+
+    uint32_t n = 0;
+    bool ok = true;
+    switch (h.op) {
+        case WireOp::kGet:
+        case WireOp::kDelete:
+            ok = r.U32(n) && n <= r.Remaining();
+            if (ok && h.op == WireOp::kGet) response.values.resize(n);
+            for (uint32_t i = 0; ok && i < n; ++i) {
+                Status st;
+                ok = r.GetStatus(st);
+                if (ok && st.ok() && h.op == WireOp::kGet) {
+                    std::string_view value;
+                    ok = r.Bytes(value);
+                    response.values[i].assign(value);
+                }
+                response.statuses.push_back(std::move(st));
+            }
+            break;
+        case WireOp::kScan:
+            ok = r.U32(n) && n <= r.Remaining() / (sizeof(key_t) + 4);
+            response.records.reserve(n);
+            for (uint32_t i = 0; ok && i < n; ++i) {
+                key_t key;
+                std::string_view value;
+                ok = r.Key(key) && r.Bytes(value);
+                if (ok) response.records.emplace_back(key, std::string(value));
+            }
+            break;
+        case WireOp::kPut:
+        case WireOp::kScanEnd:
+        case WireOp::kError:
+            ok = r.GetStatus(response.status);
+            break;
+        default:
+            ok = false;
+    }
+    if (!ok || !r.Done()) {
+        Close();
+        return Status::Corruption("malformed response frame");
+    }
+    return Status::OK();
+}
+
+}  // namespace bptree
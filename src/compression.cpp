@@ -0,0 +1,144 @@
+/// @file compression.cpp
+/// @brief LZ4 block format compressor and decompressor.
+
+#include "bptree/compression.h"
+
+#include <cstring>
+
+namespace bptree {
+
+namespace {
+
+constexpr size_t kMinMatch     = 4;
+constexpr size_t kLastLiterals = 5;   ///< a block ends in at least 5 literals
+constexpr size_t kMatchLimit   = 12;  ///< no match starts in the last 12 bytes
+constexpr size_t kMaxOffset    = 65535;
+constexpr int    kHashLog      = 12;
+
+inline uint32_t Read32(const uint8_t* p) {
+    uint32_t v;
+    std::memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+inline uint32_t Hash(uint32_t seq) {
+    return (seq * 2654435761u) >> (32 - kHashLog);
+}
+
+/// Append a length that did not fit its 4-bit token field.
+inline void WriteLength(uint8_t*& op, size_t len) {
+    for (; len >= 255; len -= 255) *op++ = 255;
+    *op++ = static_cast<uint8_t>(len);
+}
+
+/// Append one sequence: @p lit_len literals, then a match of @p match_len
+/// bytes at @p offset back (none for the last sequence, match_len == 0).
+bool EmitSequence(uint8_t*& op, const uint8_t* oend, const uint8_t* lit,
+                  size_t lit_len, size_t offset, size_t match_len) {
+    size_t needed = 1 + lit_len / 255 + 1 + lit_len +
+                    (match_len ? 2 + (match_len - kMinMatch) / 255 + 1 : 0);
+    if (needed > static_cast<size_t>(oend - op)) return false;
+
+    uint8_t* token = op++;
+    *token = static_cast<uint8_t>((lit_len < 15 ? lit_len : 15) << 4);
+    if (lit_len >= 15) WriteLength(op, lit_len - 15);
+    std::memcpy(op, lit, lit_len);
+    op += lit_len;
+    if (match_len == 0) return true;
+
+    *op++ = static_cast<uint8_t>(offset);
+    *op++ = static_cast<uint8_t>(offset >> 8);
+    size_t ml = match_len - kMinMatch;
+    *token |= static_cast<uint8_t>(ml < 15 ? ml : 15);
+    if (ml >= 15) WriteLength(op, ml - 15);
+    return true;
+}
+
+}  // namespace
+
+size_t LZ4Compress(const char* src, size_t len, char* dst, size_t capacity) {
+    const auto* in   = reinterpret_cast<const uint8_t*>(src);
+    auto*       op   = reinterpret_cast<uint8_t*>(dst);
+    const auto* oend = op + capacity;
+    size_t anchor = 0;
+
+    if (len > kMatchLimit) {
+        uint32_t table[1 << kHashLog] = {};  // last position of each hash
+        const size_t last_start = len - kMatchLimit;
+        const size_t last_end   = len - kLastLiterals;
+        size_t ip = 0;
+        size_t misses = 0;
+        while (ip <= last_start) {
+            uint32_t seq = Read32(in + ip);
+            uint32_t h   = Hash(seq);
+            size_t   ref = table[h];
+            table[h] = static_cast<uint32_t>(ip);
+            if (ref >= ip || ip - ref > kMaxOffset || Read32(in + ref) != seq) {
+                // Step faster through data that keeps missing.
+                ip += 1 + (misses++ >> 6);
+                continue;
+            }
+            size_t match_len = kMinMatch;
+            while (ip + match_len < last_end && in[ref + match_len] == in[ip + match_len]) {
+                ++match_len;
+            }
+            if (!EmitSequence(op, oend, in + anchor, ip - anchor, ip - ref, match_len)) return 0;
+            ip += match_len;
+            anchor = ip;
+            misses = 0;
+        }
+    }
+
+    if (!EmitSequence(op, oend, in + anchor, len - anchor, 0, 0)) return 0;
+    return static_cast<size_t>(op - reinterpret_cast<uint8_t*>(dst));
+}
+
+bool LZ4Decompress(const char* src, size_t len, char* dst, size_t out_len) {
+    const auto* ip   = reinterpret_cast<const uint8_t*>(src);
+    const auto* iend = ip + len;
+    auto*       out  = reinterpret_cast<uint8_t*>(dst);
+    auto*       op   = out;
+    const auto* oend = out + out_len;
+
+    // Extend a 4-bit length with 255-continued bytes.
+    auto read_length = [&](size_t& value) {
+        uint8_t b;
+        do {
+            if (ip == iend) return false;
+            b = *ip++;
+            value += b;
+        } while (b == 255);
+        return true;
+    };
+
+    for (;;) {
+        if (ip == iend) return false;
+        uint8_t token = *ip++;
+
+        size_t lit_len = token >> 4;
+        if (lit_len == 15 && !read_length(lit_len)) return false;
+        if (lit_len > static_cast<size_t>(iend - ip) ||
+            lit_len > static_cast<size_t>(oend - op)) return false;
+        std::memcpy(op, ip, lit_len);
+        op += lit_len;
+        ip += lit_len;
+        if (ip == iend) return op == oend;  // the last sequence has no match
+
+        if (iend - ip < 2) return false;
+        size_t offset = ip[0] | (static_cast<size_t>(ip[1]) << 8);
+        ip += 2;
+        if (offset == 0 || offset > static_cast<size_t>(op - out)) return false;
+
+        size_t match_len = token & 15;
+        if (match_len == 15 && !read_length(match_len)) return false;
+        match_len += kMinMatch;
+        if (match_len > static_cast<size_t>(oend - op)) return false;
+
+        // Byte by byte: the match may overlap the bytes it produces.
+        const uint8_t* match = op - offset;
+        for (size_t i = 0; i < match_len; ++i) op[i] = match[i];
+        op += match_len;
+    }
+}
+
+}  // namespace bptree
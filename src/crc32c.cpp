@@ -0,0 +1,172 @@
+/// @file crc32c.cpp
+/// @brief CRC32C: SSE4.2 / ARMv8 instructions with a slicing-by-8 fallback.
+
+#include "bptree/crc32c.h"
+
+#include <cstring>
+
+#if defined(__x86_64__) || defined(__i386__)
+#define BPTREE_CRC32C_X86 1
+#include <nmmintrin.h>
+#elif defined(__aarch64__) && defined(__linux__)
+#define BPTREE_CRC32C_ARM 1
+#include <arm_acle.h>
+#include <asm/hwcap.h>
+#include <sys/auxv.h>
+#endif
+
+namespace bptree {
+
+namespace {
+
+// ============================================================================
+// Slicing-by-8
+// ============================================================================
+
+constexpr uint32_t kPolynomial = 0x82F63B78;  // Castagnoli, reflected
+
+/// table[k][b] = CRC of byte b followed by k zero bytes.
+struct SlicingTables {
+    uint32_t table[8][256] = {};
+
+    constexpr SlicingTables() {
+        for (uint32_t b = 0; b < 256; ++b) {
+            uint32_t crc = b;
+            for (int i = 0; i < 8; ++i) crc = (crc >> 1) ^ ((crc & 1) ? kPolynomial : 0);
+            table[0][b] = crc;
+        }
+        for (int k = 1; k < 8; ++k) {
+            for (int b = 0; b < 256; ++b) {
+                uint32_t prev = table[k - 1][b];
+                table[k][b] = (prev >> 8) ^ table[0][prev & 0xFF];
+            }
+        }
+    }
+};
+
+constexpr SlicingTables kTables;
+
+uint32_t UpdatePortable(uint32_t crc, const uint8_t* p, size_t len) {
+    const auto& t = kTables.table;
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+    while (len >= 8) {
+        uint64_t v;
+        std::memcpy(&v, p, 8);
+        v ^= crc;
+        crc = t[7][v & 0xFF]         ^ t[6][(v >> 8) & 0xFF] ^
+              t[5][(v >> 16) & 0xFF] ^ t[4][(v >> 24) & 0xFF] ^
+              t[3][(v >> 32) & 0xFF] ^ t[2][(v >> 40) & 0xFF] ^
+              t[1][(v >> 48) & 0xFF] ^ t[0][v >> 56];
+        p   += 8;
+        len -= 8;
+    }
+#endif
+    while (len-- > 0) crc = t[0][(crc ^ *p++) & 0xFF] ^ (crc >> 8);
+    return crc;
+}
+
+// ============================================================================
+// Hardware
+// ============================================================================
+
+using UpdateFn = uint32_t (*)(uint32_t, const uint8_t*, size_t);
+
+#if defined(BPTREE_CRC32C_X86)
+
+__attribute__((target("sse4.2")))
+uint32_t UpdateSse42(uint32_t crc, const uint8_t* p, size_t len) {
+#if defined(__x86_64__)
+    uint64_t c = crc;
+    while (len >= 8) {
+        uint64_t v;
+        std::memcpy(&v, p, 8);
+        c    = _mm_crc32_u64(c, v);
+        p   += 8;
+        len -= 8;
+    }
+    crc = static_cast<uint32_t>(c);
+#endif
+    while (len >= 4) {
+        uint32_t v;
+        std::memcpy(&v, p, 4);
+        crc  = _mm_crc32_u32(crc, v);
+        p   += 4;
+        len -= 4;
+    }
+    while (len-- > 0) crc = _mm_crc32_u8(crc, *p++);
+    return crc;
+}
+
+UpdateFn SelectUpdate(const char*& name) {
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("sse4.2")) {
+        name = "sse4.2";
+        return UpdateSse42;
+    }
+    name = "slicing-by-8";
+    return UpdatePortable;
+}
+
+#elif defined(BPTREE_CRC32C_ARM)
+
+#if defined(__clang__)
+__attribute__((target("crc")))
+#else
+__attribute__((target("+crc")))
+#endif
+uint32_t UpdateArmv8(uint32_t crc, const uint8_t* p, size_t len) {
+    while (len >= 8) {
+        uint64_t v;
+        std::memcpy(&v, p, 8);
+        crc  = __crc32cd(crc, v);
+        p   += 8;
+        len -= 8;
+    }
+    while (len-- > 0) crc = __crc32cb(crc, *p++);
+    return crc;
+}
+
+UpdateFn SelectUpdate(const char*& name) {
+    if (getauxval(AT_HWCAP) & HWCAP_CRC32) {
+        name = "armv8";
+        return UpdateArmv8;
+    }
+    name = "slicing-by-8";
+    return UpdatePortable;
+}
+
+#else
+
+UpdateFn SelectUpdate(const char*& name) {
+    name = "slicing-by-8";
+    return UpdatePortable;
+}
+
+#endif
+
+/// The implementation for this CPU, chosen on first use.
+struct Implementation {
+    const char* name = nullptr;
+    UpdateFn    update = nullptr;
+
+    Implementation() { update = SelectUpdate(name); }
+};
+
+const Implementation& Selected() {
+    static const Implementation impl;
+    return impl;
+}
+
+}  // namespace
+
+uint32_t CRC32C(const void* data, size_t len, uint32_t crc) {
+    return ~Selected().update(~crc, static_cast<const uint8_t*>(data), len);
+}
+
+uint32_t CRC32CPortable(const void* data, size_t len, uint32_t crc) {
+    return ~UpdatePortable(~crc, static_cast<const uint8_t*>(data), len);
+}
+
+const char* CRC32CImplementation() { return Selected().name; }
+
+}  // namespace bptree
@@ -1,24 +1,270 @@
 /// @file disk_manager.cpp
-/// @brief DiskManager implementation — mmap-based page storage.
+/// @brief DiskManager implementation — mmap-based or O_DIRECT page storage,
+///        or compressed pages packed behind a page map.
 
 #include "bptree/disk_manager.h"
 
+#include <algorithm>
+#include <bitset>
 #include <cerrno>
+#include <cstdint>
 #include <cstring>
+#include <mutex>
+#include <set>
 #include <stdexcept>
+#include <vector>
 
 #include <fcntl.h>
 #include <sys/mman.h>
 #include <sys/stat.h>
+#include <sys/uio.h>
 #include <unistd.h>
 
 namespace bptree {
 
+// ============================================================================
+// Compressed files: slots and the page map
+// ============================================================================
+
+namespace {
+
+constexpr size_t kSector          = 512;
+constexpr int    kSectorsPerBlock = static_cast<int>(PAGE_SIZE / kSector);
+constexpr size_t kMapEntries      = PAGE_SIZE / sizeof(uint64_t);  ///< per map block
+constexpr size_t kDirEntries      = kMapEntries - 1;               ///< per directory block
+
+/// Slot reference: first sector << 4 | sectors (see DiskManager).
+constexpr uint64_t MakeSlot(int64_t sector, int sectors) {
+    return static_cast<uint64_t>(sector) << 4 | static_cast<uint64_t>(sectors);
+}
+constexpr int64_t SlotSector(uint64_t slot)  { return static_cast<int64_t>(slot >> 4); }
+constexpr int     SlotSectors(uint64_t slot) { return static_cast<int>(slot & 15); }
+
+/// The one-block slot at file offset @p offset.
+constexpr uint64_t BlockSlot(int64_t offset) {
+    return MakeSlot(offset / static_cast<int64_t>(kSector), kSectorsPerBlock);
+}
+
+void PRead(int fd, void* buf, size_t len, int64_t offset) {
+    auto* p = static_cast<char*>(buf);
+    while (len > 0) {
+        ssize_t n = ::pread(fd, p, len, static_cast<off_t>(offset));
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) {
+            throw std::runtime_error("DiskManager: read failed at offset " +
+                                     std::to_string(offset));
+        }
+        p += n;
+        len -= static_cast<size_t>(n);
+        offset += n;
+    }
+}
+
+void PWrite(int fd, const void* buf, size_t len, int64_t offset) {
+    const auto* p = static_cast<const char*>(buf);
+    while (len > 0) {
+        ssize_t n = ::pwrite(fd, p, len, static_cast<off_t>(offset));
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) {
+            throw std::runtime_error("DiskManager: write failed at offset " +
+                                     std::to_string(offset) + ": " + std::strerror(errno));
+        }
+        p += n;
+        len -= static_cast<size_t>(n);
+        offset += n;
+    }
+}
+
+/// Write @p count buffers back to back from @p offset in one call where
+/// the kernel takes it all.  @p iov is consumed.
+void PWriteV(int fd, iovec* iov, int count, int64_t offset) {
+    while (count > 0) {
+        ssize_t n = ::pwritev(fd, iov, count, static_cast<off_t>(offset));
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) {
+            throw std::runtime_error("DiskManager: write failed at offset " +
+                                     std::to_string(offset) + ": " + std::strerror(errno));
+        }
+        offset += n;
+        for (; count > 0 && static_cast<size_t>(n) >= iov->iov_len; ++iov, --count) {
+            n -= static_cast<ssize_t>(iov->iov_len);
+        }
+        if (count > 0) {
+            iov->iov_base = static_cast<char*>(iov->iov_base) + n;
+            iov->iov_len -= static_cast<size_t>(n);
+        }
+    }
+}
+
+/// Compress @p page into @p out as stored in a slot: [length(2) | LZ4
+/// block], zero-padded to whole sectors.  Returns the sectors taken; a
+/// page that would not save one is copied as it is into all 8.
+int PackPage(const char* page, char* out) {
+    size_t len = LZ4Compress(page, PAGE_SIZE, out + 2, PAGE_SIZE - kSector - 2);
+    if (len == 0) {
+        std::memcpy(out, page, PAGE_SIZE);
+        return kSectorsPerBlock;
+    }
+    auto stored = static_cast<uint16_t>(len);
+    std::memcpy(out, &stored, sizeof(stored));
+    int sectors = static_cast<int>((len + 2 + kSector - 1) / kSector);
+    std::memset(out + 2 + len, 0, sectors * kSector - 2 - len);
+    return sectors;
+}
+
+}  // namespace
+
+struct DiskManager::PackedPages {
+    int   fd   = -1;
+    char* meta = nullptr;  ///< the mapped metadata page
+
+    std::vector<uint64_t> map;         ///< page number -> slot (0 = zeros)
+    std::vector<int64_t>  map_blocks;  ///< file offset of each map block (0 = none yet)
+    std::vector<int64_t>  dir_blocks;  ///< the directory chain
+    std::vector<uint64_t> released;    ///< slots to free once Sync has made the map durable
+
+    /// Per block: slot size in sectors (0 = free), and a bit per used slot.
+    std::vector<uint8_t>  block_sectors;
+    std::vector<uint8_t>  block_used;
+    std::set<int64_t>     open[kSectorsPerBlock + 1];  ///< blocks with a free slot, by slot size
+    std::set<int64_t>     free_blocks;
+
+    static int SlotsPerBlock(int sectors) { return kSectorsPerBlock / sectors; }
+
+    [[nodiscard]] bool Full(int64_t block) const {
+        return static_cast<int>(std::bitset<8>(block_used[block]).count()) ==
+               SlotsPerBlock(block_sectors[block]);
+    }
+
+    /// Size the map for @p pages pages (whole map blocks).
+    void Grow(size_t pages) {
+        size_t blocks = (pages + kMapEntries - 1) / kMapEntries;
+        if (blocks <= map_blocks.size()) return;
+        map.resize(blocks * kMapEntries, 0);
+        map_blocks.resize(blocks, 0);
+    }
+
+    /// Point page @p page at @p slot, on disk right away; its old slot is
+    /// freed after the next Sync.
+    void Assign(size_t page, uint64_t slot) {
+        if (map[page] != 0) released.push_back(map[page]);
+        map[page] = slot;
+        size_t m = page / kMapEntries;
+        if (map_blocks[m] != 0) {
+            PWrite(fd, &slot, sizeof(slot),
+                   map_blocks[m] + static_cast<int64_t>(page % kMapEntries * sizeof(slot)));
+        } else if (slot != 0) {
+            // A block's first slot: write the block, then list it.
+            int64_t block = AllocateBlock();
+            PWrite(fd, map.data() + m * kMapEntries, PAGE_SIZE, block);
+            map_blocks[m] = block;
+            ListMapBlock(m);
+        }
+    }
+
+    /// Enter map block @p m in the directory, extending the chain if needed.
+    void ListMapBlock(size_t m) {
+        size_t d = m / kDirEntries;
+        while (dir_blocks.size() <= d) {
+            int64_t dir = AllocateBlock();
+            std::vector<int64_t> zeros(kMapEntries, 0);
+            PWrite(fd, zeros.data(), PAGE_SIZE, dir);
+            if (dir_blocks.empty()) {
+                std::memcpy(meta + META_PAGE_MAP, &dir, sizeof(dir));
+            } else {
+                PWrite(fd, &dir, sizeof(dir), dir_blocks.back());
+            }
+            dir_blocks.push_back(dir);
+        }
+        PWrite(fd, &map_blocks[m], sizeof(int64_t),
+               dir_blocks[d] + static_cast<int64_t>((1 + m % kDirEntries) * sizeof(int64_t)));
+    }
+
+    /// A free slot of @p sectors sectors, lowest block first.
+    uint64_t Allocate(int sectors) {
+        int64_t block;
+        if (!open[sectors].empty()) {
+            block = *open[sectors].begin();
+        } else {
+            if (!free_blocks.empty()) {
+                block = *free_blocks.begin();
+                free_blocks.erase(free_blocks.begin());
+            } else {
+                block = static_cast<int64_t>(block_sectors.size());
+                block_sectors.push_back(0);
+                block_used.push_back(0);
+            }
+            block_sectors[block] = static_cast<uint8_t>(sectors);
+            block_used[block]    = 0;
+            open[sectors].insert(block);
+        }
+        int index = 0;
+        while (block_used[block] & (1u << index)) ++index;
+        block_used[block] |= static_cast<uint8_t>(1u << index);
+        if (Full(block)) open[sectors].erase(block);
+        return MakeSlot(block * kSectorsPerBlock + index * sectors, sectors);
+    }
+
+    /// File offset of a free whole block.
+    int64_t AllocateBlock() {
+        return SlotSector(Allocate(kSectorsPerBlock)) * static_cast<int64_t>(kSector);
+    }
+
+    void Release(uint64_t slot) {
+        int     sectors = SlotSectors(slot);
+        int64_t block   = SlotSector(slot) / kSectorsPerBlock;
+        int     index   = static_cast<int>(SlotSector(slot) % kSectorsPerBlock) / sectors;
+        block_used[block] &= static_cast<uint8_t>(~(1u << index));
+        if (block_used[block] == 0) {
+            open[sectors].erase(block);
+            block_sectors[block] = 0;
+            free_blocks.insert(block);
+        } else {
+            open[sectors].insert(block);
+        }
+    }
+
+    /// Mark @p slot used while loading.  False if it is malformed or
+    /// overlaps a slot already claimed.
+    bool Claim(uint64_t slot) {
+        int sectors = SlotSectors(slot);
+        if (sectors < 1 || sectors > kSectorsPerBlock) return false;
+        int64_t block = SlotSector(slot) / kSectorsPerBlock;
+        int     first = static_cast<int>(SlotSector(slot) % kSectorsPerBlock);
+        if (first % sectors != 0 || first / sectors >= SlotsPerBlock(sectors)) return false;
+        if (block >= static_cast<int64_t>(block_sectors.size())) {
+            block_sectors.resize(block + 1, 0);
+            block_used.resize(block + 1, 0);
+        }
+        auto bit = static_cast<uint8_t>(1u << (first / sectors));
+        if ((block_sectors[block] != 0 && block_sectors[block] != sectors) ||
+            (block_used[block] & bit)) {
+            return false;
+        }
+        block_sectors[block] = static_cast<uint8_t>(sectors);
+        block_used[block] |= bit;
+        return true;
+    }
+
+    /// After loading: file every block that has room.
+    void IndexFreeSpace() {
+        for (int64_t b = 0; b < static_cast<int64_t>(block_sectors.size()); ++b) {
+            if (block_sectors[b] == 0) {
+                free_blocks.insert(b);
+            } else if (!Full(b)) {
+                open[block_sectors[b]].insert(b);
+            }
+        }
+    }
+};
+
 // ============================================================================
 // Construction / destruction
 // ============================================================================
 
-DiskManager::DiskManager(const std::string& path) : path_(path) {
+DiskManager::DiskManager(const std::string& path, PageCompression compression,
+                         DiskBackend backend, IoEngine engine)
+    : path_(path), backend_(backend) {
     fd_ = ::open(path_.c_str(), O_RDWR | O_CREAT, 0666);
     if (fd_ < 0) {
         throw std::runtime_error("DiskManager: cannot open " + path_ +
@@ -43,8 +289,23 @@ DiskManager::DiskManager(const std::string& path) : path_(path) {
         }
     }
 
+    // An existing file says how it stores its pages.
+    compression_ = compression;
+    if (sb.st_size != 0) {
+        int64_t stored = 0;
+        if (::pread(fd_, &stored, sizeof(stored), META_COMPRESSION) != sizeof(stored) ||
+            (stored != static_cast<int64_t>(PageCompression::kNone) &&
+             stored != static_cast<int64_t>(PageCompression::kLZ4))) {
+            ::close(fd_);
+            throw std::runtime_error("DiskManager: " + path_ + " has unknown page compression");
+        }
+        compression_ = static_cast<PageCompression>(stored);
+    }
+
+    // A compressed file, or the direct backend, maps only the metadata page.
+    mapped_size_ = IsCompressed() || backend_ == DiskBackend::kDirect ? PAGE_SIZE : file_size_;
     mapped_ = static_cast<char*>(
-        ::mmap(nullptr, file_size_, PROT_READ | PROT_WRITE, MAP_SHARED, fd_, 0));
+        ::mmap(nullptr, mapped_size_, PROT_READ | PROT_WRITE, MAP_SHARED, fd_, 0));
 
     if (mapped_ == MAP_FAILED) {
         mapped_ = nullptr;
@@ -58,14 +319,46 @@ DiskManager::DiskManager(const std::string& path) : path_(path) {
         SetRootOffset(INVALID_PAGE_ID);
         SetNextPageOffset(PAGE_SIZE);
         SetFreeListHead(INVALID_PAGE_ID);
+        SetFormatVersion(FILE_FORMAT_VERSION);
+        WriteMeta(META_COMPRESSION, static_cast<int64_t>(compression_));
+        WriteMeta(META_PAGE_MAP, 0);
         FlushMetadata();
     }
+
+    if (backend_ == DiskBackend::kDirect && !IsCompressed()) {
+        // A second descriptor, so page 0 stays with the mapping.
+        io_fd_ = ::open(path_.c_str(), O_RDWR | O_DIRECT);
+        direct_io_ = io_fd_ >= 0;
+        if (io_fd_ < 0 && errno == EINVAL) io_fd_ = fd_;  // no O_DIRECT here
+        if (io_fd_ < 0) {
+            int err = errno;
+            ::munmap(mapped_, mapped_size_);
+            ::close(fd_);
+            throw std::runtime_error("DiskManager: cannot open " + path_ +
+                                     " for direct I/O: " + std::strerror(err));
+        }
+        if (engine == IoEngine::kUring) ring_ = std::make_unique<IoRing>(IoEngine::kUring);
+    }
+
+    if (IsCompressed()) {
+        packed_ = std::make_unique<PackedPages>();
+        try {
+            LoadPageMap();
+        } catch (...) {
+            ::munmap(mapped_, mapped_size_);
+            ::close(fd_);
+            throw;
+        }
+    }
 }
 
 DiskManager::~DiskManager() {
     if (mapped_) {
         Sync();
-        ::munmap(mapped_, file_size_);
+        ::munmap(mapped_, mapped_size_);
+    }
+    if (io_fd_ >= 0 && io_fd_ != fd_) {
+        ::close(io_fd_);
     }
     if (fd_ >= 0) {
         ::close(fd_);
@@ -77,6 +370,8 @@ DiskManager::~DiskManager() {
 // ============================================================================
 
 char* DiskManager::PageData(int64_t offset) {
+    if (packed_) throw std::logic_error("DiskManager::PageData: pages are compressed");
+    if (!MapsPages()) throw std::logic_error("DiskManager::PageData: pages are not mapped");
     if (offset < 0 || static_cast<size_t>(offset + PAGE_SIZE) > file_size_) {
         throw std::out_of_range("DiskManager::PageData: offset out of range");
     }
@@ -84,28 +379,240 @@ char* DiskManager::PageData(int64_t offset) {
 }
 
 const char* DiskManager::PageData(int64_t offset) const {
+    if (packed_) throw std::logic_error("DiskManager::PageData: pages are compressed");
+    if (!MapsPages()) throw std::logic_error("DiskManager::PageData: pages are not mapped");
     if (offset < 0 || static_cast<size_t>(offset + PAGE_SIZE) > file_size_) {
         throw std::out_of_range("DiskManager::PageData: offset out of range");
     }
     return mapped_ + offset;
 }
 
+void DiskManager::ReadPage(int64_t offset, char* out) const {
+    std::shared_lock<std::shared_mutex> guard(latch_);
+    ReadPageLocked(offset, out);
+}
+
+void DiskManager::WritePage(int64_t offset, const char* data) {
+    if (!packed_) {
+        std::shared_lock<std::shared_mutex> guard(latch_);
+        WritePageLocked(offset, data);
+        return;
+    }
+    std::unique_lock<std::shared_mutex> guard(latch_);
+    WritePageLocked(offset, data);
+}
+
+void DiskManager::ReadPageLocked(int64_t offset, char* out) const {
+    if (MapsPages() || offset == 0) {
+        std::memcpy(out, MapsPages() ? PageData(offset) : mapped_, PAGE_SIZE);
+        return;
+    }
+    if (offset < 0 || offset % PAGE_SIZE != 0 ||
+        static_cast<size_t>(offset + PAGE_SIZE) > file_size_) {
+        throw std::out_of_range("DiskManager::ReadPage: offset out of range");
+    }
+    if (!packed_) {
+        ReadDirect(offset, out);
+        return;
+    }
+    uint64_t slot = packed_->map[offset / PAGE_SIZE];
+    if (slot == 0) {
+        std::memset(out, 0, PAGE_SIZE);
+        return;
+    }
+    int64_t at      = SlotSector(slot) * static_cast<int64_t>(kSector);
+    int     sectors = SlotSectors(slot);
+    if (sectors == kSectorsPerBlock) {
+        PRead(fd_, out, PAGE_SIZE, at);
+        return;
+    }
+    char buf[PAGE_SIZE];
+    PRead(fd_, buf, sectors * kSector, at);
+    uint16_t len;
+    std::memcpy(&len, buf, sizeof(len));
+    if (len + 2u > sectors * kSector || !LZ4Decompress(buf + 2, len, out, PAGE_SIZE)) {
+        throw std::runtime_error("DiskManager: corrupt compressed page at offset " +
+                                 std::to_string(offset));
+    }
+}
+
+void DiskManager::WritePageLocked(int64_t offset, const char* data) {
+    if (MapsPages() || offset == 0) {
+        std::memcpy(MapsPages() ? PageData(offset) : mapped_, data, PAGE_SIZE);
+        return;
+    }
+    if (offset < 0 || offset % PAGE_SIZE != 0 ||
+        static_cast<size_t>(offset + PAGE_SIZE) > file_size_) {
+        throw std::out_of_range("DiskManager::WritePage: offset out of range");
+    }
+    if (!packed_) {
+        WriteDirect(offset, data);
+        return;
+    }
+    // Always to a fresh slot: the map on disk may still point at the old
+    // one until the next Sync.
+    char buf[PAGE_SIZE];
+    int      sectors = PackPage(data, buf);
+    uint64_t slot    = packed_->Allocate(sectors);
+    PWrite(fd_, buf, sectors * kSector, SlotSector(slot) * static_cast<int64_t>(kSector));
+    packed_->Assign(static_cast<size_t>(offset / PAGE_SIZE), slot);
+}
+
+void DiskManager::ReadPages(const int64_t* offsets, char* const* out, size_t count) const {
+    std::shared_lock<std::shared_mutex> guard(latch_);
+    std::vector<IoRequest> reqs;
+    for (size_t i = 0; i < count; ++i) {
+        if (!UsesIoUring() || !BatchablePage(offsets[i], out[i])) {
+            ReadPageLocked(offsets[i], out[i]);
+            continue;
+        }
+        reqs.push_back({IoOp::kRead, io_fd_, out[i], PAGE_SIZE, offsets[i]});
+    }
+    SubmitPages(reqs);
+}
+
+void DiskManager::WritePages(const int64_t* offsets, const char* const* data, size_t count) {
+    if (packed_ || backend_ != DiskBackend::kDirect) {
+        for (size_t i = 0; i < count; ++i) WritePage(offsets[i], data[i]);
+        return;
+    }
+    std::shared_lock<std::shared_mutex> guard(latch_);
+    if (!UsesIoUring()) {
+        WriteRuns(offsets, data, count);
+        return;
+    }
+    std::vector<IoRequest> reqs;
+    for (size_t i = 0; i < count; ++i) {
+        if (!BatchablePage(offsets[i], data[i])) {
+            WritePageLocked(offsets[i], data[i]);
+            continue;
+        }
+        reqs.push_back({IoOp::kWrite, io_fd_, const_cast<char*>(data[i]), PAGE_SIZE, offsets[i]});
+    }
+    SubmitPages(reqs);
+}
+
+void DiskManager::WriteRuns(const int64_t* offsets, const char* const* data, size_t count) {
+    iovec iov[kMaxRun];
+    for (size_t i = 0; i < count;) {
+        if (!BatchablePage(offsets[i], data[i])) {
+            WritePageLocked(offsets[i], data[i]);
+            ++i;
+            continue;
+        }
+        int run = 0;
+        for (; i + run < count && run < kMaxRun; ++run) {
+            size_t j = i + run;
+            if (run > 0 && (offsets[j] != offsets[j - 1] + static_cast<int64_t>(PAGE_SIZE) ||
+                            !BatchablePage(offsets[j], data[j]))) {
+                break;
+            }
+            iov[run] = {const_cast<char*>(data[j]), PAGE_SIZE};
+        }
+        PWriteV(io_fd_, iov, run, offsets[i]);
+        i += static_cast<size_t>(run);
+    }
+}
+
+bool DiskManager::BatchablePage(int64_t offset, const char* buf) const {
+    if (offset <= 0 || offset % PAGE_SIZE != 0 ||
+        static_cast<size_t>(offset + PAGE_SIZE) > file_size_) {
+        return false;  // the metadata page, or an error to report
+    }
+    return reinterpret_cast<uintptr_t>(buf) % PAGE_SIZE == 0;
+}
+
+void DiskManager::SubmitPages(std::vector<IoRequest>& reqs) const {
+    if (reqs.empty()) return;
+    ring_->Submit(reqs.data(), reqs.size());
+    for (const IoRequest& r : reqs) {
+        if (r.result != static_cast<ssize_t>(PAGE_SIZE)) {
+            int err = r.result < 0 ? static_cast<int>(-r.result) : EIO;
+            throw std::runtime_error(std::string("DiskManager: ") +
+                                     (r.op == IoOp::kRead ? "read" : "write") +
+                                     " failed at offset " + std::to_string(r.offset) + ": " +
+                                     std::strerror(err));
+        }
+    }
+}
+
+void DiskManager::ReadDirect(int64_t offset, char* out) const {
+    if (reinterpret_cast<uintptr_t>(out) % PAGE_SIZE == 0) {
+        PRead(io_fd_, out, PAGE_SIZE, offset);
+        return;
+    }
+    alignas(PAGE_SIZE) char bounce[PAGE_SIZE];
+    PRead(io_fd_, bounce, PAGE_SIZE, offset);
+    std::memcpy(out, bounce, PAGE_SIZE);
+}
+
+void DiskManager::WriteDirect(int64_t offset, const char* data) {
+    if (reinterpret_cast<uintptr_t>(data) % PAGE_SIZE == 0) {
+        PWrite(io_fd_, data, PAGE_SIZE, offset);
+        return;
+    }
+    alignas(PAGE_SIZE) char bounce[PAGE_SIZE];
+    std::memcpy(bounce, data, PAGE_SIZE);
+    PWrite(io_fd_, bounce, PAGE_SIZE, offset);
+}
+
+void DiskManager::WillNeed(int64_t offset, size_t count) const {
+    std::shared_lock<std::shared_mutex> guard(latch_);
+    if (offset < 0 || static_cast<size_t>(offset) >= file_size_ || direct_io_) return;
+    if (!MapsPages() && !packed_) {
+        ::posix_fadvise(io_fd_, static_cast<off_t>(offset),
+                        static_cast<off_t>(count * PAGE_SIZE), POSIX_FADV_WILLNEED);
+        return;
+    }
+    if (packed_) {
+        size_t first = static_cast<size_t>(offset) / PAGE_SIZE;
+        size_t last  = std::min(first + count, file_size_ / PAGE_SIZE);
+        for (size_t page = first; page < last; ++page) {
+            uint64_t slot = packed_->map[page];
+            if (slot == 0) continue;
+            ::posix_fadvise(fd_, static_cast<off_t>(SlotSector(slot) * kSector),
+                            static_cast<off_t>(SlotSectors(slot) * kSector), POSIX_FADV_WILLNEED);
+        }
+        return;
+    }
+    size_t len = std::min(count * PAGE_SIZE, file_size_ - static_cast<size_t>(offset));
+
+    // madvise wants a start aligned to the system page size.
+    static const size_t sys_page = static_cast<size_t>(::sysconf(_SC_PAGESIZE));
+    size_t start = static_cast<size_t>(offset) / sys_page * sys_page;
+    ::madvise(mapped_ + start, len + (static_cast<size_t>(offset) - start), MADV_WILLNEED);
+}
+
 int64_t DiskManager::AllocatePage() {
+    std::unique_lock<std::shared_mutex> guard(latch_);
+
     // Try to reuse a freed page first.
-    int64_t reclaimed = ReclaimPage();
+    int64_t reclaimed = ReclaimPageLocked();
     if (reclaimed != INVALID_PAGE_ID) {
-        std::memset(mapped_ + reclaimed, 0, PAGE_SIZE);
+        if (packed_) {
+            packed_->Assign(static_cast<size_t>(reclaimed / PAGE_SIZE), 0);
+        } else if (!MapsPages()) {
+            alignas(PAGE_SIZE) static const char zeros[PAGE_SIZE] = {};
+            WriteDirect(reclaimed, zeros);
+        } else {
+            std::memset(mapped_ + reclaimed, 0, PAGE_SIZE);
+        }
         return reclaimed;
     }
 
-    int64_t next = NextPageOffset();
+    int64_t next = ReadMeta(META_NEXT_PAGE);
     int64_t new_next = next + static_cast<int64_t>(PAGE_SIZE);
     EnsureCapacity(new_next);
 
-    // Zero out the fresh page.
-    std::memset(mapped_ + next, 0, PAGE_SIZE);
+    // Zero out the fresh page (a compressed file has no slot for it yet).
+    if (MapsPages()) {
+        std::memset(mapped_ + next, 0, PAGE_SIZE);
+    } else if (!packed_) {
+        alignas(PAGE_SIZE) static const char zeros[PAGE_SIZE] = {};
+        WriteDirect(next, zeros);
+    }
 
-    SetNextPageOffset(new_next);
+    WriteMeta(META_NEXT_PAGE, new_next);
     return next;
 }
 
@@ -113,27 +620,59 @@ int64_t DiskManager::AllocatePage() {
 // Metadata helpers (page 0)
 // ============================================================================
 
-int64_t DiskManager::RootOffset() const {
+int64_t DiskManager::ReadMeta(size_t field) const {
     int64_t v;
-    std::memcpy(&v, mapped_ + META_ROOT_OFFSET, sizeof(v));
+    std::memcpy(&v, mapped_ + field, sizeof(v));
     return v;
 }
 
+void DiskManager::WriteMeta(size_t field, int64_t value) {
+    std::memcpy(mapped_ + field, &value, sizeof(value));
+}
+
+int64_t DiskManager::RootOffset() const {
+    std::shared_lock<std::shared_mutex> guard(latch_);
+    return ReadMeta(META_ROOT_OFFSET);
+}
+
 void DiskManager::SetRootOffset(int64_t offset) {
-    std::memcpy(mapped_ + META_ROOT_OFFSET, &offset, sizeof(offset));
+    std::shared_lock<std::shared_mutex> guard(latch_);
+    WriteMeta(META_ROOT_OFFSET, offset);
 }
 
 int64_t DiskManager::NextPageOffset() const {
-    int64_t v;
-    std::memcpy(&v, mapped_ + META_NEXT_PAGE, sizeof(v));
-    return v;
+    std::shared_lock<std::shared_mutex> guard(latch_);
+    return ReadMeta(META_NEXT_PAGE);
 }
 
 void DiskManager::SetNextPageOffset(int64_t offset) {
-    std::memcpy(mapped_ + META_NEXT_PAGE, &offset, sizeof(offset));
+    std::shared_lock<std::shared_mutex> guard(latch_);
+    WriteMeta(META_NEXT_PAGE, offset);
+}
+
+int64_t DiskManager::FormatVersion() const {
+    std::shared_lock<std::shared_mutex> guard(latch_);
+    return ReadMeta(META_FORMAT_VERSION);
+}
+
+void DiskManager::SetFormatVersion(int64_t version) {
+    std::shared_lock<std::shared_mutex> guard(latch_);
+    WriteMeta(META_FORMAT_VERSION, version);
+}
+
+size_t DiskManager::KeySize() const {
+    std::shared_lock<std::shared_mutex> guard(latch_);
+    int64_t size = ReadMeta(META_KEY_SIZE);
+    return size > 0 ? static_cast<size_t>(size) : sizeof(int);
+}
+
+void DiskManager::SetKeySize(size_t size) {
+    std::shared_lock<std::shared_mutex> guard(latch_);
+    WriteMeta(META_KEY_SIZE, static_cast<int64_t>(size));
 }
 
 void DiskManager::FlushMetadata() {
+    std::shared_lock<std::shared_mutex> guard(latch_);
     ::msync(mapped_, PAGE_SIZE, MS_SYNC);
 }
 
@@ -142,48 +681,188 @@ void DiskManager::FlushMetadata() {
 // ============================================================================
 
 int64_t DiskManager::FreeListHead() const {
-    int64_t v;
-    std::memcpy(&v, mapped_ + META_FREE_LIST_HEAD, sizeof(v));
-    return v;
+    std::shared_lock<std::shared_mutex> guard(latch_);
+    return ReadMeta(META_FREE_LIST_HEAD);
 }
 
 void DiskManager::SetFreeListHead(int64_t offset) {
-    std::memcpy(mapped_ + META_FREE_LIST_HEAD, &offset, sizeof(offset));
+    std::shared_lock<std::shared_mutex> guard(latch_);
+    WriteMeta(META_FREE_LIST_HEAD, offset);
 }
 
 void DiskManager::FreePage(int64_t page_offset) {
     if (page_offset < static_cast<int64_t>(PAGE_SIZE)) return;  // don't free metadata page
 
+    std::unique_lock<std::shared_mutex> guard(latch_);
+
     // Push onto the free-list: store current head as this page's "next".
-    int64_t old_head = FreeListHead();
-    std::memcpy(mapped_ + page_offset + FREE_PAGE_NEXT_OFFSET, &old_head, sizeof(old_head));
-    SetFreeListHead(page_offset);
+    int64_t old_head = ReadMeta(META_FREE_LIST_HEAD);
+    if (!MapsPages()) {
+        char page[PAGE_SIZE] = {};
+        std::memcpy(page + FREE_PAGE_NEXT_OFFSET, &old_head, sizeof(old_head));
+        WritePageLocked(page_offset, page);
+    } else {
+        std::memcpy(mapped_ + page_offset + FREE_PAGE_NEXT_OFFSET, &old_head, sizeof(old_head));
+    }
+    WriteMeta(META_FREE_LIST_HEAD, page_offset);
 }
 
 int64_t DiskManager::ReclaimPage() {
-    int64_t head = FreeListHead();
+    std::unique_lock<std::shared_mutex> guard(latch_);
+    return ReclaimPageLocked();
+}
+
+int64_t DiskManager::ReclaimPageLocked() {
+    int64_t head = ReadMeta(META_FREE_LIST_HEAD);
     if (head == INVALID_PAGE_ID) return INVALID_PAGE_ID;
 
     // Pop from the free-list.
     int64_t next;
-    std::memcpy(&next, mapped_ + head + FREE_PAGE_NEXT_OFFSET, sizeof(next));
-    SetFreeListHead(next);
+    if (!MapsPages()) {
+        char page[PAGE_SIZE];
+        ReadPageLocked(head, page);
+        std::memcpy(&next, page + FREE_PAGE_NEXT_OFFSET, sizeof(next));
+    } else {
+        std::memcpy(&next, mapped_ + head + FREE_PAGE_NEXT_OFFSET, sizeof(next));
+    }
+    WriteMeta(META_FREE_LIST_HEAD, next);
     return head;
 }
 
+void DiskManager::Truncate(int64_t end) {
+    end = std::max<int64_t>(end, PAGE_SIZE);
+    std::unique_lock<std::shared_mutex> guard(latch_);
+    int64_t next = ReadMeta(META_NEXT_PAGE);
+    if (end >= next) return;
+
+    WriteMeta(META_NEXT_PAGE, end);
+    ::msync(mapped_, PAGE_SIZE, MS_SYNC);
+
+    if (packed_) {
+        for (int64_t page = end; page < next; page += PAGE_SIZE) {
+            packed_->Assign(static_cast<size_t>(page / PAGE_SIZE), 0);
+        }
+        return;
+    }
+
+    if (!MapsPages()) {
+        if (::ftruncate(fd_, static_cast<off_t>(end)) != 0) {
+            throw std::runtime_error("DiskManager::Truncate: ftruncate failed");
+        }
+        file_size_ = static_cast<size_t>(end);
+        return;
+    }
+
+    // Cut the file under a fresh mapping, as EnsureCapacity grows it.
+    ::msync(mapped_, mapped_size_, MS_SYNC);
+    ::munmap(mapped_, mapped_size_);
+    mapped_ = nullptr;
+    if (::ftruncate(fd_, static_cast<off_t>(end)) != 0) {
+        throw std::runtime_error("DiskManager::Truncate: ftruncate failed");
+    }
+    mapped_ = static_cast<char*>(
+        ::mmap(nullptr, static_cast<size_t>(end), PROT_READ | PROT_WRITE, MAP_SHARED, fd_, 0));
+    if (mapped_ == MAP_FAILED) {
+        mapped_ = nullptr;
+        throw std::runtime_error("DiskManager::Truncate: mmap failed");
+    }
+    file_size_   = static_cast<size_t>(end);
+    mapped_size_ = static_cast<size_t>(end);
+}
+
 // ============================================================================
 // Sync
 // ============================================================================
 
 void DiskManager::Sync() {
+    if (packed_) {
+        std::unique_lock<std::shared_mutex> guard(latch_);
+        SyncPacked();
+        return;
+    }
+    std::shared_lock<std::shared_mutex> guard(latch_);
+    if (!MapsPages() && ::fdatasync(io_fd_) != 0) {
+        throw std::runtime_error("DiskManager: fdatasync failed: " +
+                                 std::string(std::strerror(errno)));
+    }
     if (mapped_) {
-        ::msync(mapped_, file_size_, MS_SYNC);
+        ::msync(mapped_, mapped_size_, MS_SYNC);
     }
 }
 
 void DiskManager::SyncAsync() {
+    std::shared_lock<std::shared_mutex> guard(latch_);
     if (mapped_) {
-        ::msync(mapped_, file_size_, MS_ASYNC);
+        ::msync(mapped_, mapped_size_, MS_ASYNC);
+    }
+}
+
+size_t DiskManager::StoredSize() const {
+    std::shared_lock<std::shared_mutex> guard(latch_);
+    if (!packed_) return file_size_;
+    struct stat sb{};
+    return ::fstat(fd_, &sb) == 0 ? static_cast<size_t>(sb.st_size) : 0;
+}
+
+// ============================================================================
+// Page map (compressed files)
+// ============================================================================
+
+void DiskManager::LoadPageMap() {
+    PackedPages& p = *packed_;
+    p.fd   = fd_;
+    p.meta = mapped_;
+    p.Claim(BlockSlot(0));  // the metadata page
+    p.Grow(static_cast<size_t>(std::max<int64_t>(ReadMeta(META_NEXT_PAGE), PAGE_SIZE)) / PAGE_SIZE);
+
+    auto corrupt = [&] {
+        return std::runtime_error("DiskManager: " + path_ + " has a corrupt page map");
+    };
+    std::vector<int64_t> entries(kMapEntries);
+    size_t m = 0;
+    for (int64_t dir = ReadMeta(META_PAGE_MAP); dir != 0; dir = entries[0]) {
+        if (dir < 0 || dir % PAGE_SIZE != 0 || !p.Claim(BlockSlot(dir))) throw corrupt();
+        p.dir_blocks.push_back(dir);
+        PRead(fd_, entries.data(), PAGE_SIZE, dir);
+        for (size_t i = 1; i <= kDirEntries; ++i, ++m) {
+            int64_t block = entries[i];
+            if (block == 0) continue;
+            if (block < 0 || block % PAGE_SIZE != 0 || !p.Claim(BlockSlot(block))) throw corrupt();
+            p.Grow((m + 1) * kMapEntries);
+            p.map_blocks[m] = block;
+            PRead(fd_, p.map.data() + m * kMapEntries, PAGE_SIZE, block);
+        }
+    }
+    for (uint64_t slot : p.map) {
+        if (slot != 0 && !p.Claim(slot)) throw corrupt();
+    }
+    p.IndexFreeSpace();
+    file_size_ = p.map.size() * PAGE_SIZE;
+}
+
+void DiskManager::SyncPacked() {
+    PackedPages& p = *packed_;
+    if (::fdatasync(fd_) != 0) {
+        throw std::runtime_error("DiskManager: fdatasync failed: " +
+                                 std::string(std::strerror(errno)));
+    }
+    ::msync(mapped_, PAGE_SIZE, MS_SYNC);
+
+    // The map on disk no longer refers to the replaced slots.
+    for (uint64_t slot : p.released) p.Release(slot);
+    p.released.clear();
+
+    // Give free blocks at the end of the file back.
+    size_t blocks = p.block_sectors.size();
+    while (blocks > 1 && p.block_sectors[blocks - 1] == 0) {
+        p.free_blocks.erase(static_cast<int64_t>(--blocks));
+    }
+    if (blocks < p.block_sectors.size()) {
+        p.block_sectors.resize(blocks);
+        p.block_used.resize(blocks);
+        if (::ftruncate(fd_, static_cast<off_t>(blocks * PAGE_SIZE)) != 0) {
+            throw std::runtime_error("DiskManager: ftruncate failed");
+        }
     }
 }
 
@@ -194,16 +873,32 @@ void DiskManager::SyncAsync() {
 void DiskManager::EnsureCapacity(int64_t required) {
     if (required <= static_cast<int64_t>(file_size_)) return;
 
+    // A compressed file only needs map entries; pages take space as written.
+    if (packed_) {
+        packed_->Grow(static_cast<size_t>(required) / PAGE_SIZE);
+        file_size_ = packed_->map.size() * PAGE_SIZE;
+        return;
+    }
+
     // Grow geometrically (at least double, minimum 1 MB) to avoid
-    // frequent ftruncate + mmap cycles during bulk inserts.
+    // frequent ftruncate + mmap cycles during bulk inserts.  The direct
+    // backend only extends the file.
     size_t min_size = ((static_cast<size_t>(required) + PAGE_SIZE - 1) / PAGE_SIZE) * PAGE_SIZE;
     size_t new_size = std::max(min_size, std::max(file_size_ * 2, static_cast<size_t>(1 << 20)));
     new_size = ((new_size + PAGE_SIZE - 1) / PAGE_SIZE) * PAGE_SIZE;
 
+    if (!MapsPages()) {
+        if (::ftruncate(fd_, static_cast<off_t>(new_size)) != 0) {
+            throw std::runtime_error("DiskManager::EnsureCapacity: ftruncate failed");
+        }
+        file_size_ = new_size;
+        return;
+    }
+
     // Flush and unmap current region.
     if (mapped_) {
-        ::msync(mapped_, file_size_, MS_ASYNC);
-        ::munmap(mapped_, file_size_);
+        ::msync(mapped_, mapped_size_, MS_ASYNC);
+        ::munmap(mapped_, mapped_size_);
         mapped_ = nullptr;
     }
 
@@ -221,7 +916,8 @@ void DiskManager::EnsureCapacity(int64_t required) {
         throw std::runtime_error("DiskManager::EnsureCapacity: mmap failed");
     }
 
-    file_size_ = new_size;
+    file_size_   = new_size;
+    mapped_size_ = new_size;
 }
 
 }  // namespace bptree
@@ -0,0 +1,117 @@
+/// @file frame_arena.cpp
+/// @brief FrameArena implementation — anonymous mappings, madvise, mbind.
+
+#include "bptree/frame_arena.h"
+
+#include <algorithm>
+#include <fstream>
+#include <new>
+#include <sstream>
+#include <string>
+
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#ifndef MAP_HUGE_SHIFT
+#define MAP_HUGE_SHIFT 26
+#endif
+
+namespace bptree {
+
+namespace {
+
+constexpr size_t kHugePage2M = size_t{2} << 20;
+constexpr size_t kHugePage1G = size_t{1} << 30;
+
+/// mbind(2) mode: allocate on the given node while it has memory.
+constexpr int kMpolPreferred = 1;
+
+size_t RoundUp(size_t n, size_t to) { return (n + to - 1) / to * to; }
+
+/// Map @p bytes of anonymous memory from the hugetlbfs pool of
+/// @p page_size pages.  @return nullptr if there are not enough.
+char* MapHuge(size_t bytes, size_t page_size) {
+    int log2 = page_size == kHugePage1G ? 30 : 21;
+    void* p = ::mmap(nullptr, bytes, PROT_READ | PROT_WRITE,
+                     MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB | (log2 << MAP_HUGE_SHIFT),
+                     -1, 0);
+    return p == MAP_FAILED ? nullptr : static_cast<char*>(p);
+}
+
+}  // namespace
+
+FrameArena::FrameArena(size_t frames, HugePages huge_pages) : frames_(frames) {
+    size_t bytes = std::max<size_t>(frames, 1) * PAGE_SIZE;
+
+    if (huge_pages == HugePages::kExplicit) {
+        for (size_t page : {kHugePage1G, kHugePage2M}) {
+            if (page == kHugePage1G && bytes < kHugePage1G) continue;
+            size_t rounded = RoundUp(bytes, page);
+            if ((base_ = MapHuge(rounded, page)) != nullptr) {
+                bytes_     = rounded;
+                page_size_ = page;
+                backing_   = HugePages::kExplicit;
+                return;
+            }
+        }
+        huge_pages = HugePages::kTransparent;
+    }
+
+    // Rounded to whole huge pages either way, so the last one can be huge.
+    bytes_ = huge_pages == HugePages::kTransparent ? RoundUp(bytes, kHugePage2M) : bytes;
+    void* p = ::mmap(nullptr, bytes_, PROT_READ | PROT_WRITE,
+                     MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (p == MAP_FAILED) throw std::bad_alloc();
+    base_ = static_cast<char*>(p);
+    if (huge_pages == HugePages::kTransparent &&
+        ::madvise(base_, bytes_, MADV_HUGEPAGE) == 0) {
+        page_size_ = kHugePage2M;
+        backing_   = HugePages::kTransparent;
+    }
+}
+
+FrameArena::~FrameArena() {
+    if (base_) ::munmap(base_, bytes_);
+}
+
+bool FrameArena::BindToNode(size_t begin, size_t end, int node) {
+    if (node < 0 || node >= 1024) return false;
+
+    // mbind works on whole pages of the mapping.
+    size_t from = RoundUp(begin * PAGE_SIZE, page_size_);
+    size_t to   = std::min(end * PAGE_SIZE, bytes_) / page_size_ * page_size_;
+    if (from >= to) return true;  // nothing of its own to move
+
+    unsigned long mask[1024 / (8 * sizeof(unsigned long))] = {};
+    mask[node / (8 * sizeof(unsigned long))] |= 1UL << (node % (8 * sizeof(unsigned long)));
+    long rc = ::syscall(SYS_mbind, base_ + from, to - from, kMpolPreferred, mask,
+                        sizeof(mask) * 8 + 1, 0U);
+    return rc == 0;
+}
+
+std::vector<int> FrameArena::NumaNodes() {
+    // A list of ranges, e.g. "0-1,4".
+    std::ifstream in("/sys/devices/system/node/online");
+    std::string list;
+    std::vector<int> nodes;
+    if (in && std::getline(in, list)) {
+        std::stringstream ranges(list);
+        std::string range;
+        while (std::getline(ranges, range, ',')) {
+            size_t dash = range.find('-');
+            try {
+                int lo = std::stoi(range.substr(0, dash));
+                int hi = dash == std::string::npos ? lo : std::stoi(range.substr(dash + 1));
+                for (int n = lo; n <= hi && n < 1024; ++n) nodes.push_back(n);
+            } catch (const std::exception&) {
+                nodes.clear();
+                break;
+            }
+        }
+    }
+    if (nodes.empty()) nodes.push_back(0);
+    return nodes;
+}
+
+}  // namespace bptree
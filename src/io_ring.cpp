@@ -0,0 +1,244 @@
+/// @file io_ring.cpp
+/// @brief IoRing implementation — raw io_uring system calls.
+
+#include "bptree/io_ring.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+namespace bptree {
+
+namespace {
+
+int SetupRing(unsigned entries, io_uring_params* p) {
+    return static_cast<int>(::syscall(__NR_io_uring_setup, entries, p));
+}
+
+int EnterRing(int fd, unsigned to_submit, unsigned min_complete) {
+    return static_cast<int>(::syscall(__NR_io_uring_enter, fd, to_submit, min_complete,
+                                      IORING_ENTER_GETEVENTS, nullptr, 0));
+}
+
+unsigned* At(void* base, uint32_t offset) {
+    return reinterpret_cast<unsigned*>(static_cast<char*>(base) + offset);
+}
+
+/// Run what is left of @p r synchronously: the bytes past a short
+/// transfer, or all of it.
+void Finish(IoRequest& r, size_t done) {
+    if (r.op == IoOp::kSync) {
+        r.result = ::fdatasync(r.fd) == 0 ? 0 : -errno;
+        return;
+    }
+    auto* p = static_cast<char*>(r.buf);
+    while (done < r.len) {
+        ssize_t n;
+        if (r.op == IoOp::kRead) {
+            n = r.offset < 0 ? ::read(r.fd, p + done, r.len - done)
+                             : ::pread(r.fd, p + done, r.len - done,
+                                       static_cast<off_t>(r.offset + static_cast<int64_t>(done)));
+        } else {
+            n = r.offset < 0 ? ::write(r.fd, p + done, r.len - done)
+                             : ::pwrite(r.fd, p + done, r.len - done,
+                                        static_cast<off_t>(r.offset + static_cast<int64_t>(done)));
+        }
+        if (n < 0 && errno == EINTR) continue;
+        if (n < 0) {
+            r.result = -errno;
+            return;
+        }
+        if (n == 0) break;  // end of file
+        done += static_cast<size_t>(n);
+    }
+    r.result = static_cast<ssize_t>(done);
+}
+
+}  // namespace
+
+// ============================================================================
+// Construction / destruction
+// ============================================================================
+
+IoRing::IoRing(IoEngine engine, unsigned entries) {
+    if (engine != IoEngine::kUring) return;
+
+    io_uring_params p{};
+    int fd = SetupRing(entries, &p);
+    if (fd < 0) return;
+
+    // IORING_OP_READ / WRITE and offset -1 arrived together (5.6).
+    if (!(p.features & IORING_FEAT_RW_CUR_POS)) {
+        ::close(fd);
+        return;
+    }
+
+    sq_ring_size_ = p.sq_off.array + p.sq_entries * sizeof(unsigned);
+    cq_ring_size_ = p.cq_off.cqes + p.cq_entries * sizeof(io_uring_cqe);
+    bool single = p.features & IORING_FEAT_SINGLE_MMAP;
+    if (single) sq_ring_size_ = cq_ring_size_ = std::max(sq_ring_size_, cq_ring_size_);
+
+    sq_ring_ = ::mmap(nullptr, sq_ring_size_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                      fd, IORING_OFF_SQ_RING);
+    cq_ring_ = single ? sq_ring_
+                      : ::mmap(nullptr, cq_ring_size_, PROT_READ | PROT_WRITE,
+                               MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_CQ_RING);
+    sqes_size_ = p.sq_entries * sizeof(io_uring_sqe);
+    sqes_ = ::mmap(nullptr, sqes_size_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                   fd, IORING_OFF_SQES);
+    if (sq_ring_ == MAP_FAILED || cq_ring_ == MAP_FAILED || sqes_ == MAP_FAILED) {
+        if (sqes_ != MAP_FAILED) ::munmap(sqes_, sqes_size_);
+        if (!single && cq_ring_ != MAP_FAILED) ::munmap(cq_ring_, cq_ring_size_);
+        if (sq_ring_ != MAP_FAILED) ::munmap(sq_ring_, sq_ring_size_);
+        sq_ring_ = cq_ring_ = sqes_ = nullptr;
+        ::close(fd);
+        return;
+    }
+
+    sq_tail_  = At(sq_ring_, p.sq_off.tail);
+    sq_mask_  = At(sq_ring_, p.sq_off.ring_mask);
+    sq_array_ = At(sq_ring_, p.sq_off.array);
+    cq_head_  = At(cq_ring_, p.cq_off.head);
+    cq_tail_  = At(cq_ring_, p.cq_off.tail);
+    cq_mask_  = At(cq_ring_, p.cq_off.ring_mask);
+    cqes_     = static_cast<char*>(cq_ring_) + p.cq_off.cqes;
+    entries_  = p.sq_entries;
+    ring_fd_  = fd;
+    async_    = true;
+}
+
+IoRing::~IoRing() {
+    if (ring_fd_ < 0) return;
+    ::munmap(sqes_, sqes_size_);
+    if (cq_ring_ != sq_ring_) ::munmap(cq_ring_, cq_ring_size_);
+    ::munmap(sq_ring_, sq_ring_size_);
+    ::close(ring_fd_);
+}
+
+// ============================================================================
+// Submission
+// ============================================================================
+
+void IoRing::Submit(IoRequest* reqs, size_t count) {
+    std::lock_guard<std::mutex> guard(latch_);
+
+    // A batch of up to one ring at a time.  Each chunk is finished before
+    // the next goes in, so links hold across chunk boundaries too.
+    bool chain_failed = false;
+    for (size_t start = 0; start < count;) {
+        // Requests behind a failed link are not run.
+        if (chain_failed) {
+            reqs[start].result = -ECANCELED;
+            chain_failed = reqs[start].link;
+            ++start;
+            continue;
+        }
+
+        size_t n = std::min<size_t>(count - start, async_ ? entries_ : 0);
+        if (n > 0) {
+            SubmitRing(reqs + start, n);
+        } else {
+            n = count - start;
+            for (size_t i = 0; i < n; ++i) reqs[start + i].result = -ECANCELED;
+        }
+
+        // Complete short transfers and run canceled requests in order; a
+        // link was canceled only because its predecessor stopped short.
+        for (size_t i = start; i < start + n; ++i) {
+            IoRequest& r = reqs[i];
+            if (chain_failed) {
+                r.result = -ECANCELED;
+            } else if (r.result == -ECANCELED || r.result == -EAGAIN || r.result == -EINTR) {
+                Finish(r, 0);
+            } else if (r.result >= 0 && r.op != IoOp::kSync &&
+                       static_cast<size_t>(r.result) < r.len) {
+                Finish(r, static_cast<size_t>(r.result));
+            }
+            bool ok = r.result >= 0 &&
+                      (r.op == IoOp::kSync || static_cast<size_t>(r.result) == r.len);
+            chain_failed = r.link && !ok;
+        }
+        start += n;
+    }
+}
+
+void IoRing::SubmitRing(IoRequest* reqs, size_t count) {
+    auto* sqes = static_cast<io_uring_sqe*>(sqes_);
+    auto* cqes = static_cast<io_uring_cqe*>(cqes_);
+
+    unsigned tail = *sq_tail_;  // we are the only producer
+    unsigned mask = *sq_mask_;
+    for (size_t i = 0; i < count; ++i) {
+        const IoRequest& r = reqs[i];
+        unsigned idx = tail & mask;
+        io_uring_sqe& sqe = sqes[idx];
+        std::memset(&sqe, 0, sizeof(sqe));
+        switch (r.op) {
+            case IoOp::kRead:  sqe.opcode = IORING_OP_READ;  break;
+            case IoOp::kWrite: sqe.opcode = IORING_OP_WRITE; break;
+            case IoOp::kSync:
+                sqe.opcode      = IORING_OP_FSYNC;
+                sqe.fsync_flags = IORING_FSYNC_DATASYNC;
+                break;
+        }
+        sqe.fd        = r.fd;
+        sqe.addr      = reinterpret_cast<uint64_t>(r.buf);
+        sqe.len       = static_cast<uint32_t>(r.len);
+        sqe.off       = static_cast<uint64_t>(r.offset);
+        sqe.user_data = i;
+        // A chain may not end the submission; Submit orders the chunks.
+        if (r.link && i + 1 < count) sqe.flags = IOSQE_IO_LINK;
+        sq_array_[idx] = idx;
+        ++tail;
+    }
+    __atomic_store_n(sq_tail_, tail, __ATOMIC_RELEASE);
+
+    // Until its completion arrives a request is in flight.
+    for (size_t i = 0; i < count; ++i) reqs[i].result = -EINPROGRESS;
+
+    auto reap = [&] {
+        size_t n = 0;
+        unsigned head = *cq_head_;
+        unsigned cq_tail = __atomic_load_n(cq_tail_, __ATOMIC_ACQUIRE);
+        for (; head != cq_tail; ++head, ++n) {
+            const io_uring_cqe& cqe = cqes[head & *cq_mask_];
+            reqs[cqe.user_data].result = cqe.res;
+        }
+        __atomic_store_n(cq_head_, head, __ATOMIC_RELEASE);
+        return n;
+    };
+
+    // The kernel takes SQEs in ring order, so the first `submitted` are in
+    // flight and the rest were never seen.
+    size_t submitted = 0, completed = 0;
+    bool   failed    = false;
+    while (completed < count) {
+        auto to_submit = static_cast<unsigned>(failed ? 0 : count - submitted);
+        int ret = EnterRing(ring_fd_, to_submit, 1);
+        if (ret < 0) {
+            if (errno == EINTR || errno == EAGAIN || errno == EBUSY) continue;
+            // The ring is unusable; later batches run synchronously.  But the
+            // SQEs already taken may still run, so wait for them first.
+            async_ = false;
+            if (failed || completed == submitted) break;
+            failed = true;
+            continue;
+        }
+        submitted += std::min<size_t>(to_submit, static_cast<size_t>(ret));
+        completed += reap();
+        if (failed && completed == submitted) break;
+    }
+
+    // Submit runs the requests that never reached the kernel.  One that
+    // did but whose completion was lost may have run: it is not run again.
+    for (size_t i = 0; i < count; ++i) {
+        if (reqs[i].result == -EINPROGRESS) reqs[i].result = i < submitted ? -EIO : -ECANCELED;
+    }
+}
+
+}  // namespace bptree
@@ -0,0 +1,185 @@
+/// @file metrics.cpp
+/// @brief Metrics registry, histogram math and exports.
+
+#include "bptree/metrics.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <iterator>
+#include <sstream>
+
+namespace bptree {
+
+namespace {
+
+const char* const kHistogramNames[] = {
+    "search", "insert", "delete", "range_query", "wal_sync", "eviction", "miss_read", "checkpoint",
+};
+const char* const kCounterNames[] = {
+    "leaf_splits",     "internal_splits",          "leaf_merges", "leaf_redistributions",
+    "internal_merges", "internal_redistributions", "evictions",   "dirty_evictions",
+    "filter_negatives", "filter_false_positives",
+};
+static_assert(std::size(kHistogramNames) == static_cast<size_t>(Histogram::kCount));
+static_assert(std::size(kCounterNames) == static_cast<size_t>(Counter::kCount));
+
+constexpr double kQuantiles[] = {0.5, 0.9, 0.99, 0.999};
+
+/// "0.99" -> "p99", "0.999" -> "p999".
+std::string QuantileLabel(double q) {
+    char buf[16];
+    std::snprintf(buf, sizeof(buf), "%g", q * 100);
+    std::string s = std::string("p") + buf;
+    s.erase(std::remove(s.begin(), s.end(), '.'), s.end());
+    return s;
+}
+
+}  // namespace
+
+const char* HistogramName(Histogram h) { return kHistogramNames[static_cast<size_t>(h)]; }
+const char* CounterName(Counter c) { return kCounterNames[static_cast<size_t>(c)]; }
+
+// ============================================================================
+// Histogram buckets
+// ============================================================================
+
+int HistogramSnapshot::BucketOf(uint64_t value) {
+    if (value < kSubBuckets) return static_cast<int>(value);
+    int log2 = 63 - __builtin_clzll(value);  // >= 3
+    int sub  = static_cast<int>(value >> (log2 - 3)) & (kSubBuckets - 1);
+    return (log2 - 2) * kSubBuckets + sub;
+}
+
+uint64_t HistogramSnapshot::BucketHigh(int bucket) {
+    if (bucket < kSubBuckets) return static_cast<uint64_t>(bucket);
+    int log2 = bucket / kSubBuckets + 2;
+    uint64_t sub   = static_cast<uint64_t>(bucket % kSubBuckets);
+    uint64_t width = uint64_t{1} << (log2 - 3);
+    return (kSubBuckets + sub) * width + (width - 1);
+}
+
+uint64_t HistogramSnapshot::Percentile(double q) const {
+    if (count == 0) return 0;
+    auto rank = static_cast<uint64_t>(std::ceil(std::clamp(q, 0.0, 1.0) * count));
+    rank = std::max<uint64_t>(rank, 1);
+    uint64_t seen = 0;
+    for (int b = 0; b < kBuckets; ++b) {
+        seen += buckets[b];
+        if (seen >= rank) return std::min(BucketHigh(b), max);
+    }
+    return max;
+}
+
+// ============================================================================
+// Registry
+// ============================================================================
+
+/// Registers the thread's shard on first use and retires it at thread exit.
+struct ShardOwner {
+    Metrics::Shard* shard = nullptr;
+    ~ShardOwner() {
+        if (shard) Metrics::Instance().Retire(shard);
+    }
+};
+
+Metrics::Shard& Metrics::LocalShard() {
+    thread_local ShardOwner owner;
+    if (!owner.shard) {
+        owner.shard = new Shard();
+        std::lock_guard<std::mutex> guard(latch_);
+        shards_.push_back(owner.shard);
+    }
+    return *owner.shard;
+}
+
+void Metrics::Retire(Shard* shard) {
+    std::lock_guard<std::mutex> guard(latch_);
+    AddTo(retired_, *shard);
+    shards_.erase(std::remove(shards_.begin(), shards_.end(), shard), shards_.end());
+    delete shard;
+}
+
+void Metrics::AddTo(MetricsSnapshot& out, const Shard& s) {
+    for (size_t h = 0; h < out.histograms.size(); ++h) {
+        const HistogramShard& from = s.histograms[h];
+        HistogramSnapshot& into = out.histograms[h];
+        into.count += from.count.load(std::memory_order_relaxed);
+        into.sum   += from.sum.load(std::memory_order_relaxed);
+        into.max    = std::max(into.max, from.max.load(std::memory_order_relaxed));
+        for (int b = 0; b < HistogramSnapshot::kBuckets; ++b) {
+            into.buckets[b] += from.buckets[b].load(std::memory_order_relaxed);
+        }
+    }
+    for (size_t c = 0; c < out.counters.size(); ++c) {
+        out.counters[c] += s.counters[c].load(std::memory_order_relaxed);
+    }
+}
+
+MetricsSnapshot Metrics::Snapshot() const {
+    std::lock_guard<std::mutex> guard(latch_);
+    MetricsSnapshot out = retired_;
+    for (const Shard* s : shards_) AddTo(out, *s);
+    return out;
+}
+
+void Metrics::Reset() {
+    std::lock_guard<std::mutex> guard(latch_);
+    retired_ = MetricsSnapshot{};
+    for (Shard* s : shards_) {
+        for (HistogramShard& h : s->histograms) {
+            for (auto& b : h.buckets) b.store(0, std::memory_order_relaxed);
+            h.count.store(0, std::memory_order_relaxed);
+            h.sum.store(0, std::memory_order_relaxed);
+            h.max.store(0, std::memory_order_relaxed);
+        }
+        for (auto& c : s->counters) c.store(0, std::memory_order_relaxed);
+    }
+}
+
+void Metrics::Log(LogLevel level) const {
+    Logger::Instance().Log(level, __FILE__, __LINE__, __func__, "metrics " + Snapshot().ToJSON());
+}
+
+// ============================================================================
+// Exports
+// ============================================================================
+
+std::string MetricsSnapshot::ToJSON() const {
+    std::ostringstream out;
+    out << "{\"histograms\": {";
+    for (size_t h = 0; h < histograms.size(); ++h) {
+        const HistogramSnapshot& hs = histograms[h];
+        out << (h ? ", " : "") << '"' << kHistogramNames[h] << "\": {\"count\": " << hs.count
+            << ", \"mean_ns\": " << static_cast<uint64_t>(hs.Mean());
+        for (double q : kQuantiles) out << ", \"" << QuantileLabel(q) << "_ns\": " << hs.Percentile(q);
+        out << ", \"max_ns\": " << hs.max << '}';
+    }
+    out << "}, \"counters\": {";
+    for (size_t c = 0; c < counters.size(); ++c) {
+        out << (c ? ", " : "") << '"' << kCounterNames[c] << "\": " << counters[c];
+    }
+    out << "}}";
+    return out.str();
+}
+
+std::string MetricsSnapshot::ToPrometheus() const {
+    std::ostringstream out;
+    for (size_t h = 0; h < histograms.size(); ++h) {
+        const HistogramSnapshot& hs = histograms[h];
+        std::string name = std::string("bptree_") + kHistogramNames[h] + "_seconds";
+        out << "# TYPE " << name << " summary\n";
+        for (double q : kQuantiles) {
+            out << name << "{quantile=\"" << q << "\"} " << hs.Percentile(q) * 1e-9 << '\n';
+        }
+        out << name << "_sum " << hs.sum * 1e-9 << '\n'
+            << name << "_count " << hs.count << '\n';
+    }
+    for (size_t c = 0; c < counters.size(); ++c) {
+        std::string name = std::string("bptree_") + kCounterNames[c] + "_total";
+        out << "# TYPE " << name << " counter\n" << name << ' ' << counters[c] << '\n';
+    }
+    return out.str();
+}
+
+}  // namespace bptree
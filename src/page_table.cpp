@@ -0,0 +1,79 @@
+/// @file page_table.cpp
+/// @brief Open-addressing page table implementation.
+
+#include "bptree/page_table.h"
+
+#include <cassert>
+
+namespace bptree {
+
+PageTable::PageTable(size_t max_entries) {
+    // Keep the load factor at or below 1/2.
+    size_t capacity = 4;
+    int    bits     = 2;
+    while (capacity < 2 * max_entries) {
+        capacity <<= 1;
+        ++bits;
+    }
+    mask_  = capacity - 1;
+    shift_ = 64 - bits;
+
+    slots_ = std::make_unique<std::atomic<uint64_t>[]>(capacity);
+    for (size_t i = 0; i < capacity; ++i) {
+        slots_[i].store(0, std::memory_order_relaxed);
+    }
+}
+
+int PageTable::Find(int64_t page_id) const {
+    uint64_t tag = Tag(page_id);
+    size_t   i   = Home(tag);
+    for (size_t n = 0; n <= mask_; ++n, i = (i + 1) & mask_) {
+        uint64_t s = slots_[i].load(std::memory_order_acquire);
+        if (s == 0) return -1;
+        if (TagOf(s) == tag) return FrameOf(s);
+    }
+    return -1;
+}
+
+void PageTable::Insert(int64_t page_id, int frame) {
+    assert(page_id >= 0 && page_id % static_cast<int64_t>(PAGE_SIZE) == 0);
+    assert(frame >= 0 && frame <= kMaxFrames);
+    assert(size_.load(std::memory_order_relaxed) <= mask_ / 2);
+
+    uint64_t packed = Pack(page_id, frame);
+    size_t   i      = Home(TagOf(packed));
+    while (slots_[i].load(std::memory_order_relaxed) != 0) i = (i + 1) & mask_;
+    slots_[i].store(packed, std::memory_order_release);
+    size_.fetch_add(1, std::memory_order_relaxed);
+}
+
+bool PageTable::Erase(int64_t page_id) {
+    uint64_t tag = Tag(page_id);
+    size_t   i   = Home(tag);
+    for (;;) {
+        uint64_t s = slots_[i].load(std::memory_order_relaxed);
+        if (s == 0) return false;
+        if (TagOf(s) == tag) break;
+        i = (i + 1) & mask_;
+    }
+
+    // Backward-shift: pull later entries of the probe run into the hole
+    // until an entry that is already at (or past) its home slot, or an empty
+    // slot, ends the run.  An entry being moved is briefly present twice; the
+    // hole is only cleared at the very end.
+    for (size_t j = (i + 1) & mask_;; j = (j + 1) & mask_) {
+        uint64_t s = slots_[j].load(std::memory_order_relaxed);
+        if (s == 0) break;
+
+        size_t home = Home(TagOf(s));
+        if (((j - home) & mask_) >= ((j - i) & mask_)) {
+            slots_[i].store(s, std::memory_order_release);
+            i = j;
+        }
+    }
+    slots_[i].store(0, std::memory_order_release);
+    size_.fetch_sub(1, std::memory_order_relaxed);
+    return true;
+}
+
+}  // namespace bptree
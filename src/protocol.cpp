@@ -0,0 +1,65 @@
+/// @file protocol.cpp
+/// @brief Status encoding of the wire protocol.
+
+#include "bptree/protocol.h"
+
+#include <algorithm>
+
+namespace bptree {
+
+namespace {
+
+/// Wire codes of the Status kinds; fixed, unlike Status's own enum.
+enum StatusCode : uint8_t {
+    kOk = 0, kNotFound, kIOError, kCorruption, kInvalidArg, kFull,
+};
+
+/// Status::ToString() without its "Kind: " prefix.
+std::string Message(const Status& s) {
+    std::string text = s.ToString();
+    size_t colon = text.find(": ");
+    return colon == std::string::npos ? std::string() : text.substr(colon + 2);
+}
+
+}  // namespace
+
+void FrameWriter::PutStatus(const Status& s) {
+    uint8_t code = s.ok()           ? kOk
+                 : s.IsNotFound()   ? kNotFound
+                 : s.IsIOError()    ? kIOError
+                 : s.IsCorruption() ? kCorruption
+                 : s.IsInvalidArg() ? kInvalidArg
+                                    : kFull;
+    U8(code);
+    if (code == kOk || code == kNotFound) return;
+    std::string msg = Message(s);
+    msg.resize(std::min<size_t>(msg.size(), UINT16_MAX));
+    U16(static_cast<uint16_t>(msg.size()));
+    out_.append(msg);
+}
+
+bool FrameReader::GetStatus(Status& s) {
+    uint8_t code;
+    if (!U8(code)) return false;
+    if (code == kOk) {
+        s = Status::OK();
+        return true;
+    }
+    if (code == kNotFound) {
+        s = Status::NotFound("key not found");
+        return true;
+    }
+    uint16_t len;
+    if (!U16(len) || Remaining() < len) return Fail();
+    std::string msg(p_, len);
+    p_ += len;
+    switch (code) {
+        case kIOError:    s = Status::IOError(msg);    return true;
+        case kCorruption: s = Status::Corruption(msg); return true;
+        case kInvalidArg: s = Status::InvalidArg(msg); return true;
+        case kFull:       s = Status::Full(msg);       return true;
+        default:          return Fail();
+    }
+}
+
+}  // namespace bptree
@@ -0,0 +1,329 @@
+/// @file replacer.cpp
+/// @brief LRU, CLOCK and LRU-K replacement policies.
+
+#include "bptree/replacer.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cstdint>
+#include <utility>
+
+namespace bptree {
+
+const char* ReplacementPolicyName(ReplacementPolicy policy) {
+    switch (policy) {
+        case ReplacementPolicy::kLRU:   return "LRU";
+        case ReplacementPolicy::kClock: return "CLOCK";
+        case ReplacementPolicy::kLRUK:  return "LRU-2";
+    }
+    return "unknown";
+}
+
+std::unique_ptr<Replacer> MakeReplacer(ReplacementPolicy policy,
+                                       size_t num_frames) {
+    switch (policy) {
+        case ReplacementPolicy::kLRU:   return std::make_unique<LruReplacer>(num_frames);
+        case ReplacementPolicy::kClock: return std::make_unique<ClockReplacer>(num_frames);
+        case ReplacementPolicy::kLRUK:  return std::make_unique<LruKReplacer>(num_frames, 2);
+    }
+    return nullptr;
+}
+
+// ============================================================================
+// Reference bits
+// ============================================================================
+
+ReferenceBits::ReferenceBits(size_t num_frames)
+    : words_(std::make_unique<std::atomic<uint64_t>[]>((num_frames + 63) / 64))
+{
+    for (size_t i = 0; i < (num_frames + 63) / 64; ++i) {
+        words_[i].store(0, std::memory_order_relaxed);
+    }
+}
+
+void ReferenceBits::Set(int frame) {
+    std::atomic<uint64_t>& word = words_[frame / 64];
+    uint64_t mask = uint64_t{1} << (frame % 64);
+    if (!(word.load(std::memory_order_relaxed) & mask)) {
+        word.fetch_or(mask, std::memory_order_relaxed);
+    }
+}
+
+void ReferenceBits::Clear(int frame) {
+    words_[frame / 64].fetch_and(~(uint64_t{1} << (frame % 64)),
+                                 std::memory_order_relaxed);
+}
+
+bool ReferenceBits::TestAndClear(int frame) {
+    std::atomic<uint64_t>& word = words_[frame / 64];
+    uint64_t mask = uint64_t{1} << (frame % 64);
+    if (!(word.load(std::memory_order_relaxed) & mask)) return false;
+    return word.fetch_and(~mask, std::memory_order_relaxed) & mask;
+}
+
+bool ReferenceBits::Test(int frame) const {
+    return words_[frame / 64].load(std::memory_order_relaxed) & (uint64_t{1} << (frame % 64));
+}
+
+// ============================================================================
+// LRU
+// ============================================================================
+
+LruReplacer::LruReplacer(size_t num_frames)
+    : moved_(std::make_unique<std::atomic<uint64_t>[]>(num_frames)),
+      referenced_(num_frames), prev_(num_frames, -1), next_(num_frames, -1)
+{
+    for (size_t i = 0; i < num_frames; ++i) moved_[i].store(0, std::memory_order_relaxed);
+}
+
+void LruReplacer::Unlink(int frame) {
+    int p = prev_[frame];
+    int n = next_[frame];
+    (p == -1 ? head_ : next_[p]) = n;
+    (n == -1 ? tail_ : prev_[n]) = p;
+    prev_[frame] = next_[frame] = -1;
+    --linked_;
+}
+
+void LruReplacer::PushBack(int frame) {
+    prev_[frame] = tail_;
+    next_[frame] = -1;
+    (tail_ == -1 ? head_ : next_[tail_]) = frame;
+    tail_ = frame;
+    ++linked_;
+    moved_[frame].store(clock_.load(std::memory_order_relaxed), std::memory_order_relaxed);
+}
+
+void LruReplacer::RecordAccess(int frame) {
+    // Correlated reference: a use in the tick the frame was placed at the
+    // recent end is already accounted for.
+    if (moved_[frame].load(std::memory_order_relaxed) != clock_.load(std::memory_order_relaxed)) {
+        referenced_.Set(frame);
+    }
+}
+
+void LruReplacer::RecordLoad(int frame) {
+    clock_.fetch_add(1, std::memory_order_relaxed);
+    if (Linked(frame)) Unlink(frame);
+    PushBack(frame);
+    referenced_.Clear(frame);
+}
+
+void LruReplacer::Remove(int frame) {
+    if (Linked(frame)) Unlink(frame);
+    referenced_.Clear(frame);
+}
+
+int LruReplacer::Victim(const std::function<bool(int)>& evictable) {
+    // Two passes: the first may only move referenced frames back; what is
+    // still unevictable on the second is pinned.
+    for (size_t step = 0; step < 2 * linked_ && head_ != -1; ++step) {
+        int f = head_;
+        if (!referenced_.TestAndClear(f) && evictable(f)) return f;
+        Unlink(f);
+        PushBack(f);
+    }
+    return -1;
+}
+
+std::vector<int> LruReplacer::Coldest(size_t n) const {
+    // The order Victim takes: unreferenced frames in list order, then the
+    // referenced ones it moves back.
+    std::vector<int> frames;
+    for (int pass = 0; pass < 2; ++pass) {
+        for (int f = head_; f != -1 && frames.size() < n; f = next_[f]) {
+            if (referenced_.Test(f) == (pass == 1)) frames.push_back(f);
+        }
+    }
+    return frames;
+}
+
+// ============================================================================
+// CLOCK
+// ============================================================================
+
+ClockReplacer::ClockReplacer(size_t num_frames)
+    : num_frames_(num_frames), ref_bits_(num_frames) {}
+
+void ClockReplacer::RecordAccess(int frame) { ref_bits_.Set(frame); }
+void ClockReplacer::RecordLoad(int frame)   { ref_bits_.Set(frame); }
+void ClockReplacer::Remove(int frame)       { ref_bits_.Clear(frame); }
+
+int ClockReplacer::Victim(const std::function<bool(int)>& evictable) {
+    if (num_frames_ == 0) return -1;
+
+    // Two full sweeps: the first may only clear reference bits.
+    for (size_t step = 0; step < 2 * num_frames_ + 1; ++step) {
+        int f = static_cast<int>(hand_);
+        hand_ = (hand_ + 1) % num_frames_;
+        if (!evictable(f)) continue;
+        if (ref_bits_.TestAndClear(f)) continue;  // second chance
+        return f;
+    }
+    return -1;
+}
+
+std::vector<int> ClockReplacer::Coldest(size_t n) const {
+    // From the hand: frames without a reference bit go on the first sweep,
+    // the others on the second.
+    std::vector<int> frames;
+    for (int pass = 0; pass < 2; ++pass) {
+        for (size_t step = 0; step < num_frames_ && frames.size() < n; ++step) {
+            int f = static_cast<int>((hand_ + step) % num_frames_);
+            if (ref_bits_.Test(f) == (pass == 1)) frames.push_back(f);
+        }
+    }
+    return frames;
+}
+
+// ============================================================================
+// LRU-K
+// ============================================================================
+
+LruKReplacer::LruKReplacer(size_t num_frames, size_t k)
+    : num_frames_(num_frames), k_(k),
+      history_(std::make_unique<std::atomic<uint64_t>[]>(num_frames * k)),
+      gen_(num_frames, 0), loaded_(num_frames, false)
+{
+    assert(k >= 1);
+    for (size_t i = 0; i < num_frames * k; ++i) history_[i].store(0, std::memory_order_relaxed);
+}
+
+LruKReplacer::Rank LruKReplacer::RankOf(int frame) const {
+    // Frames with fewer than K uses have infinite backward K-distance and go
+    // first, least recently used among them; otherwise the oldest K-th most
+    // recent use goes first.
+    uint64_t kth  = History(frame, k_ - 1).load(std::memory_order_relaxed);
+    bool     full = kth != 0;
+    return {full, full ? kth : History(frame, 0).load(std::memory_order_relaxed), frame};
+}
+
+void LruKReplacer::Push(const Entry& e) {
+    heap_.push_back(e);
+    for (size_t i = heap_.size() - 1; i > 0;) {
+        size_t parent = (i - 1) / 2;
+        if (!(heap_[i].rank < heap_[parent].rank)) break;
+        std::swap(heap_[i], heap_[parent]);
+        i = parent;
+    }
+}
+
+void LruKReplacer::PopFront() {
+    heap_.front() = heap_.back();
+    heap_.pop_back();
+    for (size_t i = 0;;) {
+        size_t least = i;
+        for (size_t child : {2 * i + 1, 2 * i + 2}) {
+            if (child < heap_.size() && heap_[child].rank < heap_[least].rank) least = child;
+        }
+        if (least == i) break;
+        std::swap(heap_[i], heap_[least]);
+        i = least;
+    }
+}
+
+void LruKReplacer::Rebuild() {
+    // Drop the dead entries left by Remove and reloads.
+    heap_.clear();
+    for (size_t i = 0; i < num_frames_; ++i) {
+        int f = static_cast<int>(i);
+        if (loaded_[i]) Push({RankOf(f), gen_[i]});
+    }
+}
+
+void LruKReplacer::RecordAccess(int frame) {
+    uint64_t now = clock_.load(std::memory_order_relaxed);
+    // Correlated reference: uses within one tick count once.
+    if (History(frame, 0).load(std::memory_order_relaxed) == now) return;
+
+    // Racing accesses to one frame can lose a history entry; the ranking
+    // only needs to be approximate.
+    for (size_t i = k_ - 1; i > 0; --i) {
+        History(frame, i).store(History(frame, i - 1).load(std::memory_order_relaxed),
+                                std::memory_order_relaxed);
+    }
+    History(frame, 0).store(now, std::memory_order_relaxed);
+}
+
+void LruKReplacer::RecordLoad(int frame) {
+    uint64_t now = clock_.fetch_add(1, std::memory_order_relaxed) + 1;
+    History(frame, 0).store(now, std::memory_order_relaxed);
+    for (size_t i = 1; i < k_; ++i) History(frame, i).store(0, std::memory_order_relaxed);
+
+    loaded_[frame] = true;
+    if (heap_.size() >= 2 * num_frames_ + 16) Rebuild();
+    Push({RankOf(frame), ++gen_[frame]});
+}
+
+void LruKReplacer::Remove(int frame) {
+    for (size_t i = 0; i < k_; ++i) History(frame, i).store(0, std::memory_order_relaxed);
+    loaded_[frame] = false;
+    ++gen_[frame];
+}
+
+int LruKReplacer::Victim(const std::function<bool(int)>& evictable) {
+    // Uses only move a frame's rank later, so the front entry, once it is
+    // current, ranks before every frame in the heap.
+    std::vector<Entry> skipped;
+    int victim = -1;
+    while (!heap_.empty()) {
+        Entry e    = heap_.front();
+        int   f    = e.rank.frame;
+        bool  live = e.gen == gen_[f];
+        Rank  now  = live ? RankOf(f) : e.rank;
+        if (live && now == e.rank && evictable(f)) {
+            victim = f;
+            break;
+        }
+        PopFront();
+        if (!live) continue;
+        if (now == e.rank) {
+            skipped.push_back(e);  // pinned
+        } else {
+            Push({now, e.gen});
+        }
+    }
+    for (const Entry& e : skipped) Push(e);
+    return victim;
+}
+
+std::vector<int> LruKReplacer::Coldest(size_t n) const {
+    // The first n frames of Victim's order, without popping: a second heap
+    // holds the roots of the unvisited subtrees of heap_, plus refreshed
+    // ranks of stale entries (which have no subtree).
+    constexpr size_t kRefreshed = SIZE_MAX;
+    struct Open {
+        Rank   rank;
+        size_t index;
+    };
+    auto later = [](const Open& a, const Open& b) { return b.rank < a.rank; };
+
+    std::vector<Open> open;
+    std::vector<int>  frames;
+    if (!heap_.empty()) open.push_back({heap_[0].rank, 0});
+    while (!open.empty() && frames.size() < n) {
+        std::pop_heap(open.begin(), open.end(), later);
+        Open o = open.back();
+        open.pop_back();
+
+        if (o.index != kRefreshed) {
+            for (size_t child : {2 * o.index + 1, 2 * o.index + 2}) {
+                if (child >= heap_.size()) continue;
+                open.push_back({heap_[child].rank, child});
+                std::push_heap(open.begin(), open.end(), later);
+            }
+            const Entry& e = heap_[o.index];
+            if (e.gen != gen_[e.rank.frame]) continue;
+            Rank now = RankOf(e.rank.frame);
+            if (!(now == e.rank)) {
+                open.push_back({now, kRefreshed});
+                std::push_heap(open.begin(), open.end(), later);
+                continue;
+            }
+        }
+        frames.push_back(o.rank.frame);
+    }
+    return frames;
+}
+
+}  // namespace bptree
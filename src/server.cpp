@@ -0,0 +1,502 @@
+/// @file server.cpp
+/// @brief Epoll event loops of the network server.
+
+#include "bptree/server.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <mutex>
+#include <optional>
+#include <unordered_map>
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+namespace bptree {
+
+namespace {
+
+constexpr size_t kReadChunk      = 64 << 10;  ///< bytes per recv
+constexpr int    kReadsPerEvent  = 16;        ///< then let other connections run
+constexpr int    kMaxEvents      = 128;
+
+/// epoll_event.data.ptr of the listening socket and of a loop's eventfd;
+/// every other event carries its Connection.
+char kListenTag;
+char kWakeTag;
+
+Status SocketError(const std::string& what) {
+    return Status::IOError(what + ": " + std::strerror(errno));
+}
+
+void Wake(int fd) {
+    uint64_t one = 1;
+    [[maybe_unused]] ssize_t n = ::write(fd, &one, sizeof(one));
+}
+
+}  // namespace
+
+/// One client.  Owned by its loop and touched only by its thread.
+struct Server::Connection {
+    /// An open SCAN: where the next chunk starts.
+    struct Scan {
+        uint32_t id;
+        key_t    next;
+        key_t    upper;
+        size_t   left;   ///< records still to send
+    };
+
+    int         fd = -1;
+    std::string in;             ///< received, in_pos onwards not yet run
+    size_t      in_pos  = 0;
+    std::string out;            ///< answers, out_pos onwards not yet sent
+    size_t      out_pos = 0;
+    uint32_t    events  = 0;    ///< epoll interest registered
+    bool        closing = false;  ///< no more input: close once answered
+    std::optional<Scan> scan;
+
+    [[nodiscard]] size_t Unsent() const { return out.size() - out_pos; }
+};
+
+struct Server::Loop {
+    ~Loop() {
+        if (epoll_fd >= 0) ::close(epoll_fd);
+        if (wake_fd >= 0) ::close(wake_fd);
+    }
+
+    int epoll_fd = -1;
+    int wake_fd  = -1;
+
+    std::mutex       incoming_latch;
+    std::vector<int> incoming;  ///< accepted, not yet adopted
+
+    std::unordered_map<int, std::unique_ptr<Connection>> connections;
+};
+
+// ============================================================================
+// Lifecycle
+// ============================================================================
+
+Server::Server(BPlusTree& tree, const ServerOptions& options)
+    : tree_(tree), options_(options) {}
+
+Server::~Server() { Stop(); }
+
+Status Server::Start() {
+    if (!loops_.empty()) return Status::InvalidArg("server already started");
+
+    sockaddr_in addr{};
+    addr.sin_family = AF_INET;
+    addr.sin_port   = htons(options_.port);
+    if (::inet_pton(AF_INET, options_.address.c_str(), &addr.sin_addr) != 1) {
+        return Status::InvalidArg("not an IPv4 address: " + options_.address);
+    }
+
+    listen_fd_ = ::socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (listen_fd_ < 0) return SocketError("socket");
+    auto fail = [&](const std::string& what) {
+        Status st = SocketError(what);
+        loops_.clear();
+        ::close(listen_fd_);
+        listen_fd_ = -1;
+        return st;
+    };
+
+    int one = 1;
+    ::setsockopt(listen_fd_, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+    if (::bind(listen_fd_, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) < 0) {
+        return fail("bind");
+    }
+    if (::listen(listen_fd_, SOMAXCONN) < 0) return fail("listen");
+    socklen_t len = sizeof(addr);
+    if (::getsockname(listen_fd_, reinterpret_cast<sockaddr*>(&addr), &len) < 0) {
+        return fail("getsockname");
+    }
+    port_ = ntohs(addr.sin_port);
+
+    unsigned threads = options_.threads;
+    if (threads == 0) threads = std::max(1u, std::thread::hardware_concurrency());
+    for (unsigned i = 0; i < threads; ++i) {
+        auto loop = std::make_unique<Loop>();
+        loop->epoll_fd = ::epoll_create1(EPOLL_CLOEXEC);
+        if (loop->epoll_fd < 0) return fail("epoll_create1");
+        loop->wake_fd = ::eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+        if (loop->wake_fd < 0) return fail("eventfd");
+        epoll_event ev{};
+        ev.events   = EPOLLIN;
+        ev.data.ptr = &kWakeTag;
+        if (::epoll_ctl(loop->epoll_fd, EPOLL_CTL_ADD, loop->wake_fd, &ev) < 0) {
+            return fail("epoll_ctl");
+        }
+        loops_.push_back(std::move(loop));
+    }
+    epoll_event ev{};
+    ev.events   = EPOLLIN;
+    ev.data.ptr = &kListenTag;
+    if (::epoll_ctl(loops_[0]->epoll_fd, EPOLL_CTL_ADD, listen_fd_, &ev) < 0) {
+        return fail("epoll_ctl");
+    }
+
+    stopping_.store(false, std::memory_order_relaxed);
+    for (auto& loop : loops_) {
+        threads_.emplace_back([this, l = loop.get()] { Run(*l); });
+    }
+    return Status::OK();
+}
+
+void Server::Stop() {
+    if (threads_.empty()) return;
+    stopping_.store(true, std::memory_order_release);
+    for (auto& loop : loops_) Wake(loop->wake_fd);
+    for (auto& t : threads_) t.join();
+    threads_.clear();
+
+    // Connections handed over after their loop stopped.
+    for (auto& loop : loops_) {
+        for (int fd : loop->incoming) {
+            ::close(fd);
+            connections_.fetch_sub(1, std::memory_order_relaxed);
+        }
+    }
+    loops_.clear();
+    ::close(listen_fd_);
+    listen_fd_ = -1;
+}
+
+ServerStats Server::Stats() const {
+    ServerStats st;
+    st.accepted    = accepted_.load(std::memory_order_relaxed);
+    st.connections = connections_.load(std::memory_order_relaxed);
+    st.requests    = requests_.load(std::memory_order_relaxed);
+    st.bytes_in    = bytes_in_.load(std::memory_order_relaxed);
+    st.bytes_out   = bytes_out_.load(std::memory_order_relaxed);
+    return st;
+}
+
+// ============================================================================
+// Event loop
+// ============================================================================
+
+void Server::Run(Loop& loop) {
+    epoll_event events[kMaxEvents];
+    while (!stopping_.load(std::memory_order_acquire)) {
+        int n = ::epoll_wait(loop.epoll_fd, events, kMaxEvents, -1);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            break;
+        }
+        for (int i = 0; i < n; ++i) {
+            void* tag = events[i].data.ptr;
+            if (tag == &kListenTag) {
+                Accept();
+            } else if (tag == &kWakeTag) {
+                uint64_t count;
+                [[maybe_unused]] ssize_t r = ::read(loop.wake_fd, &count, sizeof(count));
+                Adopt(loop);
+            } else {
+                auto& c = *static_cast<Connection*>(tag);
+                if (events[i].events & EPOLLERR) {
+                    Close(loop, c);
+                } else if (events[i].events & (EPOLLIN | EPOLLHUP)) {
+                    OnReadable(loop, c);
+                } else {
+                    Drive(loop, c);  // EPOLLOUT
+                }
+            }
+        }
+    }
+
+    for (auto& [fd, c] : loop.connections) {
+        ::close(fd);
+        connections_.fetch_sub(1, std::memory_order_relaxed);
+    }
+    loop.connections.clear();
+}
+
+void Server::Accept() {
+    for (;;) {
+        int fd = ::accept4(listen_fd_, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+        if (fd < 0) {
+            if (errno == EINTR || errno == ECONNABORTED) continue;
+            return;  // EAGAIN; anything else is retried on the next event
+        }
+        int one = 1;
+        ::setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+        accepted_.fetch_add(1, std::memory_order_relaxed);
+        connections_.fetch_add(1, std::memory_order_relaxed);
+
+        Loop& to = *loops_[next_loop_++ % loops_.size()];
+        {
+            std::lock_guard<std::mutex> guard(to.incoming_latch);
+            to.incoming.push_back(fd);
+        }
+        Wake(to.wake_fd);
+    }
+}
+
+void Server::Adopt(Loop& loop) {
+    std::vector<int> fds;
+    {
+        std::lock_guard<std::mutex> guard(loop.incoming_latch);
+        fds.swap(loop.incoming);
+    }
+    for (int fd : fds) {
+        auto c = std::make_unique<Connection>();
+        c->fd     = fd;
+        c->events = EPOLLIN;
+        epoll_event ev{};
+        ev.events   = c->events;
+        ev.data.ptr = c.get();
+        if (::epoll_ctl(loop.epoll_fd, EPOLL_CTL_ADD, fd, &ev) < 0) {
+            ::close(fd);
+            connections_.fetch_sub(1, std::memory_order_relaxed);
+            continue;
+        }
+        loop.connections.emplace(fd, std::move(c));
+    }
+}
+
+void Server::OnReadable(Loop& loop, Connection& c) {
+    for (int reads = 0; reads < kReadsPerEvent; ++reads) {
+        size_t old = c.in.size();
+        c.in.resize(old + kReadChunk);
+        ssize_t n = ::recv(c.fd, &c.in[old], kReadChunk, 0);
+        c.in.resize(old + static_cast<size_t>(std::max<ssize_t>(n, 0)));
+        if (n > 0) {
+            bytes_in_.fetch_add(static_cast<size_t>(n), std::memory_order_relaxed);
+            if (static_cast<size_t>(n) < kReadChunk) break;
+        } else if (n == 0) {
+            c.closing = true;  // the client is done sending
+            break;
+        } else if (errno == EAGAIN || errno == EWOULDBLOCK) {
+            break;
+        } else if (errno != EINTR) {
+            Close(loop, c);
+            return;
+        }
+    }
+    Drive(loop, c);
+}
+
+void Server::Drive(Loop& loop, Connection& c) {
+    for (;;) {
+        bool produced = false;
+        if (c.scan) produced |= StreamScan(c);
+        if (!c.scan) produced |= RunFrames(c);
+        if (!Flush(c)) {
+            Close(loop, c);
+            return;
+        }
+        if (c.Unsent() > 0 || !produced) break;
+    }
+    if (c.closing && !c.scan && c.Unsent() == 0) {
+        Close(loop, c);
+        return;
+    }
+
+    bool read_more = !c.closing && !c.scan && c.Unsent() < options_.output_high_water;
+    uint32_t want = (read_more ? EPOLLIN : 0u) | (c.Unsent() > 0 ? EPOLLOUT : 0u);
+    if (want != c.events) {
+        epoll_event ev{};
+        ev.events   = want;
+        ev.data.ptr = &c;
+        ::epoll_ctl(loop.epoll_fd, EPOLL_CTL_MOD, c.fd, &ev);
+        c.events = want;
+    }
+}
+
+bool Server::RunFrames(Connection& c) {
+    bool ran = false;
+    while (!c.scan && c.Unsent() < options_.output_high_water) {
+        size_t avail = c.in.size() - c.in_pos;
+        if (avail < kFrameHeaderSize) break;
+        FrameHeader h = DecodeFrameHeader(&c.in[c.in_pos]);
+        bool ok = h.length <= kMaxFrameBytes;
+        if (ok && avail < kFrameHeaderSize + h.length) break;
+
+        if (ok) {
+            std::string_view body(&c.in[c.in_pos + kFrameHeaderSize], h.length);
+            c.in_pos += kFrameHeaderSize + h.length;
+            ok = Handle(c, h, body);
+        }
+        requests_.fetch_add(1, std::memory_order_relaxed);
+        ran = true;
+        if (!ok) {
+            // The stream cannot be trusted past a bad frame: answer it and
+            // hang up.
+            FrameWriter w(c.out);
+            size_t at = w.Begin(WireOp::kError, h.id);
+            w.PutStatus(Status::InvalidArg("malformed request"));
+            w.End(at);
+            c.closing = true;
+            c.in.clear();
+            c.in_pos = 0;
+            break;
+        }
+    }
+
+    if (c.in_pos == c.in.size()) {
+        c.in.clear();
+        c.in_pos = 0;
+    } else if (c.in_pos > c.in.size() / 2) {
+        c.in.erase(0, c.in_pos);
+        c.in_pos = 0;
+    }
+    return ran;
+}
+
+bool Server::Handle(Connection& c, const FrameHeader& h, std::string_view body) {
+    FrameReader r(body);
+    FrameWriter w(c.out);
+    uint32_t n;
+    switch (h.op) {
+        case WireOp::kGet: {
+            if (!r.U32(n) || r.Remaining() != size_t{n} * sizeof(key_t)) return false;
+            std::vector<key_t> keys(n);
+            for (key_t& k : keys) r.Key(k);
+            std::vector<std::string> values;
+            std::vector<Status> statuses = tree_.MultiGet(keys, values);
+
+            size_t at = w.Begin(WireOp::kGet, h.id);
+            w.U32(n);
+            for (uint32_t i = 0; i < n; ++i) {
+                w.PutStatus(statuses[i]);
+                if (statuses[i].ok()) w.Bytes(values[i]);
+            }
+            w.End(at);
+            return true;
+        }
+        case WireOp::kPut: {
+            if (!r.U32(n) || n > r.Remaining() / (sizeof(key_t) + 4)) return false;
+            Status st;
+            key_t key;
+            std::string_view value;
+            if (n == 1) {
+                if (!r.Key(key) || !r.Bytes(value) || !r.Done()) return false;
+                st = tree_.Insert(key, value.data(), value.size());
+            } else {
+                std::vector<std::pair<key_t, std::string>> records;
+                records.reserve(n);
+                for (uint32_t i = 0; i < n; ++i) {
+                    if (!r.Key(key) || !r.Bytes(value)) return false;
+                    records.emplace_back(key, std::string(value));
+                }
+                if (!r.Done()) return false;
+                st = tree_.InsertBatch(records);
+            }
+            size_t at = w.Begin(WireOp::kPut, h.id);
+            w.PutStatus(st);
+            w.End(at);
+            return true;
+        }
+        case WireOp::kDelete: {
+            if (!r.U32(n) || r.Remaining() != size_t{n} * sizeof(key_t)) return false;
+            size_t at = w.Begin(WireOp::kDelete, h.id);
+            w.U32(n);
+            for (uint32_t i = 0; i < n; ++i) {
+                key_t key = 0;
+                r.Key(key);
+                w.PutStatus(tree_.Delete(key));
+            }
+            w.End(at);
+            return true;
+        }
+        case WireOp::kScan: {
+            key_t lower, upper;
+            uint32_t limit;
+            if (!r.Key(lower) || !r.Key(upper) || !r.U32(limit) || !r.Done()) return false;
+            if (upper < lower) {
+                size_t at = w.Begin(WireOp::kScanEnd, h.id);
+                w.PutStatus(Status::InvalidArg("lower > upper"));
+                w.End(at);
+                return true;
+            }
+            c.scan = Connection::Scan{h.id, lower, upper, limit ? size_t{limit} : SIZE_MAX};
+            return true;
+        }
+        default:
+            return false;
+    }
+}
+
+bool Server::StreamScan(Connection& c) {
+    Connection::Scan& scan = *c.scan;
+    FrameWriter w(c.out);
+    bool added = false;
+
+    // The cursor lives for this call only: between rounds no leaf is
+    // latched, and the next round seeks to the first key not yet sent.
+    BPlusTree::Cursor cursor = tree_.NewCursor();
+    cursor.SetUpperBound(scan.upper);
+    cursor.Seek(scan.next);
+    while (cursor.Valid() && scan.left > 0 && c.Unsent() < options_.output_high_water) {
+        size_t at = w.Begin(WireOp::kScan, scan.id);
+        size_t count_at = c.out.size();
+        w.U32(0);
+        uint32_t count = 0;
+        while (cursor.Valid() && scan.left > 0 &&
+               w.BodySize(at) < options_.scan_chunk_bytes) {
+            w.Key(cursor.key());
+            w.Bytes(cursor.value());
+            ++count;
+            --scan.left;
+            cursor.Next();
+        }
+        std::memcpy(&c.out[count_at], &count, sizeof(count));
+        w.End(at);
+        added = true;
+    }
+
+    if (!cursor.Valid() || scan.left == 0) {
+        size_t at = w.Begin(WireOp::kScanEnd, scan.id);
+        w.PutStatus(Status::OK());
+        w.End(at);
+        c.scan.reset();
+        return true;
+    }
+    scan.next = cursor.key();
+    return added;
+}
+
+bool Server::Flush(Connection& c) {
+    while (c.Unsent() > 0) {
+        ssize_t n = ::send(c.fd, c.out.data() + c.out_pos, c.Unsent(), MSG_NOSIGNAL);
+        if (n > 0) {
+            c.out_pos += static_cast<size_t>(n);
+            bytes_out_.fetch_add(static_cast<size_t>(n), std::memory_order_relaxed);
+        } else if (n < 0 && errno == EINTR) {
+            continue;
+        } else if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+            break;
+        } else {
+            return false;
+        }
+    }
+
+    if (c.out_pos == c.out.size()) {
+        c.out.clear();
+        c.out_pos = 0;
+        // A huge answer should not pin its buffer for the connection's life.
+        if (c.out.capacity() > 2 * options_.output_high_water) c.out.shrink_to_fit();
+    } else if (c.out_pos > c.out.size() / 2) {
+        c.out.erase(0, c.out_pos);
+        c.out_pos = 0;
+    }
+    return true;
+}
+
+void Server::Close(Loop& loop, Connection& c) {
+    int fd = c.fd;
+    ::epoll_ctl(loop.epoll_fd, EPOLL_CTL_DEL, fd, nullptr);
+    ::close(fd);
+    connections_.fetch_sub(1, std::memory_order_relaxed);
+    loop.connections.erase(fd);  // destroys c
+}
+
+}  // namespace bptree
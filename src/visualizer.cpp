@@ -95,16 +95,17 @@ void TreeVisualizer::GenerateDOTRecursive(
                 if (i > 0) out << "|";
                 out << leaf.KeyAt(i);
                 // Show first few chars of data
-                char data[DATA_SIZE];
-                leaf.GetData(i, data);
-                std::string data_str(data, std::min<size_t>(10, DATA_SIZE));
+                if (leaf.IsOverflow(i)) {
+                    out << "\\n(" << leaf.ValueSize(i) << " B overflow)";
+                    continue;
+                }
+                std::string data_str(leaf.Value(i).substr(0, 8));
                 // Escape special chars
                 for (char& c : data_str) {
-                    if (c == '\0') break;
-                    if (!std::isprint(c)) c = '?';
+                    if (!std::isprint(static_cast<unsigned char>(c))) c = '?';
                 }
                 if (!data_str.empty()) {
-                    out << "\\n" << data_str.substr(0, 8) << "...";
+                    out << "\\n" << data_str << "...";
                 }
             }
             out << "}}";
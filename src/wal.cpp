@@ -1,16 +1,25 @@
 /// @file wal.cpp
 /// @brief Write-Ahead Log implementation — append-only redo log with
-///        CRC32 integrity checks and checkpoint/truncate support.
+///        CRC32C integrity checks, group commit and checkpoint/truncate
+///        support.
 
 #include "bptree/wal.h"
+#include "bptree/crc32c.h"
 #include "bptree/disk_manager.h"
+#include "bptree/metrics.h"
+#include "bptree/page.h"
 
+#include <algorithm>
+#include <chrono>
 #include <cerrno>
 #include <cstring>
+#include <exception>
 #include <stdexcept>
 
 #include <fcntl.h>
+#include <sys/mman.h>
 #include <sys/stat.h>
+#include <sys/uio.h>
 #include <unistd.h>
 
 namespace bptree {
@@ -74,6 +83,23 @@ uint32_t WriteAheadLog::CRC32(const void* data, size_t len) {
     return crc ^ 0xFFFFFFFF;
 }
 
+uint32_t WriteAheadLog::RecordChecksum(const LogRecordHeader& hdr, const char* data,
+                                       uint32_t data_len, uint32_t version) {
+    // The checksum covers the header with its checksum field zeroed.
+    LogRecordHeader check_hdr = hdr;
+    check_hdr.checksum = 0;
+
+    if (version < 3) {
+        // CRC32 of header and payload separately, XOR'd.
+        uint32_t crc = CRC32(&check_hdr, sizeof(check_hdr));
+        if (data && data_len > 0) crc ^= CRC32(data, data_len);
+        return crc;
+    }
+    uint32_t crc = CRC32C(&check_hdr, sizeof(check_hdr));
+    if (data && data_len > 0) crc = CRC32C(data, data_len, crc);
+    return crc;
+}
+
 // ============================================================================
 // Helper: full write (handles partial writes / EINTR)
 // ============================================================================
@@ -93,6 +119,28 @@ static bool FullWrite(int fd, const void* buf, size_t count) {
     return true;
 }
 
+static bool FullWritev(int fd, struct iovec* iov, int iovcnt) {
+    while (iovcnt > 0) {
+        ssize_t n = ::writev(fd, iov, iovcnt);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            return false;
+        }
+        // Skip fully written buffers, then trim the partially written one.
+        auto done = static_cast<size_t>(n);
+        while (iovcnt > 0 && done >= iov->iov_len) {
+            done -= iov->iov_len;
+            ++iov;
+            --iovcnt;
+        }
+        if (iovcnt > 0) {
+            iov->iov_base = static_cast<char*>(iov->iov_base) + done;
+            iov->iov_len -= done;
+        }
+    }
+    return true;
+}
+
 static bool FullRead(int fd, void* buf, size_t count) {
     auto* p = static_cast<char*>(buf);
     size_t remaining = count;
@@ -113,7 +161,9 @@ static bool FullRead(int fd, void* buf, size_t count) {
 // Construction / destruction
 // ============================================================================
 
-WriteAheadLog::WriteAheadLog(const std::string& path) : path_(path) {
+WriteAheadLog::WriteAheadLog(const std::string& path, const WALOptions& options)
+    : path_(path), options_(options)
+{
     // Open or create the WAL file.
     fd_ = ::open(path_.c_str(), O_RDWR | O_CREAT, 0666);
     if (fd_ < 0) {
@@ -139,31 +189,59 @@ WriteAheadLog::WriteAheadLog(const std::string& path) : path_(path) {
         ::fsync(fd_);
         next_lsn_ = 1;
         checkpoint_lsn_ = 0;
+        version_ = hdr.version;
     } else {
         // Existing WAL -- read the file header.
         WALFileHeader hdr{};
         ::lseek(fd_, 0, SEEK_SET);
-        if (!FullRead(fd_, &hdr, sizeof(hdr)) || hdr.magic != 0x57414C31) {
+        if (!FullRead(fd_, &hdr, sizeof(hdr)) || hdr.magic != 0x57414C31 ||
+            hdr.version > WAL_FORMAT_VERSION) {
             ::close(fd_);
             fd_ = -1;
             throw std::runtime_error("WriteAheadLog: invalid WAL file");
         }
         checkpoint_lsn_ = hdr.checkpoint_lsn;
+        version_ = hdr.version;
 
-        // Scan to find the highest LSN.
-        auto records = ReadAllRecords();
-        if (!records.empty()) {
-            next_lsn_ = records.back().header.lsn + 1;
+        // Scan to find the highest LSN.  LSNs keep growing across
+        // truncation because pages on disk carry them.  `Recover` need not
+        // verify these records again.
+        LogScan scan;
+        ScanLog(scan, 0);
+        if (!scan.records.empty()) {
+            next_lsn_ = std::max(scan.records.back().header.lsn, checkpoint_lsn_.load()) + 1;
         } else {
-            next_lsn_ = 1;
+            next_lsn_ = checkpoint_lsn_ + 1;
         }
+        verified_end_ = scan.end;
 
         // Seek to end for appending.
         ::lseek(fd_, 0, SEEK_END);
     }
+
+    // Everything already in the file is treated as durable.
+    written_lsn_ = next_lsn_ - 1;
+    durable_lsn_ = next_lsn_ - 1;
+
+    if (options_.group_commit) {
+        buffer_.reserve(2 * options_.max_batch_bytes);
+        if (options_.io_engine == IoEngine::kUring) {
+            ring_ = std::make_unique<IoRing>(IoEngine::kUring, 2);
+            if (!ring_->IsAsync()) ring_.reset();
+        }
+        flusher_ = std::thread(&WriteAheadLog::FlusherLoop, this);
+    }
 }
 
 WriteAheadLog::~WriteAheadLog() {
+    if (flusher_.joinable()) {
+        {
+            std::lock_guard<std::mutex> guard(latch_);
+            stop_ = true;
+        }
+        flush_cv_.notify_one();
+        flusher_.join();  // drains the buffer before exiting
+    }
     if (fd_ >= 0) {
         ::fsync(fd_);
         ::close(fd_);
@@ -174,65 +252,97 @@ WriteAheadLog::~WriteAheadLog() {
 // Logging
 // ============================================================================
 
-void WriteAheadLog::AppendRecord(LogRecordType type, int64_t page_id,
-                                 const char* data, uint32_t data_len) {
+uint64_t WriteAheadLog::AppendRecord(LogRecordType type, int64_t page_id,
+                                     const char* data, uint32_t data_len) {
     LogRecordHeader hdr{};
     hdr.lsn      = next_lsn_++;
     hdr.type     = type;
     hdr.page_id  = page_id;
     hdr.data_len = data_len;
-    hdr.checksum = 0;  // compute below
-
-    // Checksum covers the header (with checksum field zeroed) + data.
-    uint32_t crc = CRC32(&hdr, sizeof(hdr));
-    if (data && data_len > 0) {
-        // Chain the CRC: continue from where we left off.
-        // Simple approach: hash header || data together.
-        // We'll concatenate logically by computing combined CRC.
-        // For simplicity, compute CRC of full payload separately and XOR.
-        uint32_t data_crc = CRC32(data, data_len);
-        crc ^= data_crc;
-    }
-    hdr.checksum = crc;
+    hdr.checksum = RecordChecksum(hdr, data, data_len, version_);
 
-    // Write header.
-    if (!FullWrite(fd_, &hdr, sizeof(hdr))) {
-        throw std::runtime_error("WriteAheadLog: write failed (header)");
-    }
-
-    // Write data payload.
-    if (data && data_len > 0) {
-        if (!FullWrite(fd_, data, data_len)) {
-            throw std::runtime_error("WriteAheadLog: write failed (data)");
+    if (options_.group_commit) {
+        // Buffer the record; the flusher writes it with the rest of its batch.
+        size_t before = buffer_.size();
+        auto* h = reinterpret_cast<const char*>(&hdr);
+        buffer_.insert(buffer_.end(), h, h + sizeof(hdr));
+        if (data && data_len > 0) buffer_.insert(buffer_.end(), data, data + data_len);
+        if (before < options_.max_batch_bytes &&
+            buffer_.size() >= options_.max_batch_bytes) {
+            flush_cv_.notify_one();
+        }
+    } else {
+        // Header and payload in a single syscall.
+        struct iovec iov[2];
+        iov[0].iov_base = &hdr;
+        iov[0].iov_len  = sizeof(hdr);
+        iov[1].iov_base = const_cast<char*>(data);
+        iov[1].iov_len  = data ? data_len : 0;
+        if (!FullWritev(fd_, iov, iov[1].iov_len > 0 ? 2 : 1)) {
+            throw std::runtime_error("WriteAheadLog: write failed");
         }
+        written_lsn_.store(hdr.lsn, std::memory_order_release);
     }
 
     bytes_written_ += sizeof(hdr) + data_len;
     ++records_written_;
+    return hdr.lsn;
 }
 
 uint64_t WriteAheadLog::LogPageWrite(int64_t page_id, const char* page_data) {
-    uint64_t lsn = next_lsn_;
-    AppendRecord(LogRecordType::kPageWrite, page_id,
-                 page_data, static_cast<uint32_t>(PAGE_SIZE));
-    return lsn;
+    std::unique_lock<std::mutex> guard(latch_);
+    if (options_.group_commit) {
+        // Back-pressure: wait for the flusher to take a full buffer.
+        durable_cv_.wait(guard, [&] {
+            return buffer_.size() < 2 * options_.max_batch_bytes || failed_;
+        });
+    }
+    return AppendRecord(LogRecordType::kPageWrite, page_id,
+                        page_data, static_cast<uint32_t>(PAGE_SIZE));
 }
 
-uint64_t WriteAheadLog::BeginCheckpoint() {
-    uint64_t lsn = next_lsn_;
-    AppendRecord(LogRecordType::kCheckpointBegin, INVALID_PAGE_ID, nullptr, 0);
-    Flush();
+uint64_t WriteAheadLog::LogRecord(LogRecordType type, int64_t page_id,
+                                  const void* payload, uint32_t len) {
+    std::unique_lock<std::mutex> guard(latch_);
+    if (options_.group_commit) {
+        durable_cv_.wait(guard, [&] {
+            return buffer_.size() < 2 * options_.max_batch_bytes || failed_;
+        });
+    }
+    return AppendRecord(type, page_id, static_cast<const char*>(payload), len);
+}
+
+uint64_t WriteAheadLog::BeginCheckpoint(uint64_t oldest_lsn, uint64_t dirty_pages) {
+    std::scoped_lock guard(io_latch_, latch_);
+    CheckpointLog rec{oldest_lsn, dirty_pages};
+    uint64_t lsn = AppendRecord(LogRecordType::kCheckpointBegin, INVALID_PAGE_ID,
+                                reinterpret_cast<const char*>(&rec), sizeof(rec));
+    DrainLocked();
+
+    // Redo will start here, so from now on the first change to a page logs
+    // its image: a delta must never be replayed onto a page torn by a
+    // write-back after this point.
+    checkpoint_lsn_ = lsn;
     return lsn;
 }
 
-uint64_t WriteAheadLog::EndCheckpoint() {
-    uint64_t lsn = next_lsn_;
-    AppendRecord(LogRecordType::kCheckpointEnd, INVALID_PAGE_ID, nullptr, 0);
-    Flush();
+uint64_t WriteAheadLog::EndCheckpoint(uint64_t redo_lsn) {
+    std::scoped_lock guard(io_latch_, latch_);
+    uint64_t      lsn = next_lsn_;
+    CheckpointLog rec{redo_lsn != 0 ? redo_lsn : lsn, 0};
+    AppendRecord(LogRecordType::kCheckpointEnd, INVALID_PAGE_ID,
+                 reinterpret_cast<const char*>(&rec), sizeof(rec));
+    DrainLocked();
+    if (rec.lsn != lsn) {
+        // Changes logged since the checkpoint began may not be on disk.
+        TruncateThrough(rec.lsn);
+        return lsn;
+    }
 
     // Update the file header with the new checkpoint LSN.
     checkpoint_lsn_ = lsn;
     WALFileHeader hdr{};
+    hdr.version        = version_;
     hdr.checkpoint_lsn = checkpoint_lsn_;
     ::lseek(fd_, 0, SEEK_SET);
     FullWrite(fd_, &hdr, sizeof(hdr));
@@ -248,115 +358,603 @@ uint64_t WriteAheadLog::EndCheckpoint() {
 
 void WriteAheadLog::Flush() {
     if (fd_ >= 0) {
-        ::fsync(fd_);
+        WaitDurable(next_lsn_ - 1);
+    }
+}
+
+void WriteAheadLog::WaitDurable(uint64_t lsn) {
+    if (durable_lsn_.load(std::memory_order_acquire) >= lsn) return;
+
+    // A page LSN from an older log can be ahead of this one; everything
+    // this log has handed out is all there is to wait for.
+    lsn = std::min(lsn, next_lsn_.load() - 1);
+    if (durable_lsn_.load(std::memory_order_acquire) >= lsn) return;
+
+    if (!options_.group_commit) {
+        SyncDirect();
+        return;
+    }
+
+    // Without a batching window, waiters write the batches themselves
+    // rather than handing each commit to the flusher.  Writes are ordered by
+    // io_latch_, but the sync runs outside it so the next batch can be
+    // written while this one is still syncing.
+    if (options_.max_latency_us == 0) {
+        std::unique_lock<std::mutex> io_guard(io_latch_);
+        if (written_lsn_.load(std::memory_order_acquire) < lsn) {
+            uint64_t end = 0;
+            bool ok = ring_ ? WriteSyncBatch(end) : WriteBatch(end);
+            io_guard.unlock();
+            if (!ok || !SyncBatch(end)) {
+                throw std::runtime_error("WriteAheadLog: log flush failed");
+            }
+            return;
+        }
+        // Already written by another waiter, who is syncing it now.
+    }
+
+    std::unique_lock<std::mutex> guard(latch_);
+    if (options_.max_latency_us > 0 && lsn > requested_lsn_) {
+        requested_lsn_ = lsn;
+        flush_cv_.notify_one();
+    }
+    durable_cv_.wait(guard, [&] { return durable_lsn_ >= lsn || failed_; });
+    if (durable_lsn_ < lsn) {
+        throw std::runtime_error("WriteAheadLog: log flush failed");
+    }
+}
+
+void WriteAheadLog::SyncDirect() {
+    uint64_t upto = written_lsn_.load(std::memory_order_acquire);
+    {
+        BPTREE_TIME(Histogram::kWALSync);
+        ::fdatasync(fd_);
+    }
+    ++syncs_;
+
+    // Concurrent syncs may finish out of order; keep the maximum.
+    uint64_t cur = durable_lsn_.load(std::memory_order_relaxed);
+    while (cur < upto && !durable_lsn_.compare_exchange_weak(cur, upto)) {
+    }
+}
+
+void WriteAheadLog::DrainLocked() {
+    if (!buffer_.empty()) {
+        if (!FullWrite(fd_, buffer_.data(), buffer_.size())) {
+            throw std::runtime_error("WriteAheadLog: write failed");
+        }
+        buffer_.clear();
+    }
+    written_lsn_ = next_lsn_ - 1;
+    {
+        BPTREE_TIME(Histogram::kWALSync);
+        ::fdatasync(fd_);
     }
+    ++syncs_;
+    durable_lsn_ = next_lsn_ - 1;
+    durable_cv_.notify_all();
 }
 
 // ============================================================================
-// Recovery
+// Group commit
 // ============================================================================
 
-std::vector<WriteAheadLog::RecoveryRecord> WriteAheadLog::ReadAllRecords() {
-    std::vector<RecoveryRecord> records;
+bool WriteAheadLog::WriteBatch(uint64_t& end) {
+    // Take the whole buffer as one batch; appends continue into the other.
+    {
+        std::lock_guard<std::mutex> guard(latch_);
+        batch_.swap(buffer_);
+        end = next_lsn_ - 1;
+    }
+    durable_cv_.notify_all();  // room for blocked appends
 
-    ::lseek(fd_, static_cast<off_t>(sizeof(WALFileHeader)), SEEK_SET);
+    if (batch_.empty()) return true;
+    bool ok = FullWrite(fd_, batch_.data(), batch_.size());
+    batch_.clear();
+    if (ok) written_lsn_.store(end, std::memory_order_release);
+    return ok;
+}
 
-    while (true) {
-        LogRecordHeader hdr{};
-        if (!FullRead(fd_, &hdr, sizeof(hdr))) break;  // EOF or error
+bool WriteAheadLog::WriteSyncBatch(uint64_t& end) {
+    {
+        std::lock_guard<std::mutex> guard(latch_);
+        batch_.swap(buffer_);
+        end = next_lsn_ - 1;
+    }
+    durable_cv_.notify_all();  // room for blocked appends
 
-        // Validate: LSN should be > 0, type should be valid.
-        if (hdr.lsn == 0 ||
-            static_cast<uint32_t>(hdr.type) > static_cast<uint32_t>(LogRecordType::kCheckpointEnd)) {
-            break;  // corrupt or end of valid records
+    if (batch_.empty()) return true;  // SyncBatch syncs what others wrote
+
+    // The sync runs only once the write has completed in full.
+    IoRequest reqs[2];
+    reqs[0] = {IoOp::kWrite, fd_, batch_.data(), batch_.size(), -1, true};
+    reqs[1] = {IoOp::kSync, fd_};
+    {
+        BPTREE_TIME(Histogram::kWALSync);
+        ring_->Submit(reqs, 2);
+    }
+    bool ok = reqs[0].result == static_cast<ssize_t>(batch_.size()) && reqs[1].result == 0;
+    batch_.clear();
+    if (!ok) return false;
+    written_lsn_.store(end, std::memory_order_release);
+    ++syncs_;
+
+    {
+        std::lock_guard<std::mutex> guard(latch_);
+        if (durable_lsn_ < end) durable_lsn_ = end;
+    }
+    durable_cv_.notify_all();
+    return true;
+}
+
+bool WriteAheadLog::SyncBatch(uint64_t end) {
+    if (durable_lsn_.load(std::memory_order_acquire) >= end) return true;
+    {
+        BPTREE_TIME(Histogram::kWALSync);
+        if (::fdatasync(fd_) != 0) return false;
+    }
+    ++syncs_;
+
+    // Syncs may finish out of order; keep the maximum.
+    {
+        std::lock_guard<std::mutex> guard(latch_);
+        if (durable_lsn_ < end) durable_lsn_ = end;
+    }
+    durable_cv_.notify_all();
+    return true;
+}
+
+void WriteAheadLog::FlusherLoop() {
+    const auto window = std::chrono::microseconds(options_.max_latency_us);
+
+    std::unique_lock<std::mutex> guard(latch_);
+    for (;;) {
+        flush_cv_.wait(guard, [&] {
+            return stop_ || requested_lsn_ > durable_lsn_ ||
+                   buffer_.size() >= options_.max_batch_bytes;
+        });
+        if (stop_ && buffer_.empty()) return;
+
+        // Hold the batch open so concurrent committers can join it.
+        if (window.count() > 0 && !stop_) {
+            flush_cv_.wait_for(guard, window, [&] {
+                return stop_ || buffer_.size() >= options_.max_batch_bytes;
+            });
         }
 
-        RecoveryRecord rec;
-        rec.header = hdr;
+        guard.unlock();
+        uint64_t end = 0;
+        bool ok;
+        {
+            std::lock_guard<std::mutex> io_guard(io_latch_);
+            ok = ring_ ? WriteSyncBatch(end) : WriteBatch(end);
+        }
+        ok = ok && SyncBatch(end);
+        guard.lock();
+        if (!ok) {
+            failed_ = true;
+            durable_cv_.notify_all();
+            return;
+        }
+    }
+}
 
-        if (hdr.data_len > 0) {
-            rec.data.resize(hdr.data_len);
-            if (!FullRead(fd_, rec.data.data(), hdr.data_len)) break;  // truncated
+// ============================================================================
+// Recovery
+// ============================================================================
 
-            // Verify checksum.
-            LogRecordHeader check_hdr = hdr;
-            check_hdr.checksum = 0;
-            uint32_t expected_crc = CRC32(&check_hdr, sizeof(check_hdr));
-            expected_crc ^= CRC32(rec.data.data(), rec.data.size());
+namespace {
 
-            if (expected_crc != hdr.checksum) {
-                break;  // checksum mismatch -- treat as end of valid log
-            }
-        } else {
-            // Verify header-only checksum.
-            LogRecordHeader check_hdr = hdr;
-            check_hdr.checksum = 0;
-            uint32_t expected_crc = CRC32(&check_hdr, sizeof(check_hdr));
-            if (expected_crc != hdr.checksum) {
-                break;
-            }
+using Clock = std::chrono::steady_clock;
+
+/// Records below which another recovery thread is not worth starting.
+constexpr size_t kRecordsPerRecoveryThread = 256;
+
+double SecondsSince(Clock::time_point start) {
+    return std::chrono::duration<double>(Clock::now() - start).count();
+}
+
+/// Run @p fn(i) for every i below @p n, each on its own thread (0 on the
+/// caller's), and rethrow the first exception any of them threw.
+template <typename Fn>
+void RunParallel(unsigned n, const Fn& fn) {
+    std::vector<std::exception_ptr> errors(n);
+    auto run = [&](unsigned i) {
+        try {
+            fn(i);
+        } catch (...) {
+            errors[i] = std::current_exception();
         }
+    };
+    std::vector<std::thread> workers;
+    for (unsigned i = 1; i < n; ++i) workers.emplace_back(run, i);
+    run(0);
+    for (auto& t : workers) t.join();
+    for (auto& e : errors) {
+        if (e) std::rethrow_exception(e);
+    }
+}
+
+}  // namespace
+
+WriteAheadLog::LogScan::~LogScan() {
+    if (map) ::munmap(const_cast<char*>(map), size);
+}
+
+unsigned WriteAheadLog::RecoveryThreads(size_t records) const {
+    unsigned most = options_.recovery_threads;
+    if (most == 0) most = std::max(1u, std::thread::hardware_concurrency());
+    return static_cast<unsigned>(
+        std::clamp<size_t>(records / kRecordsPerRecoveryThread, 1, most));
+}
 
-        records.push_back(std::move(rec));
+void WriteAheadLog::ScanLog(LogScan& scan, size_t verified_end) const {
+    struct stat sb{};
+    if (::fstat(fd_, &sb) != 0) throw std::runtime_error("WriteAheadLog: fstat failed");
+    scan.end = sizeof(WALFileHeader);
+    if (static_cast<size_t>(sb.st_size) <= sizeof(WALFileHeader)) return;
+
+    scan.size = static_cast<size_t>(sb.st_size);
+    void* map = ::mmap(nullptr, scan.size, PROT_READ, MAP_SHARED, fd_, 0);
+    if (map == MAP_FAILED) {
+        scan.size = 0;
+        throw std::runtime_error("WriteAheadLog: cannot map " + path_ + ": " +
+                                 std::strerror(errno));
+    }
+    scan.map = static_cast<const char*>(map);
+
+    // Record boundaries come from the headers, so this pass is serial; it
+    // stops at the first header that cannot start a record.
+    std::vector<size_t> ends;
+    size_t at = sizeof(WALFileHeader);
+    while (scan.size - at >= sizeof(LogRecordHeader)) {
+        RecoveryRecord rec;
+        std::memcpy(&rec.header, scan.map + at, sizeof(rec.header));
+        const LogRecordHeader& hdr = rec.header;
+        if (hdr.lsn == 0 ||
+            static_cast<uint32_t>(hdr.type) > static_cast<uint32_t>(LogRecordType::kInternalSetKey)) {
+            break;  // corrupt or end of valid records
+        }
+        at += sizeof(hdr);
+        if (hdr.data_len > scan.size - at) break;  // truncated
+        rec.data = std::string_view(scan.map + at, hdr.data_len);
+        at += hdr.data_len;
+        scan.records.push_back(rec);
+        ends.push_back(at);
     }
 
-    return records;
+    // Checksums, a slice of the records per thread.  A mismatch is the end
+    // of the valid log.
+    const size_t n       = scan.records.size();
+    size_t       checked = static_cast<size_t>(
+        std::upper_bound(ends.begin(), ends.end(), verified_end) - ends.begin());
+    unsigned threads = RecoveryThreads(n - checked);
+    std::vector<size_t> first_bad(threads, n);
+    RunParallel(threads, [&](unsigned t) {
+        size_t begin = checked + (n - checked) * t / threads;
+        size_t end   = checked + (n - checked) * (t + 1) / threads;
+        for (size_t i = begin; i < end; ++i) {
+            const RecoveryRecord& rec = scan.records[i];
+            if (RecordChecksum(rec.header, rec.data.data(), rec.header.data_len, version_) !=
+                rec.header.checksum) {
+                first_bad[t] = i;
+                return;
+            }
+        }
+    });
+    scan.records.resize(*std::min_element(first_bad.begin(), first_bad.end()));
+    if (!scan.records.empty()) scan.end = ends[scan.records.size() - 1];
 }
 
 size_t WriteAheadLog::Recover(DiskManager& disk) {
-    auto records = ReadAllRecords();
+    RecoveryStats stats;
+    auto start = Clock::now();
+    LogScan scan;
+    ScanLog(scan, verified_end_);
+    const std::vector<RecoveryRecord>& records = scan.records;
+    stats.records = records.size();
+    stats.bytes   = scan.end - sizeof(WALFileHeader);
+    stats.threads = RecoveryThreads(records.size());
+    stats.scan_seconds = SecondsSince(start);
+    start = Clock::now();
 
     // Find the last completed checkpoint.
     uint64_t redo_after_lsn = checkpoint_lsn_;
     for (auto it = records.rbegin(); it != records.rend(); ++it) {
         if (it->header.type == LogRecordType::kCheckpointEnd) {
+            // Before format 5 every change before the end record was on disk.
             redo_after_lsn = it->header.lsn;
+            CheckpointLog rec{};
+            if (it->data.size() >= sizeof(rec)) {
+                std::memcpy(&rec, it->data.data(), sizeof(rec));
+                redo_after_lsn = rec.lsn;
+            }
             break;
         }
     }
 
-    // Redo all PAGE_WRITE records after the checkpoint.
-    size_t pages_recovered = 0;
-    for (const auto& rec : records) {
-        if (rec.header.lsn <= redo_after_lsn) continue;
-        if (rec.header.type != LogRecordType::kPageWrite) continue;
-        if (rec.header.page_id == INVALID_PAGE_ID) continue;
-        if (rec.data.size() != PAGE_SIZE) continue;
+    // Partition the page records after the checkpoint by page, keeping log
+    // order within each partition.
+    std::vector<std::vector<size_t>> parts(stats.threads);
+    int64_t last_page = INVALID_PAGE_ID;
+    for (size_t i = 0; i < records.size(); ++i) {
+        const LogRecordHeader& hdr = records[i].header;
+        if (hdr.lsn <= redo_after_lsn) continue;
+        if (hdr.type == LogRecordType::kCheckpointBegin ||
+            hdr.type == LogRecordType::kCheckpointEnd) continue;
+        if (hdr.page_id == INVALID_PAGE_ID) continue;
+        if (hdr.type == LogRecordType::kPageWrite && hdr.data_len != PAGE_SIZE) continue;
+        parts[static_cast<size_t>(hdr.page_id / PAGE_SIZE) % stats.threads].push_back(i);
+        last_page = std::max(last_page, hdr.page_id);
+    }
+
+    // Ensure the data file is large enough.  The data file may not have
+    // grown yet -- the WAL has the truth.
+    if (last_page != INVALID_PAGE_ID &&
+        last_page + static_cast<int64_t>(PAGE_SIZE) > static_cast<int64_t>(disk.FileSize())) {
+        while (disk.NextPageOffset() <= last_page) disk.AllocatePage();
+    }
 
-        // Ensure the data file is large enough.
-        int64_t required = rec.header.page_id + static_cast<int64_t>(PAGE_SIZE);
-        if (required > static_cast<int64_t>(disk.FileSize())) {
-            // The data file may not have grown yet -- the WAL has the truth.
-            // We need to allocate pages up to this point.
-            while (disk.NextPageOffset() <= rec.header.page_id) {
-                disk.AllocatePage();
+    // Apply each page's records from its last image on: the after-image,
+    // or a change unless the page already has it, stamping the page with
+    // the record's LSN.  Through a copy, as a compressed file has no page
+    // to edit in place; the page is written once at the end.
+    size_t key_size = disk.KeySize();
+    std::vector<RecoveryStats> part_stats(stats.threads);
+    RunParallel(stats.threads, [&](unsigned t) {
+        std::vector<size_t>& ids = parts[t];
+        std::stable_sort(ids.begin(), ids.end(), [&](size_t a, size_t b) {
+            return records[a].header.page_id < records[b].header.page_id;
+        });
+
+        RecoveryStats& ps = part_stats[t];
+        char page[PAGE_SIZE];
+        for (size_t first = 0, last; first < ids.size(); first = last) {
+            int64_t page_id = records[ids[first]].header.page_id;
+            last = first + 1;
+            while (last < ids.size() && records[ids[last]].header.page_id == page_id) ++last;
+
+            size_t from = first;
+            for (size_t i = last; i-- > first;) {
+                if (records[ids[i]].header.type == LogRecordType::kPageWrite) {
+                    from = i;
+                    break;
+                }
             }
-        }
+            ps.superseded += from - first;
 
-        // Apply the after-image.
-        char* page = disk.PageData(rec.header.page_id);
-        std::memcpy(page, rec.data.data(), PAGE_SIZE);
-        ++pages_recovered;
+            bool loaded = false, changed = false, failed = false;
+            for (size_t i = from; i < last && !failed; ++i) {
+                const RecoveryRecord& rec = records[ids[i]];
+                if (rec.header.type == LogRecordType::kPageWrite) {
+                    std::memcpy(page, rec.data.data(), PAGE_SIZE);
+                    loaded = true;
+                } else {
+                    if (!loaded) disk.ReadPage(page_id, page);
+                    loaded = true;
+                    if (PageLSN(page) >= rec.header.lsn) continue;
+                    // The later changes of this page build on this one.
+                    if (!RedoRecord(rec, page, key_size, version_)) {
+                        ++ps.failed;
+                        failed = true;
+                        continue;
+                    }
+                }
+                SetPageLSN(page, rec.header.lsn);
+                changed = true;
+                ++ps.redone;
+            }
+            if (changed && !failed) {
+                disk.WritePage(page_id, page);
+                ++ps.pages;
+            }
+        }
+    });
+    for (const RecoveryStats& ps : part_stats) {
+        stats.redone     += ps.redone;
+        stats.superseded += ps.superseded;
+        stats.pages      += ps.pages;
+        stats.failed     += ps.failed;
     }
 
-    if (pages_recovered > 0) {
+    if (stats.redone > 0) {
         disk.Sync();
     }
 
     // Update next_lsn_ to be past all recovered records.
     if (!records.empty()) {
-        next_lsn_ = records.back().header.lsn + 1;
+        next_lsn_ = std::max(records.back().header.lsn, checkpoint_lsn_.load()) + 1;
     }
 
     // Seek to end for future appends.
     ::lseek(fd_, 0, SEEK_END);
 
-    // If we recovered anything, truncate the WAL since we've applied everything.
-    if (pages_recovered > 0) {
+    // If we recovered anything, truncate the WAL since we've applied
+    // everything.  The synced data file now acts as a checkpoint, so the
+    // next change to each page is logged as a full-page write again.  A
+    // failed change keeps the log: it is the only copy of that page's state.
+    if (stats.redone > 0 && stats.failed == 0) {
+        checkpoint_lsn_ = next_lsn_ - 1;
         Truncate();
     }
 
-    return pages_recovered;
+    stats.redo_seconds = SecondsSince(start);
+    last_recovery_     = stats;
+    return stats.redone;
+}
+
+bool WriteAheadLog::RedoRecord(const RecoveryRecord& rec, char* page, size_t key_size,
+                               uint32_t version) {
+    // Record-level changes depend on the key type only through its size.
+    switch (key_size) {
+        case sizeof(int32_t): return RedoRecordAs<int32_t>(rec, page, version);
+        case sizeof(int64_t): return RedoRecordAs<int64_t>(rec, page, version);
+        default:              return false;
+    }
+}
+
+namespace {
+
+/// Copy the fixed part of @p rec's payload into @p out; false if it is short.
+template <typename T>
+bool ReadPayload(std::string_view data, T& out) {
+    if (data.size() < sizeof(out)) return false;
+    std::memcpy(&out, data.data(), sizeof(out));
+    return true;
+}
+
+}  // namespace
+
+template <typename Key>
+bool WriteAheadLog::RedoRecordAs(const RecoveryRecord& rec, char* page, uint32_t version) {
+    using Leaf     = BasicLeafPage<Key>;
+    using Internal = BasicInternalPage<Key>;
+
+    const char* p   = rec.data.data();
+    size_t      len = rec.data.size();
+
+    bool leaf_change = rec.header.type >= LogRecordType::kLeafInsert &&
+                       rec.header.type <= LogRecordType::kLeafMerge;
+    if (leaf_change && version < 4) return RedoFixedLeaf<Key>(rec, page);
+    if (leaf_change && (!PageIsLeaf(page) || Leaf::IsLegacy(page))) return false;
+
+    // Logs from before the current internal layout change pages in the old
+    // ones; entries are addressed by index, so converting the page first
+    // replays them the same way.
+    if (!leaf_change && Internal::IsLegacy(page)) Internal::UpgradeLegacy(page);
+
+    // A cell of @p len - @p off bytes at @p off; false if it is malformed.
+    auto cell_at = [&](size_t off) {
+        return len >= off + Leaf::kCellHeaderSize &&
+               len == off + Leaf::CellSizeOf(p + off);
+    };
+
+    Leaf     leaf(page);
+    Internal node(page);
+    switch (rec.header.type) {
+        case LogRecordType::kLeafInsert:
+        case LogRecordType::kLeafUpdate: {
+            BasicLeafSlotLog<Key> r{};
+            if (!ReadPayload(rec.data, r) || !cell_at(sizeof(r))) return false;
+            const char* cell = p + sizeof(r);
+            size_t      size = Leaf::CellSizeOf(cell);
+            if (rec.header.type == LogRecordType::kLeafInsert) {
+                if (r.slot < 0 || r.slot > leaf.NumKeys() || !leaf.HasRoom(r.key, -1, size)) return false;
+                leaf.InsertAt(r.slot, r.key, cell);
+            } else {
+                if (r.slot < 0 || r.slot >= leaf.NumKeys() || !leaf.HasRoom(r.key, r.slot, size)) return false;
+                leaf.SetCell(r.slot, cell);
+            }
+            return true;
+        }
+        case LogRecordType::kLeafDelete: {
+            SlotLog r{};
+            if (!ReadPayload(rec.data, r) || r.slot < 0 || r.slot >= leaf.NumKeys()) return false;
+            leaf.RemoveAt(r.slot);
+            return true;
+        }
+        case LogRecordType::kLeafSplit: {
+            LeafLinkLog r{};
+            if (!ReadPayload(rec.data, r) || r.count < 0 || r.count > leaf.NumKeys()) return false;
+            leaf.Truncate(r.count);
+            leaf.SetNextLeaf(r.next_leaf);
+            return true;
+        }
+        case LogRecordType::kLeafMerge: {
+            LeafLinkLog r{};
+            if (!ReadPayload(rec.data, r) || r.count < 0) return false;
+            // Walk the packed records to check they fill the payload exactly
+            // and fit in the leaf even with full keys, as the tree ensures.
+            size_t off = sizeof(r), bytes = 0;
+            for (int i = 0; i < r.count; ++i) {
+                if (len < off + sizeof(Key) + Leaf::kCellHeaderSize) return false;
+                size_t size = Leaf::CellSizeOf(p + off + sizeof(Key));
+                off   += sizeof(Key) + size;
+                bytes += Leaf::RecordSize(size);
+            }
+            if (off != len || leaf.UsedBytes() + bytes > Leaf::kCapacity) return false;
+            leaf.AppendRecords(p + sizeof(r), r.count);
+            leaf.SetNextLeaf(r.next_leaf);
+            return true;
+        }
+        case LogRecordType::kInternalInsert: {
+            BasicInternalSlotLog<Key> r{};
+            if (!ReadPayload(rec.data, r) || r.slot < 0 || r.slot > node.NumKeys() ||
+                node.NumKeys() >= Internal::kMaxKeys) return false;
+            node.InsertAt(r.slot, r.key, r.child);
+            return true;
+        }
+        case LogRecordType::kInternalDelete: {
+            SlotLog r{};
+            if (!ReadPayload(rec.data, r) || r.slot < 0 || r.slot >= node.NumKeys()) return false;
+            node.RemoveAt(r.slot);
+            return true;
+        }
+        case LogRecordType::kInternalSetKey: {
+            BasicInternalSlotLog<Key> r{};
+            if (!ReadPayload(rec.data, r) || r.slot < 0 || r.slot >= node.NumKeys()) return false;
+            node.SetKeyAt(r.slot, r.key);
+            return true;
+        }
+        default:
+            return false;
+    }
+}
+
+template <typename Key>
+bool WriteAheadLog::RedoFixedLeaf(const RecoveryRecord& rec, char* page) {
+    using Leaf = BasicFixedLeafPage<Key>;
+
+    // The page is in the layout of the build that logged the change, or an
+    // older one; records are addressed by index, so converting the page
+    // first replays them the same way.  The tree makes it slotted later.
+    if (Leaf::IsLegacy(page)) Leaf::UpgradeLegacy(page);
+    if (PageType(page) != PAGE_TYPE_V3_LEAF) return false;
+
+    size_t len = rec.data.size();
+    Leaf   leaf(page);
+    switch (rec.header.type) {
+        case LogRecordType::kLeafInsert:
+        case LogRecordType::kLeafUpdate: {
+            BasicLeafSlotLogV3<Key> r{};
+            if (!ReadPayload(rec.data, r)) return false;
+            if (rec.header.type == LogRecordType::kLeafInsert) {
+                if (r.slot < 0 || r.slot > leaf.NumKeys() ||
+                    leaf.NumKeys() >= Leaf::kMaxKeys) return false;
+                leaf.InsertAt(r.slot, r.key, r.data);
+            } else {
+                if (r.slot < 0 || r.slot >= leaf.NumKeys()) return false;
+                leaf.SetRecord(r.slot, r.key, r.data);
+            }
+            return true;
+        }
+        case LogRecordType::kLeafDelete: {
+            SlotLog r{};
+            if (!ReadPayload(rec.data, r) || r.slot < 0 || r.slot >= leaf.NumKeys()) return false;
+            leaf.RemoveAt(r.slot);
+            return true;
+        }
+        case LogRecordType::kLeafSplit: {
+            LeafLinkLog r{};
+            if (!ReadPayload(rec.data, r) || r.count < 0 || r.count > leaf.NumKeys()) return false;
+            leaf.SetNumKeys(r.count);
+            leaf.SetNextLeaf(r.next_leaf);
+            return true;
+        }
+        case LogRecordType::kLeafMerge: {
+            LeafLinkLog r{};
+            if (!ReadPayload(rec.data, r) || r.count < 0 ||
+                leaf.NumKeys() + r.count > Leaf::kMaxKeys ||
+                len != sizeof(r) + static_cast<size_t>(r.count) * Leaf::kRecordSize) {
+                return false;
+            }
+            leaf.AppendRecords(rec.data.data() + sizeof(r), r.count);
+            leaf.SetNextLeaf(r.next_leaf);
+            return true;
+        }
+        default:
+            return false;
+    }
 }
 
 // ============================================================================
@@ -364,9 +962,12 @@ size_t WriteAheadLog::Recover(DiskManager& disk) {
 // ============================================================================
 
 void WriteAheadLog::Truncate() {
-    // Reset to just the file header.
+    // Reset to just the file header.  The log is empty, so this is also
+    // when an older file is upgraded to the current format.
     WALFileHeader hdr{};
     hdr.checkpoint_lsn = checkpoint_lsn_;
+    version_      = hdr.version;
+    verified_end_ = 0;
 
     if (::ftruncate(fd_, sizeof(WALFileHeader)) != 0) {
         throw std::runtime_error("WriteAheadLog::Truncate: ftruncate failed");
@@ -380,4 +981,62 @@ void WriteAheadLog::Truncate() {
     ::lseek(fd_, 0, SEEK_END);
 }
 
+void WriteAheadLog::TruncateThrough(uint64_t lsn) {
+    // Records are in LSN order: skip those up to lsn, then see whether
+    // anything but checkpoint records follows.
+    verified_end_ = 0;
+    const off_t end  = ::lseek(fd_, 0, SEEK_END);
+    off_t       keep = sizeof(WALFileHeader);
+    LogRecordHeader hdr{};
+    auto read_header = [&](off_t at) {
+        return ::pread(fd_, &hdr, sizeof(hdr), at) == static_cast<ssize_t>(sizeof(hdr));
+    };
+    while (keep < end && read_header(keep) && hdr.lsn <= lsn) {
+        keep += static_cast<off_t>(sizeof(hdr) + hdr.data_len);
+    }
+    bool changes = false;
+    for (off_t at = keep; at < end && !changes && read_header(at);
+         at += static_cast<off_t>(sizeof(hdr) + hdr.data_len)) {
+        changes = hdr.type != LogRecordType::kCheckpointBegin &&
+                  hdr.type != LogRecordType::kCheckpointEnd;
+    }
+    if (!changes) {
+        Truncate();
+        return;
+    }
+
+    // Copy the rest into a new file and rename it over the log, so a crash
+    // leaves one or the other.  Version 4 records are valid version 5 ones.
+    WALFileHeader fresh{};
+    fresh.version        = version_ >= 4 ? WAL_FORMAT_VERSION : version_;
+    fresh.checkpoint_lsn = lsn;
+    std::string tmp = path_ + ".tmp";
+    int out = ::open(tmp.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0666);
+    if (out < 0) {
+        throw std::runtime_error("WriteAheadLog: cannot create " + tmp + ": " +
+                                 std::strerror(errno));
+    }
+    bool ok = FullWrite(out, &fresh, sizeof(fresh));
+    std::vector<char> buf(1 << 20);
+    for (off_t at = keep; ok && at < end;) {
+        ssize_t n = ::pread(fd_, buf.data(), std::min(buf.size(), static_cast<size_t>(end - at)), at);
+        if (n < 0 && errno == EINTR) continue;
+        ok = n > 0 && FullWrite(out, buf.data(), static_cast<size_t>(n));
+        at += n;
+    }
+    ok = ok && ::fsync(out) == 0 && ::rename(tmp.c_str(), path_.c_str()) == 0;
+    if (!ok) {
+        ::close(out);
+        ::unlink(tmp.c_str());
+        throw std::runtime_error("WriteAheadLog: cannot rewrite " + path_);
+    }
+
+    // Keep the descriptor number: syncs run outside the latches and may be
+    // about to use it.
+    ::dup2(out, fd_);
+    ::close(out);
+    ::lseek(fd_, 0, SEEK_END);
+    version_ = fresh.version;
+}
+
 }  // namespace bptree
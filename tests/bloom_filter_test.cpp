@@ -0,0 +1,104 @@
+/// @file bloom_filter_test.cpp
+/// @brief Google Test suite for the layered, blocked BloomFilter.
+
+#include <gtest/gtest.h>
+#include "bptree/bloom_filter.h"
+
+#include <atomic>
+#include <cstdint>
+#include <thread>
+#include <vector>
+
+using namespace bptree;
+
+namespace {
+/// A well-mixed hash of @p i (SplitMix64).
+uint64_t Hash(uint64_t i) {
+    uint64_t z = i + 0x9E3779B97F4A7C15ull;
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+    return z ^ (z >> 31);
+}
+
+/// Fraction of @p n keys never added that pass the filter.
+double MeasuredFPR(const BloomFilter& filter, uint64_t first, uint64_t n) {
+    uint64_t passed = 0;
+    for (uint64_t i = first; i < first + n; ++i) passed += filter.MayContain(Hash(i));
+    return static_cast<double>(passed) / static_cast<double>(n);
+}
+}  // namespace
+
+TEST(BloomFilterTest, EmptyFilterContainsNothing) {
+    BloomFilter filter(10, 1000);
+    EXPECT_EQ(MeasuredFPR(filter, 0, 10000), 0.0);
+    BloomFilterStats st = filter.Stats();
+    EXPECT_EQ(st.layers, 1u);
+    EXPECT_EQ(st.keys, 0u);
+    EXPECT_EQ(st.estimated_fpr, 0.0);
+    EXPECT_EQ(filter.Hashes(), 7);
+}
+
+TEST(BloomFilterTest, NoFalseNegatives) {
+    BloomFilter filter(10, 50000);
+    for (uint64_t i = 0; i < 50000; ++i) filter.Add(Hash(i));
+    for (uint64_t i = 0; i < 50000; ++i) ASSERT_TRUE(filter.MayContain(Hash(i))) << i;
+}
+
+TEST(BloomFilterTest, FalsePositiveRateMatchesTheEstimate) {
+    BloomFilter filter(10, 100000);
+    for (uint64_t i = 0; i < 100000; ++i) filter.Add(Hash(i));
+
+    // Ten bits per key: about 1% for a standard filter, a little more for a
+    // blocked one.
+    double measured  = MeasuredFPR(filter, 1u << 30, 200000);
+    double estimated = filter.Stats().estimated_fpr;
+    EXPECT_LT(measured, 0.02);
+    EXPECT_GT(measured, 0.002);
+    EXPECT_NEAR(estimated, measured, measured * 0.25);
+}
+
+TEST(BloomFilterTest, GrowsPastItsCapacity) {
+    BloomFilter filter(10, BloomFilter::kMinCapacity);
+    const uint64_t n = 40 * BloomFilter::kMinCapacity;
+    for (uint64_t i = 0; i < n; ++i) filter.Add(Hash(i));
+    for (uint64_t i = 0; i < n; ++i) ASSERT_TRUE(filter.MayContain(Hash(i))) << i;
+
+    // 1 + 2 + 4 + 8 + 16 + 32 capacities: six layers for 40.
+    BloomFilterStats st = filter.Stats();
+    EXPECT_EQ(st.layers, 6u);
+    EXPECT_EQ(st.keys, n);
+    EXPECT_GE(st.bits, n * 10);
+    // Layers only fill to their capacity, so the rate stays that of one
+    // filter of ten bits per key, times the handful of layers at most.
+    EXPECT_LT(MeasuredFPR(filter, 1u << 30, 200000), 0.04);
+}
+
+TEST(BloomFilterTest, ConcurrentAddsAndProbes) {
+    BloomFilter filter(8, BloomFilter::kMinCapacity);
+    constexpr int kThreads = 4;
+    constexpr uint64_t kPerThread = 20000;
+    std::atomic<uint64_t> published{0};  // keys [0, published) of thread 0 are in
+
+    std::vector<std::thread> threads;
+    for (int t = 0; t < kThreads; ++t) {
+        threads.emplace_back([&, t] {
+            for (uint64_t i = 0; i < kPerThread; ++i) {
+                filter.Add(Hash(t * kPerThread + i));
+                if (t == 0) published.store(i + 1, std::memory_order_release);
+            }
+        });
+    }
+    std::thread prober([&] {
+        for (int round = 0; round < 200; ++round) {
+            uint64_t n = published.load(std::memory_order_acquire);
+            for (uint64_t i = 0; i < n; i += 97) ASSERT_TRUE(filter.MayContain(Hash(i))) << i;
+        }
+    });
+    for (auto& t : threads) t.join();
+    prober.join();
+
+    for (uint64_t i = 0; i < kThreads * kPerThread; ++i) {
+        ASSERT_TRUE(filter.MayContain(Hash(i))) << i;
+    }
+    EXPECT_EQ(filter.Stats().keys, kThreads * kPerThread);
+}
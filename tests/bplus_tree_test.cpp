@@ -3,13 +3,22 @@
 
 #include <gtest/gtest.h>
 #include "bptree/bplus_tree.h"
+#include "bptree/disk_manager.h"
+#include "bptree/page.h"
 
 #include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <climits>
 #include <cstdio>
 #include <cstring>
+#include <filesystem>
 #include <numeric>
 #include <random>
+#include <stdexcept>
 #include <string>
+#include <string_view>
+#include <thread>
 #include <vector>
 
 using namespace bptree;
@@ -19,14 +28,25 @@ class BPlusTreeTest : public ::testing::Test {
 protected:
     static constexpr const char* kTestFile = "test_bptree.idx";
 
-    void SetUp() override { std::remove(kTestFile); }
+    void SetUp() override {
+        std::remove(kTestFile);
+        std::remove((std::string(kTestFile) + ".wal").c_str());
+    }
 
-    void TearDown() override { std::remove(kTestFile); }
+    void TearDown() override {
+        std::remove(kTestFile);
+        std::remove((std::string(kTestFile) + ".wal").c_str());
+    }
 
     /// Helper: create a tree with the test file.
     BPlusTree MakeTree() { return BPlusTree(kTestFile); }
 };
 
+/// Records with values of up to 6 bytes that fill a leaf: roughly how many
+/// of the tests' short records a leaf holds.
+constexpr int kLeafRecords =
+    static_cast<int>(LeafPage::kCapacity / LeafPage::RecordSize(LeafPage::kCellHeaderSize + 6));
+
 // ============================================================================
 // Basic CRUD
 // ============================================================================
@@ -85,6 +105,126 @@ TEST_F(BPlusTreeTest, DeleteNonExistentKeyReturnsNotFound) {
     EXPECT_TRUE(tree.Delete(999).IsNotFound());
 }
 
+// ============================================================================
+// Variable-length values
+// ============================================================================
+
+TEST_F(BPlusTreeTest, BinaryValuesKeepTheirLength) {
+    auto tree = MakeTree();
+    const char bytes[] = {'a', '\0', 'b', '\0'};
+    ASSERT_TRUE(tree.Insert(1, bytes, sizeof(bytes)).ok());
+    ASSERT_TRUE(tree.Insert(2, "", 0).ok());
+
+    std::string val;
+    ASSERT_TRUE(tree.Search(1, val).ok());
+    EXPECT_EQ(val, std::string(bytes, sizeof(bytes)));
+    ASSERT_TRUE(tree.Search(2, val).ok());
+    EXPECT_TRUE(val.empty());
+
+    // A short buffer gets a prefix and the full length.
+    char buf[2];
+    size_t len = 0;
+    ASSERT_TRUE(tree.Search(1, buf, sizeof(buf), len).ok());
+    EXPECT_EQ(len, sizeof(bytes));
+    EXPECT_EQ(std::string(buf, 2), std::string("a\0", 2));
+    EXPECT_TRUE(tree.Search(3, buf, sizeof(buf), len).IsNotFound());
+}
+
+TEST_F(BPlusTreeTest, ShortValuesPackLeaves) {
+    // 12-byte values: a leaf holds about 200 records, where fixed 100-byte
+    // payloads fit 38.  Sequential inserts leave leaves about half full.
+    const int N = 20000;
+    auto tree = MakeTree();
+    for (int i = 0; i < N; ++i) {
+        char buf[16];
+        std::snprintf(buf, sizeof(buf), "value-%06d", i);
+        ASSERT_TRUE(tree.Insert(i, buf).ok());
+    }
+    EXPECT_LT(tree.PageCount(), size_t(N / 50));
+
+    std::vector<std::pair<key_t, std::string>> results;
+    ASSERT_TRUE(tree.RangeQuery(100, 102, results).ok());
+    ASSERT_EQ(results.size(), 3u);
+    EXPECT_EQ(results[0].second, "value-000100");
+}
+
+TEST_F(BPlusTreeTest, OverflowValuesRoundTrip) {
+    const size_t inline_max = LeafPage::kMaxInlineValue;
+    const std::vector<size_t> sizes = {0, 1, inline_max, inline_max + 1,
+                                       OverflowPage::kCapacity, 3 * PAGE_SIZE + 17, 200000};
+    auto value = [](int key, size_t size) {
+        std::string v(size, '\0');
+        for (size_t i = 0; i < size; ++i) v[i] = static_cast<char>('a' + (key + i) % 26);
+        return v;
+    };
+    const int N = 300;
+    {
+        auto tree = MakeTree();
+        for (int i = 0; i < N; ++i) {
+            std::string v = value(i, sizes[i % sizes.size()]);
+            ASSERT_TRUE(tree.Insert(i, v.data(), v.size()).ok()) << i;
+        }
+        // Grow small values and shrink large ones.
+        for (int i = 0; i < N; i += 3) {
+            std::string v = value(i, sizes[(i + 4) % sizes.size()]);
+            ASSERT_TRUE(tree.Insert(i, v.data(), v.size()).ok()) << i;
+        }
+        for (int i = 1; i < N; i += 3) ASSERT_TRUE(tree.Delete(i).ok()) << i;
+    }
+
+    auto expected = [&](int i) {
+        return value(i, sizes[(i % 3 == 0 ? i + 4 : i) % sizes.size()]);
+    };
+    auto tree = MakeTree();
+    for (int i = 0; i < N; ++i) {
+        std::string val;
+        if (i % 3 == 1) {
+            EXPECT_TRUE(tree.Search(i, val).IsNotFound()) << i;
+            continue;
+        }
+        ASSERT_TRUE(tree.Search(i, val).ok()) << i;
+        ASSERT_EQ(val, expected(i)) << i;
+    }
+
+    // Cursors, scans and batches see the same values.
+    int seen = 0;
+    ASSERT_TRUE(tree.Scan(0, N, [&](key_t k, std::string_view v) {
+        EXPECT_EQ(v, expected(k)) << k;
+        ++seen;
+        return true;
+    }).ok());
+    EXPECT_EQ(seen, N - N / 3);
+    std::vector<std::string> values;
+    auto statuses = tree.MultiGet({5, 7, 12}, values);
+    EXPECT_EQ(values[0], expected(5));
+    EXPECT_TRUE(statuses[1].IsNotFound());
+    EXPECT_EQ(values[2], expected(12));
+
+    // Freed overflow pages are reused.
+    size_t pages = tree.PageCount();
+    for (int i = 0; i < N; i += 3) ASSERT_TRUE(tree.Delete(i).ok());
+    for (int i = 0; i < N; i += 3) {
+        std::string v = expected(i);
+        ASSERT_TRUE(tree.Insert(i, v.data(), v.size()).ok());
+    }
+    EXPECT_LE(tree.PageCount(), pages);
+}
+
+TEST_F(BPlusTreeTest, BulkLoadSpillsLongValues) {
+    std::vector<std::pair<key_t, std::string>> records;
+    for (int i = 0; i < 2000; ++i) {
+        records.emplace_back(i, std::string(i % 100 == 0 ? 10000 : 20, static_cast<char>('a' + i % 26)));
+    }
+    {
+        auto tree = MakeTree();
+        ASSERT_TRUE(tree.BulkLoad(records.begin(), records.end()).ok());
+    }
+    auto tree = MakeTree();
+    std::vector<std::pair<key_t, std::string>> results;
+    ASSERT_TRUE(tree.RangeQuery(0, 2000, results).ok());
+    EXPECT_EQ(results, records);
+}
+
 // ============================================================================
 // Range queries
 // ============================================================================
@@ -120,18 +260,421 @@ TEST_F(BPlusTreeTest, RangeQueryInvalidRange) {
     EXPECT_FALSE(s.ok());
 }
 
+// ============================================================================
+// Scans and cursors
+// ============================================================================
+
+TEST_F(BPlusTreeTest, ScanVisitsRangeInOrder) {
+    auto tree = MakeTree();
+    for (int i = 1; i <= 500; ++i) {
+        tree.Insert(i, ("val_" + std::to_string(i)).c_str());
+    }
+
+    std::vector<key_t> keys;
+    ASSERT_TRUE(tree.Scan(100, 300, [&](key_t k, std::string_view v) {
+        EXPECT_EQ(v, "val_" + std::to_string(k));
+        keys.push_back(k);
+        return true;
+    }).ok());
+
+    ASSERT_EQ(keys.size(), 201u);
+    for (size_t i = 0; i < keys.size(); ++i) EXPECT_EQ(keys[i], 100 + static_cast<int>(i));
+
+    EXPECT_FALSE(tree.Scan(10, 5, [](key_t, std::string_view) { return true; }).ok());
+}
+
+TEST_F(BPlusTreeTest, ScanStopsEarly) {
+    auto tree = MakeTree();
+    for (int i = 0; i < 200; ++i) tree.Insert(i, "x");
+
+    std::vector<key_t> keys;
+    auto collect = [&](key_t k, std::string_view) {
+        keys.push_back(k);
+        return keys.size() < 5;
+    };
+    ASSERT_TRUE(tree.Scan(30, 150, collect).ok());
+    EXPECT_EQ(keys, (std::vector<key_t>{30, 31, 32, 33, 34}));
+
+    keys.clear();
+    ASSERT_TRUE(tree.Scan(30, 150, [&](key_t k, std::string_view) {
+        keys.push_back(k);
+        return true;
+    }, /*limit=*/3).ok());
+    EXPECT_EQ(keys, (std::vector<key_t>{30, 31, 32}));
+
+    keys.clear();
+    ASSERT_TRUE(tree.Scan(30, 150, collect, /*limit=*/0).ok());
+    EXPECT_TRUE(keys.empty());
+
+    // Nothing is left latched: a write from this thread goes through.
+    EXPECT_TRUE(tree.Insert(31, "y").ok());
+}
+
+TEST_F(BPlusTreeTest, ScanReadAheadFollowsLeafChain) {
+    constexpr int kKeys = kLeafRecords * 400;     // leaves under several parents
+    {
+        std::vector<std::pair<key_t, std::string>> records;
+        for (int i = 0; i < kKeys; ++i) records.emplace_back(i, "v" + std::to_string(i));
+        auto tree = MakeTree();
+        ASSERT_TRUE(tree.BulkLoad(records.begin(), records.end()).ok());
+    }
+
+    // Reopen with a cold pool smaller than the tree.
+    Options opts;
+    opts.pool_size       = 128;
+    opts.scan_read_ahead = 16;
+    BPlusTree tree(kTestFile, opts);
+
+    // The pages are in the OS cache, so a fast scan could outrun the
+    // prefetch thread; pausing at each leaf stands in for slow I/O.
+    int expected = 0;
+    ASSERT_TRUE(tree.Scan(INT_MIN, INT_MAX, [&](key_t k, std::string_view v) {
+        EXPECT_EQ(k, expected);
+        EXPECT_EQ(v, "v" + std::to_string(k));
+        if (k % kLeafRecords == 0) std::this_thread::sleep_for(std::chrono::microseconds(100));
+        ++expected;
+        return true;
+    }).ok());
+    EXPECT_EQ(expected, kKeys);
+    EXPECT_GT(tree.BufferPoolPrefetches(), 0u);
+    EXPECT_GT(tree.BufferPoolPrefetchHits(), 0u);
+
+    // Seeks, bounds and backward steps are unaffected.
+    auto cur = tree.NewCursor();
+    cur.SetUpperBound(kKeys / 2);
+    int count = 0;
+    for (cur.Seek(kKeys / 4); cur.Valid(); cur.Next()) ++count;
+    EXPECT_EQ(count, kKeys / 2 - kKeys / 4 + 1);
+    expected = kKeys / 2;
+    for (cur.SeekToLast(); cur.Valid() && expected > kKeys / 2 - 500; cur.Prev()) {
+        ASSERT_EQ(cur.key(), expected--);
+    }
+}
+
+TEST_F(BPlusTreeTest, CursorWalksForwardAndBackward) {
+    auto tree = MakeTree();
+    for (int i = 0; i < 1000; i += 2) tree.Insert(i, std::to_string(i).c_str());
+
+    auto cur = tree.NewCursor();
+    EXPECT_FALSE(cur.Valid());
+
+    cur.Seek(101);
+    ASSERT_TRUE(cur.Valid());
+    EXPECT_EQ(cur.key(), 102);
+    EXPECT_EQ(cur.value(), "102");
+
+    int expected = 102;
+    for (; cur.Valid(); cur.Next()) {
+        ASSERT_EQ(cur.key(), expected);
+        expected += 2;
+    }
+    EXPECT_EQ(expected, 1000);
+
+    cur.SeekToLast();
+    ASSERT_TRUE(cur.Valid());
+    expected = 998;
+    for (; cur.Valid(); cur.Prev()) {
+        ASSERT_EQ(cur.key(), expected);
+        ASSERT_EQ(cur.value(), std::to_string(expected));
+        expected -= 2;
+    }
+    EXPECT_EQ(expected, -2);
+
+    cur.SeekToFirst();
+    ASSERT_TRUE(cur.Valid());
+    EXPECT_EQ(cur.key(), 0);
+    cur.Next();
+    cur.Prev();
+    EXPECT_EQ(cur.key(), 0);
+
+    cur.Seek(999);
+    EXPECT_FALSE(cur.Valid());
+}
+
+TEST_F(BPlusTreeTest, CursorPrevCrossesGapBelowSeparator) {
+    auto tree = MakeTree();
+    // Full leaves of one-byte values.
+    const int per_leaf =
+        static_cast<int>(LeafPage::kCapacity / LeafPage::RecordSize(LeafPage::kCellHeaderSize + 1));
+    std::vector<std::pair<key_t, std::string>> records;
+    for (int i = 0; i < 10 * per_leaf; ++i) records.emplace_back(i, "v");
+    ASSERT_TRUE(tree.BulkLoad(records.begin(), records.end()).ok());
+
+    // Leaf 1 holds [per_leaf, 2 * per_leaf).  Deleting its first keys
+    // leaves a gap between its separator and its smallest key.
+    const int first = per_leaf;
+    for (int i = first; i < first + 6; ++i) ASSERT_TRUE(tree.Delete(i).ok());
+
+    auto cur = tree.NewCursor();
+    cur.Seek(first);
+    ASSERT_TRUE(cur.Valid());
+    EXPECT_EQ(cur.key(), first + 6);
+    cur.Prev();
+    ASSERT_TRUE(cur.Valid());
+    EXPECT_EQ(cur.key(), first - 1);
+    cur.Next();
+    ASSERT_TRUE(cur.Valid());
+    EXPECT_EQ(cur.key(), first + 6);
+}
+
+TEST_F(BPlusTreeTest, CursorUpperBoundAndLimit) {
+    auto tree = MakeTree();
+    for (int i = 0; i < 300; ++i) tree.Insert(i, "x");
+
+    auto cur = tree.NewCursor();
+    cur.SetUpperBound(120);
+    int count = 0;
+    for (cur.Seek(100); cur.Valid(); cur.Next()) ++count;
+    EXPECT_EQ(count, 21);
+
+    cur.SeekToLast();
+    ASSERT_TRUE(cur.Valid());
+    EXPECT_EQ(cur.key(), 120);
+
+    // The limit counts the record each seek lands on, in either direction.
+    cur.SetLimit(4);
+    std::vector<key_t> keys;
+    for (cur.SeekToLast(); cur.Valid(); cur.Prev()) keys.push_back(cur.key());
+    EXPECT_EQ(keys, (std::vector<key_t>{120, 119, 118, 117}));
+
+    keys.clear();
+    for (cur.Seek(50); cur.Valid(); cur.Next()) keys.push_back(cur.key());
+    EXPECT_EQ(keys, (std::vector<key_t>{50, 51, 52, 53}));
+}
+
+TEST_F(BPlusTreeTest, CursorOnEmptyTree) {
+    auto tree = MakeTree();
+    auto cur = tree.NewCursor();
+    cur.SeekToFirst();
+    EXPECT_FALSE(cur.Valid());
+    cur.SeekToLast();
+    EXPECT_FALSE(cur.Valid());
+
+    int calls = 0;
+    ASSERT_TRUE(tree.Scan(INT_MIN, INT_MAX, [&](key_t, std::string_view) {
+        ++calls;
+        return true;
+    }).ok());
+    EXPECT_EQ(calls, 0);
+
+    // A tree whose only leaf was emptied.
+    tree.Insert(1, "x");
+    tree.Delete(1);
+    cur.SeekToFirst();
+    EXPECT_FALSE(cur.Valid());
+    cur.SeekToLast();
+    EXPECT_FALSE(cur.Valid());
+}
+
+TEST_F(BPlusTreeTest, CursorValuePointsIntoPage) {
+    auto tree = MakeTree();
+    std::string full(DATA_SIZE, 'z');
+    tree.Insert(7, full.c_str());
+    tree.Insert(8, "short");
+
+    auto cur = tree.NewCursor();
+    cur.Seek(7);
+    ASSERT_TRUE(cur.Valid());
+    std::string_view v = cur.value();
+    EXPECT_EQ(v, full);
+    EXPECT_EQ(v.data(), cur.value().data());
+
+    // A moved-from cursor hands over its position.
+    auto moved = std::move(cur);
+    EXPECT_FALSE(cur.Valid());
+    ASSERT_TRUE(moved.Valid());
+    EXPECT_EQ(moved.value().data(), v.data());
+    moved.Next();
+    EXPECT_EQ(moved.value(), "short");
+
+    moved.Reset();
+    EXPECT_FALSE(moved.Valid());
+    EXPECT_TRUE(tree.Insert(9, "x").ok());
+}
+
+// ============================================================================
+// Batches
+// ============================================================================
+
+TEST_F(BPlusTreeTest, MultiGetReturnsValuesInInputOrder) {
+    auto tree = MakeTree();
+    for (int i = 0; i < 2000; i += 2) tree.Insert(i, ("v" + std::to_string(i)).c_str());
+
+    // Unsorted, with misses, duplicates and keys beyond both ends.
+    std::vector<key_t> keys;
+    for (int i = -10; i < 2010; ++i) keys.push_back(i);
+    keys.push_back(40);
+    keys.push_back(41);
+    std::shuffle(keys.begin(), keys.end(), std::mt19937(7));
+
+    std::vector<std::string> values;
+    auto statuses = tree.MultiGet(keys, values);
+    ASSERT_EQ(statuses.size(), keys.size());
+    ASSERT_EQ(values.size(), keys.size());
+    for (size_t i = 0; i < keys.size(); ++i) {
+        bool present = keys[i] >= 0 && keys[i] < 2000 && keys[i] % 2 == 0;
+        ASSERT_EQ(statuses[i].ok(), present) << "key " << keys[i];
+        if (present) {
+            EXPECT_EQ(values[i], "v" + std::to_string(keys[i]));
+        } else {
+            EXPECT_TRUE(statuses[i].IsNotFound());
+            EXPECT_TRUE(values[i].empty());
+        }
+    }
+
+    // Nothing is left latched.
+    EXPECT_TRUE(tree.Insert(1, "x").ok());
+}
+
+TEST_F(BPlusTreeTest, MultiGetOnEmptyTree) {
+    auto tree = MakeTree();
+    std::vector<std::string> values;
+    auto statuses = tree.MultiGet({1, 2, 3}, values);
+    ASSERT_EQ(statuses.size(), 3u);
+    for (const auto& s : statuses) EXPECT_TRUE(s.IsNotFound());
+    EXPECT_TRUE(tree.MultiGet({}, values).empty());
+}
+
+TEST_F(BPlusTreeTest, InsertBatchInsertsAndUpserts) {
+    auto tree = MakeTree();
+    for (int i = 0; i < 3000; i += 3) tree.Insert(i, "old");
+
+    // Shuffled new and existing keys; every tenth key appears twice, and
+    // the later copy must win.
+    std::vector<std::pair<key_t, std::string>> batch;
+    for (int i = 0; i < 3000; ++i) batch.emplace_back(i, "first" + std::to_string(i));
+    std::shuffle(batch.begin(), batch.end(), std::mt19937(11));
+    for (int i = 0; i < 3000; i += 10) batch.emplace_back(i, "last" + std::to_string(i));
+    ASSERT_TRUE(tree.InsertBatch(batch).ok());
+
+    for (int i = 0; i < 3000; ++i) {
+        std::string val;
+        ASSERT_TRUE(tree.Search(i, val).ok()) << "key " << i;
+        EXPECT_EQ(val, (i % 10 == 0 ? "last" : "first") + std::to_string(i));
+    }
+    std::vector<std::pair<key_t, std::string>> results;
+    ASSERT_TRUE(tree.RangeQuery(INT_MIN, INT_MAX, results).ok());
+    EXPECT_EQ(results.size(), 3000u);
+
+    // Long values are kept whole.
+    std::string big(3 * PAGE_SIZE, 'q');
+    ASSERT_TRUE(tree.InsertBatch({{5000, big}, {5001, "small"}}).ok());
+    std::string val;
+    ASSERT_TRUE(tree.Search(5000, val).ok());
+    EXPECT_EQ(val, big);
+}
+
+TEST_F(BPlusTreeTest, InsertBatchBuildsTreeAndPersists) {
+    std::vector<std::pair<key_t, std::string>> batch;
+    for (int i = 5000; i > 0; --i) batch.emplace_back(i * 7, std::to_string(i));
+    {
+        auto tree = MakeTree();
+        ASSERT_TRUE(tree.InsertBatch(batch).ok());
+        ASSERT_TRUE(tree.InsertBatch({}).ok());
+    }
+
+    auto tree = MakeTree();
+    std::vector<key_t> keys;
+    for (const auto& [k, v] : batch) keys.push_back(k);
+    std::vector<std::string> values;
+    auto statuses = tree.MultiGet(keys, values);
+    for (size_t i = 0; i < batch.size(); ++i) {
+        ASSERT_TRUE(statuses[i].ok()) << "key " << keys[i];
+        EXPECT_EQ(values[i], batch[i].second);
+    }
+}
+
+// ============================================================================
+// Key filter
+// ============================================================================
+
+TEST_F(BPlusTreeTest, FilterAnswersMissesWithoutThePool) {
+    Options opts;
+    opts.bloom_bits_per_key = 10;
+    opts.optimistic_reads   = false;  // every descent counts in the pool stats
+    BPlusTree tree(kTestFile, opts);
+    EXPECT_EQ(tree.FilterStats().keys, 0u);
+
+    constexpr int kKeys = 20000;
+    for (int i = 0; i < kKeys; i += 2) ASSERT_TRUE(tree.Insert(i, "v").ok());
+    std::vector<std::pair<key_t, std::string>> batch;
+    for (int i = kKeys; i < kKeys + 1000; i += 2) batch.emplace_back(i, "b");
+    ASSERT_TRUE(tree.InsertBatch(batch).ok());
+
+    size_t before = tree.BufferPoolHits() + tree.BufferPoolMisses();
+    std::string v;
+    int misses = 0;
+    for (int i = 1; i < kKeys + 1000; i += 2) misses += tree.Search(i, v).IsNotFound();
+    size_t touched = tree.BufferPoolHits() + tree.BufferPoolMisses() - before;
+    EXPECT_EQ(misses, (kKeys + 1000) / 2);
+    // Each lookup that gets past the filter pins a page per level.
+    EXPECT_LT(touched, static_cast<size_t>(misses) / 10);
+
+    std::vector<key_t> keys;
+    for (int i = 0; i < kKeys + 1000; ++i) keys.push_back(i);
+    std::vector<std::string> values;
+    auto statuses = tree.MultiGet(keys, values);
+    for (int i = 0; i < kKeys + 1000; ++i) {
+        ASSERT_EQ(statuses[i].ok(), i % 2 == 0) << "key " << i;
+        if (i % 2 == 0) {
+            EXPECT_EQ(values[i], i < kKeys ? "v" : "b");
+        }
+    }
+
+    BloomFilterStats st = tree.FilterStats();
+    EXPECT_EQ(st.keys, static_cast<size_t>(kKeys + 1000) / 2);
+    EXPECT_GT(st.estimated_fpr, 0.0);
+    EXPECT_LT(st.estimated_fpr, 0.02);
+}
+
+TEST_F(BPlusTreeTest, FilterIsRebuiltOnOpen) {
+    // Without the option there is no filter.
+    EXPECT_EQ(MakeTree().FilterStats().bits, 0u);
+
+    Options opts;
+    opts.bloom_bits_per_key = 8;
+    {
+        BPlusTree tree(kTestFile, opts);
+        std::vector<std::pair<key_t, std::string>> records;
+        for (int i = 0; i < 5000; ++i) records.emplace_back(i * 3, std::to_string(i));
+        ASSERT_TRUE(tree.BulkLoad(records.begin(), records.end()).ok());
+        for (int i = 0; i < 5000; i += 2) ASSERT_TRUE(tree.Delete(i * 3).ok());
+
+        // Deleted keys stay in the filter but are still not found.
+        EXPECT_EQ(tree.FilterStats().keys, 5000u);
+        std::string v;
+        for (int i = 0; i < 5000; ++i) {
+            ASSERT_EQ(tree.Search(i * 3, v).ok(), i % 2 == 1) << i;
+        }
+    }
+
+    BPlusTree tree(kTestFile, opts);
+    BloomFilterStats st = tree.FilterStats();
+    EXPECT_EQ(st.keys, 2500u);
+    EXPECT_GE(st.bits, 2 * 2500u * 8);  // room for as many again
+    std::string v;
+    for (int i = 0; i < 15000; ++i) {
+        bool present = i % 3 == 0 && (i / 3) % 2 == 1;
+        ASSERT_EQ(tree.Search(i, v).ok(), present) << i;
+        if (present) {
+            EXPECT_EQ(v, std::to_string(i / 3));
+        }
+    }
+}
+
 // ============================================================================
 // Stress / split tests
 // ============================================================================
 
 TEST_F(BPlusTreeTest, InsertForcesLeafSplit) {
     auto tree = MakeTree();
-    // LEAF_MAX_KEYS = 35, so 36 inserts triggers at least one split.
-    for (int i = 1; i <= 50; ++i) {
+    // More records than a leaf holds trigger at least one split.
+    const int N = kLeafRecords + 15;
+    for (int i = 1; i <= N; ++i) {
         ASSERT_TRUE(tree.Insert(i, ("d" + std::to_string(i)).c_str()).ok());
     }
     // Verify all keys.
-    for (int i = 1; i <= 50; ++i) {
+    for (int i = 1; i <= N; ++i) {
         std::string val;
         ASSERT_TRUE(tree.Search(i, val).ok()) << "key " << i << " missing";
     }
@@ -139,9 +682,9 @@ TEST_F(BPlusTreeTest, InsertForcesLeafSplit) {
 
 TEST_F(BPlusTreeTest, InsertForcesInternalSplit) {
     auto tree = MakeTree();
-    // Need enough inserts to fill an internal node (INTERNAL_MAX_KEYS = 100).
-    // Each leaf holds 35 keys → ~3600 keys should create ~100+ leaves.
-    const int N = 5000;
+    // Need enough leaves to overfill an internal node: sequential inserts
+    // leave leaves about half full, so this makes about twice as many.
+    const int N = kLeafRecords * (INTERNAL_MAX_KEYS + 1);
     for (int i = 0; i < N; ++i) {
         ASSERT_TRUE(tree.Insert(i, ("r" + std::to_string(i)).c_str()).ok());
     }
@@ -221,6 +764,115 @@ TEST_F(BPlusTreeTest, LargeDatasetPersists) {
     }
 }
 
+TEST_F(BPlusTreeTest, CompressedFilePersists) {
+    // A pool smaller than the tree, so pages are compressed on eviction and
+    // decompressed on misses, then again after reopening.
+    Options opts;
+    opts.pool_size        = 64;
+    opts.page_compression = PageCompression::kLZ4;
+    const int N = 20000;
+    auto value = [](int i) { return "p" + std::to_string(i) + std::string(40, '.'); };
+    size_t pages;
+    {
+        BPlusTree tree(kTestFile, opts);
+        for (int i = 0; i < N; ++i) ASSERT_TRUE(tree.Insert(i, value(i).c_str()).ok());
+        for (int i = 0; i < N; i += 4) ASSERT_TRUE(tree.Delete(i).ok());
+        pages = tree.PageCount();
+    }
+    EXPECT_LT(std::filesystem::file_size(kTestFile), pages * PAGE_SIZE / 3);
+
+    BPlusTree tree(kTestFile, opts);
+    for (int i = 0; i < N; ++i) {
+        std::string val;
+        if (i % 4 == 0) {
+            EXPECT_TRUE(tree.Search(i, val).IsNotFound()) << "key " << i;
+        } else {
+            ASSERT_TRUE(tree.Search(i, val).ok()) << "key " << i;
+            EXPECT_EQ(val, value(i));
+        }
+    }
+}
+
+TEST_F(BPlusTreeTest, DirectBackendPersists) {
+    // Every miss and write-back is an O_DIRECT read or write into a frame.
+    Options opts;
+    opts.pool_size    = 64;
+    opts.disk_backend = DiskBackend::kDirect;
+    const int N = 20000;
+    {
+        BPlusTree tree(kTestFile, opts);
+        for (int i = 0; i < N; ++i) ASSERT_TRUE(tree.Insert(i, ("d" + std::to_string(i)).c_str()).ok());
+        for (int i = 0; i < N; i += 4) ASSERT_TRUE(tree.Delete(i).ok());
+    }
+
+    // Reopened with the other backend: the file is the same either way.
+    for (DiskBackend backend : {DiskBackend::kMmap, DiskBackend::kDirect}) {
+        opts.disk_backend = backend;
+        BPlusTree tree(kTestFile, opts);
+        for (int i = 0; i < N; ++i) {
+            std::string val;
+            if (i % 4 == 0) {
+                EXPECT_TRUE(tree.Search(i, val).IsNotFound()) << "key " << i;
+            } else {
+                ASSERT_TRUE(tree.Search(i, val).ok()) << "key " << i;
+                EXPECT_EQ(val, "d" + std::to_string(i));
+            }
+        }
+    }
+}
+
+TEST_F(BPlusTreeTest, IoUringBatchesReadAheadAndWriteBack) {
+    // Checkpoints write back and scans read ahead in batches, each one
+    // io_uring submission of O_DIRECT requests.
+    Options opts;
+    opts.pool_size       = 128;
+    opts.disk_backend    = DiskBackend::kDirect;
+    opts.io_engine       = IoEngine::kUring;
+    opts.scan_read_ahead = 32;
+    constexpr int kKeys = kLeafRecords * 400;
+    {
+        BPlusTree tree(kTestFile, opts);
+        for (int i = 0; i < kKeys; ++i) ASSERT_TRUE(tree.Insert(i, ("u" + std::to_string(i)).c_str()).ok());
+        tree.Checkpoint();
+    }
+
+    BPlusTree tree(kTestFile, opts);
+    int expected = 0;
+    ASSERT_TRUE(tree.Scan(INT_MIN, INT_MAX, [&](key_t k, std::string_view v) {
+        EXPECT_EQ(k, expected);
+        EXPECT_EQ(v, "u" + std::to_string(k));
+        if (k % kLeafRecords == 0) std::this_thread::sleep_for(std::chrono::microseconds(100));
+        ++expected;
+        return true;
+    }).ok());
+    EXPECT_EQ(expected, kKeys);
+    EXPECT_GT(tree.BufferPoolPrefetches(), 0u);
+}
+
+TEST_F(BPlusTreeTest, PageCleanerWritesAheadOfEviction) {
+    Options opts;
+    opts.pool_size                = 64;
+    opts.page_cleaner             = true;
+    opts.page_cleaner_interval_ms = 1;
+    constexpr int kKeys = kLeafRecords * 200;
+    {
+        BPlusTree tree(kTestFile, opts);
+        for (int i = 0; i < kKeys; ++i) {
+            ASSERT_TRUE(tree.Insert(i, ("c" + std::to_string(i)).c_str()).ok());
+            if (i % kLeafRecords == 0) std::this_thread::sleep_for(std::chrono::microseconds(200));
+        }
+        EXPECT_GT(tree.BufferPoolCleanerWrites(), 0u);
+        EXPECT_LE(tree.BufferPoolDirtyPages(), opts.pool_size);
+    }
+
+    BPlusTree tree(kTestFile, opts);
+    for (int i = 0; i < kKeys; i += 7) {
+        std::string val;
+        ASSERT_TRUE(tree.Search(i, val).ok()) << "key " << i;
+        EXPECT_EQ(val, "c" + std::to_string(i));
+    }
+}
+
 // ============================================================================
 // Delete edge cases
 // ============================================================================
@@ -349,6 +1001,360 @@ TEST_F(BPlusTreeTest, DeletePersistsAcrossReopen) {
     }
 }
 
+TEST_F(BPlusTreeTest, LazyMergeKeepsSparserLeaves) {
+    // Delete four keys in five: eager rebalancing keeps leaves half full,
+    // a merge threshold of 0 only merges the leaves that empty.
+    constexpr int kKeys = 20000;
+    auto remaining_pages = [&](double threshold) {
+        std::remove(kTestFile);
+        Options opts;
+        opts.enable_wal      = false;
+        opts.merge_threshold = threshold;
+        BPlusTree tree(kTestFile, opts);
+        for (int i = 0; i < kKeys; ++i) tree.Insert(i, ("v" + std::to_string(i)).c_str());
+        for (int i = 0; i < kKeys; ++i) {
+            if (i % 5 != 0) {
+                EXPECT_TRUE(tree.Delete(i).ok()) << "delete " << i;
+            }
+        }
+        for (int i = 0; i < kKeys; ++i) {
+            std::string val;
+            if (i % 5 == 0) {
+                EXPECT_TRUE(tree.Search(i, val).ok()) << "key " << i;
+                EXPECT_EQ(val, "v" + std::to_string(i));
+            } else {
+                EXPECT_TRUE(tree.Search(i, val).IsNotFound()) << "key " << i;
+            }
+        }
+        std::vector<std::pair<key_t, std::string>> out;
+        EXPECT_TRUE(tree.RangeQuery(0, kKeys, out).ok());
+        EXPECT_EQ(out.size(), static_cast<size_t>(kKeys / 5));
+
+        EXPECT_TRUE(tree.Compact().ok());
+        return tree.PageCount();
+    };
+    size_t eager = remaining_pages(1.0);
+    size_t lazy  = remaining_pages(0.0);
+    EXPECT_GT(lazy, eager);
+
+    // Empty leaves still go, down to an empty tree.
+    Options opts;
+    opts.enable_wal      = false;
+    opts.merge_threshold = 0.0;
+    std::remove(kTestFile);
+    BPlusTree tree(kTestFile, opts);
+    for (int i = 0; i < kKeys; ++i) tree.Insert(i, "v");
+    for (int i = 0; i < kKeys; ++i) ASSERT_TRUE(tree.Delete(i).ok()) << "delete " << i;
+    EXPECT_TRUE(tree.IsEmpty());
+}
+
+TEST_F(BPlusTreeTest, CompactShrinksFileAndKeepsData) {
+    constexpr int kKeys = 20000;
+    const std::string big(3 * PAGE_SIZE, 'o');  // on an overflow chain
+    auto value = [&](int i) {
+        return i % 100 == 1 ? big + std::to_string(i) : "v" + std::to_string(i);
+    };
+    auto kept = [](int i) { return i % 5 >= 3; };
+
+    const std::pair<PageCompression, DiskBackend> layouts[] = {
+        {PageCompression::kNone, DiskBackend::kMmap},
+        {PageCompression::kNone, DiskBackend::kDirect},
+        {PageCompression::kLZ4, DiskBackend::kMmap},
+    };
+    for (const auto& [compression, backend] : layouts) {
+        SCOPED_TRACE(static_cast<int>(backend) * 2 + static_cast<int>(compression));
+        std::remove(kTestFile);
+        std::remove((std::string(kTestFile) + ".wal").c_str());
+        Options opts;
+        opts.pool_size        = 256;  // the tree does not fit
+        opts.page_compression = compression;
+        opts.disk_backend     = backend;
+        size_t before = 0, after = 0;
+        {
+            BPlusTree tree(kTestFile, opts);
+            for (int i = 0; i < kKeys; ++i) {
+                std::string v = value(i);
+                ASSERT_TRUE(tree.Insert(i, v.data(), v.size()).ok());
+            }
+            for (int i = 0; i < kKeys; ++i) {
+                if (!kept(i)) {
+                    ASSERT_TRUE(tree.Delete(i).ok()) << "delete " << i;
+                }
+            }
+            tree.Checkpoint();
+            before = tree.PageCount();
+
+            ASSERT_TRUE(tree.Compact().ok());
+            after = tree.PageCount();
+            EXPECT_LT(after, before * 3 / 4);
+            if (compression == PageCompression::kNone) {
+                EXPECT_EQ(std::filesystem::file_size(kTestFile), after * PAGE_SIZE);
+            }
+
+            // A second run has nothing to move.
+            ASSERT_TRUE(tree.Compact().ok());
+            EXPECT_EQ(tree.PageCount(), after);
+
+            // The tree keeps working, and grows the file again.
+            for (int i = 0; i < kKeys; i += 5) {
+                std::string v = "new" + std::to_string(i);
+                ASSERT_TRUE(tree.Insert(i, v.data(), v.size()).ok());
+            }
+        }
+
+        BPlusTree tree(kTestFile, opts);
+        EXPECT_GE(tree.PageCount(), after);
+        for (int i = 0; i < kKeys; ++i) {
+            std::string val;
+            if (kept(i)) {
+                ASSERT_TRUE(tree.Search(i, val).ok()) << "key " << i;
+                EXPECT_EQ(val, value(i));
+            } else if (i % 5 == 0) {
+                ASSERT_TRUE(tree.Search(i, val).ok()) << "key " << i;
+                EXPECT_EQ(val, "new" + std::to_string(i));
+            } else {
+                EXPECT_TRUE(tree.Search(i, val).IsNotFound()) << "key " << i;
+            }
+        }
+        std::vector<std::pair<key_t, std::string>> out;
+        ASSERT_TRUE(tree.RangeQuery(0, kKeys, out).ok());
+        ASSERT_EQ(out.size(), static_cast<size_t>(kKeys / 5 * 3));
+        EXPECT_TRUE(std::is_sorted(out.begin(), out.end(),
+                                   [](const auto& a, const auto& b) { return a.first < b.first; }));
+    }
+}
+
+namespace {
+
+/// Value of @p key in files written by `WriteOlderFormat`: "v<key>", padded
+/// to DATA_SIZE - 1 bytes (the longest C string) if @p long_values.
+std::string OlderValue(int key, bool long_values) {
+    std::string value = "v" + std::to_string(key);
+    if (long_values) value.resize(DATA_SIZE - 1, '.');
+    return value;
+}
+
+/// Write a new index file holding keys [0, @p n) with `OlderValue` values
+/// in the page layouts of format @p version: row leaves (types 0, 1),
+/// columnar leaves for 35 records (2) or sized by the key size (3), and
+/// interleaved internal pages (0), separate arrays for 100 keys (1, 2) or
+/// sized by the key size (3).  Nodes are kept small enough for every old
+/// layout: 20 records per leaf (full leaves in version 3), 50 children per
+/// internal node.
+/// @return the number of pages written.
+size_t WriteOlderFormat(const char* path, int64_t version, int n, bool long_values = false) {
+    const int kRecords = version >= 3 ? FixedLeafPage::kMaxKeys : 20;
+    constexpr int kChildren = 50;
+    std::remove(path);
+    DiskManager disk(path);
+
+    // Leaves, linked left to right.
+    std::vector<std::pair<int, int64_t>> level;  // (first key, page)
+    for (int first = 0; first < n; first += kRecords) level.emplace_back(first, disk.AllocatePage());
+    for (size_t l = 0; l < level.size(); ++l) {
+        char* raw = disk.PageData(level[l].second);
+        int count = std::min(kRecords, n - level[l].first);
+        int type  = version >= 2 ? PAGE_TYPE_V2_LEAF : PAGE_TYPE_LEGACY_LEAF;
+        int64_t next = l + 1 < level.size() ? level[l + 1].second : INVALID_PAGE_ID;
+        if (version >= 3) {
+            FixedLeafPage::Init(raw);
+        } else {
+            std::memcpy(raw, &count, 4);
+            std::memcpy(raw + 4, &type, 4);
+        }
+        std::memcpy(raw + 8, &next, 8);
+        for (int i = 0; i < count; ++i) {
+            int key = level[l].first + i;
+            std::string data = OlderValue(key, long_values);
+            data.resize(DATA_SIZE, '\0');
+            if (version >= 3) {
+                FixedLeafPage leaf(raw);
+                leaf.SetNumKeys(i + 1);
+                leaf.SetRecord(i, key, data.data());
+            } else if (version >= 2) {
+                // Keys at 16, one-byte slots at 156, payloads at 192.
+                std::memcpy(raw + 16 + i * 4, &key, 4);
+                raw[156 + i] = static_cast<char>(i);
+                std::memcpy(raw + 192 + i * DATA_SIZE, data.data(), DATA_SIZE);
+            } else {
+                std::memcpy(raw + 16 + i * (4 + DATA_SIZE), &key, 4);
+                std::memcpy(raw + 16 + i * (4 + DATA_SIZE) + 4, data.data(), DATA_SIZE);
+            }
+        }
+    }
+    size_t pages = level.size();
+
+    // Internal levels, bottom up.
+    while (level.size() > 1) {
+        std::vector<std::pair<int, int64_t>> parents;
+        for (size_t first = 0; first < level.size(); first += kChildren) {
+            size_t  count = std::min(level.size() - first, size_t(kChildren));
+            int64_t off   = disk.AllocatePage();
+            char*   raw   = disk.PageData(off);
+            int keys = static_cast<int>(count) - 1;
+            int type = version >= 1 ? PAGE_TYPE_V2_INTERNAL : PAGE_TYPE_LEGACY_INTERNAL;
+            if (version >= 3) {
+                InternalPage::Init(raw);
+                InternalPage(raw).SetNumKeys(keys);
+            } else {
+                std::memcpy(raw, &keys, 4);
+                std::memcpy(raw + 4, &type, 4);
+            }
+            for (size_t i = 0; i < count; ++i) {
+                auto [key, child] = level[first + i];
+                if (version >= 3) {
+                    InternalPage node(raw);
+                    node.SetChildAt(static_cast<int>(i), child);
+                    if (i > 0) node.SetKeyAt(static_cast<int>(i) - 1, key);
+                } else if (version >= 1) {
+                    // Keys at 8, children at 408.
+                    std::memcpy(raw + 408 + i * 8, &child, 8);
+                    if (i > 0) std::memcpy(raw + 8 + (i - 1) * 4, &key, 4);
+                } else {
+                    // [child(8) | key(4)] slots: key i follows child i.
+                    std::memcpy(raw + 8 + i * 12, &child, 8);
+                    if (i > 0) std::memcpy(raw + 8 + (i - 1) * 12 + 8, &key, 4);
+                }
+            }
+            parents.emplace_back(level[first].first, off);
+        }
+        pages += parents.size();
+        level.swap(parents);
+    }
+
+    disk.SetRootOffset(level.front().second);
+    disk.SetKeySize(version >= 3 ? sizeof(int) : 0);  // not recorded before version 3
+    disk.SetFormatVersion(version);
+    disk.FlushMetadata();
+    disk.Sync();
+    return pages;
+}
+
+}  // namespace
+
+TEST_F(BPlusTreeTest, OpensAndUpgradesOlderFormats) {
+    const int N = 20000;  // two internal levels
+    for (int64_t version : {0, 1, 2, 3}) {
+        ASSERT_GT(WriteOlderFormat(kTestFile, version, N), size_t(N / 40));
+
+        {
+            auto tree = MakeTree();
+            for (int i = 0; i < N; i += 7) {
+                std::string val;
+                ASSERT_TRUE(tree.Search(i, val).ok()) << "version " << version << " key " << i;
+                EXPECT_EQ(val, "v" + std::to_string(i));
+            }
+            for (int i = N; i < N + 5000; ++i) ASSERT_TRUE(tree.Insert(i, "new").ok());
+            for (int i = 0; i < 5000; ++i) ASSERT_TRUE(tree.Delete(i).ok());
+        }
+        {
+            DiskManager disk(kTestFile);
+            EXPECT_EQ(disk.FormatVersion(), FILE_FORMAT_VERSION);
+            EXPECT_EQ(PageType(disk.PageData(disk.RootOffset())), PAGE_TYPE_INTERNAL);
+        }
+        {
+            auto tree = MakeTree();
+            std::vector<std::pair<key_t, std::string>> results;
+            ASSERT_TRUE(tree.RangeQuery(0, 2 * N, results).ok());
+            ASSERT_EQ(results.size(), size_t(N));
+            EXPECT_EQ(results.front().first, 5000);
+            EXPECT_EQ(results.back(), std::make_pair(N + 4999, std::string("new")));
+            EXPECT_EQ(results[1], std::make_pair(5001, std::string("v5001")));
+        }
+    }
+}
+
+TEST_F(BPlusTreeTest, UpgradeSpillsValuesOfFullLeaves) {
+    // Full version 3 leaves of 99-byte values are just too big for a
+    // slotted leaf, so each upgrade moves one value to an overflow page.
+    const int N = FixedLeafPage::kMaxKeys * 30;
+    size_t pages = WriteOlderFormat(kTestFile, 3, N, /*long_values=*/true);
+    {
+        auto tree = MakeTree();
+        EXPECT_EQ(tree.PageCount(), 1 + pages + 30);
+        std::vector<std::pair<key_t, std::string>> results;
+        ASSERT_TRUE(tree.RangeQuery(0, N, results).ok());
+        ASSERT_EQ(results.size(), size_t(N));
+        for (int i = 0; i < N; ++i) {
+            ASSERT_EQ(results[i], std::make_pair(i, OlderValue(i, true))) << "key " << i;
+        }
+        for (int i = 0; i < N; i += 2) ASSERT_TRUE(tree.Delete(i).ok());
+    }
+    auto tree = MakeTree();
+    for (int i = 0; i < N; ++i) {
+        std::string val;
+        if (i % 2 == 0) {
+            EXPECT_TRUE(tree.Search(i, val).IsNotFound()) << i;
+        } else {
+            ASSERT_TRUE(tree.Search(i, val).ok()) << i;
+            EXPECT_EQ(val, OlderValue(i, true));
+        }
+    }
+}
+
+TEST_F(BPlusTreeTest, NewFilesUseCurrentFormat) {
+    { auto tree = MakeTree(); }
+    DiskManager disk(kTestFile);
+    EXPECT_EQ(disk.FormatVersion(), FILE_FORMAT_VERSION);
+    EXPECT_EQ(disk.KeySize(), sizeof(key_t));
+}
+
+// ============================================================================
+// Key types
+// ============================================================================
+
+TEST_F(BPlusTreeTest, Int64KeysBeyond32Bits) {
+    using Tree64 = BasicBPlusTree<int64_t>;
+    // Keys that collide if truncated to 32 bits, spread around zero.
+    auto key = [](int i) { return (int64_t{i} << 32) - (int64_t{3000} << 32); };
+    const int N = 6000;
+    std::vector<int> order(N);
+    std::iota(order.begin(), order.end(), 0);
+    std::shuffle(order.begin(), order.end(), std::mt19937(5));
+    {
+        Tree64 tree(kTestFile);
+        for (int i : order) {
+            ASSERT_TRUE(tree.Insert(key(i), ("w" + std::to_string(i)).c_str()).ok());
+        }
+        for (int i = 0; i < N; i += 2) ASSERT_TRUE(tree.Delete(key(i)).ok());
+    }
+    {
+        Tree64 tree(kTestFile);
+        for (int i = 0; i < N; ++i) {
+            std::string val;
+            if (i % 2 == 0) {
+                EXPECT_TRUE(tree.Search(key(i), val).IsNotFound()) << i;
+            } else {
+                ASSERT_TRUE(tree.Search(key(i), val).ok()) << i;
+                EXPECT_EQ(val, "w" + std::to_string(i));
+            }
+        }
+
+        std::vector<std::pair<int64_t, std::string>> results;
+        ASSERT_TRUE(tree.RangeQuery(key(100), key(200), results).ok());
+        ASSERT_EQ(results.size(), 50u);
+        EXPECT_EQ(results.front().first, key(101));
+        EXPECT_EQ(results.back().first, key(199));
+
+        // Backwards across every leaf, down to the smallest key.
+        auto cur = tree.NewCursor();
+        int i = N - 1;
+        for (cur.SeekToLast(); cur.Valid(); cur.Prev(), i -= 2) ASSERT_EQ(cur.key(), key(i));
+        EXPECT_EQ(i, -1);
+    }
+}
+
+TEST_F(BPlusTreeTest, KeySizeIsCheckedOnOpen) {
+    { auto tree = MakeTree(); ASSERT_TRUE(tree.Insert(1, "one").ok()); }
+    EXPECT_THROW(BasicBPlusTree<int64_t> tree(kTestFile), std::runtime_error);
+
+    // The file is untouched and still opens with its own key type.
+    auto tree = MakeTree();
+    std::string val;
+    ASSERT_TRUE(tree.Search(1, val).ok());
+    EXPECT_EQ(val, "one");
+}
+
 TEST_F(BPlusTreeTest, BufferPoolStatsAfterOperations) {
     auto tree = MakeTree();
     for (int i = 0; i < 100; ++i) tree.Insert(i, "x");
@@ -360,3 +1366,654 @@ TEST_F(BPlusTreeTest, BufferPoolStatsAfterOperations) {
     EXPECT_GT(tree.BufferPoolHits(), 0u);
     EXPECT_GT(tree.BufferPoolHitRate(), 0.0);
 }
+
+// ============================================================================
+// Bulk load
+// ============================================================================
+
+namespace {
+
+/// Records key, key + step, ... with "v<key>" values.
+std::vector<std::pair<key_t, std::string>> SortedRecords(int n, int step = 1) {
+    std::vector<std::pair<key_t, std::string>> records;
+    records.reserve(n);
+    for (int i = 0; i < n; ++i) {
+        records.emplace_back(i * step, "v" + std::to_string(i * step));
+    }
+    return records;
+}
+
+/// Leaf bytes of a `PaddedRecords` record as balancing counts them (full
+/// width), as stored once its key is a suffix of the prefix 0 (keys below
+/// 65536), and how many fill a leaf (254).
+constexpr size_t kPaddedRecord  = LeafPage::RecordSize(LeafPage::kCellHeaderSize + 10);
+constexpr size_t kPaddedStored  = kPaddedRecord - (sizeof(key_t) - LeafPage::kSuffixSize);
+constexpr int    kPaddedPerLeaf = static_cast<int>(LeafPage::kCapacity / kPaddedStored);
+
+/// Records 0, 1, ... with 10-byte "p<key>" values, so leaves fill evenly.
+std::vector<std::pair<key_t, std::string>> PaddedRecords(int n) {
+    std::vector<std::pair<key_t, std::string>> records;
+    records.reserve(n);
+    char buf[16];
+    for (int i = 0; i < n; ++i) {
+        std::snprintf(buf, sizeof(buf), "p%09d", i);
+        records.emplace_back(i, buf);
+    }
+    return records;
+}
+
+}  // namespace
+
+TEST_F(BPlusTreeTest, BulkLoadBuildsSearchableTree) {
+    auto tree = MakeTree();
+    const int N = 20000;  // three levels
+    auto records = SortedRecords(N, 2);
+    ASSERT_TRUE(tree.BulkLoad(records.begin(), records.end()).ok());
+    EXPECT_FALSE(tree.IsEmpty());
+
+    for (const auto& [key, value] : records) {
+        std::string val;
+        ASSERT_TRUE(tree.Search(key, val).ok()) << "key " << key;
+        EXPECT_EQ(val, value);
+    }
+    std::string val;
+    EXPECT_TRUE(tree.Search(1, val).IsNotFound());
+    EXPECT_TRUE(tree.Search(2 * N, val).IsNotFound());
+
+    std::vector<std::pair<key_t, std::string>> results;
+    ASSERT_TRUE(tree.RangeQuery(0, 2 * N, results).ok());
+    EXPECT_EQ(results, records);
+
+    results.clear();
+    ASSERT_TRUE(tree.RangeQuery(1001, 1101, results).ok());
+    ASSERT_EQ(results.size(), 50u);
+    EXPECT_EQ(results.front().first, 1002);
+    EXPECT_EQ(results.back().first, 1100);
+}
+
+TEST_F(BPlusTreeTest, BulkLoadFromCallback) {
+    auto tree = MakeTree();
+    int next = 0;
+    std::string value;
+    ASSERT_TRUE(tree.BulkLoad([&](key_t& key, std::string_view& view) {
+        if (next == 1000) return false;
+        key   = next;
+        value = "cb" + std::to_string(next);
+        view  = value;
+        ++next;
+        return true;
+    }).ok());
+
+    for (int i = 0; i < 1000; ++i) {
+        std::string val;
+        ASSERT_TRUE(tree.Search(i, val).ok()) << "key " << i;
+        EXPECT_EQ(val, "cb" + std::to_string(i));
+    }
+}
+
+TEST_F(BPlusTreeTest, BulkLoadEmptyInputLeavesTreeEmpty) {
+    auto tree = MakeTree();
+    std::vector<std::pair<key_t, std::string>> none;
+    ASSERT_TRUE(tree.BulkLoad(none.begin(), none.end()).ok());
+    EXPECT_TRUE(tree.IsEmpty());
+    ASSERT_TRUE(tree.Insert(1, "one").ok());
+}
+
+TEST_F(BPlusTreeTest, BulkLoadPacksLeavesToFillFactor) {
+    // 100 full leaves under one root, plus the metadata page.
+    const int N = kPaddedPerLeaf * 100;
+    auto records = PaddedRecords(N);
+    {
+        auto tree = MakeTree();
+        ASSERT_TRUE(tree.BulkLoad(records.begin(), records.end(), 1.0).ok());
+        EXPECT_EQ(tree.PageCount(), 1u + 100u + 1u);
+    }
+    std::remove(kTestFile);
+    {
+        // Splits leave inserted leaves about half full.
+        auto tree = MakeTree();
+        for (const auto& [key, value] : records) ASSERT_TRUE(tree.Insert(key, value.c_str()).ok());
+        EXPECT_GT(tree.PageCount(), 1u + 150u);
+    }
+    std::remove(kTestFile);
+    {
+        // Leaves are closed once 70% of their bytes are used: 178 records
+        // each -> 143 leaves under one root.
+        auto tree = MakeTree();
+        ASSERT_TRUE(tree.BulkLoad(records.begin(), records.end(), 0.7).ok());
+        EXPECT_EQ(tree.PageCount(), 1u + 143u + 1u);
+    }
+    std::remove(kTestFile);
+    {
+        // Low fill factors are raised to the minimum occupancy: 96 records
+        // per leaf, the short last leaf merged -> 264 leaves.
+        auto tree = MakeTree();
+        ASSERT_TRUE(tree.BulkLoad(records.begin(), records.end(), 0.01).ok());
+        EXPECT_EQ(tree.PageCount(), 1u + 264u + 1u);
+    }
+}
+
+TEST_F(BPlusTreeTest, BulkLoadRejectsBadInput) {
+    auto tree = MakeTree();
+    auto records = PaddedRecords(2 * kPaddedPerLeaf + 50);
+
+    EXPECT_TRUE(tree.BulkLoad(records.begin(), records.end(), 0.0).IsInvalidArg());
+    EXPECT_TRUE(tree.BulkLoad(records.begin(), records.end(), 1.5).IsInvalidArg());
+    EXPECT_TRUE(tree.IsEmpty());
+
+    // Out of order in the middle of the third leaf, and a duplicate.
+    auto unsorted = records;
+    std::swap(unsorted[2 * kPaddedPerLeaf + 20], unsorted[2 * kPaddedPerLeaf + 21]);
+    EXPECT_TRUE(tree.BulkLoad(unsorted.begin(), unsorted.end()).IsInvalidArg());
+    EXPECT_TRUE(tree.IsEmpty());
+    auto dup = records;
+    dup[kPaddedPerLeaf + 50].first = dup[kPaddedPerLeaf + 49].first;
+    EXPECT_TRUE(tree.BulkLoad(dup.begin(), dup.end()).IsInvalidArg());
+    EXPECT_TRUE(tree.IsEmpty());
+
+    // The leaves of the failed loads went back to the free list and are
+    // reused: three leaves and a root.
+    EXPECT_EQ(tree.PageCount(), 1u + 3u);
+    ASSERT_TRUE(tree.BulkLoad(records.begin(), records.end()).ok());
+    EXPECT_EQ(tree.PageCount(), 1u + 3u + 1u);
+
+    EXPECT_TRUE(tree.BulkLoad(records.begin(), records.end()).IsInvalidArg());
+    std::string val;
+    ASSERT_TRUE(tree.Search(99, val).ok());
+    EXPECT_EQ(val, "p000000099");
+}
+
+TEST_F(BPlusTreeTest, BulkLoadPersistsAcrossReopen) {
+    auto records = SortedRecords(5000, 3);
+    {
+        auto tree = MakeTree();
+        ASSERT_TRUE(tree.BulkLoad(records.begin(), records.end()).ok());
+        // Nothing but the checkpoints is in the log.
+        EXPECT_LT(tree.WALBytesWritten(), size_t(PAGE_SIZE));
+    }
+    {
+        auto tree = MakeTree();
+        std::vector<std::pair<key_t, std::string>> results;
+        ASSERT_TRUE(tree.RangeQuery(0, 3 * 5000, results).ok());
+        EXPECT_EQ(results, records);
+    }
+}
+
+TEST_F(BPlusTreeTest, BulkLoadedTreeSupportsUpdates) {
+    // Full leaves and nodes: the first insert into each one splits it.  The
+    // short last leaf is evened out with its neighbour.
+    auto tree = MakeTree();
+    const int N = kLeafRecords * 150 + 3;
+    auto records = SortedRecords(N, 2);
+    ASSERT_TRUE(tree.BulkLoad(records.begin(), records.end()).ok());
+
+    for (int i = 0; i < N; ++i) ASSERT_TRUE(tree.Insert(2 * i + 1, "odd").ok());
+    for (int i = 0; i < 2 * N; i += 2) ASSERT_TRUE(tree.Delete(i).ok()) << "key " << i;
+
+    std::vector<std::pair<key_t, std::string>> results;
+    ASSERT_TRUE(tree.RangeQuery(0, 2 * N, results).ok());
+    ASSERT_EQ(results.size(), size_t(N));
+    for (int i = 0; i < N; ++i) EXPECT_EQ(results[i].first, 2 * i + 1);
+
+    for (int i = 0; i < N; ++i) ASSERT_TRUE(tree.Delete(2 * i + 1).ok());
+    EXPECT_TRUE(tree.IsEmpty());
+}
+
+TEST_F(BPlusTreeTest, BulkLoadShortLastLeaf) {
+    // Loads whose last leaf would fall below the minimum, either merged into
+    // its neighbour (fill 0.5) or split evenly with it (fill 1.0); deleting
+    // everything afterwards rebalances through those leaves.
+    const int min_records = static_cast<int>(LeafPage::kMinUsed / kPaddedRecord);  // still short
+    for (double fill : {0.5, 1.0}) {
+        // Records in each leaf but the last.
+        const int per_leaf = std::min(
+            kPaddedPerLeaf, static_cast<int>(fill * LeafPage::kCapacity / kPaddedStored) + 1);
+        for (int extra : {1, min_records}) {
+            std::remove(kTestFile);
+            auto tree = MakeTree();
+            const int N = per_leaf * 4 + extra;
+            auto records = PaddedRecords(N);
+            ASSERT_TRUE(tree.BulkLoad(records.begin(), records.end(), fill).ok());
+
+            for (int i = N - 1; i >= 0; --i) {
+                ASSERT_TRUE(tree.Delete(i).ok()) << "fill " << fill << " key " << i;
+                std::vector<std::pair<key_t, std::string>> results;
+                ASSERT_TRUE(tree.RangeQuery(0, N, results).ok());
+                ASSERT_EQ(results.size(), size_t(i));
+            }
+            EXPECT_TRUE(tree.IsEmpty());
+        }
+    }
+}
+
+// ============================================================================
+// Concurrency
+// ============================================================================
+
+TEST_F(BPlusTreeTest, ConcurrentReaders) {
+    auto tree = MakeTree();
+    for (int i = 0; i < 2000; ++i) tree.Insert(i, ("v" + std::to_string(i)).c_str());
+
+    std::vector<std::thread> threads;
+    std::vector<int> misses(4, 0);
+    for (int t = 0; t < 4; ++t) {
+        threads.emplace_back([&, t] {
+            std::mt19937 rng(t);
+            for (int n = 0; n < 5000; ++n) {
+                int k = static_cast<int>(rng() % 2000);
+                std::string val;
+                if (!tree.Search(k, val).ok() || val != "v" + std::to_string(k)) {
+                    ++misses[t];
+                }
+            }
+        });
+    }
+    for (auto& th : threads) th.join();
+
+    for (int m : misses) EXPECT_EQ(m, 0);
+}
+
+TEST_F(BPlusTreeTest, ConcurrentOptimisticReadersAndSplits) {
+    // Readers descend without latches while writers split and merge the
+    // nodes above them, the root included.
+    for (bool optimistic : {true, false}) {
+        std::remove(kTestFile);
+        Options opts;
+        opts.optimistic_reads = optimistic;
+        BPlusTree tree(kTestFile, opts);
+        for (int i = 0; i < 100; ++i) tree.Insert(i * 1000, "stable");
+
+        std::atomic<bool> done{false};
+        std::vector<std::thread> threads;
+        for (int w = 0; w < 2; ++w) {
+            threads.emplace_back([&, w] {
+                for (int round = 0; round < 2; ++round) {
+                    for (int i = 0; i < 6000; ++i) {
+                        int k = (i % 100) * 1000 + 1 + i / 100 * 2 + w;
+                        tree.Insert(k, "churn");
+                    }
+                    for (int i = 0; i < 6000; ++i) {
+                        tree.Delete((i % 100) * 1000 + 1 + i / 100 * 2 + w);
+                    }
+                }
+            });
+        }
+        std::vector<int> misses(2, 0);
+        for (int r = 0; r < 2; ++r) {
+            threads.emplace_back([&, r] {
+                std::mt19937 rng(r);
+                while (!done) {
+                    int k = static_cast<int>(rng() % 100) * 1000;
+                    std::string val;
+                    if (!tree.Search(k, val).ok() || val != "stable") ++misses[r];
+                }
+            });
+        }
+        threads[0].join();
+        threads[1].join();
+        done = true;
+        for (size_t i = 2; i < threads.size(); ++i) threads[i].join();
+
+        for (int m : misses) {
+            EXPECT_EQ(m, 0) << "optimistic " << optimistic;
+        }
+        std::vector<std::pair<key_t, std::string>> results;
+        ASSERT_TRUE(tree.RangeQuery(0, INT_MAX, results).ok());
+        EXPECT_EQ(results.size(), 100u);
+        if (!optimistic) {
+            EXPECT_EQ(tree.OptimisticRestarts(), 0u);
+        }
+    }
+}
+
+TEST_F(BPlusTreeTest, ConcurrentReadersWhilePagesAreFreed) {
+    // Readers probing a page pin it for a moment.  That must not leave a
+    // merged-away page's frame in the pool once the page is on the free
+    // list: evicted later, it would overwrite the free-list link, and the
+    // page would be handed out twice (or a garbage offset followed).
+    for (int run = 0; run < 3; ++run) {
+        std::remove(kTestFile);
+        std::remove((std::string(kTestFile) + ".wal").c_str());
+        Options opts;
+        opts.pool_size = 64;  // evicts whatever stale frames are left
+        BPlusTree tree(kTestFile, opts);
+
+        std::atomic<bool> done{false};
+        std::vector<std::thread> writers, readers;
+        for (int w = 0; w < 3; ++w) {
+            writers.emplace_back([&, w] {
+                for (int round = 0; round < 4; ++round) {
+                    for (int k = w; k < 3000; k += 3) tree.Insert(k, "value");
+                    for (int k = w; k < 3000; k += 3) tree.Delete(k);
+                }
+            });
+        }
+        for (int r = 0; r < 3; ++r) {
+            readers.emplace_back([&, r] {
+                std::mt19937 rng(r);
+                std::string val;
+                while (!done) tree.Search(static_cast<int>(rng() % 3000), val);
+            });
+        }
+        for (auto& th : writers) th.join();
+        done = true;
+        for (auto& th : readers) th.join();
+        ASSERT_TRUE(tree.IsEmpty());
+
+        // Reusing the freed pages must give every record a page of its own.
+        for (int k = 0; k < 3000; ++k) {
+            ASSERT_TRUE(tree.Insert(k, ("v" + std::to_string(k)).c_str()).ok());
+        }
+        for (int k = 0; k < 3000; ++k) {
+            std::string val;
+            ASSERT_TRUE(tree.Search(k, val).ok()) << k;
+            ASSERT_EQ(val, "v" + std::to_string(k));
+        }
+    }
+}
+
+TEST_F(BPlusTreeTest, SwizzledLookupsSurviveEviction) {
+    for (bool swizzle : {true, false}) {
+        std::remove(kTestFile);
+        Options opts;
+        opts.pool_size        = 64;
+        opts.swizzle_pointers = swizzle;
+        BPlusTree tree(kTestFile, opts);
+        const std::string pad(200, '.');
+        for (int i = 0; i < 5000; ++i) tree.Insert(i, (std::to_string(i) + pad).c_str());
+
+        // Lookups in a pool far smaller than the tree keep evicting the
+        // children that parents point to.
+        std::mt19937 rng(7);
+        for (int n = 0; n < 5000; ++n) {
+            int k = static_cast<int>(rng() % 5000);
+            std::string val;
+            ASSERT_TRUE(tree.Search(k, val).ok()) << k;
+            ASSERT_EQ(val, std::to_string(k) + pad);
+        }
+        if (swizzle) {
+            EXPECT_GT(tree.BufferPoolSwizzledPages(), 0u);
+        } else {
+            EXPECT_EQ(tree.BufferPoolSwizzledPages(), 0u);
+        }
+    }
+}
+
+TEST_F(BPlusTreeTest, ConcurrentReadersDuringCompact) {
+    Options opts;
+    opts.pool_size = 512;
+    BPlusTree tree(kTestFile, opts);
+    constexpr int kKeys = 20000;
+    for (int i = 0; i < kKeys; ++i) tree.Insert(i, ("v" + std::to_string(i)).c_str());
+    for (int i = 0; i < kKeys; ++i) {
+        if (i % 4 != 0) tree.Delete(i);
+    }
+
+    // Point lookups and cursors keep running across the moves; only the
+    // multiples of 4 are left.
+    std::atomic<bool> done{false};
+    std::vector<int> errors(3, 0);
+    std::vector<std::thread> threads;
+    for (int t = 0; t < 2; ++t) {
+        threads.emplace_back([&, t] {
+            std::mt19937 rng(t);
+            do {
+                int k = static_cast<int>(rng() % kKeys);
+                std::string val;
+                Status st = tree.Search(k, val);
+                if (k % 4 == 0 ? !st.ok() || val != "v" + std::to_string(k) : !st.IsNotFound()) {
+                    ++errors[t];
+                }
+            } while (!done.load());
+        });
+    }
+    threads.emplace_back([&] {
+        do {
+            auto cur = tree.NewCursor();
+            int prev = -1, n = 0;
+            for (cur.SeekToFirst(); cur.Valid(); cur.Next()) {
+                if (cur.key() <= prev || cur.key() % 4 != 0) ++errors[2];
+                prev = cur.key();
+                ++n;
+            }
+            if (n != kKeys / 4) ++errors[2];
+        } while (!done.load());
+    });
+
+    size_t before = tree.PageCount();
+    ASSERT_TRUE(tree.Compact().ok());
+    done = true;
+    for (auto& th : threads) th.join();
+
+    for (int e : errors) EXPECT_EQ(e, 0);
+    EXPECT_LT(tree.PageCount(), before / 2);
+}
+
+TEST_F(BPlusTreeTest, ConcurrentDisjointInserts) {
+    auto tree = MakeTree();
+    constexpr int kThreads = 4;
+    constexpr int kPerThread = 1500;
+
+    std::vector<std::thread> threads;
+    for (int t = 0; t < kThreads; ++t) {
+        threads.emplace_back([&, t] {
+            // Interleave key ranges so threads contend for the same leaves.
+            for (int i = 0; i < kPerThread; ++i) {
+                int k = i * kThreads + t;
+                tree.Insert(k, ("v" + std::to_string(k)).c_str());
+            }
+        });
+    }
+    for (auto& th : threads) th.join();
+
+    for (int k = 0; k < kThreads * kPerThread; ++k) {
+        std::string val;
+        ASSERT_TRUE(tree.Search(k, val).ok()) << "key " << k;
+        EXPECT_EQ(val, "v" + std::to_string(k));
+    }
+
+    std::vector<std::pair<key_t, std::string>> results;
+    ASSERT_TRUE(tree.RangeQuery(0, kThreads * kPerThread, results).ok());
+    EXPECT_EQ(results.size(), static_cast<size_t>(kThreads * kPerThread));
+}
+
+TEST_F(BPlusTreeTest, ConcurrentMixedWorkload) {
+    auto tree = MakeTree();
+    constexpr int kKeys = 3000;
+    for (int i = 0; i < kKeys; ++i) tree.Insert(i, "base");
+
+    // Writers own disjoint key sets: even keys are deleted, keys above
+    // kKeys are inserted.  Readers scan and probe the stable odd keys.
+    std::vector<std::thread> threads;
+    threads.emplace_back([&] {
+        for (int i = 0; i < kKeys; i += 2) tree.Delete(i);
+    });
+    threads.emplace_back([&] {
+        for (int i = kKeys; i < 2 * kKeys; ++i) tree.Insert(i, "new");
+    });
+
+    std::vector<int> errors(2, 0);
+    for (int r = 0; r < 2; ++r) {
+        threads.emplace_back([&, r] {
+            for (int n = 0; n < 200; ++n) {
+                std::vector<std::pair<key_t, std::string>> results;
+                tree.RangeQuery(n * 10, n * 10 + 100, results);
+                if (!std::is_sorted(results.begin(), results.end())) ++errors[r];
+
+                std::string val;
+                if (!tree.Search(2 * n + 1, val).ok()) ++errors[r];
+            }
+        });
+    }
+    for (auto& th : threads) th.join();
+
+    for (int e : errors) EXPECT_EQ(e, 0);
+    for (int i = 0; i < 2 * kKeys; ++i) {
+        std::string val;
+        bool present = tree.Search(i, val).ok();
+        EXPECT_EQ(present, i >= kKeys || i % 2 == 1) << "key " << i;
+    }
+}
+
+TEST_F(BPlusTreeTest, ConcurrentCursorsAndWriters) {
+    auto tree = MakeTree();
+    constexpr int kKeys = 3000;
+    for (int i = 0; i < kKeys; ++i) tree.Insert(i, "base");
+
+    // As in ConcurrentMixedWorkload, the odd keys below kKeys never change;
+    // cursors walk them in both directions while writers split and merge
+    // leaves around them.
+    std::vector<std::thread> threads;
+    threads.emplace_back([&] {
+        for (int i = 0; i < kKeys; i += 2) tree.Delete(i);
+    });
+    threads.emplace_back([&] {
+        for (int i = kKeys; i < 2 * kKeys; ++i) tree.Insert(i, "new");
+    });
+
+    std::vector<int> errors(2, 0);
+    threads.emplace_back([&] {
+        for (int n = 0; n < 20; ++n) {
+            auto cur = tree.NewCursor();
+            cur.SetUpperBound(kKeys - 1);
+            int prev = -1, odd = 0;
+            for (cur.SeekToFirst(); cur.Valid(); cur.Next()) {
+                if (cur.key() <= prev) ++errors[0];
+                if (cur.key() % 2 == 1) ++odd;
+                prev = cur.key();
+            }
+            if (odd != kKeys / 2) ++errors[0];
+        }
+    });
+    threads.emplace_back([&] {
+        for (int n = 0; n < 20; ++n) {
+            auto cur = tree.NewCursor();
+            cur.SetUpperBound(kKeys - 1);
+            int prev = kKeys, odd = 0;
+            for (cur.SeekToLast(); cur.Valid(); cur.Prev()) {
+                if (cur.key() >= prev) ++errors[1];
+                if (cur.key() % 2 == 1) ++odd;
+                prev = cur.key();
+            }
+            if (odd != kKeys / 2) ++errors[1];
+        }
+    });
+    for (auto& th : threads) th.join();
+
+    for (int e : errors) EXPECT_EQ(e, 0);
+}
+
+TEST_F(BPlusTreeTest, ConcurrentReadAheadScansAndWriters) {
+    Options opts;
+    opts.pool_size       = 64;
+    opts.scan_read_ahead = 8;
+    BPlusTree tree(kTestFile, opts);
+    constexpr int kKeys = 6000;
+    for (int i = 0; i < kKeys; ++i) tree.Insert(i, "base");
+
+    // Odd keys below kKeys are stable; the prefetch thread competes with
+    // writers and scanners for a pool far smaller than the tree.
+    std::vector<std::thread> threads;
+    threads.emplace_back([&] {
+        for (int i = 0; i < kKeys; i += 2) tree.Delete(i);
+    });
+    threads.emplace_back([&] {
+        for (int i = kKeys; i < 2 * kKeys; ++i) tree.Insert(i, "new");
+    });
+
+    std::vector<int> errors(2, 0);
+    for (int r = 0; r < 2; ++r) {
+        threads.emplace_back([&, r] {
+            for (int n = 0; n < 10; ++n) {
+                int prev = -1, odd = 0;
+                tree.Scan(0, kKeys - 1, [&](key_t k, std::string_view) {
+                    if (k <= prev) ++errors[r];
+                    if (k % 2 == 1) ++odd;
+                    prev = k;
+                    return true;
+                });
+                if (odd != kKeys / 2) ++errors[r];
+            }
+        });
+    }
+    for (auto& th : threads) th.join();
+
+    for (int e : errors) EXPECT_EQ(e, 0);
+}
+
+TEST_F(BPlusTreeTest, ConcurrentBatchesAndWriters) {
+    auto tree = MakeTree();
+    constexpr int kKeys = 4000;
+    for (int i = 0; i < kKeys; ++i) tree.Insert(i, "base");
+
+    // Batch writers own disjoint key ranges above kKeys; a plain writer
+    // deletes even keys below it.  MultiGet probes the stable odd keys.
+    std::vector<std::thread> threads;
+    for (int t = 0; t < 2; ++t) {
+        threads.emplace_back([&, t] {
+            std::mt19937 rng(t);
+            for (int round = 0; round < 20; ++round) {
+                std::vector<std::pair<key_t, std::string>> batch;
+                int base = kKeys + (t * 20 + round) * 200;
+                for (int i = 0; i < 200; ++i) batch.emplace_back(base + i, "b");
+                std::shuffle(batch.begin(), batch.end(), rng);
+                tree.InsertBatch(batch);
+            }
+        });
+    }
+    threads.emplace_back([&] {
+        for (int i = 0; i < kKeys; i += 2) tree.Delete(i);
+    });
+
+    int errors = 0;
+    threads.emplace_back([&] {
+        std::vector<key_t> keys;
+        for (int i = 1; i < kKeys; i += 2) keys.push_back(i);
+        for (int n = 0; n < 20; ++n) {
+            std::vector<std::string> values;
+            for (const auto& s : tree.MultiGet(keys, values)) {
+                if (!s.ok()) ++errors;
+            }
+        }
+    });
+    for (auto& th : threads) th.join();
+
+    EXPECT_EQ(errors, 0);
+    for (int i = 0; i < kKeys + 40 * 200; ++i) {
+        std::string val;
+        bool present = tree.Search(i, val).ok();
+        ASSERT_EQ(present, i >= kKeys || i % 2 == 1) << "key " << i;
+    }
+}
+
+TEST_F(BPlusTreeTest, ConcurrentWritersShardedPool) {
+    Options opts;
+    opts.pool_size   = 64;
+    opts.pool_shards = 4;
+    BPlusTree tree(kTestFile, opts);
+    ASSERT_EQ(tree.BufferPoolShards(), 4u);
+
+    // A pool much smaller than the tree keeps every shard evicting.
+    std::vector<std::thread> threads;
+    for (int t = 0; t < 4; ++t) {
+        threads.emplace_back([&, t] {
+            for (int i = t; i < 4000; i += 4) {
+                tree.Insert(i, ("v" + std::to_string(i) + std::string(100, '.')).c_str());
+            }
+            for (int i = t; i < 4000; i += 8) tree.Delete(i);
+        });
+    }
+    for (auto& th : threads) th.join();
+
+    for (int i = 0; i < 4000; ++i) {
+        std::string val;
+        bool deleted = (i % 4) == (i % 8);
+        ASSERT_EQ(tree.Search(i, val).ok(), !deleted) << "key " << i;
+    }
+
+    size_t evictions = 0;
+    for (size_t i = 0; i < tree.BufferPoolShards(); ++i) {
+        evictions += tree.BufferPoolShardStats(i).evictions;
+    }
+    EXPECT_GT(evictions, 0u);
+}
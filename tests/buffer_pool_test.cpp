@@ -7,8 +7,12 @@
 #include "bptree/config.h"
 
 #include <algorithm>
+#include <atomic>
+#include <chrono>
 #include <cstdio>
 #include <cstring>
+#include <thread>
+#include <vector>
 
 using namespace bptree;
 
@@ -205,6 +209,37 @@ TEST_F(BufferPoolTest, DeletePinnedPageFails) {
     EXPECT_TRUE(pool.DeletePage(page_id));
 }
 
+TEST_F(BufferPoolTest, TruncateDropsPagesPastTheEnd) {
+    DiskManager disk(kTestFile);
+    BufferPool pool(disk, 8);
+
+    int64_t ids[6];
+    for (int64_t& id : ids) {
+        char* page = pool.NewPage(id);
+        std::memset(page, 'x', PAGE_SIZE);
+        pool.UnpinPage(id, true);
+    }
+    ASSERT_NE(pool.FetchPage(ids[4]), nullptr);
+
+    // A pinned page past the end stops it, leaving everything in place.
+    EXPECT_FALSE(pool.Truncate(ids[3]));
+    EXPECT_EQ(pool.PagesInUse(), 6u);
+    EXPECT_EQ(disk.NextPageOffset(), ids[5] + static_cast<int64_t>(PAGE_SIZE));
+
+    pool.UnpinPage(ids[4], false);
+    EXPECT_TRUE(pool.Truncate(ids[3]));
+    EXPECT_EQ(pool.PagesInUse(), 3u);
+    EXPECT_EQ(disk.NextPageOffset(), ids[3]);
+
+    // The dropped pages were not written back; the rest are still there.
+    pool.FlushAllPages();
+    EXPECT_EQ(disk.FileSize(), static_cast<size_t>(ids[3]));
+    char* page = pool.FetchPage(ids[2]);
+    ASSERT_NE(page, nullptr);
+    EXPECT_EQ(page[0], 'x');
+    pool.UnpinPage(ids[2], false);
+}
+
 // ============================================================================
 // Statistics
 // ============================================================================
@@ -252,3 +287,506 @@ TEST_F(BufferPoolTest, FlushAllPagesWritesDirty) {
         pool.UnpinPage(p1, false);
     }
 }
+
+// ============================================================================
+// Sharding
+// ============================================================================
+
+TEST_F(BufferPoolTest, ShardCountIsClamped) {
+    DiskManager disk(kTestFile);
+
+    BufferPool small(disk, 8, /*num_shards=*/4);
+    EXPECT_EQ(small.NumShards(), 1u);
+
+    BufferPool pool(disk, 64, /*num_shards=*/4);
+    ASSERT_EQ(pool.NumShards(), 4u);
+    size_t frames = 0;
+    for (size_t i = 0; i < pool.NumShards(); ++i) frames += pool.GetShardStats(i).frames;
+    EXPECT_EQ(frames, 64u);
+}
+
+TEST_F(BufferPoolTest, ShardedPoolEvictsWithinShard) {
+    DiskManager disk(kTestFile);
+    BufferPool pool(disk, 32, /*num_shards=*/2);
+
+    // Write more pages than the pool holds, then read them all back.
+    std::vector<int64_t> ids;
+    for (int i = 0; i < 100; ++i) {
+        int64_t id;
+        char* d = pool.NewPage(id);
+        ASSERT_NE(d, nullptr);
+        std::snprintf(d, 16, "page_%d", i);
+        pool.UnpinPage(id, true);
+        ids.push_back(id);
+    }
+    EXPECT_LE(pool.PagesInUse(), 32u);
+
+    for (int i = 0; i < 100; ++i) {
+        char expect[16];
+        std::snprintf(expect, sizeof(expect), "page_%d", i);
+        char* d = pool.FetchPage(ids[i]);
+        ASSERT_NE(d, nullptr);
+        EXPECT_STREQ(d, expect);
+        pool.UnpinPage(ids[i], false);
+    }
+
+    size_t evictions = 0;
+    for (size_t i = 0; i < pool.NumShards(); ++i) {
+        ShardStats st = pool.GetShardStats(i);
+        EXPECT_GT(st.misses, 0u);
+        EXPECT_GE(st.latch_acquisitions, st.latch_contentions);
+        evictions += st.evictions;
+    }
+    EXPECT_GT(evictions, 0u);
+}
+
+TEST_F(BufferPoolTest, ConcurrentFetchUnderEviction) {
+    DiskManager disk(kTestFile);
+    BufferPool pool(disk, 32, /*num_shards=*/2);
+
+    constexpr int kPages = 128;
+    std::vector<int64_t> ids(kPages);
+    for (int i = 0; i < kPages; ++i) {
+        char* d = pool.NewPage(ids[i]);
+        std::memcpy(d, &i, sizeof(i));
+        pool.UnpinPage(ids[i], true);
+    }
+
+    // Threads hammer overlapping pages through a pool a quarter of the
+    // working set, so hits race with evictions of the same frames.
+    std::atomic<int> errors{0};
+    std::vector<std::thread> threads;
+    for (int t = 0; t < 4; ++t) {
+        threads.emplace_back([&, t] {
+            for (int n = 0; n < 5000; ++n) {
+                int i = (n * 7 + t * 13) % kPages;
+                char* d = pool.FetchPage(ids[i], LatchMode::kShared);
+                if (!d) { ++errors; continue; }
+                int v;
+                std::memcpy(&v, d, sizeof(v));
+                if (v != i) ++errors;
+                pool.UnpinPage(ids[i], false, LatchMode::kShared);
+            }
+        });
+    }
+    for (auto& th : threads) th.join();
+
+    EXPECT_EQ(errors.load(), 0);
+    EXPECT_EQ(pool.HitCount() + pool.MissCount(), 4u * 5000u);
+}
+
+// ============================================================================
+// Replacement policies
+// ============================================================================
+
+TEST_F(BufferPoolTest, EveryPolicyRoundTripsUnderEviction) {
+    for (auto policy : {ReplacementPolicy::kLRU, ReplacementPolicy::kClock,
+                        ReplacementPolicy::kLRUK}) {
+        std::remove(kTestFile);
+        DiskManager disk(kTestFile);
+        BufferPool pool(disk, 8, 1, policy);
+        EXPECT_EQ(pool.Policy(), policy);
+
+        std::vector<int64_t> ids(40);
+        for (int i = 0; i < 40; ++i) {
+            char* d = pool.NewPage(ids[i]);
+            ASSERT_NE(d, nullptr) << ReplacementPolicyName(policy);
+            std::memcpy(d, &i, sizeof(i));
+            pool.UnpinPage(ids[i], true);
+        }
+        for (int i = 39; i >= 0; --i) {
+            char* d = pool.FetchPage(ids[i]);
+            ASSERT_NE(d, nullptr) << ReplacementPolicyName(policy);
+            int v;
+            std::memcpy(&v, d, sizeof(v));
+            EXPECT_EQ(v, i) << ReplacementPolicyName(policy);
+            pool.UnpinPage(ids[i], false);
+        }
+    }
+}
+
+TEST_F(BufferPoolTest, LruKSurvivesScanPollution) {
+    DiskManager disk(kTestFile);
+    BufferPool pool(disk, 16, 1, ReplacementPolicy::kLRUK);
+
+    // Four hot pages, each used on several distinct misses.
+    std::vector<int64_t> hot(4), cold(64);
+    for (auto& id : hot) { pool.NewPage(id); pool.UnpinPage(id, true); }
+    for (auto& id : cold) { pool.NewPage(id); pool.UnpinPage(id, true); }
+    for (int round = 0; round < 3; ++round) {
+        for (int i = 0; i < 4; ++i) {
+            pool.FetchPage(cold[round * 4 + i]);
+            pool.UnpinPage(cold[round * 4 + i], false);
+            for (auto id : hot) { pool.FetchPage(id); pool.UnpinPage(id, false); }
+        }
+    }
+
+    // A scan over every cold page, each touched once.
+    for (auto id : cold) { pool.FetchPage(id); pool.UnpinPage(id, false); }
+
+    size_t misses = pool.MissCount();
+    for (auto id : hot) { pool.FetchPage(id); pool.UnpinPage(id, false); }
+    EXPECT_EQ(pool.MissCount(), misses);
+}
+
+// ============================================================================
+// Read-ahead
+// ============================================================================
+
+namespace {
+
+/// Allocate @p n pages straight on disk, each holding its index.
+std::vector<int64_t> WritePages(DiskManager& disk, int n) {
+    std::vector<int64_t> ids;
+    char buf[PAGE_SIZE]{};
+    for (int i = 0; i < n; ++i) {
+        int64_t id = disk.AllocatePage();
+        std::memcpy(buf, &i, sizeof(i));
+        disk.WritePage(id, buf);
+        ids.push_back(id);
+    }
+    return ids;
+}
+
+/// Wait (bounded) for the prefetch thread to have loaded @p n pages.
+bool WaitForPrefetches(const BufferPool& pool, size_t n) {
+    for (int i = 0; i < 2000 && pool.PrefetchCount() < n; ++i) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    return pool.PrefetchCount() >= n;
+}
+
+size_t PrefetchUnused(const BufferPool& pool) {
+    size_t n = 0;
+    for (size_t i = 0; i < pool.NumShards(); ++i) n += pool.GetShardStats(i).prefetch_unused;
+    return n;
+}
+
+}  // namespace
+
+TEST_F(BufferPoolTest, PrefetchLoadsPagesAhead) {
+    DiskManager disk(kTestFile);
+    BufferPool pool(disk, 64, 4);
+    auto ids = WritePages(disk, 8);
+
+    EXPECT_EQ(pool.Prefetch(ids.data(), ids.size()), ids.size());
+    ASSERT_TRUE(WaitForPrefetches(pool, ids.size()));
+    EXPECT_EQ(pool.PagesInUse(), ids.size());
+
+    // Every fetch is now a hit, and counts as a prefetch hit once.
+    for (int round = 0; round < 2; ++round) {
+        for (int i = 0; i < 8; ++i) {
+            char* data = pool.FetchPage(ids[i]);
+            ASSERT_NE(data, nullptr);
+            int v;
+            std::memcpy(&v, data, sizeof(v));
+            EXPECT_EQ(v, i);
+            pool.UnpinPage(ids[i], false);
+        }
+    }
+    EXPECT_EQ(pool.MissCount(), 0u);
+    EXPECT_EQ(pool.PrefetchHitCount(), ids.size());
+
+    size_t per_shard = 0;
+    for (size_t i = 0; i < pool.NumShards(); ++i) {
+        per_shard += pool.GetShardStats(i).prefetch_hits;
+    }
+    EXPECT_EQ(per_shard, ids.size());
+}
+
+TEST_F(BufferPoolTest, PrefetchSkipsResidentAndInvalidPages) {
+    DiskManager disk(kTestFile);
+    BufferPool pool(disk, 16);
+
+    int64_t resident;
+    pool.NewPage(resident);
+    pool.UnpinPage(resident, true);
+
+    // The metadata page, a page past the end and a resident page.
+    std::vector<int64_t> ids = {0, resident, resident + 100 * static_cast<int64_t>(PAGE_SIZE)};
+    EXPECT_EQ(pool.Prefetch(ids.data(), ids.size()), ids.size());
+
+    auto fresh = WritePages(disk, 1);
+    pool.Prefetch(fresh.data(), 1);
+    ASSERT_TRUE(WaitForPrefetches(pool, 1));
+
+    // The queue is worked in order, so anything queued before is done too.
+    EXPECT_EQ(pool.PrefetchCount(), 1u);
+    EXPECT_EQ(pool.PagesInUse(), 2u);
+}
+
+TEST_F(BufferPoolTest, PrefetchedPagesEvictedUnfetchedAreCounted) {
+    DiskManager disk(kTestFile);
+    BufferPool pool(disk, 16);
+    auto ids = WritePages(disk, 4 + 16);
+
+    ASSERT_EQ(pool.Prefetch(ids.data(), 4), 4u);
+    ASSERT_TRUE(WaitForPrefetches(pool, 4));
+
+    // Fill the whole pool with other pages.
+    for (size_t i = 4; i < ids.size(); ++i) {
+        ASSERT_NE(pool.FetchPage(ids[i]), nullptr);
+        pool.UnpinPage(ids[i], false);
+    }
+    EXPECT_EQ(PrefetchUnused(pool), 4u);
+    EXPECT_EQ(pool.PrefetchHitCount(), 0u);
+}
+
+// ============================================================================
+// Page cleaner
+// ============================================================================
+
+namespace {
+
+/// Wait (bounded) for the cleaner to have written @p n pages.
+bool WaitForCleanerWrites(const BufferPool& pool, size_t n) {
+    for (int i = 0; i < 2000 && pool.CleanerWrites() < n; ++i) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    return pool.CleanerWrites() >= n;
+}
+
+/// Fill the pool with @p n new dirty pages, each holding its index.
+std::vector<int64_t> DirtyPages(BufferPool& pool, int n) {
+    std::vector<int64_t> ids;
+    for (int i = 0; i < n; ++i) {
+        int64_t id;
+        char* data = pool.NewPage(id);
+        std::memcpy(data, &i, sizeof(i));
+        pool.UnpinPage(id, true);
+        ids.push_back(id);
+    }
+    return ids;
+}
+
+}  // namespace
+
+TEST_F(BufferPoolTest, CleanerKeepsColdestFramesClean) {
+    DiskManager disk(kTestFile);
+    BufferPool pool(disk, 64, 1);
+    auto ids = DirtyPages(pool, 64);
+    EXPECT_EQ(pool.DirtyCount(), 64u);
+
+    CleanerOptions options;
+    options.clean_fraction   = 0.25;
+    options.dirty_high_water = 1.0;
+    options.interval_ms      = 1;
+    pool.StartCleaner(options);
+    ASSERT_TRUE(WaitForCleanerWrites(pool, 16));
+    pool.StopCleaner();
+    EXPECT_EQ(pool.CleanerWrites(), 16u);
+    EXPECT_EQ(pool.DirtyCount(), 48u);
+
+    // The 16 least recently used pages were written, so evicting them
+    // writes nothing.
+    DirtyPages(pool, 16);
+    EXPECT_EQ(pool.GetShardStats(0).evictions, 16u);
+    EXPECT_EQ(pool.GetShardStats(0).dirty_evictions, 0u);
+    for (int i = 0; i < 16; ++i) {
+        char* data = pool.FetchPage(ids[i]);
+        ASSERT_NE(data, nullptr);
+        int v;
+        std::memcpy(&v, data, sizeof(v));
+        EXPECT_EQ(v, i);
+        pool.UnpinPage(ids[i], false);
+    }
+}
+
+TEST_F(BufferPoolTest, CleanerWritesDownToLowWater) {
+    DiskManager disk(kTestFile);
+    BufferPool pool(disk, 64, 1);
+    DirtyPages(pool, 40);
+
+    // Above the high water mark the cleaner runs at once, whatever the
+    // interval, and writes until a quarter of the pool is dirty.
+    CleanerOptions options;
+    options.clean_fraction   = 0.0;
+    options.dirty_high_water = 0.5;
+    options.dirty_low_water  = 0.25;
+    options.interval_ms      = 60000;
+    pool.StartCleaner(options);
+    ASSERT_TRUE(WaitForCleanerWrites(pool, 24));
+    pool.StopCleaner();
+    EXPECT_EQ(pool.DirtyCount(), 16u);
+}
+
+TEST_F(BufferPoolTest, CleanerSkipsPinnedFrames) {
+    DiskManager disk(kTestFile);
+    BufferPool pool(disk, 8, 1);
+    auto ids = DirtyPages(pool, 8);
+    ASSERT_NE(pool.FetchPage(ids[0]), nullptr);
+
+    CleanerOptions options;
+    options.clean_fraction = 1.0;
+    options.interval_ms    = 1;
+    pool.StartCleaner(options);
+    ASSERT_TRUE(WaitForCleanerWrites(pool, 7));
+    EXPECT_EQ(pool.DirtyCount(), 1u);  // the pinned page
+
+    pool.UnpinPage(ids[0], false);
+    ASSERT_TRUE(WaitForCleanerWrites(pool, 8));
+    pool.StopCleaner();
+    EXPECT_EQ(pool.DirtyCount(), 0u);
+}
+
+// ============================================================================
+// Fuzzy checkpoints
+// ============================================================================
+
+TEST_F(BufferPoolTest, CheckpointWritesItsDirtyPageTable) {
+    for (bool cleaner : {false, true}) {
+        std::remove(kTestFile);
+        DiskManager disk(kTestFile);
+        BufferPool pool(disk, 32, 2);
+        auto ids = DirtyPages(pool, 20);
+        if (cleaner) {
+            CleanerOptions options;
+            options.clean_fraction   = 0.0;  // only the checkpoint's pages
+            options.dirty_high_water = 1.0;
+            options.interval_ms      = 60000;
+            pool.StartCleaner(options);
+        }
+
+        DirtyPageTable table = pool.BeginCheckpoint(/*redo_lsn=*/0);
+        EXPECT_EQ(table.pages, 20u);
+        EXPECT_EQ(table.oldest_lsn, 0u);
+
+        // Pages dirtied after the table was taken are not its business.
+        DirtyPages(pool, 4);
+        pool.FlushCheckpoint();
+        EXPECT_EQ(pool.DirtyCount(), 4u);
+        EXPECT_EQ(pool.CleanerWrites(), cleaner ? 20u : 0u);
+        for (int i = 0; i < 20; ++i) {
+            int v;
+            std::memcpy(&v, disk.PageData(ids[i]), sizeof(v));
+            EXPECT_EQ(v, i);
+        }
+        pool.StopCleaner();
+    }
+}
+
+TEST_F(BufferPoolTest, CheckpointWaitsForLatchedPages) {
+    DiskManager disk(kTestFile);
+    BufferPool pool(disk, 8, 1);
+    auto ids = DirtyPages(pool, 8);
+    ASSERT_NE(pool.FetchPage(ids[0], LatchMode::kExclusive), nullptr);
+
+    pool.BeginCheckpoint(0);
+    std::atomic<bool> done{false};
+    std::thread checkpoint([&] {
+        pool.FlushCheckpoint();
+        done = true;
+    });
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    EXPECT_FALSE(done);
+    EXPECT_EQ(pool.DirtyCount(), 1u);  // the page being modified
+
+    pool.UnpinPage(ids[0], true, LatchMode::kExclusive);
+    checkpoint.join();
+    EXPECT_EQ(pool.DirtyCount(), 0u);
+}
+
+// ============================================================================
+// Optimistic reads
+// ============================================================================
+
+TEST_F(BufferPoolTest, OptimisticReadFailsAcrossExclusiveLatch) {
+    DiskManager disk(kTestFile);
+    BufferPool pool(disk, 8);
+    int64_t id;
+    std::memcpy(pool.NewPage(id), "hello", 6);
+    pool.UnpinPage(id, true);
+
+    BufferPool::OptimisticPage page;
+    ASSERT_TRUE(pool.ReadOptimistic(id, page));
+    EXPECT_EQ(std::memcmp(page.data, "hello", 6), 0);
+    EXPECT_TRUE(pool.Validate(page));
+
+    // Readers change nothing.
+    ASSERT_NE(pool.FetchPage(id, LatchMode::kShared), nullptr);
+    EXPECT_TRUE(pool.Validate(page));
+    pool.UnpinPage(id, false, LatchMode::kShared);
+    EXPECT_TRUE(pool.Validate(page));
+
+    // A writer invalidates from the moment it holds the latch.
+    ASSERT_NE(pool.FetchPage(id, LatchMode::kExclusive), nullptr);
+    EXPECT_FALSE(pool.Validate(page));
+    BufferPool::OptimisticPage during;
+    EXPECT_FALSE(pool.ReadOptimistic(id, during));
+    pool.UnpinPage(id, true, LatchMode::kExclusive);
+    EXPECT_FALSE(pool.Validate(page));
+
+    BufferPool::OptimisticPage after;
+    ASSERT_TRUE(pool.ReadOptimistic(id, after));
+    EXPECT_TRUE(pool.Validate(after));
+    EXPECT_GT(after.version, page.version);
+}
+
+TEST_F(BufferPoolTest, OptimisticReadFailsOnceTheFrameIsReused) {
+    DiskManager disk(kTestFile);
+    BufferPool pool(disk, 4);
+    std::vector<int64_t> ids(8);
+    for (auto& id : ids) {
+        ASSERT_NE(pool.NewPage(id), nullptr);
+        pool.UnpinPage(id, true);
+    }
+
+    // Evicted: the frame now holds another page.
+    BufferPool::OptimisticPage page;
+    ASSERT_TRUE(pool.ReadOptimistic(ids[7], page));
+    for (int i = 0; i < 4; ++i) {
+        ASSERT_NE(pool.FetchPage(ids[i]), nullptr);
+        pool.UnpinPage(ids[i], false);
+    }
+    EXPECT_FALSE(pool.Validate(page));
+    EXPECT_FALSE(pool.ReadOptimistic(ids[7], page));
+
+    // Deleted: the frame is free.
+    ASSERT_TRUE(pool.ReadOptimistic(ids[0], page));
+    ASSERT_TRUE(pool.DeletePage(ids[0]));
+    EXPECT_FALSE(pool.Validate(page));
+}
+
+TEST_F(BufferPoolTest, SwizzledChildFollowsItsPage) {
+    DiskManager disk(kTestFile);
+    BufferPool pool(disk, 32);
+    pool.EnableSwizzling(4);
+    int64_t parent_id, child_id;
+    ASSERT_NE(pool.NewPage(parent_id), nullptr);
+    pool.UnpinPage(parent_id, true);
+    std::memcpy(pool.NewPage(child_id), "child", 6);
+    pool.UnpinPage(child_id, true);
+
+    BufferPool::OptimisticPage parent, child;
+    ASSERT_TRUE(pool.ReadOptimistic(parent_id, parent));
+    ASSERT_TRUE(pool.ReadChildOptimistic(parent, 1, child_id, child));
+    EXPECT_EQ(pool.SwizzledPages(), 1u);
+    ASSERT_TRUE(pool.ReadChildOptimistic(parent, 1, child_id, child));
+    EXPECT_EQ(std::memcmp(child.data, "child", 6), 0);
+
+    // Another page in the same slot: the swizzled frame is not trusted.
+    int64_t other_id;
+    std::memcpy(pool.NewPage(other_id), "other", 6);
+    pool.UnpinPage(other_id, true);
+    ASSERT_TRUE(pool.ReadChildOptimistic(parent, 1, other_id, child));
+    EXPECT_EQ(std::memcmp(child.data, "other", 6), 0);
+
+    // The child leaves the pool and comes back in another frame.
+    ASSERT_TRUE(pool.ReadChildOptimistic(parent, 2, child_id, child));
+    const PageFrame* old_frame = child.frame;
+    ASSERT_TRUE(pool.FlushPage(child_id));
+    ASSERT_TRUE(pool.DeletePage(child_id));
+    EXPECT_FALSE(pool.ReadChildOptimistic(parent, 2, child_id, child));
+    int64_t filler;
+    ASSERT_NE(pool.NewPage(filler), nullptr);  // takes the freed frame
+    pool.UnpinPage(filler, true);
+    ASSERT_NE(pool.FetchPage(child_id), nullptr);
+    pool.UnpinPage(child_id, false);
+    ASSERT_TRUE(pool.ReadChildOptimistic(parent, 2, child_id, child));
+    EXPECT_NE(child.frame, old_frame);
+    EXPECT_EQ(std::memcmp(child.data, "child", 6), 0);
+
+    // Evicting the parent returns its table.
+    ASSERT_TRUE(pool.DeletePage(parent_id));
+    EXPECT_EQ(pool.SwizzledPages(), 0u);
+}
@@ -0,0 +1,110 @@
+/// @file compression_test.cpp
+/// @brief Google Test suite for the LZ4 block codec.
+
+#include <gtest/gtest.h>
+#include "bptree/compression.h"
+#include "bptree/config.h"
+
+#include <random>
+#include <string>
+#include <vector>
+
+using namespace bptree;
+
+namespace {
+
+/// Compress and decompress @p input; returns the compressed size.
+size_t RoundTrip(const std::string& input) {
+    std::vector<char> packed(LZ4CompressBound(input.size()));
+    size_t n = LZ4Compress(input.data(), input.size(), packed.data(), packed.size());
+    EXPECT_GT(n, 0u);
+    std::string out(input.size(), '\0');
+    EXPECT_TRUE(LZ4Decompress(packed.data(), n, out.data(), out.size()));
+    EXPECT_EQ(out, input);
+    return n;
+}
+
+std::string RandomBytes(size_t n, uint32_t seed) {
+    std::mt19937 rng(seed);
+    std::string s(n, '\0');
+    for (char& c : s) c = static_cast<char>(rng());
+    return s;
+}
+
+}  // namespace
+
+TEST(CompressionTest, RoundTripsShortInputs) {
+    // Below the 13 bytes a match needs, everything is literals.
+    for (size_t n = 0; n < 40; ++n) RoundTrip(std::string(n, 'a'));
+    for (size_t n = 0; n < 40; ++n) RoundTrip(RandomBytes(n, static_cast<uint32_t>(n)));
+}
+
+TEST(CompressionTest, CompressesRepetitivePages) {
+    EXPECT_LT(RoundTrip(std::string(PAGE_SIZE, '\0')), 32u);
+
+    std::string text;
+    for (int i = 0; text.size() < PAGE_SIZE; ++i) text += "key " + std::to_string(i) + " value; ";
+    text.resize(PAGE_SIZE);
+    EXPECT_LT(RoundTrip(text), PAGE_SIZE / 2);
+
+    // Long literal runs and long matches both need extra length bytes.
+    std::string mixed = RandomBytes(700, 1) + std::string(2000, 'x') + RandomBytes(300, 2) +
+                        std::string(PAGE_SIZE - 3000, 'y');
+    EXPECT_LT(RoundTrip(mixed), 1100u);
+}
+
+TEST(CompressionTest, IncompressibleInputFitsTheBound) {
+    std::string noise = RandomBytes(PAGE_SIZE, 3);
+    size_t n = RoundTrip(noise);
+    EXPECT_GT(n, PAGE_SIZE);
+    EXPECT_LE(n, LZ4CompressBound(PAGE_SIZE));
+
+    // Too little room is reported, not overrun.
+    std::vector<char> small(PAGE_SIZE);
+    EXPECT_EQ(LZ4Compress(noise.data(), noise.size(), small.data(), small.size()), 0u);
+}
+
+TEST(CompressionTest, DecodesStandardBlocks) {
+    // "abc", then a 9-byte match 3 back, then 5 literals.
+    const unsigned char block[] = {0x35, 'a', 'b', 'c', 0x03, 0x00, 0x50, 'x', 'y', 'z', 'z', 'y'};
+    std::string out(17, '\0');
+    ASSERT_TRUE(LZ4Decompress(reinterpret_cast<const char*>(block), sizeof(block),
+                              out.data(), out.size()));
+    EXPECT_EQ(out, "abcabcabcabcxyzzy");
+
+    // The wrong output size is an error either way.
+    std::string shorter(16, '\0'), longer(18, '\0');
+    EXPECT_FALSE(LZ4Decompress(reinterpret_cast<const char*>(block), sizeof(block),
+                               shorter.data(), shorter.size()));
+    EXPECT_FALSE(LZ4Decompress(reinterpret_cast<const char*>(block), sizeof(block),
+                               longer.data(), longer.size()));
+}
+
+TEST(CompressionTest, RejectsMalformedBlocks) {
+    std::string text;
+    for (int i = 0; text.size() < PAGE_SIZE; ++i) text += "row " + std::to_string(i % 50) + ";";
+    text.resize(PAGE_SIZE);
+    std::vector<char> packed(LZ4CompressBound(PAGE_SIZE));
+    size_t n = LZ4Compress(text.data(), text.size(), packed.data(), packed.size());
+    ASSERT_GT(n, 0u);
+
+    std::string out(PAGE_SIZE, '\0');
+    EXPECT_FALSE(LZ4Decompress(packed.data(), 0, out.data(), out.size()));
+    for (size_t cut = 1; cut < n; cut += 7) {
+        EXPECT_FALSE(LZ4Decompress(packed.data(), cut, out.data(), out.size())) << cut;
+    }
+
+    // An offset before the start of the output.
+    const unsigned char far_back[] = {0x14, 'a', 0x05, 0x00, 0x50, 'b', 'b', 'b', 'b', 'b'};
+    std::string small(14, '\0');
+    EXPECT_FALSE(LZ4Decompress(reinterpret_cast<const char*>(far_back), sizeof(far_back),
+                               small.data(), small.size()));
+
+    // Corrupted bytes decode to something or fail, within bounds.
+    std::mt19937 rng(4);
+    for (int trial = 0; trial < 500; ++trial) {
+        std::vector<char> bad(packed.begin(), packed.begin() + n);
+        bad[rng() % n] = static_cast<char>(rng());
+        (void)LZ4Decompress(bad.data(), bad.size(), out.data(), out.size());
+    }
+}
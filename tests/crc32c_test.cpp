@@ -0,0 +1,71 @@
+/// @file crc32c_test.cpp
+/// @brief Google Test suite for the CRC32C implementations.
+
+#include <gtest/gtest.h>
+#include "bptree/crc32c.h"
+
+#include <cstdint>
+#include <cstring>
+#include <random>
+#include <string>
+#include <vector>
+
+using namespace bptree;
+
+TEST(CRC32CTest, KnownVectors) {
+    // RFC 3720, appendix B.4, and the usual "123456789" check value.
+    uint8_t buf[32];
+
+    std::memset(buf, 0, sizeof(buf));
+    EXPECT_EQ(CRC32C(buf, sizeof(buf)), 0x8A9136AAu);
+
+    std::memset(buf, 0xFF, sizeof(buf));
+    EXPECT_EQ(CRC32C(buf, sizeof(buf)), 0x62A8AB43u);
+
+    for (int i = 0; i < 32; ++i) buf[i] = static_cast<uint8_t>(i);
+    EXPECT_EQ(CRC32C(buf, sizeof(buf)), 0x46DD794Eu);
+
+    for (int i = 0; i < 32; ++i) buf[i] = static_cast<uint8_t>(31 - i);
+    EXPECT_EQ(CRC32C(buf, sizeof(buf)), 0x113FDB5Cu);
+
+    EXPECT_EQ(CRC32C("123456789", 9), 0xE3069283u);
+    EXPECT_EQ(CRC32CPortable("123456789", 9), 0xE3069283u);
+    EXPECT_EQ(CRC32C(nullptr, 0), 0u);
+}
+
+TEST(CRC32CTest, HardwareMatchesPortable) {
+    std::mt19937 rng(42);
+    std::vector<uint8_t> buf(4096 + 64);
+    for (auto& b : buf) b = static_cast<uint8_t>(rng());
+
+    // Every length up to a few words, at every alignment, then page sizes.
+    for (size_t offset = 0; offset < 8; ++offset) {
+        for (size_t len = 0; len <= 40; ++len) {
+            ASSERT_EQ(CRC32C(buf.data() + offset, len),
+                      CRC32CPortable(buf.data() + offset, len))
+                << CRC32CImplementation() << " offset " << offset << " len " << len;
+        }
+    }
+    for (size_t len : {1000u, 4096u, 4100u}) {
+        EXPECT_EQ(CRC32C(buf.data() + 3, len), CRC32CPortable(buf.data() + 3, len));
+    }
+}
+
+TEST(CRC32CTest, ExtendEqualsOneShot) {
+    std::string data = "write-ahead log record header, then its payload";
+    uint32_t whole = CRC32C(data.data(), data.size());
+    for (size_t split = 0; split <= data.size(); ++split) {
+        uint32_t crc = CRC32C(data.data(), split);
+        EXPECT_EQ(CRC32C(data.data() + split, data.size() - split, crc), whole);
+        crc = CRC32CPortable(data.data(), split);
+        EXPECT_EQ(CRC32CPortable(data.data() + split, data.size() - split, crc), whole);
+    }
+}
+
+TEST(CRC32CTest, ReportsImplementation) {
+    std::string name = CRC32CImplementation();
+    EXPECT_TRUE(name == "sse4.2" || name == "armv8" || name == "slicing-by-8") << name;
+#if defined(__SSE4_2__)
+    EXPECT_EQ(name, "sse4.2");
+#endif
+}
@@ -7,6 +7,10 @@
 
 #include <cstdio>
 #include <cstring>
+#include <filesystem>
+#include <random>
+#include <string>
+#include <vector>
 
 using namespace bptree;
 
@@ -14,8 +18,26 @@ class DiskManagerTest : public ::testing::Test {
 protected:
     static constexpr const char* kTestFile = "test_disk.idx";
 
-    void SetUp() override { std::remove(kTestFile); }
-    void TearDown() override { std::remove(kTestFile); }
+    static constexpr const char* kCopyFile = "test_disk_copy.idx";
+
+    void SetUp() override { std::remove(kTestFile); std::remove(kCopyFile); }
+    void TearDown() override { std::remove(kTestFile); std::remove(kCopyFile); }
+
+    /// A page of text from @p seed: compresses to about a third.
+    static std::string TextPage(int seed) {
+        std::string page;
+        for (int i = 0; page.size() < PAGE_SIZE; ++i) {
+            page += "row " + std::to_string(seed * 1000 + i % 40) + ", ";
+        }
+        page.resize(PAGE_SIZE);
+        return page;
+    }
+
+    static std::string ReadBack(const DiskManager& dm, int64_t off) {
+        std::string page(PAGE_SIZE, '\0');
+        dm.ReadPage(off, page.data());
+        return page;
+    }
 };
 
 TEST_F(DiskManagerTest, CreateNewFile) {
@@ -100,3 +122,274 @@ TEST_F(DiskManagerTest, OutOfRangePageThrows) {
     EXPECT_THROW((void)dm.PageData(999999), std::out_of_range);
     EXPECT_THROW((void)dm.PageData(-1), std::out_of_range);
 }
+
+TEST_F(DiskManagerTest, TruncateDropsTheTail) {
+    const std::pair<PageCompression, DiskBackend> layouts[] = {
+        {PageCompression::kNone, DiskBackend::kMmap},
+        {PageCompression::kNone, DiskBackend::kDirect},
+        {PageCompression::kLZ4, DiskBackend::kMmap},
+    };
+    for (const auto& [compression, backend] : layouts) {
+        std::remove(kTestFile);
+        const int64_t end = 100 * PAGE_SIZE;
+        size_t stored = 0;
+        {
+            DiskManager dm(kTestFile, compression, backend);
+            for (int i = 0; i < 600; ++i) dm.WritePage(dm.AllocatePage(), TextPage(i).data());
+            dm.Sync();
+            stored = dm.StoredSize();
+
+            dm.Truncate(end);
+            dm.Sync();
+            EXPECT_EQ(dm.NextPageOffset(), end);
+            // A compressed file frees the slots; only blocks past the last
+            // one still in use (a page map block, say) leave the file.
+            EXPECT_LT(dm.StoredSize(), compression == PageCompression::kNone ? stored / 2 : stored);
+            if (compression == PageCompression::kNone) {
+                EXPECT_EQ(std::filesystem::file_size(kTestFile), static_cast<size_t>(end));
+                EXPECT_THROW(ReadBack(dm, end), std::out_of_range);
+            }
+
+            // Allocation carries on from the new end.
+            EXPECT_EQ(dm.AllocatePage(), end);
+            EXPECT_EQ(ReadBack(dm, end), std::string(PAGE_SIZE, '\0'));
+        }
+        DiskManager dm(kTestFile, compression, backend);
+        EXPECT_EQ(dm.NextPageOffset(), end + static_cast<int64_t>(PAGE_SIZE));
+        for (int i = 0; i < 99; ++i) EXPECT_EQ(ReadBack(dm, (i + 1) * PAGE_SIZE), TextPage(i)) << i;
+    }
+}
+
+// ---------------------------------------------------------------------------
+// Compressed files
+// ---------------------------------------------------------------------------
+
+TEST_F(DiskManagerTest, CompressedPagesRoundTripAndPersist) {
+    std::mt19937 rng(7);
+    std::string noise(PAGE_SIZE, '\0');
+    for (char& c : noise) c = static_cast<char>(rng());
+
+    constexpr int N = 64;
+    {
+        DiskManager dm(kTestFile, PageCompression::kLZ4);
+        EXPECT_TRUE(dm.IsCompressed());
+        for (int i = 0; i < N; ++i) {
+            int64_t off = dm.AllocatePage();
+            EXPECT_EQ(ReadBack(dm, off), std::string(PAGE_SIZE, '\0'));
+            dm.WritePage(off, i == 5 ? noise.data() : TextPage(i).data());
+        }
+        dm.SetRootOffset(PAGE_SIZE);
+        for (int i = 0; i < N; ++i) {
+            EXPECT_EQ(ReadBack(dm, (i + 1) * PAGE_SIZE), i == 5 ? noise : TextPage(i)) << i;
+        }
+        EXPECT_THROW((void)dm.PageData(PAGE_SIZE), std::logic_error);
+        EXPECT_THROW(ReadBack(dm, 1000 * PAGE_SIZE), std::out_of_range);
+    }
+
+    // The file keeps its compression whatever the next open asks for.
+    DiskManager dm(kTestFile);
+    ASSERT_TRUE(dm.IsCompressed());
+    EXPECT_EQ(dm.RootOffset(), static_cast<int64_t>(PAGE_SIZE));
+    EXPECT_GE(dm.FileSize(), (N + 1) * PAGE_SIZE);
+    for (int i = 0; i < N; ++i) {
+        EXPECT_EQ(ReadBack(dm, (i + 1) * PAGE_SIZE), i == 5 ? noise : TextPage(i)) << i;
+    }
+    EXPECT_LT(dm.StoredSize(), N * PAGE_SIZE / 2);
+}
+
+TEST_F(DiskManagerTest, UncompressedFileStaysUncompressed) {
+    { DiskManager dm(kTestFile); }
+    DiskManager dm(kTestFile, PageCompression::kLZ4);
+    EXPECT_FALSE(dm.IsCompressed());
+    EXPECT_EQ(dm.StoredSize(), dm.FileSize());
+}
+
+TEST_F(DiskManagerTest, CompressedRewritesReuseSpaceAfterSync) {
+    DiskManager dm(kTestFile, PageCompression::kLZ4);
+    constexpr int N = 32;
+    for (int i = 0; i < N; ++i) dm.WritePage(dm.AllocatePage(), TextPage(i).data());
+    dm.Sync();
+    size_t stored = dm.StoredSize();
+
+    // Each round moves every page to a new slot; the old ones come back
+    // at the next Sync, so the file stops growing.
+    for (int round = 1; round <= 10; ++round) {
+        for (int i = 0; i < N; ++i) dm.WritePage((i + 1) * PAGE_SIZE, TextPage(i + round).data());
+        dm.Sync();
+    }
+    EXPECT_LE(dm.StoredSize(), 2 * stored + PAGE_SIZE);
+    for (int i = 0; i < N; ++i) EXPECT_EQ(ReadBack(dm, (i + 1) * PAGE_SIZE), TextPage(i + 10));
+}
+
+TEST_F(DiskManagerTest, CompressedFreeListReusesPages) {
+    DiskManager dm(kTestFile, PageCompression::kLZ4);
+    int64_t a = dm.AllocatePage();
+    int64_t b = dm.AllocatePage();
+    dm.WritePage(a, TextPage(1).data());
+    dm.WritePage(b, TextPage(2).data());
+    dm.FreePage(a);
+    dm.FreePage(b);
+    EXPECT_EQ(dm.FreeListHead(), b);
+
+    // Reclaimed pages come back zeroed, most recently freed first.
+    EXPECT_EQ(dm.AllocatePage(), b);
+    EXPECT_EQ(ReadBack(dm, b), std::string(PAGE_SIZE, '\0'));
+    EXPECT_EQ(dm.AllocatePage(), a);
+    EXPECT_EQ(dm.FreeListHead(), INVALID_PAGE_ID);
+    EXPECT_EQ(dm.AllocatePage(), 3 * static_cast<int64_t>(PAGE_SIZE));
+}
+
+TEST_F(DiskManagerTest, CompressedFileIsCurrentWithoutSync) {
+    // A copy taken while the file is open, as a crashed process leaves it:
+    // every write is there, including the page map.
+    {
+        DiskManager dm(kTestFile, PageCompression::kLZ4);
+        for (int i = 0; i < 600; ++i) dm.WritePage(dm.AllocatePage(), TextPage(i).data());
+        dm.Sync();
+        for (int i = 0; i < 600; i += 3) dm.WritePage((i + 1) * PAGE_SIZE, TextPage(-i).data());
+        std::filesystem::copy_file(kTestFile, kCopyFile);
+    }
+    DiskManager dm(kCopyFile);
+    for (int i = 0; i < 600; ++i) {
+        EXPECT_EQ(ReadBack(dm, (i + 1) * PAGE_SIZE), TextPage(i % 3 == 0 ? -i : i)) << i;
+    }
+}
+
+// ---------------------------------------------------------------------------
+// Direct backend
+// ---------------------------------------------------------------------------
+
+TEST_F(DiskManagerTest, DirectPagesRoundTripAndPersist) {
+    constexpr int N = 300;  // past the first geometric growth
+    {
+        DiskManager dm(kTestFile, PageCompression::kNone, DiskBackend::kDirect);
+        EXPECT_EQ(dm.Backend(), DiskBackend::kDirect);
+        EXPECT_FALSE(dm.IsCompressed());
+        for (int i = 0; i < N; ++i) {
+            int64_t off = dm.AllocatePage();
+            EXPECT_EQ(ReadBack(dm, off), std::string(PAGE_SIZE, '\0'));
+            dm.WritePage(off, TextPage(i).data());
+        }
+        dm.SetRootOffset(PAGE_SIZE);
+
+        // A buffer that is not PAGE_SIZE-aligned goes through a bounce buffer.
+        std::vector<char> buf(PAGE_SIZE + 1);
+        std::string page = TextPage(-1);
+        std::memcpy(buf.data() + 1, page.data(), PAGE_SIZE);
+        dm.WritePage(PAGE_SIZE, buf.data() + 1);
+        std::memset(buf.data(), 0, buf.size());
+        dm.ReadPage(PAGE_SIZE, buf.data() + 1);
+        EXPECT_EQ(std::string(buf.data() + 1, PAGE_SIZE), page);
+
+        EXPECT_THROW((void)dm.PageData(PAGE_SIZE), std::logic_error);
+        EXPECT_THROW(ReadBack(dm, static_cast<int64_t>(dm.FileSize())), std::out_of_range);
+    }
+
+    // The file is an ordinary one: the mmap backend reads it, and back.
+    {
+        DiskManager dm(kTestFile);
+        EXPECT_EQ(dm.RootOffset(), static_cast<int64_t>(PAGE_SIZE));
+        EXPECT_EQ(ReadBack(dm, PAGE_SIZE), TextPage(-1));
+        for (int i = 1; i < N; ++i) EXPECT_EQ(ReadBack(dm, (i + 1) * PAGE_SIZE), TextPage(i)) << i;
+        dm.WritePage(2 * PAGE_SIZE, TextPage(-2).data());
+    }
+    DiskManager dm(kTestFile, PageCompression::kNone, DiskBackend::kDirect);
+    EXPECT_EQ(ReadBack(dm, 2 * PAGE_SIZE), TextPage(-2));
+}
+
+TEST_F(DiskManagerTest, DirectFreeListReusesPages) {
+    DiskManager dm(kTestFile, PageCompression::kNone, DiskBackend::kDirect);
+    int64_t a = dm.AllocatePage();
+    int64_t b = dm.AllocatePage();
+    dm.WritePage(a, TextPage(1).data());
+    dm.WritePage(b, TextPage(2).data());
+    dm.FreePage(a);
+    dm.FreePage(b);
+    EXPECT_EQ(dm.FreeListHead(), b);
+
+    EXPECT_EQ(dm.AllocatePage(), b);
+    EXPECT_EQ(ReadBack(dm, b), std::string(PAGE_SIZE, '\0'));
+    EXPECT_EQ(dm.AllocatePage(), a);
+    EXPECT_EQ(dm.FreeListHead(), INVALID_PAGE_ID);
+}
+
+TEST_F(DiskManagerTest, DirectFileIsCurrentWithoutSync) {
+    {
+        DiskManager dm(kTestFile, PageCompression::kNone, DiskBackend::kDirect);
+        for (int i = 0; i < 100; ++i) dm.WritePage(dm.AllocatePage(), TextPage(i).data());
+        std::filesystem::copy_file(kTestFile, kCopyFile);
+    }
+    DiskManager dm(kCopyFile, PageCompression::kNone, DiskBackend::kDirect);
+    EXPECT_EQ(dm.NextPageOffset(), 101 * static_cast<int64_t>(PAGE_SIZE));
+    for (int i = 0; i < 100; ++i) EXPECT_EQ(ReadBack(dm, (i + 1) * PAGE_SIZE), TextPage(i)) << i;
+}
+
+TEST_F(DiskManagerTest, DirectWritesAdjacentPagesTogether) {
+    // Without a ring, runs of adjacent pages in aligned buffers are written
+    // with pwritev; a gap, an unaligned buffer or the run limit ends a run.
+    DiskManager dm(kTestFile, PageCompression::kNone, DiskBackend::kDirect);
+    constexpr int N = 150;
+    std::vector<int64_t> offsets;
+    for (int i = 0; i < N + 1; ++i) offsets.push_back(dm.AllocatePage());
+    offsets.erase(offsets.begin() + 100);
+
+    std::vector<char> frames(N * PAGE_SIZE + PAGE_SIZE);
+    char* base = frames.data() + (PAGE_SIZE - reinterpret_cast<uintptr_t>(frames.data()) % PAGE_SIZE);
+    std::vector<const char*> data;
+    for (int i = 0; i < N; ++i) {
+        std::string page = TextPage(i);
+        std::memcpy(base + i * PAGE_SIZE, page.data(), PAGE_SIZE);
+        data.push_back(base + i * PAGE_SIZE);
+    }
+    std::string odd = " " + TextPage(-1);
+    data[7] = odd.data() + 1;
+    dm.WritePages(offsets.data(), data.data(), N);
+
+    for (int i = 0; i < N; ++i) {
+        EXPECT_EQ(ReadBack(dm, offsets[i]), i == 7 ? TextPage(-1) : TextPage(i)) << i;
+    }
+    EXPECT_EQ(ReadBack(dm, (100 + 1) * PAGE_SIZE), std::string(PAGE_SIZE, '\0'));
+}
+
+TEST_F(DiskManagerTest, DirectBatchesThroughIoUring) {
+    DiskManager dm(kTestFile, PageCompression::kNone, DiskBackend::kDirect, IoEngine::kUring);
+    constexpr int N = 100;
+    std::vector<int64_t> offsets;
+    for (int i = 0; i < N; ++i) offsets.push_back(dm.AllocatePage());
+
+    // Aligned frames go through the ring; an unaligned one and the
+    // metadata page are copied one at a time.
+    std::vector<char> frames(N * PAGE_SIZE + PAGE_SIZE);
+    char* base = frames.data() + (PAGE_SIZE - reinterpret_cast<uintptr_t>(frames.data()) % PAGE_SIZE);
+    std::vector<char*> bufs;
+    for (int i = 0; i < N; ++i) {
+        bufs.push_back(base + i * PAGE_SIZE);
+        std::string page = TextPage(i);
+        std::memcpy(bufs[i], page.data(), PAGE_SIZE);
+    }
+    std::string odd = " " + TextPage(-1);
+    bufs[7] = odd.data() + 1;
+    std::vector<const char*> data(bufs.begin(), bufs.end());
+    dm.WritePages(offsets.data(), data.data(), N);
+
+    for (int i = 0; i < N; ++i) {
+        EXPECT_EQ(ReadBack(dm, offsets[i]), i == 7 ? TextPage(-1) : TextPage(i)) << i;
+    }
+
+    std::memset(base, 0, N * PAGE_SIZE);
+    std::string meta(PAGE_SIZE, '\0');
+    std::vector<int64_t> read_offsets(offsets.rbegin(), offsets.rend());
+    read_offsets.push_back(0);
+    std::vector<char*> out(bufs.begin(), bufs.end());
+    out[7] = base + 7 * PAGE_SIZE;
+    out.push_back(meta.data());
+    dm.ReadPages(read_offsets.data(), out.data(), out.size());
+    for (int i = 0; i < N; ++i) {
+        EXPECT_EQ(std::string(out[i], PAGE_SIZE), N - 1 - i == 7 ? TextPage(-1) : TextPage(N - 1 - i))
+            << i;
+    }
+    EXPECT_EQ(meta, ReadBack(dm, 0));
+
+    int64_t bad = static_cast<int64_t>(dm.FileSize());
+    EXPECT_THROW(dm.ReadPages(&bad, out.data(), 1), std::out_of_range);
+}
@@ -0,0 +1,100 @@
+/// @file frame_arena_test.cpp
+/// @brief Google Test suite for FrameArena, with and without huge pages.
+
+#include <gtest/gtest.h>
+#include "bptree/buffer_pool.h"
+#include "bptree/config.h"
+#include "bptree/disk_manager.h"
+#include "bptree/frame_arena.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+using namespace bptree;
+
+namespace {
+
+class FrameArenaTest : public ::testing::TestWithParam<HugePages> {};
+
+}  // namespace
+
+TEST_P(FrameArenaTest, FramesAreAlignedZeroedAndDisjoint) {
+    FrameArena arena(600, GetParam());
+    ASSERT_EQ(arena.Frames(), 600u);
+
+    // Whatever the kernel gave, never more than was asked for.
+    switch (GetParam()) {
+        case HugePages::kOff:
+            EXPECT_EQ(arena.Backing(), HugePages::kOff);
+            EXPECT_EQ(arena.PageSize(), PAGE_SIZE);
+            break;
+        case HugePages::kTransparent:
+            EXPECT_NE(arena.Backing(), HugePages::kExplicit);
+            break;
+        case HugePages::kExplicit:
+            break;
+    }
+    EXPECT_EQ(arena.PageSize() % PAGE_SIZE, 0u);
+
+    for (size_t i = 0; i < arena.Frames(); ++i) {
+        char* f = arena.Frame(i);
+        ASSERT_EQ(reinterpret_cast<uintptr_t>(f) % PAGE_SIZE, 0u);
+        ASSERT_TRUE(std::all_of(f, f + PAGE_SIZE, [](char c) { return c == 0; }));
+        std::memset(f, static_cast<int>(i % 251), PAGE_SIZE);
+    }
+    for (size_t i = 0; i < arena.Frames(); ++i) {
+        EXPECT_EQ(arena.Frame(i)[0], static_cast<char>(i % 251));
+        EXPECT_EQ(arena.Frame(i)[PAGE_SIZE - 1], static_cast<char>(i % 251));
+    }
+}
+
+TEST_P(FrameArenaTest, BindsRangesToAnOnlineNode) {
+    std::vector<int> nodes = FrameArena::NumaNodes();
+    ASSERT_FALSE(nodes.empty());
+
+    FrameArena arena(1024, GetParam());
+    EXPECT_FALSE(arena.BindToNode(0, 1024, -1));
+    // The kernel may not do NUMA at all; the memory works either way.
+    (void)arena.BindToNode(0, 512, nodes.front());
+    (void)arena.BindToNode(512, 1024, nodes.back());
+    for (size_t i = 0; i < arena.Frames(); ++i) arena.Frame(i)[0] = 1;
+}
+
+TEST_P(FrameArenaTest, BufferPoolRoundTripsPages) {
+    constexpr const char* kFile = "test_frame_arena.idx";
+    std::remove(kFile);
+    {
+        DiskManager disk(kFile);
+        BufferPool pool(disk, 64, 4, ReplacementPolicy::kLRU, GetParam(), /*numa=*/true);
+        std::vector<int64_t> ids(200);
+        for (size_t i = 0; i < ids.size(); ++i) {
+            char* page = pool.NewPage(ids[i]);
+            ASSERT_NE(page, nullptr);
+            std::memcpy(page, &i, sizeof(i));
+            pool.UnpinPage(ids[i], true);
+        }
+        for (size_t i = 0; i < ids.size(); ++i) {
+            char* page = pool.FetchPage(ids[i]);
+            ASSERT_NE(page, nullptr);
+            size_t v;
+            std::memcpy(&v, page, sizeof(v));
+            EXPECT_EQ(v, i);
+            pool.UnpinPage(ids[i], false);
+        }
+
+        // Shards are placed only where there is more than one node.
+        if (FrameArena::NumaNodes().size() == 1) {
+            for (size_t s = 0; s < pool.NumShards(); ++s) {
+                EXPECT_EQ(pool.GetShardStats(s).numa_node, -1);
+            }
+        }
+    }
+    std::remove(kFile);
+}
+
+INSTANTIATE_TEST_SUITE_P(Backings, FrameArenaTest,
+                         ::testing::Values(HugePages::kOff, HugePages::kTransparent,
+                                           HugePages::kExplicit));
@@ -0,0 +1,113 @@
+/// @file io_ring_test.cpp
+/// @brief Google Test suite for IoRing, with io_uring and without.
+
+#include <gtest/gtest.h>
+#include "bptree/config.h"
+#include "bptree/io_ring.h"
+
+#include <cerrno>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+using namespace bptree;
+
+namespace {
+
+class IoRingTest : public ::testing::TestWithParam<IoEngine> {
+protected:
+    static constexpr const char* kTestFile = "test_io_ring.dat";
+
+    void SetUp() override {
+        std::remove(kTestFile);
+        fd_ = ::open(kTestFile, O_RDWR | O_CREAT, 0666);
+        ASSERT_GE(fd_, 0);
+    }
+    void TearDown() override {
+        ::close(fd_);
+        std::remove(kTestFile);
+    }
+
+    int fd_ = -1;
+};
+
+}  // namespace
+
+TEST_P(IoRingTest, BatchesLargerThanTheRing) {
+    IoRing ring(GetParam(), 8);
+    if (GetParam() == IoEngine::kSync) {
+        EXPECT_FALSE(ring.IsAsync());
+    }
+
+    constexpr int N = 50;
+    std::vector<std::string> pages;
+    std::vector<IoRequest> reqs(N);
+    for (int i = 0; i < N; ++i) {
+        pages.push_back(std::string(PAGE_SIZE, static_cast<char>('a' + i % 26)));
+        reqs[i] = {IoOp::kWrite, fd_, pages[i].data(), PAGE_SIZE,
+                   static_cast<int64_t>((N - 1 - i) * PAGE_SIZE)};
+    }
+    ring.Submit(reqs.data(), reqs.size());
+    for (const IoRequest& r : reqs) EXPECT_EQ(r.result, static_cast<ssize_t>(PAGE_SIZE));
+
+    std::vector<std::string> back(N, std::string(PAGE_SIZE, '\0'));
+    for (int i = 0; i < N; ++i) {
+        reqs[i] = {IoOp::kRead, fd_, back[i].data(), PAGE_SIZE, static_cast<int64_t>(i * PAGE_SIZE)};
+    }
+    ring.Submit(reqs.data(), reqs.size());
+    for (int i = 0; i < N; ++i) {
+        EXPECT_EQ(reqs[i].result, static_cast<ssize_t>(PAGE_SIZE));
+        EXPECT_EQ(back[i], pages[N - 1 - i]) << i;
+    }
+}
+
+TEST_P(IoRingTest, LinkedAppendsAndSyncRunInOrder) {
+    IoRing ring(GetParam());
+    std::string a = "first;", b = "second;";
+    IoRequest reqs[3];
+    reqs[0] = {IoOp::kWrite, fd_, a.data(), a.size(), -1, true};
+    reqs[1] = {IoOp::kWrite, fd_, b.data(), b.size(), -1, true};
+    reqs[2] = {IoOp::kSync, fd_};
+    ring.Submit(reqs, 3);
+    EXPECT_EQ(reqs[0].result, static_cast<ssize_t>(a.size()));
+    EXPECT_EQ(reqs[1].result, static_cast<ssize_t>(b.size()));
+    EXPECT_EQ(reqs[2].result, 0);
+
+    std::string back(a.size() + b.size(), '\0');
+    ASSERT_EQ(::pread(fd_, back.data(), back.size(), 0), static_cast<ssize_t>(back.size()));
+    EXPECT_EQ(back, a + b);
+}
+
+TEST_P(IoRingTest, FailedLinkCancelsItsChain) {
+    IoRing ring(GetParam());
+    std::string data = "payload";
+    IoRequest reqs[4];
+    reqs[0] = {IoOp::kWrite, -1, data.data(), data.size(), 0, true};  // EBADF
+    reqs[1] = {IoOp::kWrite, fd_, data.data(), data.size(), 0, true};
+    reqs[2] = {IoOp::kSync, fd_};
+    reqs[3] = {IoOp::kWrite, fd_, data.data(), data.size(), 100};      // not linked
+    ring.Submit(reqs, 4);
+    EXPECT_EQ(reqs[0].result, -EBADF);
+    EXPECT_EQ(reqs[1].result, -ECANCELED);
+    EXPECT_EQ(reqs[2].result, -ECANCELED);
+    EXPECT_EQ(reqs[3].result, static_cast<ssize_t>(data.size()));
+}
+
+TEST_P(IoRingTest, ReadStopsShortAtEndOfFile) {
+    IoRing ring(GetParam());
+    ASSERT_EQ(::pwrite(fd_, "0123456789", 10, 0), 10);
+    std::string back(PAGE_SIZE, '\0');
+    IoRequest req{IoOp::kRead, fd_, back.data(), PAGE_SIZE, 4};
+    ring.Submit(&req, 1);
+    EXPECT_EQ(req.result, 6);
+    EXPECT_EQ(back.substr(0, 6), "456789");
+}
+
+INSTANTIATE_TEST_SUITE_P(Engines, IoRingTest,
+                         ::testing::Values(IoEngine::kSync, IoEngine::kUring),
+                         [](const ::testing::TestParamInfo<IoEngine>& info) {
+                             return info.param == IoEngine::kUring ? "Uring" : "Sync";
+                         });
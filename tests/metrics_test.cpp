@@ -0,0 +1,157 @@
+/// @file metrics_test.cpp
+/// @brief Google Test suite for the latency histograms and event counters.
+
+#include <gtest/gtest.h>
+#include "bptree/bplus_tree.h"
+#include "bptree/metrics.h"
+
+#include <climits>
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace bptree;
+
+namespace {
+
+class MetricsTest : public ::testing::Test {
+protected:
+    static constexpr const char* kTestFile = "test_metrics.idx";
+
+    void SetUp() override {
+        std::remove(kTestFile);
+        std::remove((std::string(kTestFile) + ".wal").c_str());
+        Metrics::Instance().Reset();
+    }
+    void TearDown() override {
+        std::remove(kTestFile);
+        std::remove((std::string(kTestFile) + ".wal").c_str());
+    }
+};
+
+}  // namespace
+
+TEST_F(MetricsTest, BucketsBoundEveryValueWithinAnEighth) {
+    std::vector<uint64_t> values;
+    for (uint64_t v = 0; v < 5000; ++v) values.push_back(v);
+    for (int shift = 13; shift < 64; ++shift) {
+        values.push_back(uint64_t{1} << shift);
+        values.push_back((uint64_t{1} << shift) - 1);
+        values.push_back((uint64_t{1} << shift) + 12345);
+    }
+    values.push_back(UINT64_MAX);
+
+    for (uint64_t v : values) {
+        int b = HistogramSnapshot::BucketOf(v);
+        ASSERT_GE(b, 0);
+        ASSERT_LT(b, HistogramSnapshot::kBuckets);
+        uint64_t high = HistogramSnapshot::BucketHigh(b);
+        ASSERT_GE(high, v);
+        ASSERT_LE(high - v, v / 8) << v;
+        if (b > 0) {
+            ASSERT_LT(HistogramSnapshot::BucketHigh(b - 1), v) << v;
+        }
+    }
+}
+
+TEST_F(MetricsTest, PercentilesFollowTheSamples) {
+    Metrics& m = Metrics::Instance();
+    for (uint64_t ns = 1; ns <= 1000; ++ns) m.Record(Histogram::kCheckpoint, ns * 1000);
+
+    MetricsSnapshot s = m.Snapshot();
+    const HistogramSnapshot& h = s.Get(Histogram::kCheckpoint);
+    EXPECT_EQ(h.count, 1000u);
+    EXPECT_EQ(h.max, 1000000u);
+    EXPECT_DOUBLE_EQ(h.Mean(), 500500.0);
+
+    for (double q : {0.5, 0.9, 0.99}) {
+        double exact = q * 1000000;
+        EXPECT_GE(h.Percentile(q), exact);
+        EXPECT_LE(h.Percentile(q), exact * 1.125);
+    }
+    EXPECT_EQ(h.Percentile(1.0), 1000000u);
+    EXPECT_EQ(m.Snapshot().Get(Histogram::kSearch).Percentile(0.99), 0u);
+}
+
+TEST_F(MetricsTest, ExitedThreadsKeepTheirCounts) {
+    std::vector<std::thread> threads;
+    for (int t = 0; t < 4; ++t) {
+        threads.emplace_back([] {
+            for (int i = 0; i < 1000; ++i) {
+                Metrics::Instance().Add(Counter::kEvictions);
+                Metrics::Instance().Record(Histogram::kEviction, 100);
+            }
+        });
+    }
+    Metrics::Instance().Add(Counter::kEvictions, 7);
+    for (auto& t : threads) t.join();
+
+    MetricsSnapshot s = Metrics::Instance().Snapshot();
+    EXPECT_EQ(s.Get(Counter::kEvictions), 4007u);
+    EXPECT_EQ(s.Get(Histogram::kEviction).count, 4000u);
+
+    Metrics::Instance().Reset();
+    s = Metrics::Instance().Snapshot();
+    EXPECT_EQ(s.Get(Counter::kEvictions), 0u);
+    EXPECT_EQ(s.Get(Histogram::kEviction).count, 0u);
+}
+
+TEST_F(MetricsTest, ExportsNameEverySeries) {
+    Metrics::Instance().Record(Histogram::kInsert, 2000);
+    Metrics::Instance().Add(Counter::kLeafSplits, 3);
+    MetricsSnapshot s = Metrics::Instance().Snapshot();
+
+    std::string json = s.ToJSON();
+    EXPECT_NE(json.find("\"insert\": {\"count\": 1, \"mean_ns\": 2000"), std::string::npos);
+    EXPECT_NE(json.find("\"p99_ns\": 2000"), std::string::npos);
+    EXPECT_NE(json.find("\"leaf_splits\": 3"), std::string::npos);
+
+    std::string prom = s.ToPrometheus();
+    EXPECT_NE(prom.find("# TYPE bptree_insert_seconds summary\n"), std::string::npos);
+    EXPECT_NE(prom.find("bptree_insert_seconds_count 1\n"), std::string::npos);
+    EXPECT_NE(prom.find("bptree_insert_seconds{quantile=\"0.99\"} 2e-06\n"), std::string::npos);
+    EXPECT_NE(prom.find("bptree_leaf_splits_total 3\n"), std::string::npos);
+    for (int c = 0; c < static_cast<int>(Counter::kCount); ++c) {
+        EXPECT_NE(prom.find(std::string("bptree_") + CounterName(static_cast<Counter>(c))),
+                  std::string::npos);
+    }
+}
+
+#if BPTREE_METRICS
+TEST_F(MetricsTest, TreeOperationsAreRecorded) {
+    constexpr int kKeys = 20000;
+    Options opts;
+    opts.pool_size = 64;  // small enough to evict
+    BPlusTree tree(kTestFile, opts);
+
+    // Long enough values that the leaves outnumber an internal node's children.
+    const std::string value(200, 'v');
+    for (int i = 0; i < kKeys; ++i) ASSERT_TRUE(tree.Insert(i, value.data(), value.size()).ok());
+    std::string v;
+    for (int i = 0; i < kKeys; i += 10) ASSERT_TRUE(tree.Search(i, v).ok());
+    std::vector<std::pair<key_t, std::string>> out;
+    ASSERT_TRUE(tree.RangeQuery(0, 100, out).ok());
+    for (int i = 0; i < kKeys - 100; ++i) ASSERT_TRUE(tree.Delete(i).ok());
+    tree.Checkpoint();
+
+    MetricsSnapshot s = Metrics::Instance().Snapshot();
+    EXPECT_EQ(s.Get(Histogram::kInsert).count, static_cast<uint64_t>(kKeys));
+    EXPECT_EQ(s.Get(Histogram::kSearch).count, static_cast<uint64_t>(kKeys / 10));
+    EXPECT_EQ(s.Get(Histogram::kRangeQuery).count, 1u);
+    EXPECT_EQ(s.Get(Histogram::kDelete).count, static_cast<uint64_t>(kKeys - 100));
+    EXPECT_EQ(s.Get(Histogram::kCheckpoint).count, 1u);
+    EXPECT_GT(s.Get(Histogram::kInsert).Percentile(0.99), 0u);
+
+    EXPECT_GT(s.Get(Counter::kLeafSplits), 0u);
+    EXPECT_GT(s.Get(Counter::kInternalSplits), 0u);
+    EXPECT_GT(s.Get(Counter::kLeafMerges), 0u);
+    EXPECT_GT(s.Get(Counter::kInternalMerges), 0u);
+    EXPECT_GT(s.Get(Counter::kEvictions), 0u);
+    EXPECT_GE(s.Get(Counter::kEvictions), s.Get(Counter::kDirtyEvictions));
+    EXPECT_EQ(s.Get(Histogram::kEviction).count, s.Get(Counter::kEvictions));
+    EXPECT_GT(s.Get(Histogram::kMissRead).count, 0u);
+    EXPECT_GT(s.Get(Histogram::kWALSync).count, 0u);
+}
+#endif
@@ -0,0 +1,111 @@
+/// @file page_table_test.cpp
+/// @brief Google Test suite for the open-addressing PageTable.
+
+#include <gtest/gtest.h>
+#include "bptree/page_table.h"
+#include "bptree/config.h"
+
+#include <atomic>
+#include <random>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+using namespace bptree;
+
+namespace {
+int64_t Page(int64_t n) { return n * static_cast<int64_t>(PAGE_SIZE); }
+}  // namespace
+
+TEST(PageTableTest, EmptyTableFindsNothing) {
+    PageTable table(16);
+    EXPECT_EQ(table.Find(Page(1)), -1);
+    EXPECT_EQ(table.Size(), 0u);
+}
+
+TEST(PageTableTest, InsertFindErase) {
+    PageTable table(16);
+    table.Insert(Page(3), 7);
+    table.Insert(Page(9), 0);
+
+    EXPECT_EQ(table.Find(Page(3)), 7);
+    EXPECT_EQ(table.Find(Page(9)), 0);
+    EXPECT_EQ(table.Size(), 2u);
+
+    EXPECT_TRUE(table.Erase(Page(3)));
+    EXPECT_FALSE(table.Erase(Page(3)));
+    EXPECT_EQ(table.Find(Page(3)), -1);
+    EXPECT_EQ(table.Find(Page(9)), 0);
+    EXPECT_EQ(table.Size(), 1u);
+}
+
+TEST(PageTableTest, FullTableChurnMatchesReference) {
+    // Fill to capacity and churn, so probe runs wrap and backward shifts
+    // move entries across the end of the slot array.
+    constexpr int kEntries = 64;
+    PageTable table(kEntries);
+    std::unordered_map<int64_t, int> ref;
+    std::mt19937 rng(7);
+
+    for (int round = 0; round < 20000; ++round) {
+        int64_t page = Page(rng() % 512 + 1);
+        auto it = ref.find(page);
+        if (it != ref.end()) {
+            ASSERT_TRUE(table.Erase(page));
+            ref.erase(it);
+        } else if (ref.size() < kEntries) {
+            int frame = static_cast<int>(rng() % kEntries);
+            table.Insert(page, frame);
+            ref[page] = frame;
+        }
+        if (round % 97 == 0) {
+            for (auto& [p, f] : ref) ASSERT_EQ(table.Find(p), f);
+        }
+    }
+    EXPECT_EQ(table.Size(), ref.size());
+    for (auto& [p, f] : ref) EXPECT_EQ(table.Find(p), f);
+}
+
+TEST(PageTableTest, ConcurrentFindNeverReturnsWrongFrame) {
+    // One writer churns odd pages while readers look up stable even pages.
+    // Readers may transiently miss, but must never see a foreign frame.
+    constexpr int kStable = 32;
+    PageTable table(128);
+    for (int i = 0; i < kStable; ++i) table.Insert(Page(2 * i + 2), i);
+
+    std::atomic<bool> stop{false};
+    std::atomic<int>  wrong{0};
+    std::vector<std::thread> readers;
+    for (int r = 0; r < 2; ++r) {
+        readers.emplace_back([&] {
+            while (!stop.load()) {
+                for (int i = 0; i < kStable; ++i) {
+                    int f = table.Find(Page(2 * i + 2));
+                    if (f != -1 && f != i) ++wrong;
+                }
+            }
+        });
+    }
+
+    std::mt19937 rng(3);
+    std::vector<int64_t> live;
+    for (int n = 0; n < 20000; ++n) {
+        if (live.size() < 64 && (live.empty() || rng() % 2)) {
+            int64_t page = Page(2 * static_cast<int64_t>(rng() % 100000) + 1);
+            if (table.Find(page) == -1) {
+                table.Insert(page, 100);
+                live.push_back(page);
+            }
+        } else {
+            size_t k = rng() % live.size();
+            table.Erase(live[k]);
+            live[k] = live.back();
+            live.pop_back();
+        }
+    }
+    stop = true;
+    for (auto& t : readers) t.join();
+
+    EXPECT_EQ(wrong.load(), 0);
+    for (int i = 0; i < kStable; ++i) EXPECT_EQ(table.Find(Page(2 * i + 2)), i);
+}
@@ -0,0 +1,848 @@
+/// @file page_test.cpp
+/// @brief Google Test suite for the page wrappers and in-page key search.
+
+#include <gtest/gtest.h>
+#include "bptree/key_search.h"
+#include "bptree/page.h"
+
+#include <algorithm>
+#include <climits>
+#include <cstring>
+#include <random>
+#include <string>
+#include <vector>
+
+using namespace bptree;
+
+namespace {
+
+/// Capacities of the layouts written before format version 3.
+constexpr int kOldLeafMaxKeys     = 35;
+constexpr int kOldInternalMaxKeys = 100;
+
+/// Write an internal page in the pre-version-1 layout: [child(8) | key(4)]
+/// slots after the header, type PAGE_TYPE_LEGACY_INTERNAL.
+void WriteLegacyInternal(char* raw, const std::vector<int>& keys,
+                         const std::vector<int64_t>& children) {
+    std::memset(raw, 0, PAGE_SIZE);
+    int n = static_cast<int>(keys.size());
+    std::memcpy(raw, &n, sizeof(n));
+    for (int i = 0; i <= n; ++i) {
+        std::memcpy(raw + 8 + i * 12, &children[i], 8);
+        if (i < n) std::memcpy(raw + 8 + i * 12 + 8, &keys[i], 4);
+    }
+}
+
+/// DATA_SIZE payload holding @p text.
+std::string Payload(const std::string& text) {
+    std::string data(DATA_SIZE, '\0');
+    data.replace(0, text.size(), text);
+    return data;
+}
+
+std::string DataOf(const FixedLeafPage& leaf, int idx) {
+    std::string data(DATA_SIZE, '\0');
+    leaf.GetData(idx, data.data());
+    return data;
+}
+
+/// Cell holding @p value.
+std::string Cell(const std::string& value) {
+    std::string cell(LeafPage::kCellHeaderSize + value.size(), '\0');
+    LeafPage::MakeCell(cell.data(), value.data(), value.size());
+    return cell;
+}
+
+}  // namespace
+
+// ============================================================================
+// Key search
+// ============================================================================
+
+TEST(KeySearchTest, DenseMatchesStdBounds) {
+    std::mt19937 rng(7);
+    // One spare byte in front so the keys start unaligned.
+    std::vector<char> buf(1 + 128 * sizeof(key_t));
+    char* keys = buf.data() + 1;
+
+    for (int n = 0; n <= 128; ++n) {
+        // Sorted, with duplicates and the extreme values.
+        std::vector<key_t> v(n);
+        for (auto& k : v) k = static_cast<key_t>(rng() % 64) - 32;
+        if (n > 2) {
+            v[0] = INT_MIN;
+            v[n - 1] = INT_MAX;
+        }
+        std::sort(v.begin(), v.end());
+        std::memcpy(keys, v.data(), v.size() * sizeof(key_t));
+
+        for (key_t probe : {INT_MIN, -33, -32, -1, 0, 5, 31, 32, INT_MAX}) {
+            int lower = static_cast<int>(std::lower_bound(v.begin(), v.end(), probe) - v.begin());
+            int upper = static_cast<int>(std::upper_bound(v.begin(), v.end(), probe) - v.begin());
+            ASSERT_EQ(LowerBoundDense(keys, n, probe), lower)
+                << KeySearchImplementation() << " n " << n << " key " << probe;
+            ASSERT_EQ(UpperBoundDense(keys, n, probe), upper)
+                << KeySearchImplementation() << " n " << n << " key " << probe;
+        }
+    }
+}
+
+TEST(KeySearchTest, StridedMatchesStdBounds) {
+    constexpr size_t kStride = FixedLeafPage::kRecordSize;
+    std::vector<char> buf(FixedLeafPage::kMaxKeys * kStride);
+
+    for (int n = 0; n <= FixedLeafPage::kMaxKeys; ++n) {
+        std::vector<key_t> v(n);
+        for (int i = 0; i < n; ++i) v[i] = 3 * (i / 2);  // pairs of duplicates
+        for (int i = 0; i < n; ++i) std::memcpy(buf.data() + i * kStride, &v[i], sizeof(key_t));
+
+        for (key_t probe = -1; probe <= 3 * n / 2 + 1; ++probe) {
+            int lower = static_cast<int>(std::lower_bound(v.begin(), v.end(), probe) - v.begin());
+            int upper = static_cast<int>(std::upper_bound(v.begin(), v.end(), probe) - v.begin());
+            ASSERT_EQ(LowerBoundStrided(buf.data(), kStride, n, probe), lower)
+                << "n " << n << " key " << probe;
+            ASSERT_EQ(UpperBoundStrided(buf.data(), kStride, n, probe), upper)
+                << "n " << n << " key " << probe;
+        }
+    }
+}
+
+TEST(KeySearchTest, Dense64MatchesStdBounds) {
+    std::mt19937_64 rng(11);
+    std::vector<char> buf(1 + 64 * sizeof(int64_t));
+    char* keys = buf.data() + 1;
+
+    for (int n = 0; n <= 64; ++n) {
+        // Keys that differ only above the low 32 bits, around zero.
+        std::vector<int64_t> v(n);
+        for (auto& k : v) k = (static_cast<int64_t>(rng() % 16) - 8) * (int64_t{1} << 32) + rng() % 2;
+        if (n > 2) {
+            v[0] = INT64_MIN;
+            v[n - 1] = INT64_MAX;
+        }
+        std::sort(v.begin(), v.end());
+        std::memcpy(keys, v.data(), v.size() * sizeof(int64_t));
+
+        for (int64_t probe : {INT64_MIN, -(int64_t{9} << 32), int64_t{-1}, int64_t{0},
+                              int64_t{1} << 32, (int64_t{3} << 32) + 1, INT64_MAX}) {
+            int lower = static_cast<int>(std::lower_bound(v.begin(), v.end(), probe) - v.begin());
+            int upper = static_cast<int>(std::upper_bound(v.begin(), v.end(), probe) - v.begin());
+            ASSERT_EQ(LowerBoundDense64(keys, n, probe), lower)
+                << KeySearchImplementation64() << " n " << n << " key " << probe;
+            ASSERT_EQ(UpperBoundDense64(keys, n, probe), upper)
+                << KeySearchImplementation64() << " n " << n << " key " << probe;
+        }
+    }
+}
+
+TEST(KeySearchTest, GenericSearchTakesComparator) {
+    // Descending keys under std::greater go through the comparator.
+    std::vector<int> v = {50, 40, 40, 30, 10};
+    const char* keys = reinterpret_cast<const char*>(v.data());
+    int n = static_cast<int>(v.size());
+    std::greater<int> gt;
+    EXPECT_EQ(KeySearch(keys, n, 60, false, gt), 0);
+    EXPECT_EQ(KeySearch(keys, n, 40, false, gt), 1);
+    EXPECT_EQ(KeySearch(keys, n, 40, true, gt), 3);
+    EXPECT_EQ(KeySearch(keys, n, 5, true, gt), 5);
+
+    // The default order matches the dense search.
+    std::vector<int64_t> w = {-(int64_t{1} << 40), 0, int64_t{1} << 40};
+    const char* wide = reinterpret_cast<const char*>(w.data());
+    EXPECT_EQ(KeySearch(wide, 3, int64_t{1}, false), 2);
+    EXPECT_EQ(KeySearch(wide, 3, int64_t{0}, true), 2);
+}
+
+TEST(KeySearchTest, ReportsImplementation) {
+    std::string name = KeySearchImplementation();
+    EXPECT_TRUE(name == "avx2" || name == "sse2" || name == "neon" || name == "scalar") << name;
+#if defined(__AVX2__)
+    EXPECT_EQ(name, "avx2");
+#endif
+    std::string name64 = KeySearchImplementation64();
+    EXPECT_TRUE(name64 == "avx2" || name64 == "sse4.2" || name64 == "neon" ||
+                name64 == "scalar") << name64;
+}
+
+// ============================================================================
+// FixedLeafPage
+// ============================================================================
+
+TEST(PageTest, FixedLeafFindAndLowerBound) {
+    char raw[PAGE_SIZE];
+    FixedLeafPage::Init(raw);
+    FixedLeafPage leaf(raw);
+    char data[DATA_SIZE]{};
+    for (int i = 0; i < FixedLeafPage::kMaxKeys; ++i) leaf.InsertAt(i, 10 * i, data);
+
+    EXPECT_EQ(leaf.LowerBound(-5), 0);
+    EXPECT_EQ(leaf.LowerBound(0), 0);
+    EXPECT_EQ(leaf.LowerBound(1), 1);
+    EXPECT_EQ(leaf.LowerBound(10 * (FixedLeafPage::kMaxKeys - 1)), FixedLeafPage::kMaxKeys - 1);
+    EXPECT_EQ(leaf.LowerBound(10 * (FixedLeafPage::kMaxKeys - 1) + 1), FixedLeafPage::kMaxKeys);
+
+    EXPECT_EQ(leaf.Find(120), 12);
+    EXPECT_EQ(leaf.Find(125), -1);
+    EXPECT_EQ(leaf.Find(1000), -1);
+
+    FixedLeafPage::Init(raw);
+    EXPECT_EQ(leaf.LowerBound(0), 0);
+    EXPECT_EQ(leaf.Find(0), -1);
+}
+
+TEST(PageTest, FixedLeafEditsMoveKeysNotPayloads) {
+    char raw[PAGE_SIZE];
+    FixedLeafPage::Init(raw);
+    FixedLeafPage leaf(raw);
+    EXPECT_EQ(PageType(raw), PAGE_TYPE_V3_LEAF);
+    EXPECT_TRUE(PageIsLeaf(raw));
+    EXPECT_EQ(leaf.NextLeaf(), INVALID_PAGE_ID);
+
+    // Fill back to front so every insert shifts the whole page.
+    for (int k = FixedLeafPage::kMaxKeys - 1; k >= 0; --k) {
+        leaf.InsertAt(0, k, Payload("v" + std::to_string(k)).data());
+    }
+    ASSERT_EQ(leaf.NumKeys(), FixedLeafPage::kMaxKeys);
+    for (int i = 0; i < FixedLeafPage::kMaxKeys; ++i) {
+        EXPECT_EQ(leaf.KeyAt(i), i);
+        EXPECT_EQ(DataOf(leaf, i), Payload("v" + std::to_string(i)));
+    }
+
+    // Free a few payloads, then reuse them for new records.
+    for (int k : {30, 0, 17, 5}) leaf.RemoveAt(leaf.Find(k));
+    ASSERT_EQ(leaf.NumKeys(), FixedLeafPage::kMaxKeys - 4);
+    EXPECT_EQ(leaf.Find(17), -1);
+    for (int k : {100, -1, 17}) {
+        int pos = leaf.LowerBound(k);
+        leaf.InsertAt(pos, k, Payload("new" + std::to_string(k)).data());
+    }
+    ASSERT_EQ(leaf.NumKeys(), FixedLeafPage::kMaxKeys - 1);
+    // Truncation (dropping 100) keeps the free payloads usable too.
+    leaf.SetNumKeys(FixedLeafPage::kMaxKeys - 2);
+    leaf.InsertAt(FixedLeafPage::kMaxKeys - 2, 200, Payload("last").data());
+    ASSERT_EQ(leaf.NumKeys(), FixedLeafPage::kMaxKeys - 1);
+    leaf.InsertAt(FixedLeafPage::kMaxKeys - 1, 300, Payload("full").data());
+
+    std::vector<int> expected;
+    for (int k = -1; k < FixedLeafPage::kMaxKeys; ++k) {
+        if (k != 0 && k != 5 && k != 30) expected.push_back(k);
+    }
+    expected.push_back(200);
+    expected.push_back(300);
+    ASSERT_EQ(leaf.NumKeys(), static_cast<int>(expected.size()));
+    for (int i = 0; i < leaf.NumKeys(); ++i) {
+        int k = expected[i];
+        ASSERT_EQ(leaf.KeyAt(i), k);
+        std::string want = k == -1  ? "new-1"
+                         : k == 17  ? "new17"
+                         : k == 200 ? "last"
+                         : k == 300 ? "full"
+                                    : "v" + std::to_string(k);
+        EXPECT_EQ(DataOf(leaf, i), Payload(want)) << "key " << k;
+    }
+}
+
+TEST(PageTest, FixedLeafCopyAndAppendRecords) {
+    char a_raw[PAGE_SIZE], b_raw[PAGE_SIZE], c_raw[PAGE_SIZE];
+    FixedLeafPage::Init(a_raw);
+    FixedLeafPage::Init(b_raw);
+    FixedLeafPage::Init(c_raw);
+    FixedLeafPage a(a_raw), b(b_raw), c(c_raw);
+    for (int i = 0; i < 20; ++i) a.InsertAt(0, 20 - i, Payload("a" + std::to_string(20 - i)).data());
+
+    // Packed [key | data] records, as in a kLeafMerge payload.
+    std::vector<char> packed(5 * FixedLeafPage::kRecordSize);
+    a.CopyRecords(10, 5, packed.data());
+    int first;
+    std::memcpy(&first, packed.data(), 4);
+    EXPECT_EQ(first, 11);
+    EXPECT_EQ(std::string(packed.data() + 4, DATA_SIZE), Payload("a11"));
+
+    b.AppendRecords(packed.data(), 5);
+    c.AppendFrom(a, 10, 5);
+    ASSERT_EQ(b.NumKeys(), 5);
+    ASSERT_EQ(c.NumKeys(), 5);
+    for (int i = 0; i < 5; ++i) {
+        EXPECT_EQ(b.KeyAt(i), 11 + i);
+        EXPECT_EQ(c.KeyAt(i), 11 + i);
+        EXPECT_EQ(DataOf(b, i), DataOf(a, 10 + i));
+        EXPECT_EQ(DataOf(c, i), DataOf(a, 10 + i));
+    }
+}
+
+TEST(PageTest, UpgradeLegacyLeaf) {
+    char raw[PAGE_SIZE];
+    std::memset(raw, 0, PAGE_SIZE);
+    int n = kOldLeafMaxKeys, type = PAGE_TYPE_LEGACY_LEAF;
+    int64_t next = 5 * PAGE_SIZE;
+    std::memcpy(raw, &n, 4);
+    std::memcpy(raw + 4, &type, 4);
+    std::memcpy(raw + 8, &next, 8);
+    for (int i = 0; i < n; ++i) {
+        int key = 2 * i;
+        std::memcpy(raw + 16 + i * FixedLeafPage::kRecordSize, &key, 4);
+        std::string data = Payload("r" + std::to_string(i));
+        std::memcpy(raw + 16 + i * FixedLeafPage::kRecordSize + 4, data.data(), DATA_SIZE);
+    }
+    SetPageLSN(raw, 99);
+    ASSERT_TRUE(FixedLeafPage::IsLegacy(raw));
+    EXPECT_TRUE(PageIsLeaf(raw));
+
+    FixedLeafPage::UpgradeLegacy(raw);
+    EXPECT_FALSE(FixedLeafPage::IsLegacy(raw));
+    FixedLeafPage leaf(raw);
+    ASSERT_EQ(leaf.NumKeys(), n);
+    EXPECT_EQ(leaf.NextLeaf(), next);
+    EXPECT_EQ(leaf.PageLSN(), 99u);
+    for (int i = 0; i < n; ++i) {
+        EXPECT_EQ(leaf.KeyAt(i), 2 * i);
+        EXPECT_EQ(DataOf(leaf, i), Payload("r" + std::to_string(i)));
+    }
+    EXPECT_EQ(leaf.Find(34), 17);
+}
+
+// ============================================================================
+// LeafPage
+// ============================================================================
+
+TEST(PageTest, LeafStoresValuesOfAnyLength) {
+    char raw[PAGE_SIZE];
+    LeafPage::Init(raw);
+    LeafPage leaf(raw);
+    EXPECT_EQ(PageType(raw), PAGE_TYPE_LEAF);
+    EXPECT_TRUE(PageIsLeaf(raw));
+    EXPECT_FALSE(LeafPage::IsLegacy(raw));
+    EXPECT_EQ(leaf.NextLeaf(), INVALID_PAGE_ID);
+    EXPECT_EQ(leaf.UsedBytes(), 0u);
+    EXPECT_EQ(leaf.FreeBytes(), LeafPage::kCapacity);
+
+    // Empty, short, binary and the longest inline value.
+    std::string binary("a\0b\0", 4);
+    std::string longest(LeafPage::kMaxInlineValue, 'L');
+    std::vector<std::string> values = {"", "x", binary, longest};
+    for (int i = 0; i < 4; ++i) leaf.InsertAt(i, 10 * i, Cell(values[i]).data());
+    ASSERT_EQ(leaf.NumKeys(), 4);
+    size_t used = 0;
+    for (int i = 0; i < 4; ++i) {
+        EXPECT_EQ(leaf.KeyAt(i), 10 * i);
+        EXPECT_FALSE(leaf.IsOverflow(i));
+        EXPECT_EQ(leaf.Value(i), values[i]);
+        EXPECT_EQ(leaf.ValueSize(i), values[i].size());
+        EXPECT_EQ(leaf.RecordSizeAt(i), LeafPage::RecordSize(Cell(values[i]).size()));
+        used += leaf.RecordSizeAt(i);
+    }
+    EXPECT_EQ(leaf.UsedBytes(), used);
+    EXPECT_EQ(leaf.RecordSizeAt(3), LeafPage::kMaxRecordSize);
+    EXPECT_EQ(leaf.Find(20), 2);
+    EXPECT_EQ(leaf.Find(25), -1);
+    EXPECT_EQ(leaf.LowerBound(25), 3);
+
+    // An overflow reference keeps the value's full length.
+    char cell[LeafPage::kMaxCellSize];
+    size_t size = LeafPage::MakeOverflowCell(cell, 100000, 7 * PAGE_SIZE);
+    leaf.InsertAt(1, 5, cell);
+    EXPECT_TRUE(leaf.IsOverflow(1));
+    EXPECT_EQ(leaf.CellSize(1), size);
+    EXPECT_EQ(leaf.ValueSize(1), 100000u);
+    EXPECT_EQ(leaf.OverflowHead(1), 7 * static_cast<int64_t>(PAGE_SIZE));
+}
+
+TEST(PageTest, LeafReusesSpaceOfRemovedCells) {
+    char raw[PAGE_SIZE];
+    LeafPage::Init(raw);
+    LeafPage leaf(raw);
+
+    // Fill with 100-byte values back to front, so every insert shifts all
+    // entries.  The keys differ in their high half, so the page stores them
+    // at full width.
+    auto key = [](int i) { return i << 16; };
+    std::string cell = Cell(std::string(100, 'v'));
+    int n = 0;
+    while (leaf.HasRoom(key(1000 - n), -1, cell.size())) {
+        cell[LeafPage::kCellHeaderSize] = static_cast<char>('a' + n % 26);
+        leaf.InsertAt(0, key(1000 - n), cell.data());
+        ++n;
+    }
+    ASSERT_EQ(n, static_cast<int>(LeafPage::kCapacity / LeafPage::RecordSize(cell.size())));
+    EXPECT_FALSE(leaf.IsPrefixed());
+    for (int i = 0; i < n; ++i) {
+        ASSERT_EQ(leaf.KeyAt(i), key(1000 - n + 1 + i));
+        EXPECT_EQ(leaf.Value(i)[0], 'a' + (n - 1 - i) % 26);
+    }
+
+    // Removing records from the middle fragments the heap; the space is
+    // still counted free, and an insert compacts to use it.
+    size_t free = leaf.FreeBytes();
+    leaf.RemoveAt(5);
+    leaf.RemoveAt(10);
+    EXPECT_EQ(leaf.FreeBytes(), free + 2 * LeafPage::RecordSize(cell.size()));
+    std::string big = Cell(std::string(2 * 100, 'B'));
+    ASSERT_TRUE(leaf.HasRoom(0, -1, big.size()));
+    leaf.InsertAt(0, 0, big.data());
+    EXPECT_EQ(leaf.Value(0), std::string(200, 'B'));
+    EXPECT_EQ(leaf.KeyAt(1), key(1000 - n + 1));
+    EXPECT_EQ(leaf.NumKeys(), n - 1);
+
+    // Growing a value in place needs room for the difference only.
+    std::string grown = Cell(std::string(100 + leaf.FreeBytes(), 'G'));
+    int third = leaf.KeyAt(3);
+    EXPECT_TRUE(leaf.HasRoom(third, 3, grown.size()));
+    EXPECT_FALSE(leaf.HasRoom(third, -1, grown.size()));
+    leaf.SetCell(3, grown.data());
+    EXPECT_EQ(leaf.KeyAt(3), third);
+    EXPECT_EQ(leaf.Value(3), std::string(grown.size() - LeafPage::kCellHeaderSize, 'G'));
+    EXPECT_EQ(leaf.FreeBytes(), 0u);
+
+    // Truncating frees the tail; compaction keeps every value.
+    leaf.Truncate(4);
+    EXPECT_EQ(leaf.NumKeys(), 4);
+    std::vector<std::string> before;
+    for (int i = 0; i < 4; ++i) before.emplace_back(leaf.Value(i));
+    size_t used = leaf.UsedBytes();
+    leaf.Compact();
+    EXPECT_EQ(leaf.UsedBytes(), used);
+    for (int i = 0; i < 4; ++i) EXPECT_EQ(leaf.Value(i), before[i]);
+}
+
+TEST(PageTest, LeafZeroesFreedBytes) {
+    char raw[PAGE_SIZE];
+    LeafPage::Init(raw);
+    LeafPage leaf(raw);
+    for (int i = 0; i < 40; ++i) {
+        leaf.InsertAt(i, i << 16, Cell(std::string(10 + i, static_cast<char>('a' + i % 26))).data());
+    }
+    for (int i = 38; i > 0; i -= 3) leaf.RemoveAt(i);
+    leaf.Truncate(12);
+    leaf.InsertAt(0, -5, Cell(std::string(500, 'z')).data());  // compacts
+    leaf.RemoveAt(4);
+
+    // Everything but the header, the keys and offsets, and the live cells.
+    std::vector<bool> live(PAGE_SIZE, false);
+    size_t width   = leaf.IsPrefixed() ? LeafPage::kSuffixSize : sizeof(key_t);
+    size_t entries = 24 + leaf.NumKeys() * (width + sizeof(uint16_t));
+    std::fill(live.begin(), live.begin() + entries, true);
+    std::fill(live.begin() + PAGE_LSN_OFFSET, live.end(), true);
+    for (int i = 0; i < leaf.NumKeys(); ++i) {
+        size_t off = leaf.CellAt(i) - raw;
+        std::fill(live.begin() + off, live.begin() + off + leaf.CellSize(i), true);
+    }
+    for (size_t b = 0; b < PAGE_SIZE; ++b) {
+        if (!live[b]) {
+            ASSERT_EQ(raw[b], 0) << "byte " << b;
+        }
+    }
+}
+
+TEST(PageTest, PrefixedLeafStoresKeySuffixes) {
+    static_assert(LeafPage::kPrefixable && LeafPage::kSuffixSize == 2);
+    std::string cell = Cell("v");
+    // Keys sharing the high half 7, and negative keys sharing 0xFFFF.
+    for (int base : {7 << 16, -(1 << 16)}) {
+        char raw[PAGE_SIZE];
+        LeafPage::Init(raw);
+        LeafPage leaf(raw);
+        std::vector<int> keys;
+        for (int i = 0; i < 50; ++i) {
+            keys.push_back(base + i * 1000);
+            leaf.InsertAt(i, keys.back(), cell.data());
+        }
+        ASSERT_TRUE(leaf.IsPrefixed());
+        EXPECT_EQ(PageType(raw), PAGE_TYPE_PREFIX_LEAF);
+        EXPECT_TRUE(PageIsLeaf(raw));
+        EXPECT_EQ(leaf.Prefix(), static_cast<uint32_t>(base) >> 16);
+        for (int i = 0; i < 50; ++i) EXPECT_EQ(leaf.KeyAt(i), keys[i]);
+
+        // Balancing counts full-width keys; the page stores suffixes.
+        EXPECT_EQ(leaf.UsedBytes(), 50 * LeafPage::RecordSize(cell.size()));
+        EXPECT_EQ(leaf.FreeBytes(),
+                  LeafPage::kCapacity - 50 * (LeafPage::kSuffixSize + sizeof(uint16_t) + cell.size()));
+
+        // Probes inside the prefix, next to it and at the ends of the range.
+        std::vector<int> probes = {INT_MIN, INT_MAX, base - 1, base + 65536};
+        for (int p = base; p < base + 51000; p += 250) probes.push_back(p);
+        for (int p : probes) {
+            auto lo = std::lower_bound(keys.begin(), keys.end(), p) - keys.begin();
+            auto hi = std::upper_bound(keys.begin(), keys.end(), p) - keys.begin();
+            EXPECT_EQ(leaf.LowerBound(p), lo) << p;
+            EXPECT_EQ(leaf.UpperBound(p), hi) << p;
+            EXPECT_EQ(leaf.Find(p), lo < hi ? lo : -1) << p;
+        }
+    }
+}
+
+TEST(PageTest, PrefixedLeafWidensAndNarrows) {
+    char raw[PAGE_SIZE];
+    LeafPage::Init(raw);
+    LeafPage leaf(raw);
+    std::string cell = Cell(std::string(20, 'c'));
+    for (int i = 0; i < 10; ++i) leaf.InsertAt(i, i, cell.data());
+    ASSERT_TRUE(leaf.IsPrefixed());
+    size_t free = leaf.FreeBytes();
+
+    // A key outside the prefix rewrites every key at full width.
+    const int outlier = 1 << 20;
+    leaf.InsertAt(10, outlier, Cell("far").data());
+    EXPECT_FALSE(leaf.IsPrefixed());
+    EXPECT_EQ(PageType(raw), PAGE_TYPE_LEAF);
+    EXPECT_EQ(leaf.FreeBytes(), free - 10 * (sizeof(key_t) - LeafPage::kSuffixSize) -
+                                    LeafPage::RecordSize(Cell("far").size()));
+    for (int i = 0; i < 10; ++i) {
+        EXPECT_EQ(leaf.KeyAt(i), i);
+        EXPECT_EQ(leaf.Value(i), std::string(20, 'c'));
+    }
+    EXPECT_EQ(leaf.Find(outlier), 10);
+
+    // Removing it, or truncating it away, re-prefixes the rest.
+    leaf.RemoveAt(10);
+    EXPECT_TRUE(leaf.IsPrefixed());
+    EXPECT_EQ(leaf.FreeBytes(), free);
+    leaf.InsertAt(0, -1, Cell("neg").data());
+    EXPECT_FALSE(leaf.IsPrefixed());
+    leaf.RemoveAt(0);
+    leaf.InsertAt(10, outlier, Cell("far").data());
+    leaf.Truncate(10);
+    EXPECT_TRUE(leaf.IsPrefixed());
+    EXPECT_EQ(leaf.FreeBytes(), free);
+    for (int i = 0; i < 10; ++i) EXPECT_EQ(leaf.Value(i), std::string(20, 'c'));
+
+    // Near full, a key inside the prefix still fits where widening for one
+    // outside it does not.
+    LeafPage::Init(raw);
+    int n = 0;
+    for (; leaf.HasRoom(outlier, -1, cell.size()); ++n) leaf.InsertAt(n, n, cell.data());
+    EXPECT_TRUE(leaf.HasRoom(n, -1, cell.size()));
+    EXPECT_FALSE(leaf.HasRoom(-1, -1, cell.size()));
+}
+
+TEST(PageTest, PrefixedLeafWithCustomComparator) {
+    // Under std::greater the suffixes are not in key order, so search goes
+    // through the comparator on whole keys.
+    char raw[PAGE_SIZE];
+    LeafPage::Init(raw);
+    LeafPage leaf(raw);
+    std::vector<int> keys;
+    for (int i = 0; i < 40; ++i) {
+        keys.push_back((3 << 16) + 60000 - i * 1500);
+        leaf.InsertAt(i, keys.back(), Cell("g").data());
+    }
+    ASSERT_TRUE(leaf.IsPrefixed());
+    std::greater<int> gt;
+    for (int p = (3 << 16) - 10; p < (4 << 16) + 10; p += 97) {
+        auto lo = std::lower_bound(keys.begin(), keys.end(), p, gt) - keys.begin();
+        auto hi = std::upper_bound(keys.begin(), keys.end(), p, gt) - keys.begin();
+        EXPECT_EQ(leaf.LowerBound(p, gt), lo) << p;
+        EXPECT_EQ(leaf.UpperBound(p, gt), hi) << p;
+    }
+    EXPECT_EQ(leaf.Find(keys[17], gt), 17);
+}
+
+TEST(PageTest, LeafCopyAndAppendRecords) {
+    char a_raw[PAGE_SIZE], b_raw[PAGE_SIZE], c_raw[PAGE_SIZE];
+    LeafPage::Init(a_raw);
+    LeafPage::Init(b_raw);
+    LeafPage::Init(c_raw);
+    LeafPage a(a_raw), b(b_raw), c(c_raw);
+    for (int i = 0; i < 20; ++i) {
+        a.InsertAt(0, 20 - i, Cell(std::string(20 - i, 'a')).data());
+    }
+
+    // Packed [key | cell] records, as in a kLeafMerge payload.
+    size_t bytes = a.PackedSize(10, 5);
+    EXPECT_EQ(bytes, 5 * (sizeof(key_t) + LeafPage::kCellHeaderSize) + 11 + 12 + 13 + 14 + 15);
+    std::vector<char> packed(bytes);
+    EXPECT_EQ(a.CopyRecords(10, 5, packed.data()), bytes);
+    int first;
+    std::memcpy(&first, packed.data(), 4);
+    EXPECT_EQ(first, 11);
+    EXPECT_EQ(LeafPage::CellSizeOf(packed.data() + 4), LeafPage::kCellHeaderSize + 11);
+
+    b.AppendRecords(packed.data(), 5);
+    c.AppendFrom(a, 10, 5);
+    ASSERT_EQ(b.NumKeys(), 5);
+    ASSERT_EQ(c.NumKeys(), 5);
+    for (int i = 0; i < 5; ++i) {
+        EXPECT_EQ(b.KeyAt(i), 11 + i);
+        EXPECT_EQ(c.KeyAt(i), 11 + i);
+        EXPECT_EQ(b.Value(i), a.Value(10 + i));
+        EXPECT_EQ(c.Value(i), a.Value(10 + i));
+    }
+    EXPECT_EQ(b.UsedBytes(), c.UsedBytes());
+}
+
+TEST(PageTest, UpgradeFixedLeafToSlotted) {
+    char raw[PAGE_SIZE];
+    FixedLeafPage::Init(raw);
+    FixedLeafPage fixed(raw);
+    for (int i = 0; i < 10; ++i) fixed.InsertAt(i, i, Payload("v" + std::to_string(i)).data());
+    fixed.SetNextLeaf(3 * PAGE_SIZE);
+    SetPageLSN(raw, 12);
+    ASSERT_TRUE(LeafPage::IsLegacy(raw));
+
+    int spilled = 0;
+    LeafPage::UpgradeLegacy(raw, [&](const char*, size_t) { ++spilled; return int64_t{0}; });
+    EXPECT_EQ(spilled, 0);
+    EXPECT_TRUE(PageIsLeaf(raw));
+    EXPECT_FALSE(LeafPage::IsLegacy(raw));
+    LeafPage leaf(raw);
+    EXPECT_TRUE(leaf.IsPrefixed());  // keys 0..9 share the high half 0
+    ASSERT_EQ(leaf.NumKeys(), 10);
+    EXPECT_EQ(leaf.NextLeaf(), 3 * static_cast<int64_t>(PAGE_SIZE));
+    EXPECT_EQ(leaf.PageLSN(), 12u);
+    // Payloads were C strings: the value ends at the first NUL.
+    for (int i = 0; i < 10; ++i) EXPECT_EQ(leaf.Value(i), "v" + std::to_string(i));
+}
+
+TEST(PageTest, UpgradeFullFixedLeafSpillsLongestValues) {
+    // A full leaf of 99-byte values takes a few bytes more than a slotted
+    // page holds.
+    auto value = [](int i) { return std::string(i == 0 ? 98 : 99, static_cast<char>('a' + i % 26)); };
+    char raw[PAGE_SIZE];
+    FixedLeafPage::Init(raw);
+    FixedLeafPage fixed(raw);
+    for (int i = 0; i < FixedLeafPage::kMaxKeys; ++i) fixed.InsertAt(i, i, Payload(value(i)).data());
+
+    std::vector<std::string> spilled;
+    LeafPage::UpgradeLegacy(raw, [&](const char* data, size_t len) {
+        spilled.emplace_back(data, len);
+        return static_cast<int64_t>(spilled.size() * PAGE_SIZE);
+    });
+    // One spilled value is enough: the first of the longest.
+    ASSERT_EQ(spilled.size(), 1u);
+    EXPECT_EQ(spilled[0], value(1));
+    LeafPage leaf(raw);
+    ASSERT_EQ(leaf.NumKeys(), FixedLeafPage::kMaxKeys);
+    for (int i = 0; i < leaf.NumKeys(); ++i) {
+        EXPECT_EQ(leaf.KeyAt(i), i);
+        EXPECT_EQ(leaf.ValueSize(i), value(i).size());
+        EXPECT_EQ(leaf.IsOverflow(i), i == 1);
+        if (i != 1) {
+            EXPECT_EQ(leaf.Value(i), value(i));
+        }
+    }
+    EXPECT_EQ(leaf.OverflowHead(1), static_cast<int64_t>(PAGE_SIZE));
+}
+
+// ============================================================================
+// InternalPage
+// ============================================================================
+
+TEST(PageTest, InternalChildIndexRoutesKeys) {
+    char raw[PAGE_SIZE];
+    InternalPage::Init(raw);
+    InternalPage node(raw);
+    EXPECT_EQ(PageType(raw), PAGE_TYPE_INTERNAL);
+    EXPECT_FALSE(PageIsLeaf(raw));
+
+    // Keys 0, 10, 20, ...: child i holds [10 * (i - 1), 10 * i).
+    node.SetChildAt(0, 1000);
+    for (int i = 0; i < INTERNAL_MAX_KEYS; ++i) node.InsertAt(i, 10 * i, 1001 + i);
+    ASSERT_EQ(node.NumKeys(), INTERNAL_MAX_KEYS);
+
+    EXPECT_EQ(node.ChildIndex(-1), 0);
+    EXPECT_EQ(node.ChildIndex(0), 1);
+    EXPECT_EQ(node.ChildIndex(9), 1);
+    EXPECT_EQ(node.ChildIndex(10), 2);
+    EXPECT_EQ(node.ChildIndex(10 * INTERNAL_MAX_KEYS - 5), INTERNAL_MAX_KEYS);
+    EXPECT_EQ(node.LowerBound(10), 1);
+    EXPECT_EQ(node.LowerBound(11), 2);
+}
+
+TEST(PageTest, InternalInsertAndRemoveShiftBothArrays) {
+    char raw[PAGE_SIZE];
+    InternalPage::Init(raw);
+    InternalPage node(raw);
+    SetPageLSN(raw, 77);
+
+    node.SetChildAt(0, 100);
+    node.InsertAt(0, 20, 120);
+    node.InsertAt(0, 10, 110);
+    node.InsertAt(2, 30, 130);
+    node.InsertAt(2, 25, 125);
+    ASSERT_EQ(node.NumKeys(), 4);
+    std::vector<int>     keys     = {10, 20, 25, 30};
+    std::vector<int64_t> children = {100, 110, 120, 125, 130};
+    for (int i = 0; i < 4; ++i) EXPECT_EQ(node.KeyAt(i), keys[i]);
+    for (int i = 0; i <= 4; ++i) EXPECT_EQ(node.ChildAt(i), children[i]);
+
+    node.RemoveAt(1);  // key 20 and child 120
+    ASSERT_EQ(node.NumKeys(), 3);
+    EXPECT_EQ(node.KeyAt(0), 10);
+    EXPECT_EQ(node.KeyAt(1), 25);
+    EXPECT_EQ(node.KeyAt(2), 30);
+    EXPECT_EQ(node.ChildAt(0), 100);
+    EXPECT_EQ(node.ChildAt(1), 110);
+    EXPECT_EQ(node.ChildAt(2), 125);
+    EXPECT_EQ(node.ChildAt(3), 130);
+    EXPECT_EQ(node.PageLSN(), 77u);
+}
+
+TEST(PageTest, UpgradeLegacyInternalPage) {
+    std::vector<int>     keys;
+    std::vector<int64_t> children = {4096};
+    for (int i = 0; i < kOldInternalMaxKeys; ++i) {
+        keys.push_back(3 * i + 1);
+        children.push_back(4096 * (i + 2));
+    }
+
+    char raw[PAGE_SIZE];
+    WriteLegacyInternal(raw, keys, children);
+    SetPageLSN(raw, 1234);
+    ASSERT_TRUE(InternalPage::IsLegacy(raw));
+    EXPECT_FALSE(PageIsLeaf(raw));
+
+    InternalPage::UpgradeLegacy(raw);
+    EXPECT_FALSE(InternalPage::IsLegacy(raw));
+    EXPECT_EQ(PageType(raw), PAGE_TYPE_INTERNAL);
+
+    InternalPage node(raw);
+    ASSERT_EQ(node.NumKeys(), kOldInternalMaxKeys);
+    for (int i = 0; i < kOldInternalMaxKeys; ++i) EXPECT_EQ(node.KeyAt(i), keys[i]);
+    for (int i = 0; i <= kOldInternalMaxKeys; ++i) EXPECT_EQ(node.ChildAt(i), children[i]);
+    EXPECT_EQ(node.PageLSN(), 1234u);
+    EXPECT_EQ(node.ChildIndex(4), 2);
+
+    // An empty legacy page (a root that lost its last key) converts too.
+    WriteLegacyInternal(raw, {}, {8192});
+    InternalPage::UpgradeLegacy(raw);
+    EXPECT_EQ(node.NumKeys(), 0);
+    EXPECT_EQ(node.ChildAt(0), 8192);
+}
+
+TEST(PageTest, UpgradeV2InternalPage) {
+    // Version 1 and 2 files: keys at 8, children at 8 + 100 * 4, type 2.
+    char raw[PAGE_SIZE];
+    std::memset(raw, 0, PAGE_SIZE);
+    int n = kOldInternalMaxKeys, type = PAGE_TYPE_V2_INTERNAL;
+    std::memcpy(raw, &n, 4);
+    std::memcpy(raw + 4, &type, 4);
+    for (int i = 0; i <= n; ++i) {
+        int     key   = 5 * i;
+        int64_t child = 4096 * (i + 1);
+        if (i < n) std::memcpy(raw + 8 + i * 4, &key, 4);
+        std::memcpy(raw + 8 + kOldInternalMaxKeys * 4 + i * 8, &child, 8);
+    }
+    SetPageLSN(raw, 55);
+    ASSERT_TRUE(InternalPage::IsLegacy(raw));
+
+    InternalPage::UpgradeLegacy(raw);
+    EXPECT_FALSE(InternalPage::IsLegacy(raw));
+    EXPECT_EQ(PageType(raw), PAGE_TYPE_INTERNAL);
+    InternalPage node(raw);
+    ASSERT_EQ(node.NumKeys(), n);
+    for (int i = 0; i < n; ++i) EXPECT_EQ(node.KeyAt(i), 5 * i);
+    for (int i = 0; i <= n; ++i) EXPECT_EQ(node.ChildAt(i), 4096 * (i + 1));
+    EXPECT_EQ(node.PageLSN(), 55u);
+
+    // Room for the keys the old layout could not hold.
+    for (int i = n; i < INTERNAL_MAX_KEYS; ++i) node.InsertAt(i, 5 * i, 4096 * (i + 2));
+    EXPECT_EQ(node.ChildIndex(5 * n), n + 1);
+    EXPECT_EQ(node.ChildAt(n), 4096 * (n + 1));
+}
+
+TEST(PageTest, UpgradeV2Leaf) {
+    // Version 2 files: keys at 16, slots at 16 + 35 * 4, payloads at 192,
+    // type 3.  Slots out of order, as deletes and inserts leave them.
+    char raw[PAGE_SIZE];
+    std::memset(raw, 0, PAGE_SIZE);
+    int n = 20, type = PAGE_TYPE_V2_LEAF;
+    int64_t next = 9 * PAGE_SIZE;
+    std::memcpy(raw, &n, 4);
+    std::memcpy(raw + 4, &type, 4);
+    std::memcpy(raw + 8, &next, 8);
+    for (int i = 0; i < n; ++i) {
+        int key  = 3 * i;
+        int slot = n - 1 - i;
+        std::memcpy(raw + 16 + i * 4, &key, 4);
+        raw[16 + kOldLeafMaxKeys * 4 + i] = static_cast<char>(slot);
+        std::string data = Payload("p" + std::to_string(key));
+        std::memcpy(raw + 192 + slot * DATA_SIZE, data.data(), DATA_SIZE);
+    }
+    SetPageLSN(raw, 66);
+    ASSERT_TRUE(FixedLeafPage::IsLegacy(raw));
+    EXPECT_TRUE(PageIsLeaf(raw));
+
+    FixedLeafPage::UpgradeLegacy(raw);
+    EXPECT_FALSE(FixedLeafPage::IsLegacy(raw));
+    FixedLeafPage leaf(raw);
+    ASSERT_EQ(leaf.NumKeys(), n);
+    EXPECT_EQ(leaf.NextLeaf(), next);
+    EXPECT_EQ(leaf.PageLSN(), 66u);
+    for (int i = 0; i < n; ++i) {
+        EXPECT_EQ(leaf.KeyAt(i), 3 * i);
+        EXPECT_EQ(DataOf(leaf, i), Payload("p" + std::to_string(3 * i)));
+    }
+}
+
+TEST(PageTest, Int64Pages) {
+    using Leaf64     = BasicLeafPage<int64_t>;
+    using Internal64 = BasicInternalPage<int64_t>;
+    static_assert(Leaf64::kEntrySize == LeafPage::kEntrySize + 4);
+    static_assert(Internal64::kMaxKeys == InternalMaxKeys(sizeof(int64_t)));
+    static_assert(Internal64::kMaxKeys < INTERNAL_MAX_KEYS);
+
+    // Keys that only differ above 32 bits.
+    auto key = [](int i) { return (int64_t{i} << 33) - (int64_t{1} << 40); };
+
+    char raw[PAGE_SIZE];
+    Leaf64::Init(raw);
+    Leaf64 leaf(raw);
+    std::string cell = Cell("x");
+    int n = 0;
+    for (; leaf.HasRoom(key(n), -1, cell.size()); ++n) leaf.InsertAt(n, key(n), cell.data());
+    EXPECT_EQ(n, static_cast<int>(Leaf64::kCapacity / Leaf64::RecordSize(cell.size())));
+    EXPECT_FALSE(Leaf64::IsLegacy(raw));
+    EXPECT_EQ(leaf.KeyAt(n - 1), key(n - 1));
+    EXPECT_EQ(leaf.Find(key(7)), 7);
+    EXPECT_EQ(leaf.Find(key(7) + 1), -1);
+    EXPECT_EQ(leaf.LowerBound(key(7) + 1), 8);
+    EXPECT_EQ(leaf.UpperBound(key(7)), 8);
+    EXPECT_FALSE(leaf.IsPrefixed());
+
+    // Keys that share their high 32 bits keep only the low 32.
+    static_assert(Leaf64::kSuffixSize == 4);
+    auto near = [](int i) { return -5 * (int64_t{1} << 32) + int64_t{i} * 40000000; };
+    Leaf64::Init(raw);
+    for (int i = 0; i < 100; ++i) leaf.InsertAt(i, near(i), cell.data());
+    ASSERT_TRUE(leaf.IsPrefixed());
+    EXPECT_EQ(leaf.FreeBytes(), Leaf64::kCapacity - 100 * (4 + sizeof(uint16_t) + cell.size()));
+    for (int i = 0; i < 100; ++i) EXPECT_EQ(leaf.KeyAt(i), near(i));
+    EXPECT_EQ(leaf.Find(near(63)), 63);
+    EXPECT_EQ(leaf.LowerBound(near(63) + 1), 64);
+    EXPECT_EQ(leaf.LowerBound(near(0) - 1), 0);
+    EXPECT_EQ(leaf.LowerBound(int64_t{0}), 100);
+
+    Internal64::Init(raw);
+    Internal64 node(raw);
+    node.SetChildAt(0, 4096);
+    for (int i = 0; i < Internal64::kMaxKeys; ++i) node.InsertAt(i, key(i), 4096 * (i + 2));
+    ASSERT_EQ(node.NumKeys(), Internal64::kMaxKeys);
+    EXPECT_EQ(node.ChildIndex(key(0) - 1), 0);
+    EXPECT_EQ(node.ChildIndex(key(100)), 101);
+    EXPECT_EQ(node.ChildIndex(key(100) - 1), 100);
+    EXPECT_EQ(node.ChildAt(Internal64::kMaxKeys), 4096 * (Internal64::kMaxKeys + 1));
+}
+
+// ============================================================================
+// OverflowPage
+// ============================================================================
+
+TEST(PageTest, OverflowPageHoldsPartOfAValue) {
+    char raw[PAGE_SIZE];
+    OverflowPage::Init(raw);
+    OverflowPage page(raw);
+    EXPECT_EQ(PageType(raw), PAGE_TYPE_OVERFLOW);
+    EXPECT_FALSE(PageIsLeaf(raw));
+    EXPECT_EQ(page.Length(), 0u);
+    EXPECT_EQ(page.NextPage(), INVALID_PAGE_ID);
+
+    std::string data(OverflowPage::kCapacity, 'o');
+    data.front() = '<';
+    data.back()  = '>';
+    SetPageLSN(raw, 5);
+    page.SetData(data.data(), data.size());
+    page.SetNextPage(2 * PAGE_SIZE);
+    EXPECT_EQ(page.Length(), OverflowPage::kCapacity);
+    EXPECT_EQ(std::string(page.Data(), page.Length()), data);
+    EXPECT_EQ(page.NextPage(), 2 * static_cast<int64_t>(PAGE_SIZE));
+    EXPECT_EQ(PageLSN(raw), 5u);  // the data stops short of the page LSN
+}
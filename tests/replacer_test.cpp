@@ -0,0 +1,177 @@
+/// @file replacer_test.cpp
+/// @brief Google Test suite for the LRU, CLOCK and LRU-K replacers.
+
+#include <gtest/gtest.h>
+#include "bptree/replacer.h"
+
+#include <algorithm>
+#include <set>
+#include <vector>
+
+using namespace bptree;
+
+namespace {
+auto AnyFrame = [](int) { return true; };
+}  // namespace
+
+TEST(ReplacerTest, FactoryAndNames) {
+    EXPECT_NE(dynamic_cast<LruReplacer*>(MakeReplacer(ReplacementPolicy::kLRU, 4).get()), nullptr);
+    EXPECT_NE(dynamic_cast<ClockReplacer*>(MakeReplacer(ReplacementPolicy::kClock, 4).get()), nullptr);
+    EXPECT_NE(dynamic_cast<LruKReplacer*>(MakeReplacer(ReplacementPolicy::kLRUK, 4).get()), nullptr);
+    EXPECT_STREQ(ReplacementPolicyName(ReplacementPolicy::kClock), "CLOCK");
+}
+
+TEST(ReplacerTest, LruEvictsOldestUse) {
+    LruReplacer r(3);
+    r.RecordLoad(0);
+    r.RecordLoad(1);
+    r.RecordLoad(2);
+    r.RecordAccess(0);  // frame 0 becomes the most recent
+
+    EXPECT_EQ(r.Victim(AnyFrame), 1);
+    EXPECT_EQ(r.Victim([](int f) { return f != 1; }), 2);
+}
+
+TEST(ReplacerTest, LruMissDoesNotWalkTheShard) {
+    // Every frame referenced, then a run of evict-and-reload cycles: the
+    // first victim search moves each referenced frame back once, the rest
+    // find the oldest frame at the head of the list.
+    constexpr int kFrames = 4096;
+    LruReplacer r(kFrames);
+    for (int f = 0; f < kFrames; ++f) r.RecordLoad(f);
+    for (int f = 0; f < kFrames; ++f) r.RecordAccess(f);
+
+    size_t probes = 0;
+    auto counting = [&](int) { ++probes; return true; };
+    for (int i = 0; i < kFrames; ++i) {
+        int v = r.Victim(counting);
+        ASSERT_NE(v, -1);
+        r.RecordLoad(v);
+    }
+    EXPECT_LE(probes, 2u * kFrames);
+}
+
+TEST(ReplacerTest, ClockGivesSecondChance) {
+    ClockReplacer r(3);
+    for (int f = 0; f < 3; ++f) r.RecordLoad(f);
+
+    // All bits set: the first sweep clears them, then frame 0 goes.
+    EXPECT_EQ(r.Victim(AnyFrame), 0);
+
+    // Frame 1 is used again and survives the next sweep.
+    r.RecordAccess(1);
+    EXPECT_EQ(r.Victim(AnyFrame), 2);
+}
+
+TEST(ReplacerTest, ClockSkipsPinnedFrames) {
+    ClockReplacer r(130);  // spans three bit words
+    for (int f = 0; f < 130; ++f) r.RecordLoad(f);
+
+    EXPECT_EQ(r.Victim([](int f) { return f == 129; }), 129);
+    EXPECT_EQ(r.Victim([](int) { return false; }), -1);
+}
+
+TEST(ReplacerTest, LruKPrefersFramesUsedOnce) {
+    LruKReplacer r(4, 2);
+
+    // Frames 0 and 1 are hot: used again after later loads.
+    r.RecordLoad(0);
+    r.RecordLoad(1);
+    r.RecordAccess(0);  // same tick as the load of 1 -> counts
+    r.RecordLoad(2);
+    r.RecordAccess(1);
+
+    // Frame 3 is loaded by a "scan" and touched only within its own tick.
+    r.RecordLoad(3);
+    r.RecordAccess(3);
+
+    std::set<int> first_two;
+    int v1 = r.Victim(AnyFrame);
+    first_two.insert(v1);
+    first_two.insert(r.Victim([&](int f) { return f != v1; }));
+    EXPECT_EQ(first_two, (std::set<int>{2, 3}));
+}
+
+TEST(ReplacerTest, LruKOrdersByKthUse) {
+    LruKReplacer r(3, 2);
+    r.RecordLoad(0);
+    r.RecordLoad(1);
+    r.RecordLoad(2);
+    r.RecordAccess(0);  // second use of 0 at tick 3, first at tick 1
+    r.RecordAccess(1);  // second use of 1 at tick 3, first at tick 2
+    r.RecordAccess(2);  // same tick as its load: still one use
+
+    EXPECT_EQ(r.Victim(AnyFrame), 2);
+    EXPECT_EQ(r.Victim([](int f) { return f != 2; }), 0);
+}
+
+TEST(ReplacerTest, LruKMissProbesOnlyTheVictim) {
+    // Every frame but the last gets its second use after its heap entry
+    // was pushed; the first victim search refreshes those entries, and no
+    // search asks about a frame it does not return.
+    constexpr int kFrames = 4096;
+    LruKReplacer r(kFrames, 2);
+    for (int f = 0; f < kFrames; ++f) r.RecordLoad(f);
+    for (int f = 0; f < kFrames; ++f) r.RecordAccess(f);  // last: same tick
+
+    size_t probes = 0;
+    auto counting = [&](int) { ++probes; return true; };
+    ASSERT_EQ(r.Victim(counting), kFrames - 1);
+    r.Remove(kFrames - 1);
+    for (int f = 0; f < kFrames - 1; ++f) {
+        ASSERT_EQ(r.Victim(counting), f);
+        r.Remove(f);
+    }
+    EXPECT_EQ(probes, static_cast<size_t>(kFrames));
+    EXPECT_EQ(r.Victim(counting), -1);
+}
+
+TEST(ReplacerTest, RemoveForgetsTheFrame) {
+    // A removed frame is on the pool's free list: no longer a candidate,
+    // however hot it was.
+    for (auto policy : {ReplacementPolicy::kLRU, ReplacementPolicy::kLRUK}) {
+        auto r = MakeReplacer(policy, 2);
+        r->RecordLoad(0);
+        r->RecordLoad(1);
+        r->RecordAccess(0);
+        r->RecordLoad(1);
+        r->RecordAccess(0);
+        r->Remove(0);
+
+        EXPECT_EQ(r->Victim(AnyFrame), 1) << ReplacementPolicyName(policy);
+        EXPECT_EQ(r->Coldest(2), std::vector<int>{1}) << ReplacementPolicyName(policy);
+        r->Remove(1);
+        EXPECT_EQ(r->Victim(AnyFrame), -1) << ReplacementPolicyName(policy);
+    }
+}
+
+TEST(ReplacerTest, ColdestFollowsVictimOrder) {
+    // Evicting one frame after another yields the order Coldest reports.
+    for (auto policy : {ReplacementPolicy::kLRU, ReplacementPolicy::kClock,
+                        ReplacementPolicy::kLRUK}) {
+        auto r = MakeReplacer(policy, 6);
+        for (int f = 0; f < 6; ++f) r->RecordLoad(f);
+        r->RecordAccess(4);
+        r->RecordAccess(1);
+        r->RecordLoad(5);
+
+        std::vector<int> coldest = r->Coldest(3);
+        ASSERT_EQ(coldest.size(), 3u) << ReplacementPolicyName(policy);
+        EXPECT_EQ(r->Coldest(10).size(), 6u);
+
+        std::vector<int> evicted;
+        while (evicted.size() < 3) {
+            int v = r->Victim([&](int f) {
+                return std::find(evicted.begin(), evicted.end(), f) == evicted.end();
+            });
+            evicted.push_back(v);
+        }
+        if (policy == ReplacementPolicy::kClock) {
+            // Victim clears reference bits as it sweeps; only the set is stable.
+            EXPECT_EQ(std::set<int>(coldest.begin(), coldest.end()),
+                      std::set<int>(evicted.begin(), evicted.end()));
+        } else {
+            EXPECT_EQ(coldest, evicted) << ReplacementPolicyName(policy);
+        }
+    }
+}
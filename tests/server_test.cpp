@@ -0,0 +1,353 @@
+/// @file server_test.cpp
+/// @brief Google Test suite for the network server, its client and the
+///        wire protocol.
+
+#include <gtest/gtest.h>
+#include "bptree/bplus_tree.h"
+#include "bptree/client.h"
+#include "bptree/protocol.h"
+#include "bptree/server.h"
+
+#include <cstdio>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+using namespace bptree;
+
+namespace {
+
+class ServerTest : public ::testing::Test {
+protected:
+    static constexpr const char* kTestFile = "test_server.idx";
+
+    void SetUp() override {
+        std::remove(kTestFile);
+        std::remove((std::string(kTestFile) + ".wal").c_str());
+    }
+    void TearDown() override {
+        server_.reset();
+        tree_.reset();
+        std::remove(kTestFile);
+        std::remove((std::string(kTestFile) + ".wal").c_str());
+    }
+
+    /// Start a server on a free port over a fresh tree.
+    void StartServer(ServerOptions opts = {}) {
+        tree_ = std::make_unique<BPlusTree>(kTestFile);
+        opts.port = 0;
+        if (opts.threads == 0) opts.threads = 2;
+        server_ = std::make_unique<Server>(*tree_, opts);
+        ASSERT_TRUE(server_->Start().ok());
+    }
+
+    void Connect(Client& client) {
+        ASSERT_TRUE(client.Connect("127.0.0.1", server_->Port()).ok());
+    }
+
+    std::unique_ptr<BPlusTree> tree_;
+    std::unique_ptr<Server>    server_;
+};
+
+std::string Value(int i) { return "value-" + std::to_string(i); }
+
+}  // namespace
+
+TEST(ProtocolTest, FramesAndStatusesRoundTrip) {
+    std::string buf;
+    FrameWriter w(buf);
+    size_t at = w.Begin(WireOp::kDelete, 77);
+    w.Key(-5);
+    w.Bytes(std::string("a\0b", 3));
+    w.PutStatus(Status::OK());
+    w.PutStatus(Status::NotFound("ignored"));
+    w.PutStatus(Status::IOError("disk on fire"));
+    w.End(at);
+
+    ASSERT_GE(buf.size(), kFrameHeaderSize);
+    FrameHeader h = DecodeFrameHeader(buf.data());
+    EXPECT_EQ(h.op, WireOp::kDelete);
+    EXPECT_EQ(h.id, 77u);
+    ASSERT_EQ(h.length, buf.size() - kFrameHeaderSize);
+
+    FrameReader r(std::string_view(buf).substr(kFrameHeaderSize));
+    key_t key;
+    std::string_view bytes;
+    Status ok, missing, io;
+    ASSERT_TRUE(r.Key(key) && r.Bytes(bytes));
+    ASSERT_TRUE(r.GetStatus(ok) && r.GetStatus(missing) && r.GetStatus(io));
+    EXPECT_TRUE(r.Done());
+    EXPECT_EQ(key, -5);
+    EXPECT_EQ(bytes, std::string_view("a\0b", 3));
+    EXPECT_TRUE(ok.ok());
+    EXPECT_TRUE(missing.IsNotFound());
+    EXPECT_EQ(io.ToString(), "IOError: disk on fire");
+
+    // A truncated body fails and stays failed.
+    FrameReader shortr(std::string_view(buf).substr(kFrameHeaderSize, 6));
+    ASSERT_TRUE(shortr.Key(key));
+    EXPECT_FALSE(shortr.Bytes(bytes));
+    EXPECT_FALSE(shortr.Key(key));
+    EXPECT_FALSE(shortr.Done());
+}
+
+TEST_F(ServerTest, PutGetDelete) {
+    StartServer();
+    Client client;
+    Connect(client);
+
+    std::string v;
+    EXPECT_TRUE(client.Get(1, v).IsNotFound());
+    ASSERT_TRUE(client.Put(1, "one").ok());
+    ASSERT_TRUE(client.Put(2, std::string(10000, 'x')).ok());  // overflow value
+    ASSERT_TRUE(client.Get(1, v).ok());
+    EXPECT_EQ(v, "one");
+    ASSERT_TRUE(client.Get(2, v).ok());
+    EXPECT_EQ(v, std::string(10000, 'x'));
+    EXPECT_TRUE(client.Delete(1).ok());
+    EXPECT_TRUE(client.Delete(1).IsNotFound());
+    EXPECT_TRUE(client.Get(1, v).IsNotFound());
+
+    // The tree itself sees the writes.
+    ASSERT_TRUE(tree_->Search(2, v).ok());
+    EXPECT_TRUE(tree_->Search(1, v).IsNotFound());
+}
+
+TEST_F(ServerTest, BatchesMapOntoTheTree) {
+    StartServer();
+    Client client;
+    Connect(client);
+
+    std::vector<std::pair<key_t, std::string>> records;
+    for (int i = 0; i < 5000; i += 2) records.emplace_back(i, Value(i));
+    ASSERT_TRUE(client.PutBatch(records).ok());
+
+    std::vector<key_t> keys;
+    for (int i = 4999; i >= 0; --i) keys.push_back(i);
+    std::vector<std::string> values;
+    std::vector<Status> statuses;
+    ASSERT_TRUE(client.MultiGet(keys, values, statuses).ok());
+    ASSERT_EQ(statuses.size(), keys.size());
+    for (size_t i = 0; i < keys.size(); ++i) {
+        ASSERT_EQ(statuses[i].ok(), keys[i] % 2 == 0) << keys[i];
+        if (statuses[i].ok()) {
+            EXPECT_EQ(values[i], Value(keys[i]));
+        }
+    }
+}
+
+TEST_F(ServerTest, PipelinedRequestsAnswerInOrder) {
+    StartServer();
+    Client client;
+    Connect(client);
+
+    // Many small requests in one flush: PUT k, GET k, DEL k-1, ...
+    std::vector<uint32_t> ids;
+    for (int i = 0; i < 2000; ++i) {
+        ids.push_back(client.QueuePut({{i, Value(i)}}));
+        ids.push_back(client.QueueGet({i}));
+        if (i > 0) ids.push_back(client.QueueDelete({i - 1}));
+    }
+    ids.push_back(client.QueueScan(0, 5000));
+    ASSERT_TRUE(client.Flush().ok());
+
+    size_t next = 0;
+    for (int i = 0; i < 2000; ++i) {
+        ClientResponse r;
+        ASSERT_TRUE(client.Receive(r).ok());
+        EXPECT_EQ(r.op, WireOp::kPut);
+        EXPECT_EQ(r.id, ids[next++]);
+        EXPECT_TRUE(r.status.ok());
+
+        ASSERT_TRUE(client.Receive(r).ok());
+        EXPECT_EQ(r.op, WireOp::kGet);
+        EXPECT_EQ(r.id, ids[next++]);
+        ASSERT_EQ(r.statuses.size(), 1u);
+        ASSERT_TRUE(r.statuses[0].ok());
+        EXPECT_EQ(r.values[0], Value(i));
+
+        if (i > 0) {
+            ASSERT_TRUE(client.Receive(r).ok());
+            EXPECT_EQ(r.op, WireOp::kDelete);
+            EXPECT_EQ(r.id, ids[next++]);
+            EXPECT_TRUE(r.statuses[0].ok());
+        }
+    }
+
+    // Only the last key is left.
+    std::vector<std::pair<key_t, std::string>> seen;
+    ClientResponse r;
+    do {
+        ASSERT_TRUE(client.Receive(r).ok());
+        EXPECT_EQ(r.id, ids.back());
+        seen.insert(seen.end(), r.records.begin(), r.records.end());
+    } while (r.op == WireOp::kScan);
+    EXPECT_EQ(r.op, WireOp::kScanEnd);
+    EXPECT_TRUE(r.status.ok());
+    ASSERT_EQ(seen.size(), 1u);
+    EXPECT_EQ(seen[0].first, 1999);
+}
+
+TEST_F(ServerTest, ScansStreamInChunks) {
+    ServerOptions opts;
+    opts.scan_chunk_bytes  = 1024;      // many frames
+    opts.output_high_water = 16 << 10;  // and backpressure within one scan
+    StartServer(opts);
+
+    constexpr int kKeys = 20000;
+    std::vector<std::pair<key_t, std::string>> records;
+    for (int i = 0; i < kKeys; ++i) records.emplace_back(i, Value(i));
+    ASSERT_TRUE(tree_->BulkLoad(records.begin(), records.end()).ok());
+
+    Client client;
+    Connect(client);
+    int expect = 0;
+    ASSERT_TRUE(client.Scan(0, kKeys, [&](key_t k, std::string_view v) {
+        EXPECT_EQ(k, expect);
+        EXPECT_EQ(v, Value(expect));
+        ++expect;
+        return true;
+    }).ok());
+    EXPECT_EQ(expect, kKeys);
+
+    // Bounds, limits and an early stop that still drains the stream.
+    std::vector<key_t> keys;
+    ASSERT_TRUE(client.Scan(100, 199, [&](key_t k, std::string_view) {
+        keys.push_back(k);
+        return true;
+    }, 10).ok());
+    ASSERT_EQ(keys.size(), 10u);
+    EXPECT_EQ(keys.front(), 100);
+    EXPECT_EQ(keys.back(), 109);
+
+    int visited = 0;
+    ASSERT_TRUE(client.Scan(0, kKeys, [&](key_t, std::string_view) {
+        return ++visited < 5;
+    }).ok());
+    EXPECT_EQ(visited, 5);
+    EXPECT_TRUE(client.Scan(10, 5, [](key_t, std::string_view) { return true; }).IsInvalidArg());
+
+    // The connection is still in step.
+    std::string v;
+    ASSERT_TRUE(client.Get(kKeys - 1, v).ok());
+    EXPECT_EQ(v, Value(kKeys - 1));
+}
+
+TEST_F(ServerTest, WritersProceedWhileAScanIsBackedUp) {
+    ServerOptions opts;
+    opts.threads           = 1;  // the scan and the writer share a loop
+    opts.scan_chunk_bytes  = 512;
+    opts.output_high_water = 4096;
+    StartServer(opts);
+    // Far more than the socket buffers hold.
+    std::vector<std::pair<key_t, std::string>> records;
+    for (int i = 0; i < 50000; ++i) records.emplace_back(i, std::string(200, 'v'));
+    ASSERT_TRUE(tree_->BulkLoad(records.begin(), records.end()).ok());
+
+    // Start a scan and do not read it: the loop must not sit on a latch.
+    Client scanner;
+    Connect(scanner);
+    scanner.QueueScan(0, 50000);
+    ASSERT_TRUE(scanner.Flush().ok());
+
+    Client writer;
+    Connect(writer);
+    for (int i = 0; i < 50000; i += 500) ASSERT_TRUE(writer.Put(i, "new").ok());
+
+    size_t records_seen = 0;
+    ClientResponse r;
+    do {
+        ASSERT_TRUE(scanner.Receive(r).ok());
+        records_seen += r.records.size();
+    } while (r.op == WireOp::kScan);
+    EXPECT_TRUE(r.status.ok());
+    EXPECT_EQ(records_seen, 50000u);
+}
+
+TEST_F(ServerTest, ConcurrentClients) {
+    StartServer();
+    constexpr int kThreads = 4;
+    constexpr int kPerThread = 2000;
+    std::vector<std::thread> threads;
+    for (int t = 0; t < kThreads; ++t) {
+        threads.emplace_back([&, t] {
+            Client client;
+            ASSERT_TRUE(client.Connect("127.0.0.1", server_->Port()).ok());
+            for (int i = 0; i < kPerThread; ++i) {
+                int key = t * kPerThread + i;
+                ASSERT_TRUE(client.Put(key, Value(key)).ok());
+            }
+            std::string v;
+            for (int i = 0; i < kPerThread; i += 7) {
+                int key = t * kPerThread + i;
+                ASSERT_TRUE(client.Get(key, v).ok());
+                ASSERT_EQ(v, Value(key));
+            }
+        });
+    }
+    for (auto& t : threads) t.join();
+
+    std::vector<std::pair<key_t, std::string>> all;
+    ASSERT_TRUE(tree_->RangeQuery(0, kThreads * kPerThread, all).ok());
+    EXPECT_EQ(all.size(), static_cast<size_t>(kThreads * kPerThread));
+    ServerStats st = server_->Stats();
+    EXPECT_EQ(st.accepted, static_cast<size_t>(kThreads));
+    EXPECT_GE(st.requests, static_cast<size_t>(kThreads * kPerThread));
+}
+
+TEST_F(ServerTest, MalformedRequestClosesTheConnection) {
+    StartServer();
+
+    // A GET whose count does not match its body, sent over a raw socket.
+    int fd = ::socket(AF_INET, SOCK_STREAM, 0);
+    ASSERT_GE(fd, 0);
+    sockaddr_in addr{};
+    addr.sin_family = AF_INET;
+    addr.sin_port   = htons(server_->Port());
+    ::inet_pton(AF_INET, "127.0.0.1", &addr.sin_addr);
+    ASSERT_EQ(::connect(fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)), 0);
+    std::string frame;
+    FrameWriter w(frame);
+    size_t at = w.Begin(WireOp::kGet, 9);
+    w.U32(3);
+    w.Key(1);
+    w.End(at);
+    ASSERT_EQ(::send(fd, frame.data(), frame.size(), 0), static_cast<ssize_t>(frame.size()));
+
+    std::string in;
+    char buf[256];
+    ssize_t n;
+    while ((n = ::recv(fd, buf, sizeof(buf), 0)) > 0) in.append(buf, static_cast<size_t>(n));
+    EXPECT_EQ(n, 0);  // closed by the server
+    ::close(fd);
+    ASSERT_GE(in.size(), kFrameHeaderSize);
+    FrameHeader h = DecodeFrameHeader(in.data());
+    EXPECT_EQ(h.op, WireOp::kError);
+    EXPECT_EQ(h.id, 9u);
+    Status st;
+    FrameReader r(std::string_view(in).substr(kFrameHeaderSize));
+    ASSERT_TRUE(r.GetStatus(st));
+    EXPECT_TRUE(st.IsInvalidArg());
+
+    // Other clients are unaffected.
+    Client client;
+    Connect(client);
+    EXPECT_TRUE(client.Put(1, "x").ok());
+}
+
+TEST_F(ServerTest, StopClosesClients) {
+    StartServer();
+    Client client;
+    Connect(client);
+    ASSERT_TRUE(client.Put(1, "x").ok());
+    server_->Stop();
+    std::string v;
+    EXPECT_FALSE(client.Get(1, v).ok());
+    EXPECT_FALSE(client.Connected());
+    EXPECT_EQ(server_->Stats().connections, 0u);
+}
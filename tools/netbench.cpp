@@ -0,0 +1,290 @@
+/// @file netbench.cpp
+/// @brief Wire-level throughput of the network server against the tree.
+///
+/// Bulk loads `--records` keys, measures point lookups, batched lookups,
+/// batched upserts and a full scan in-process, then serves the same tree
+/// from an in-process `Server` on the loopback interface and runs the same
+/// operations through a `Client`: one round trip per lookup, `--depth`
+/// lookups pipelined, `--batch` keys per request, and a streamed scan.
+/// Each wire number is printed with its ratio to the in-process one.
+///
+/// The WAL is off by default so that the comparison is of the request
+/// path, not of fsync.
+///
+/// @code
+///   ./build/tools/netbench --records=1000000 --threads=2 --depth=64
+/// @endcode
+
+#include "bptree/bplus_tree.h"
+#include "bptree/client.h"
+#include "bptree/server.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <random>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+using namespace bptree;
+using Clock = std::chrono::steady_clock;
+
+namespace {
+
+// ---------------------------------------------------------------------------
+// Configuration
+// ---------------------------------------------------------------------------
+
+struct Config {
+    uint64_t    records    = 200'000;
+    uint64_t    operations = 200'000;
+    size_t      batch      = 100;
+    size_t      depth      = 64;
+    unsigned    threads    = 2;       // server event loops
+    size_t      pool_size  = DEFAULT_POOL_SIZE;
+    size_t      value_size = 100;
+    std::string wal        = "off";   // off | sync | group
+    unsigned    seed       = 1;
+    std::string file       = "netbench.idx";
+};
+
+void Usage() {
+    std::cerr <<
+        "usage: netbench [--records=N] [--operations=N] [--batch=N] [--depth=N]\n"
+        "                [--threads=N] [--pool=FRAMES] [--value-size=BYTES]\n"
+        "                [--wal=off|sync|group] [--seed=N] [--file=PATH]\n";
+}
+
+/// Parse `--name=value` flags into @p c.  @return false on a bad flag.
+bool ParseArgs(int argc, char** argv, Config& c) {
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        size_t eq = arg.find('=');
+        std::string name  = arg.substr(0, eq);
+        std::string value = eq == std::string::npos ? "" : arg.substr(eq + 1);
+        auto number = [&] { return std::strtoull(value.c_str(), nullptr, 10); };
+
+        if (name == "--records")           { c.records = number();
+        } else if (name == "--operations") { c.operations = number();
+        } else if (name == "--batch")      { c.batch = number();
+        } else if (name == "--depth")      { c.depth = number();
+        } else if (name == "--threads")    { c.threads = static_cast<unsigned>(number());
+        } else if (name == "--pool")       { c.pool_size = number();
+        } else if (name == "--value-size") { c.value_size = number();
+        } else if (name == "--wal") {
+            if (value != "off" && value != "sync" && value != "group") return false;
+            c.wal = value;
+        } else if (name == "--seed")       { c.seed = static_cast<unsigned>(number());
+        } else if (name == "--file")       { c.file = value;
+        } else {
+            return false;
+        }
+    }
+    return c.records > 0 && c.operations > 0 && c.batch > 0 && c.depth > 0 &&
+           c.threads > 0 && !c.file.empty();
+}
+
+void RemoveFiles(const std::string& file) {
+    std::remove(file.c_str());
+    std::remove((file + ".wal").c_str());
+}
+
+double Seconds(Clock::time_point start) {
+    return std::chrono::duration<double>(Clock::now() - start).count();
+}
+
+/// Die with @p what if @p st failed: a benchmark of errors is meaningless.
+void Check(const Status& st, const char* what) {
+    if (st.ok()) return;
+    std::cerr << "netbench: " << what << ": " << st.ToString() << "\n";
+    std::exit(1);
+}
+
+void Report(const char* name, double rate, const char* unit, double baseline = 0) {
+    if (baseline > 0) {
+        std::printf("  %-30s %12.0f %-9s (%5.1f%% of in-process)\n",
+                    name, rate, unit, 100.0 * rate / baseline);
+    } else {
+        std::printf("  %-30s %12.0f %s\n", name, rate, unit);
+    }
+}
+
+// ---------------------------------------------------------------------------
+// Workload
+// ---------------------------------------------------------------------------
+
+/// Loaded keys are 0, 2, 4, ...; upserts overwrite them.
+struct Keys {
+    explicit Keys(const Config& c) : records(c.records), rng(c.seed) {}
+
+    key_t Next() { return static_cast<key_t>(rng() % records) * 2; }
+
+    std::vector<key_t> Batch(size_t n) {
+        std::vector<key_t> keys(n);
+        for (auto& k : keys) k = Next();
+        return keys;
+    }
+
+    std::vector<std::pair<key_t, std::string>> Records(size_t n, const std::string& value) {
+        std::vector<std::pair<key_t, std::string>> out;
+        out.reserve(n);
+        for (size_t i = 0; i < n; ++i) out.emplace_back(Next(), value);
+        return out;
+    }
+
+    uint64_t     records;
+    std::mt19937 rng;
+};
+
+struct Rates {
+    double get   = 0;   // lookups/s
+    double mget  = 0;   // keys/s in batches
+    double put   = 0;   // records/s in batches
+    double scan  = 0;   // MB/s
+};
+
+Rates RunInProcess(const Config& c, BPlusTree& tree) {
+    Rates r;
+    Keys keys(c);
+    std::string value(c.value_size, 'u');
+
+    auto start = Clock::now();
+    std::string out;
+    for (uint64_t i = 0; i < c.operations; ++i) Check(tree.Search(keys.Next(), out), "search");
+    r.get = c.operations / Seconds(start);
+
+    uint64_t batches = std::max<uint64_t>(1, c.operations / c.batch);
+    start = Clock::now();
+    std::vector<std::string> values;
+    for (uint64_t i = 0; i < batches; ++i) tree.MultiGet(keys.Batch(c.batch), values);
+    r.mget = batches * c.batch / Seconds(start);
+
+    start = Clock::now();
+    for (uint64_t i = 0; i < batches; ++i) {
+        Check(tree.InsertBatch(keys.Records(c.batch, value)), "insert batch");
+    }
+    r.put = batches * c.batch / Seconds(start);
+
+    size_t bytes = 0;
+    start = Clock::now();
+    Check(tree.Scan(0, static_cast<key_t>(c.records * 2), [&](key_t, std::string_view v) {
+        bytes += sizeof(key_t) + v.size();
+        return true;
+    }), "scan");
+    r.scan = bytes / Seconds(start) / 1e6;
+    return r;
+}
+
+void RunWire(const Config& c, uint16_t port, const Rates& base) {
+    Client client;
+    Check(client.Connect("127.0.0.1", port), "connect");
+    Keys keys(c);
+    std::string value(c.value_size, 'w');
+
+    // One request in flight: bounded by the loopback round trip.
+    uint64_t trips = std::max<uint64_t>(1, c.operations / 10);
+    auto start = Clock::now();
+    std::string out;
+    for (uint64_t i = 0; i < trips; ++i) Check(client.Get(keys.Next(), out), "get");
+    Report("GET, one at a time", trips / Seconds(start), "gets/s", base.get);
+
+    // `depth` single-key requests per flush.
+    uint64_t rounds = std::max<uint64_t>(1, c.operations / c.depth);
+    start = Clock::now();
+    ClientResponse resp;
+    for (uint64_t i = 0; i < rounds; ++i) {
+        for (size_t d = 0; d < c.depth; ++d) client.QueueGet({keys.Next()});
+        Check(client.Flush(), "flush");
+        for (size_t d = 0; d < c.depth; ++d) {
+            Check(client.Receive(resp), "receive");
+            Check(resp.statuses.empty() ? resp.status : resp.statuses[0], "pipelined get");
+        }
+    }
+    char name[64];
+    std::snprintf(name, sizeof(name), "GET, %zu pipelined", c.depth);
+    Report(name, rounds * c.depth / Seconds(start), "gets/s", base.get);
+
+    uint64_t batches = std::max<uint64_t>(1, c.operations / c.batch);
+    start = Clock::now();
+    std::vector<std::string> values;
+    std::vector<Status> statuses;
+    for (uint64_t i = 0; i < batches; ++i) {
+        Check(client.MultiGet(keys.Batch(c.batch), values, statuses), "multiget");
+    }
+    std::snprintf(name, sizeof(name), "GET, %zu keys per request", c.batch);
+    Report(name, batches * c.batch / Seconds(start), "keys/s", base.mget);
+
+    start = Clock::now();
+    for (uint64_t i = 0; i < batches; ++i) {
+        Check(client.PutBatch(keys.Records(c.batch, value)), "put batch");
+    }
+    std::snprintf(name, sizeof(name), "PUT, %zu records per request", c.batch);
+    Report(name, batches * c.batch / Seconds(start), "records/s", base.put);
+
+    size_t bytes = 0;
+    start = Clock::now();
+    Check(client.Scan(0, static_cast<key_t>(c.records * 2), [&](key_t, std::string_view v) {
+        bytes += sizeof(key_t) + v.size();
+        return true;
+    }), "scan");
+    Report("SCAN, streamed", bytes / Seconds(start) / 1e6, "MB/s", base.scan);
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+    Config c;
+    if (!ParseArgs(argc, argv, c)) {
+        Usage();
+        return 2;
+    }
+
+    RemoveFiles(c.file);
+    Options opts;
+    opts.pool_size        = c.pool_size;
+    opts.enable_wal       = c.wal != "off";
+    opts.wal_group_commit = c.wal == "group";
+    {
+        BPlusTree tree(c.file, opts);
+        std::string value(c.value_size, 'v');
+        uint64_t next = 0;
+        Check(tree.BulkLoad([&](key_t& key, std::string_view& v) {
+            if (next == c.records) return false;
+            key = static_cast<key_t>(next++) * 2;
+            v = value;
+            return true;
+        }), "bulk load");
+
+        std::printf("netbench: %llu records of %zu bytes, %llu operations, %u server threads\n\n",
+                    static_cast<unsigned long long>(c.records), c.value_size,
+                    static_cast<unsigned long long>(c.operations), c.threads);
+
+        std::printf("In-process\n");
+        Rates base = RunInProcess(c, tree);
+        Report("Search", base.get, "gets/s");
+        Report("MultiGet", base.mget, "keys/s");
+        Report("InsertBatch", base.put, "records/s");
+        Report("Scan", base.scan, "MB/s");
+
+        ServerOptions so;
+        so.port    = 0;
+        so.threads = c.threads;
+        Server server(tree, so);
+        Check(server.Start(), "server start");
+
+        std::printf("\nOver the wire (127.0.0.1:%u)\n", static_cast<unsigned>(server.Port()));
+        RunWire(c, server.Port(), base);
+        server.Stop();
+
+        ServerStats ss = server.Stats();
+        std::printf("\n  %zu requests, %.1f MB in, %.1f MB out\n",
+                    ss.requests, ss.bytes_in / 1e6, ss.bytes_out / 1e6);
+    }
+    RemoveFiles(c.file);
+    return 0;
+}
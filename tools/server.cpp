@@ -0,0 +1,105 @@
+/// @file server.cpp
+/// @brief Serves one index file over TCP (see bptree/server.h).
+///
+/// Runs until SIGINT or SIGTERM, then closes the connections and the tree
+/// and prints what it served.
+///
+/// @code
+///   ./build/tools/server --file=my_index.idx --port=7878 --threads=8
+/// @endcode
+
+#include "bptree/bplus_tree.h"
+#include "bptree/server.h"
+
+#include <csignal>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+
+#include <pthread.h>
+
+using namespace bptree;
+
+namespace {
+
+struct Config {
+    std::string   file = DEFAULT_INDEX_FILE;
+    ServerOptions server;
+    Options       tree;
+    std::string   wal  = "sync";  // off | sync | group
+};
+
+void Usage() {
+    std::cerr <<
+        "usage: server [--file=PATH] [--address=IPV4] [--port=N] [--threads=N]\n"
+        "              [--pool=FRAMES] [--shards=N] [--wal=off|sync|group]\n"
+        "              [--bloom-bits=N]\n";
+}
+
+/// Parse `--name=value` flags into @p c.  @return false on a bad flag.
+bool ParseArgs(int argc, char** argv, Config& c) {
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        size_t eq = arg.find('=');
+        std::string name  = arg.substr(0, eq);
+        std::string value = eq == std::string::npos ? "" : arg.substr(eq + 1);
+        auto number = [&] { return std::strtoull(value.c_str(), nullptr, 10); };
+
+        if (name == "--file")             { c.file = value;
+        } else if (name == "--address")   { c.server.address = value;
+        } else if (name == "--port")      { c.server.port = static_cast<uint16_t>(number());
+        } else if (name == "--threads")   { c.server.threads = static_cast<unsigned>(number());
+        } else if (name == "--pool")      { c.tree.pool_size = number();
+        } else if (name == "--shards")    { c.tree.pool_shards = number();
+        } else if (name == "--bloom-bits") { c.tree.bloom_bits_per_key = number();
+        } else if (name == "--wal") {
+            if (value != "off" && value != "sync" && value != "group") return false;
+            c.wal = value;
+        } else {
+            return false;
+        }
+    }
+    c.tree.enable_wal       = c.wal != "off";
+    c.tree.wal_group_commit = c.wal == "group";
+    return !c.file.empty();
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+    Config c;
+    if (!ParseArgs(argc, argv, c)) {
+        Usage();
+        return 2;
+    }
+
+    // Block the stop signals before any thread starts, so that they all
+    // inherit the mask and the signal is taken by sigwait below.
+    sigset_t stop;
+    sigemptyset(&stop);
+    sigaddset(&stop, SIGINT);
+    sigaddset(&stop, SIGTERM);
+    pthread_sigmask(SIG_BLOCK, &stop, nullptr);
+
+    BPlusTree tree(c.file, c.tree);
+    Server server(tree, c.server);
+    Status st = server.Start();
+    if (!st.ok()) {
+        std::cerr << "server: " << st.ToString() << "\n";
+        return 1;
+    }
+    std::printf("serving %s on %s:%u\n", c.file.c_str(), c.server.address.c_str(),
+                static_cast<unsigned>(server.Port()));
+    std::fflush(stdout);
+
+    int sig = 0;
+    sigwait(&stop, &sig);
+    server.Stop();
+
+    ServerStats ss = server.Stats();
+    std::printf("stopped: %zu connections, %zu requests, %zu bytes in, %zu bytes out\n",
+                ss.accepted, ss.requests, ss.bytes_in, ss.bytes_out);
+    return 0;
+}
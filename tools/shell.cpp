@@ -2,6 +2,7 @@
 /// @brief Interactive CLI shell for the B+ tree storage engine.
 
 #include "bptree/bplus_tree.h"
+#include "bptree/metrics.h"
 
 #include <iostream>
 #include <limits>
@@ -131,8 +132,8 @@ static void CmdBulkInsert(BPlusTree& tree) {
 
     int ok = 0;
     for (int i = 0; i < count; ++i) {
-        char buf[DATA_SIZE]{};
-        std::snprintf(buf, DATA_SIZE, pattern.c_str(), start + i);
+        char buf[256]{};
+        std::snprintf(buf, sizeof(buf), pattern.c_str(), start + i);
         if (tree.Insert(start + i, buf).ok()) ++ok;
         if ((i + 1) % 1000 == 0)
             std::cout << "    " << (i + 1) << " / " << count << "\r" << std::flush;
@@ -164,8 +165,7 @@ static void CmdStats(BPlusTree& tree) {
     std::cout << "\n  records:           " << all.size()
               << "\n  index file:        " << tree.FilePath()
               << "\n  page size:         " << PAGE_SIZE << " B"
-              << "\n  data size:         " << DATA_SIZE << " B"
-              << "\n  leaf capacity:     " << LEAF_MAX_KEYS
+              << "\n  max inline value:  " << LeafPage::kMaxInlineValue << " B"
               << "\n  internal capacity: " << INTERNAL_MAX_KEYS
               << "\n  buffer pool hits:  " << tree.BufferPoolHits()
               << "\n  buffer pool miss:  " << tree.BufferPoolMisses()
@@ -173,7 +173,29 @@ static void CmdStats(BPlusTree& tree) {
               << "\n  WAL enabled:       " << (tree.WALEnabled() ? "yes" : "no")
               << "\n  WAL bytes written: " << tree.WALBytesWritten()
               << "\n  WAL records:       " << tree.WALRecordsWritten()
+              << "\n  WAL syncs:         " << tree.WALSyncCount()
               << "\n";
+
+    if (tree.BufferPoolShards() > 1) {
+        for (size_t i = 0; i < tree.BufferPoolShards(); ++i) {
+            ShardStats st = tree.BufferPoolShardStats(i);
+            std::cout << "  shard " << i << ": hits " << st.hits
+                      << "  misses " << st.misses
+                      << "  evictions " << st.evictions
+                      << "  latch waits " << st.latch_contentions
+                      << "/" << st.latch_acquisitions << "\n";
+        }
+    }
+
+    MetricsSnapshot m = Metrics::Instance().Snapshot();
+    for (Histogram h : {Histogram::kSearch, Histogram::kInsert, Histogram::kDelete,
+                        Histogram::kRangeQuery, Histogram::kWALSync}) {
+        const HistogramSnapshot& hs = m.Get(h);
+        if (hs.count == 0) continue;
+        std::cout << "  " << HistogramName(h) << ": " << hs.count
+                  << " ops  p50 " << hs.Percentile(0.5) / 1000.0
+                  << " us  p99 " << hs.Percentile(0.99) / 1000.0 << " us\n";
+    }
 }
 
 // ---------------------------------------------------------------------------
@@ -0,0 +1,473 @@
+/// @file ycsb.cpp
+/// @brief YCSB-style workload benchmark for the B+ tree storage engine.
+///
+/// Loads `--records` keys, then runs `--operations` operations of one of
+/// the YCSB core workloads from `--threads` threads and prints one JSON
+/// object: throughput and per-operation latency percentiles.
+///
+///   A  50% read, 50% update               zipfian
+///   B  95% read,  5% update               zipfian
+///   C 100% read                           zipfian
+///   D  95% read,  5% insert               latest
+///   E  95% scan,  5% insert               zipfian  (scans of 1..100 records)
+///   F  50% read, 50% read-modify-write    zipfian
+///
+/// Every run is reproducible from its flags: each thread draws from its
+/// own generator seeded with `--seed` plus the thread number.  With
+/// `--cache=cold` the tree is closed after the load and its file dropped
+/// from the OS page cache before it is reopened; `--cache=warm` (default)
+/// runs `--warmup` unmeasured operations first instead.
+///
+/// @code
+///   ./build/tools/ycsb --workload=a --records=1000000 --threads=8
+///   ./build/tools/ycsb --workload=e --pool=16384 --wal=group --cache=cold
+/// @endcode
+
+#include "bptree/bplus_tree.h"
+#include "bptree/metrics.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cctype>
+#include <chrono>
+#include <climits>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <random>
+#include <sstream>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+using namespace bptree;
+using Clock = std::chrono::steady_clock;
+
+namespace {
+
+// ---------------------------------------------------------------------------
+// Configuration
+// ---------------------------------------------------------------------------
+
+enum class Distribution { kUniform, kZipfian, kLatest };
+enum class Op { kRead, kUpdate, kInsert, kScan, kReadModifyWrite, kCount };
+
+const char* const kOpNames[] = {"read", "update", "insert", "scan", "read_modify_write"};
+
+struct Workload {
+    char         name;
+    double       read, update, insert, scan, rmw;  // proportions, summing to 1
+    Distribution distribution;
+};
+
+constexpr Workload kWorkloads[] = {
+    {'a', 0.50, 0.50, 0,    0,    0,    Distribution::kZipfian},
+    {'b', 0.95, 0.05, 0,    0,    0,    Distribution::kZipfian},
+    {'c', 1.00, 0,    0,    0,    0,    Distribution::kZipfian},
+    {'d', 0.95, 0,    0.05, 0,    0,    Distribution::kLatest},
+    {'e', 0,    0,    0.05, 0.95, 0,    Distribution::kZipfian},
+    {'f', 0.50, 0,    0,    0,    0.50, Distribution::kZipfian},
+};
+
+struct Config {
+    Workload     workload     = kWorkloads[0];
+    Distribution distribution = Distribution::kZipfian;
+    bool         distribution_set = false;
+    uint64_t     records      = 100'000;
+    uint64_t     operations   = 100'000;
+    uint64_t     warmup       = 0;       // default: operations / 10
+    bool         warmup_set   = false;
+    unsigned     threads      = 1;
+    size_t       pool_size    = DEFAULT_POOL_SIZE;
+    size_t       pool_shards  = DEFAULT_POOL_SHARDS;
+    std::string  wal          = "sync";  // off | sync | group
+    uint32_t     group_latency_us = 0;
+    bool         direct       = false;
+    bool         cold         = false;
+    size_t       value_size   = 100;
+    int          max_scan     = 100;
+    unsigned     seed         = 1;
+    std::string  file         = "ycsb.idx";
+};
+
+const char* DistributionName(Distribution d) {
+    switch (d) {
+        case Distribution::kUniform: return "uniform";
+        case Distribution::kZipfian: return "zipfian";
+        case Distribution::kLatest:  return "latest";
+    }
+    return "?";
+}
+
+void Usage() {
+    std::cerr <<
+        "usage: ycsb [--workload=a|b|c|d|e|f] [--distribution=uniform|zipfian|latest]\n"
+        "            [--records=N] [--operations=N] [--warmup=N] [--threads=N]\n"
+        "            [--pool=FRAMES] [--shards=N] [--wal=off|sync|group]\n"
+        "            [--group-latency-us=N] [--direct] [--cache=warm|cold]\n"
+        "            [--value-size=BYTES] [--max-scan=N] [--seed=N] [--file=PATH]\n";
+}
+
+/// Parse `--name=value` flags into @p c.  @return false on a bad flag.
+bool ParseArgs(int argc, char** argv, Config& c) {
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        size_t eq = arg.find('=');
+        std::string name  = arg.substr(0, eq);
+        std::string value = eq == std::string::npos ? "" : arg.substr(eq + 1);
+        auto number = [&] { return std::strtoull(value.c_str(), nullptr, 10); };
+
+        if (name == "--workload" && value.size() == 1) {
+            auto it = std::find_if(std::begin(kWorkloads), std::end(kWorkloads),
+                                   [&](const Workload& w) { return w.name == std::tolower(value[0]); });
+            if (it == std::end(kWorkloads)) return false;
+            c.workload = *it;
+        } else if (name == "--distribution") {
+            if (value == "uniform")      c.distribution = Distribution::kUniform;
+            else if (value == "zipfian") c.distribution = Distribution::kZipfian;
+            else if (value == "latest")  c.distribution = Distribution::kLatest;
+            else return false;
+            c.distribution_set = true;
+        } else if (name == "--records")    { c.records = number();
+        } else if (name == "--operations") { c.operations = number();
+        } else if (name == "--warmup")     { c.warmup = number(); c.warmup_set = true;
+        } else if (name == "--threads")    { c.threads = static_cast<unsigned>(number());
+        } else if (name == "--pool")       { c.pool_size = number();
+        } else if (name == "--shards")     { c.pool_shards = number();
+        } else if (name == "--wal") {
+            if (value != "off" && value != "sync" && value != "group") return false;
+            c.wal = value;
+        } else if (name == "--group-latency-us") { c.group_latency_us = static_cast<uint32_t>(number());
+        } else if (name == "--direct")     { c.direct = true;
+        } else if (name == "--cache") {
+            if (value != "warm" && value != "cold") return false;
+            c.cold = value == "cold";
+        } else if (name == "--value-size") { c.value_size = number();
+        } else if (name == "--max-scan")   { c.max_scan = static_cast<int>(number());
+        } else if (name == "--seed")       { c.seed = static_cast<unsigned>(number());
+        } else if (name == "--file")       { c.file = value;
+        } else {
+            return false;
+        }
+    }
+    if (!c.distribution_set) c.distribution = c.workload.distribution;
+    if (!c.warmup_set) c.warmup = c.cold ? 0 : c.operations / 10;
+    return c.records > 0 && c.records < static_cast<uint64_t>(INT_MAX) / 2 &&
+           c.threads > 0 && c.max_scan > 0 && !c.file.empty();
+}
+
+Options TreeOptions(const Config& c) {
+    Options opts;
+    opts.pool_size                   = c.pool_size;
+    opts.pool_shards                 = c.pool_shards;
+    opts.enable_wal                  = c.wal != "off";
+    opts.wal_group_commit            = c.wal == "group";
+    opts.wal_group_commit_latency_us = c.group_latency_us;
+    if (c.direct) opts.disk_backend = DiskBackend::kDirect;
+    return opts;
+}
+
+void RemoveFiles(const std::string& file) {
+    std::remove(file.c_str());
+    std::remove((file + ".wal").c_str());
+}
+
+/// Drop @p file's clean pages from the OS page cache.
+void DropFromPageCache(const std::string& file) {
+    int fd = ::open(file.c_str(), O_RDONLY);
+    if (fd < 0) return;
+    ::fdatasync(fd);
+    ::posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED);
+    ::close(fd);
+}
+
+// ---------------------------------------------------------------------------
+// Key generators (after YCSB's)
+// ---------------------------------------------------------------------------
+
+/// Zipfian ranks in [0, n) with constant 0.99, rank 0 the most popular
+/// (Gray et al., "Quickly generating billion-record synthetic databases").
+class ZipfianGenerator {
+public:
+    static constexpr double kTheta = 0.99;
+
+    explicit ZipfianGenerator(uint64_t n) : n_(n) {
+        for (uint64_t i = 1; i <= n; ++i) zetan_ += 1.0 / std::pow(static_cast<double>(i), kTheta);
+        double zeta2 = 1.0 + 1.0 / std::pow(2.0, kTheta);
+        alpha_ = 1.0 / (1.0 - kTheta);
+        eta_   = (1.0 - std::pow(2.0 / static_cast<double>(n), 1.0 - kTheta)) /
+                 (1.0 - zeta2 / zetan_);
+    }
+
+    template <typename Rng>
+    uint64_t Next(Rng& rng) const {
+        double u  = std::uniform_real_distribution<double>(0.0, 1.0)(rng);
+        double uz = u * zetan_;
+        if (uz < 1.0) return 0;
+        if (uz < 1.0 + std::pow(0.5, kTheta)) return 1;
+        auto rank = static_cast<uint64_t>(
+            static_cast<double>(n_) * std::pow(eta_ * u - eta_ + 1.0, alpha_));
+        return std::min(rank, n_ - 1);
+    }
+
+private:
+    uint64_t n_;
+    double   zetan_ = 0;
+    double   alpha_ = 0;
+    double   eta_   = 0;
+};
+
+/// FNV-1a of @p v, so that popular zipfian ranks are spread over the key
+/// space instead of clustering at its start.
+uint64_t Scramble(uint64_t v) {
+    uint64_t h = 0xcbf29ce484222325ULL;
+    for (int i = 0; i < 8; ++i) {
+        h ^= v & 0xff;
+        h *= 0x100000001b3ULL;
+        v >>= 8;
+    }
+    return h;
+}
+
+// ---------------------------------------------------------------------------
+// Latency recording
+// ---------------------------------------------------------------------------
+
+/// One thread's latencies per operation, in the metrics histogram layout.
+struct Latencies {
+    HistogramSnapshot ops[static_cast<size_t>(Op::kCount)];
+
+    void Record(Op op, uint64_t nanos) {
+        HistogramSnapshot& h = ops[static_cast<size_t>(op)];
+        ++h.buckets[HistogramSnapshot::BucketOf(nanos)];
+        ++h.count;
+        h.sum += nanos;
+        h.max  = std::max(h.max, nanos);
+    }
+
+    void Merge(const Latencies& other) {
+        for (size_t i = 0; i < std::size(ops); ++i) {
+            ops[i].count += other.ops[i].count;
+            ops[i].sum   += other.ops[i].sum;
+            ops[i].max    = std::max(ops[i].max, other.ops[i].max);
+            for (int b = 0; b < HistogramSnapshot::kBuckets; ++b) {
+                ops[i].buckets[b] += other.ops[i].buckets[b];
+            }
+        }
+    }
+};
+
+// ---------------------------------------------------------------------------
+// Workload runner
+// ---------------------------------------------------------------------------
+
+class Runner {
+public:
+    Runner(const Config& config, BPlusTree& tree)
+        : c_(config), tree_(tree), zipf_(config.records), inserted_(config.records) {}
+
+    /// Run @p operations split over the threads; @return the wall time.
+    Clock::duration Run(uint64_t operations, unsigned seed, Latencies& total) {
+        std::vector<Latencies> per_thread(c_.threads);
+        std::vector<std::thread> workers;
+        auto start = Clock::now();
+        for (unsigned t = 0; t < c_.threads; ++t) {
+            uint64_t n = operations / c_.threads + (t < operations % c_.threads ? 1 : 0);
+            workers.emplace_back([this, n, t, seed, &per_thread] {
+                Worker(n, seed + t, per_thread[t]);
+            });
+        }
+        for (auto& w : workers) w.join();
+        auto elapsed = Clock::now() - start;
+        for (const Latencies& l : per_thread) total.Merge(l);
+        return elapsed;
+    }
+
+private:
+    /// The index of an existing record to operate on.
+    uint64_t NextIndex(std::mt19937_64& rng) const {
+        uint64_t count = inserted_.load(std::memory_order_relaxed);
+        switch (c_.distribution) {
+            case Distribution::kUniform:
+                return std::uniform_int_distribution<uint64_t>(0, count - 1)(rng);
+            case Distribution::kZipfian:
+                // Over the loaded records; inserted ones are cold.
+                return Scramble(zipf_.Next(rng)) % c_.records;
+            case Distribution::kLatest: {
+                uint64_t back = zipf_.Next(rng);
+                return back < count ? count - 1 - back : 0;
+            }
+        }
+        return 0;
+    }
+
+    Op NextOp(std::mt19937_64& rng) const {
+        const Workload& w = c_.workload;
+        double r = std::uniform_real_distribution<double>(0.0, 1.0)(rng);
+        if ((r -= w.read) < 0)   return Op::kRead;
+        if ((r -= w.update) < 0) return Op::kUpdate;
+        if ((r -= w.insert) < 0) return Op::kInsert;
+        if ((r -= w.scan) < 0)   return Op::kScan;
+        return w.rmw > 0 ? Op::kReadModifyWrite : Op::kRead;
+    }
+
+    void Worker(uint64_t operations, unsigned seed, Latencies& lat) {
+        std::mt19937_64 rng(seed);
+        std::string value(c_.value_size, '\0');
+        std::string read;
+        std::uniform_int_distribution<int> byte('a', 'z');
+        std::uniform_int_distribution<int> scan_len(1, c_.max_scan);
+
+        for (uint64_t i = 0; i < operations; ++i) {
+            Op op = NextOp(rng);
+            for (char& ch : value) ch = static_cast<char>(byte(rng));
+            auto start = Clock::now();
+            switch (op) {
+                case Op::kRead:
+                    tree_.Search(static_cast<key_t>(NextIndex(rng)), read);
+                    break;
+                case Op::kUpdate:
+                    tree_.Insert(static_cast<key_t>(NextIndex(rng)), value.data(), value.size());
+                    break;
+                case Op::kInsert: {
+                    uint64_t index = inserted_.fetch_add(1, std::memory_order_relaxed);
+                    tree_.Insert(static_cast<key_t>(index), value.data(), value.size());
+                    break;
+                }
+                case Op::kScan: {
+                    size_t seen = 0;
+                    tree_.Scan(static_cast<key_t>(NextIndex(rng)), INT_MAX,
+                               [&](key_t, std::string_view v) { seen += v.size(); return true; },
+                               static_cast<size_t>(scan_len(rng)));
+                    break;
+                }
+                case Op::kReadModifyWrite: {
+                    auto key = static_cast<key_t>(NextIndex(rng));
+                    tree_.Search(key, read);
+                    tree_.Insert(key, value.data(), value.size());
+                    break;
+                }
+                case Op::kCount:
+                    break;
+            }
+            lat.Record(op, static_cast<uint64_t>(
+                std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - start).count()));
+        }
+    }
+
+    const Config&         c_;
+    BPlusTree&            tree_;
+    ZipfianGenerator      zipf_;
+    std::atomic<uint64_t> inserted_;  ///< keys [0, inserted_) exist
+};
+
+double Ms(Clock::duration d) { return std::chrono::duration<double, std::milli>(d).count(); }
+
+/// Warm up, run the measured operations on @p tree and @return the report.
+std::string RunWorkload(const Config& c, BPlusTree& tree, double load_ms) {
+    Runner runner(c, tree);
+    Latencies warmup;
+    if (c.warmup > 0) runner.Run(c.warmup, c.seed + 1000003, warmup);
+
+    Metrics::Instance().Reset();
+    size_t syncs_before = tree.WALSyncCount();
+    size_t hits_before  = tree.BufferPoolHits();
+    size_t miss_before  = tree.BufferPoolMisses();
+
+    Latencies lat;
+    double run_ms = Ms(runner.Run(c.operations, c.seed, lat));
+
+    size_t hits = tree.BufferPoolHits() - hits_before;
+    size_t miss = tree.BufferPoolMisses() - miss_before;
+
+    std::ostringstream out;
+    out << "{\"workload\": \"" << c.workload.name << "\""
+        << ", \"distribution\": \"" << DistributionName(c.distribution) << "\""
+        << ", \"records\": " << c.records
+        << ", \"operations\": " << c.operations
+        << ", \"warmup\": " << c.warmup
+        << ", \"threads\": " << c.threads
+        << ", \"pool_size\": " << c.pool_size
+        << ", \"pool_shards\": " << c.pool_shards
+        << ", \"wal\": \"" << c.wal << "\""
+        << ", \"disk\": \"" << (c.direct ? "direct" : "mmap") << "\""
+        << ", \"cache\": \"" << (c.cold ? "cold" : "warm") << "\""
+        << ", \"value_size\": " << c.value_size
+        << ", \"seed\": " << c.seed
+        << ", \"load_ms\": " << load_ms
+        << ", \"run_ms\": " << run_ms
+        << ", \"throughput_ops\": " << (run_ms > 0 ? c.operations / run_ms * 1000 : 0)
+        << ", \"pool_hit_rate\": " << (hits + miss ? static_cast<double>(hits) / (hits + miss) : 0)
+        << ", \"wal_syncs\": " << tree.WALSyncCount() - syncs_before
+        << ", \"ops\": {";
+    bool first = true;
+    for (size_t i = 0; i < std::size(lat.ops); ++i) {
+        const HistogramSnapshot& h = lat.ops[i];
+        if (h.count == 0) continue;
+        out << (first ? "" : ", ") << '"' << kOpNames[i] << "\": {\"count\": " << h.count
+            << ", \"mean_us\": " << h.Mean() / 1000
+            << ", \"p50_us\": " << h.Percentile(0.5) / 1000.0
+            << ", \"p99_us\": " << h.Percentile(0.99) / 1000.0
+            << ", \"p999_us\": " << h.Percentile(0.999) / 1000.0
+            << ", \"max_us\": " << h.max / 1000.0 << '}';
+        first = false;
+    }
+    out << "}, \"metrics\": " << Metrics::Instance().Snapshot().ToJSON() << "}";
+    return out.str();
+}
+
+}  // namespace
+
+// ---------------------------------------------------------------------------
+// Main
+// ---------------------------------------------------------------------------
+
+int main(int argc, char** argv) {
+    Config c;
+    if (!ParseArgs(argc, argv, c)) {
+        Usage();
+        return 2;
+    }
+    RemoveFiles(c.file);
+
+    // Load: keys 0..records-1 in order, bottom-up.
+    auto load_start = Clock::now();
+    {
+        BPlusTree tree(c.file, TreeOptions(c));
+        std::mt19937_64 rng(c.seed);
+        std::string value(c.value_size, 'x');
+        uint64_t next = 0;
+        Status st = tree.BulkLoad([&](key_t& key, std::string_view& v) {
+            if (next == c.records) return false;
+            key = static_cast<key_t>(next++);
+            for (char& ch : value) ch = static_cast<char>('a' + rng() % 26);
+            v = value;
+            return true;
+        });
+        if (!st.ok()) {
+            std::cerr << "ycsb: load failed: " << st.ToString() << "\n";
+            return 1;
+        }
+    }
+    double load_ms = Ms(Clock::now() - load_start);
+    if (c.cold) {
+        DropFromPageCache(c.file);
+        DropFromPageCache(c.file + ".wal");
+    }
+
+    std::string report;
+    {
+        BPlusTree tree(c.file, TreeOptions(c));
+        report = RunWorkload(c, tree, load_ms);
+    }
+    std::cout << report << std::endl;
+
+    RemoveFiles(c.file);
+    return 0;
+}